@@ -1,6 +1,6 @@
 AC_DEFUN([QTHREAD_CHECK_SYSCALLTYPES],[
 AS_IF([test "x$1" = xyes],
-	  [AC_CHECK_DECLS([SYS_nanosleep,SYS_sleep,SYS_usleep,SYS_system,SYS_select,SYS_wait4,SYS_pread,SYS_connect,SYS_poll,SYS_read,SYS_write,SYS_pwrite],
+	  [AC_CHECK_DECLS([SYS_nanosleep,SYS_sleep,SYS_usleep,SYS_system,SYS_select,SYS_wait4,SYS_pread,SYS_connect,SYS_poll,SYS_read,SYS_write,SYS_pwrite,SYS_readv,SYS_writev,SYS_preadv,SYS_pwritev,SYS_recvmsg,SYS_sendmsg,SYS_splice,SYS_sendfile,SYS_copy_file_range],
     [],[],[[#include <sys/syscall.h>]])
 AC_CHECK_SIZEOF([socklen_t],[],[[#include <sys/socket.h>]])
 AS_IF([test "$ac_cv_sizeof_socklen_t" -eq 4],
@@ -34,4 +34,10 @@ AM_CONDITIONAL([HAVE_DECL_SYS_READ], [test "x$ac_cv_have_decl_SYS_read" == xyes]
 AM_CONDITIONAL([HAVE_DECL_SYS_WRITE], [test "x$ac_cv_have_decl_SYS_write" == xyes])
 AM_CONDITIONAL([HAVE_DECL_SYS_PWRITE], [test "x$ac_cv_have_decl_SYS_pwrite" == xyes])
 AM_CONDITIONAL([HAVE_DECL_SYS_POLL], [test "x$ac_cv_have_decl_SYS_poll" == xyes])
+AM_CONDITIONAL([HAVE_DECL_SYS_READV], [test "x$ac_cv_have_decl_SYS_readv" == xyes])
+AM_CONDITIONAL([HAVE_DECL_SYS_WRITEV], [test "x$ac_cv_have_decl_SYS_writev" == xyes])
+AM_CONDITIONAL([HAVE_DECL_SYS_PREADV], [test "x$ac_cv_have_decl_SYS_preadv" == xyes])
+AM_CONDITIONAL([HAVE_DECL_SYS_PWRITEV], [test "x$ac_cv_have_decl_SYS_pwritev" == xyes])
+AM_CONDITIONAL([HAVE_DECL_SYS_RECVMSG], [test "x$ac_cv_have_decl_SYS_recvmsg" == xyes])
+AM_CONDITIONAL([HAVE_DECL_SYS_SENDMSG], [test "x$ac_cv_have_decl_SYS_sendmsg" == xyes])
 ])
@@ -20,6 +20,9 @@ void INTERNAL qt_internal_aligned_free(void         *ptr,
                                             uint_fast16_t alignment);
 
 void INTERNAL qt_internal_alignment_init(void);
+/* Called once the shepherds exist; backends that build on qt_mpool create
+ * their pools here. */
+void INTERNAL qt_internal_alloc_init(void);
 
 #ifdef __INTEL_COMPILER
 # pragma warning (disable:191)
@@ -0,0 +1,12 @@
+#ifndef QT_ARENA_H
+#define QT_ARENA_H
+
+#include <qthread/qarena.h>
+
+#include "qt_visibility.h"
+
+/* destroys *arena, if there is one, and clears it */
+void INTERNAL qt_arena_release(qarena **arena);
+
+#endif // ifndef QT_ARENA_H
+/* vim:set expandtab: */
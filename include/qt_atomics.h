@@ -734,6 +734,30 @@ static QINLINE void *qt_internal_atomic_swap_ptr(void **addr,
     return oldval;
 } /*}}}*/
 
+#ifdef QTHREAD_ATOMIC_CAS128
+/* Double-width CAS. Both words at ptr are compared against oldv[0..1] and, if
+ * they match, replaced with newv[0..1]. Either way, oldv is updated to hold
+ * what was in memory, so a failed CAS doubles as an atomic 128-bit read.
+ * Returns non-zero on success. ptr MUST be 16-byte aligned. */
+static QINLINE int qt_cas128(uint64_t *const       ptr,
+                             uint64_t *const       oldv,
+                             const uint64_t *const newv)
+{   /*{{{*/
+    char result;
+
+    __asm__ __volatile__ ("lock; cmpxchg16b %0\n\t"
+                          "setz %1"
+                          : "+m" (*(volatile uint64_t (*)[2])ptr),
+                          "=q" (result),
+                          "+a" (oldv[0]),
+                          "+d" (oldv[1])
+                          : "b" (newv[0]),
+                          "c" (newv[1])
+                          : "cc", "memory");
+    return result;
+} /*}}}*/
+#endif /* ifdef QTHREAD_ATOMIC_CAS128 */
+
 #endif /* ifndef QT_ATOMICS_H */
 
 /* vim:set expandtab */
@@ -11,22 +11,31 @@
 typedef enum blocking_syscalls {
     ACCEPT,
     CONNECT,
+    COPY_FILE_RANGE,
     NANOSLEEP,
     POLL,
     READ,
     PREAD,
+    READV,
+    PREADV,
+    RECVMSG,
     /*RECV,
      * RECVFROM,*/
     SELECT,
+    SENDFILE,
+    SENDMSG,
     /*SEND,
      * SENDTO,*/
     /*SIGWAIT,*/
     SLEEP,
+    SPLICE,
     SYSTEM,
     USLEEP,
     WAIT4,
     WRITE,
     PWRITE,
+    WRITEV,
+    PWRITEV,
     USER_DEFINED
 } syscall_t;
 
@@ -36,12 +45,23 @@ typedef struct qthread_addrres_s {
     struct qthread_addrres_s *next;
 } qthread_addrres_t;
 
+/* Jobs submitted together by qt_io_batch(); the task is only woken once the
+ * last of them is done. */
+typedef struct _qt_blocking_batch_s {
+    aligned_t                         remaining;
+    struct _qt_blocking_queue_node_s *first; /* linked through batch_next */
+} qt_blocking_batch_t;
+
 typedef struct _qt_blocking_queue_node_s {
     struct _qt_blocking_queue_node_s *next;
     qthread_t                        *thread;
     syscall_t                         op;
-    uintptr_t                         args[5];
+    uintptr_t                         args[6];
     ssize_t                           ret;
+    int                               err; /* errno, if ret < 0 */
+    double                            queued_at; /* for the proxy pool's stats */
+    qt_blocking_batch_t              *batch; /* NULL unless part of a batch */
+    struct _qt_blocking_queue_node_s *batch_next;
 } qt_blocking_queue_node_t;
 
 typedef struct qthread_addrstat_s {
@@ -55,6 +75,8 @@ typedef struct qthread_addrstat_s {
 #endif
     uint_fast8_t          full;
     uint_fast8_t          valid;
+    uint_fast8_t          lingering; /* left in the hash while full (QT_FEB_LINGER) */
+    uint_fast8_t          hot;       /* went back to full since the last sweep */
 } qthread_addrstat_t;
 
 #ifdef UNPOOLED
@@ -0,0 +1,39 @@
+#ifndef QT_FEB_PROFILE_H
+#define QT_FEB_PROFILE_H
+
+#include <signal.h> /* for sig_atomic_t */
+
+#include "qt_visibility.h"
+#include "qt_qthread_t.h"
+#include "qthread/qtimer.h"
+
+/* Sampling period of the FEB contention profiler: one in every
+ * qt_feb_profile_period blocking FEB/syncvar waits is recorded. Zero means
+ * the profiler is off, which costs one load and branch per blocking wait. */
+extern unsigned long qt_feb_profile_period;
+/* Set by the QT_FEB_PROFILE_SIGNAL handler; the dump itself is done by the
+ * next worker to go through its scheduling loop. */
+extern volatile sig_atomic_t qt_feb_profile_dump_requested;
+
+void INTERNAL qt_feb_profile_subsystem_init(void);
+int INTERNAL  qt_feb_profile_sample(qthread_t *waiter);
+void INTERNAL qt_feb_profile_record(const void *addr,
+                                    qthread_t  *waiter,
+                                    double      start);
+void INTERNAL qt_feb_profile_dump_pending(void);
+
+#define QTHREAD_FEB_PROFILE_START(ME)                                    \
+    const double feb_profile_start = (qt_feb_profile_period &&           \
+                                      qt_feb_profile_sample(ME)) ?       \
+                                     qtimer_wtime() : 0.0
+#define QTHREAD_FEB_PROFILE_STOP(ADDR, ME)                               \
+    do { if (feb_profile_start != 0.0) {                                 \
+             qt_feb_profile_record((ADDR), (ME), feb_profile_start); } } \
+    while (0)
+
+#define QTHREAD_FEB_PROFILE_CHECK_DUMP()                                 \
+    do { if (qt_feb_profile_dump_requested) {                            \
+             qt_feb_profile_dump_pending(); } } while (0)
+
+#endif // ifndef QT_FEB_PROFILE_H
+/* vim:set expandtab: */
@@ -1,6 +1,11 @@
 #ifndef QT_HAZARDPTRS_H
 #define QT_HAZARDPTRS_H
 
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "qthread/qthread.h"           /* for aligned_t */
 #include "qt_visibility.h"
 
 #define HAZARD_PTRS_PER_SHEP 2
@@ -15,6 +20,34 @@ typedef struct {
     unsigned int             count;
 } hazard_freelist_t;
 
+#ifdef QTHREAD_EPOCH_RECLAMATION
+/* Epoch-based reclamation: a thread that calls hazardous_ptr() is "pinned" to
+ * the global epoch it saw until it has cleared all of its hazard pointers (or
+ * released a node, or its worker has gone back to the scheduler). Callers
+ * must clear their hazard pointers once done with a node, since threads that
+ * are not workers have no scheduler to do it for them. Retired nodes wait in
+ * the retiring thread's limbo list for their epoch, and are freed once the
+ * global epoch is two ahead of it, which it can only get to once every pinned
+ * thread has seen the epoch after. */
+# define HAZARD_EPOCHS 3
+
+typedef struct {
+    hazard_freelist_entry_t *freelist;
+    unsigned int             count;
+    unsigned int             size;
+    aligned_t                epoch;
+} hazard_limbo_t;
+
+typedef struct hazard_epoch_s {
+    volatile aligned_t     announce; /* (epoch << 1) | 1 while pinned, else 0 */
+    unsigned int           slots;    /* which hazard pointers are set */
+    unsigned int           nest;     /* hazardous_enter() depth */
+    unsigned int           retired;  /* since the last attempt to advance */
+    hazard_limbo_t         limbo[HAZARD_EPOCHS];
+    struct hazard_epoch_s *next;     /* for threads that are not workers */
+} hazard_epoch_t;
+#endif /* ifdef QTHREAD_EPOCH_RECLAMATION */
+
 void INTERNAL initialize_hazardptrs(void);
 void INTERNAL hazardous_ptr(unsigned int which,
                             void        *ptr);
@@ -23,5 +56,17 @@ typedef void (*hazardous_free_f)(void *arg);
 void INTERNAL hazardous_release_node(hazardous_free_f freefunc,
                                      void            *ptr);
 
+#ifdef QTHREAD_EPOCH_RECLAMATION
+/* brackets a traversal that reads nodes without publishing each of them */
+void INTERNAL hazardous_enter(void);
+void INTERNAL hazardous_exit(void);
+/* called by workers between tasks, when they cannot be holding any node */
+void INTERNAL hazardous_quiescent(void);
+#else
+# define hazardous_enter()
+# define hazardous_exit()
+# define hazardous_quiescent()
+#endif
+
 #endif // ifndef QT_HAZARDPTRS_H
 /* vim:set expandtab: */
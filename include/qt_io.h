@@ -8,9 +8,12 @@
 #include "qthread/io.h"
 
 /* Internal Headers */
+#include "qt_visibility.h"
 #include "qt_blocking_structs.h"
 #include "qt_qthread_struct.h"
 #include "qt_qthread_mgmt.h"
+#include "qt_threadqueues.h"
+#include "qt_atomics.h"
 #include "qt_debug.h"
 
 #if defined(UNPOOLED)
@@ -23,9 +26,49 @@
 
 extern qt_mpool syscall_job_pool;
 
+/* preadv(2) and pwritev(2) take the offset as two longs, low half first; on
+ * 64-bit platforms the kernel ignores the high one */
+#define QT_SYSCALL_OFFSET(o) (long)(o), (long)((uint64_t)(o) >> 32)
+
 void            qt_blocking_subsystem_init(void);
-int             qt_process_blocking_call(void);
+int             qt_process_blocking_call(qthread_shepherd_id_t home);
 void            qt_blocking_subsystem_enqueue(qt_blocking_queue_node_t *job);
+/* Queues the job for the proxy threads, bypassing io_uring and epoll. */
+void INTERNAL   qt_blocking_subsystem_enqueue_proxy(qt_blocking_queue_node_t *job);
+
+#ifdef QTHREAD_USE_IO_URING
+/* The io_uring backend: qt_io_uring_submit() hands the job to the kernel and
+ * returns 1, or returns 0 if the job has to go to a proxy thread instead
+ * (the ring is unavailable or full, or the kernel cannot do that call). With
+ * <defer> set, the job is only queued in the ring until the next submission
+ * or qt_io_uring_flush(), so that a batch costs one system call. */
+void INTERNAL qt_io_uring_init(void);
+int INTERNAL  qt_io_uring_submit(qt_blocking_queue_node_t *job,
+                                 int                       defer);
+void INTERNAL qt_io_uring_flush(void);
+#endif
+
+#ifdef QTHREAD_USE_IO_EPOLL
+/* The epoll reactor: qt_io_epoll_submit() takes socket calls (accept,
+ * connect, read and write), either finishing them on the spot or parking them
+ * until the socket is ready, and returns 1; it returns 0 for anything that
+ * has to go to a proxy thread instead. */
+void INTERNAL qt_io_epoll_init(void);
+int INTERNAL  qt_io_epoll_submit(qt_blocking_queue_node_t *job);
+#endif
+
+/* Called by whatever performed the job, once it is done with it: reschedules
+ * the task, unless it is waiting on other jobs in the same batch. The job
+ * belongs to the task again afterwards and must not be touched. */
+static inline void qt_blocking_complete(qt_blocking_queue_node_t *job)
+{
+    qthread_t *t = job->thread;
+
+    if ((job->batch != NULL) && (qthread_incr(&job->batch->remaining, -1) != 1)) {
+        return;
+    }
+    qt_threadqueue_enqueue(t->rdata->shepherd_ptr->ready, t);
+}
 
 static inline int qt_blockable(void)
 {
@@ -3,6 +3,8 @@
 
 #include <stddef.h>                    /* for size_t (according to C89) */
 
+#include <qthread/qpool.h>             /* for qpool_stats_t */
+
 typedef struct qt_mpool_s *qt_mpool;
 
 void *qt_mpool_alloc(qt_mpool pool);
@@ -14,8 +16,29 @@ void qt_mpool_free(qt_mpool pool,
 
 qt_mpool qt_mpool_create_aligned(size_t       item_size,
                                  const size_t alignment);
+/* Like qt_mpool_create_aligned(), but backs the blocks with huge pages if
+ * QT_HUGEPAGES is set. Blocks are then a multiple of the huge page size. */
+qt_mpool qt_mpool_create_huge(size_t item_size,
+                              size_t alignment);
+int      qt_mpool_is_huge(const qt_mpool pool);
 void qt_mpool_destroy(qt_mpool pool);
 
+/* Names show up in qt_mpool_stats_dump(); name must outlive the pool. */
+void qt_mpool_set_name(qt_mpool    pool,
+                       const char *name);
+void   qt_mpool_stats(qt_mpool       pool,
+                      qpool_stats_t *stats);
+size_t qt_mpool_stats_all(qpool_stats_t *stats,
+                          size_t         count);
+int qt_mpool_stats_dump(const char *filename);
+
+/* Returns the pages of entirely-free blocks to the OS; returns the number of
+ * bytes released. */
+size_t qt_mpool_trim(qt_mpool pool);
+size_t qt_mpool_trim_all(void);
+void   qt_mpool_set_high_water(qt_mpool pool,
+                               size_t   bytes);
+
 void qt_mpool_subsystem_init(void);
 
 #endif // ifndef QT_MPOOL_H
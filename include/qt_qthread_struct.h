@@ -50,11 +50,13 @@ struct qthread_runtime_data_s {
         qt_blocking_queue_node_t *io;
         qthread_t                *thread;
         qthread_queue_t           queue;
+        struct qt_timer_node_s   *timer;
     } blockedon;
     qthread_shepherd_t *shepherd_ptr;    /* the shepherd we run on */
     unsigned            tasklocal_size;
     int                 criticalsect; /* critical section depth */
     qt_barrier_t       *barrier;      /* add to allow barriers to be stacked/nested parallelism - akp 10/16/12 */
+    struct qarena_s    *arena;        /* qarena_task(), created on demand */
 
 #ifdef QTHREAD_USE_VALGRIND
     unsigned int valgrind_stack_id;
@@ -82,7 +84,7 @@ struct qthread_s {
     unsigned int               thread_id;
     qthread_shepherd_id_t      target_shepherd; /* the shepherd we'd rather run on; set to NO_SHEPHERD unless the thread either migrated or was spawned to a specific destination (aka the programmer expressed a desire for this thread to be somewhere) */
     uint16_t                   flags;           /* may not need all bits */
-    uint8_t                    thread_state : 4;
+    uint8_t                    thread_state : 5;
 
     Q_ALIGNED(8) uint8_t data[]; /* this is where we stick argcopy and tasklocal data */
 };
@@ -37,8 +37,12 @@ typedef struct qthread_shepherd_s qthread_shepherd_t;
 # define STEAL_BUFFER_LENGTH 128
 
 struct qthread_worker_s {
+#ifdef QTHREAD_EPOCH_RECLAMATION
+    hazard_epoch_t            hazard_epoch;
+#else
     uintptr_t                 hazard_ptrs[HAZARD_PTRS_PER_SHEP]; /* hazard pointers (see http://portal.acm.org/citation.cfm?id=987524.987595) */
     hazard_freelist_t         hazard_free_list;
+#endif
     pthread_t                 worker;
     qthread_shepherd_t       *shepherd;
     struct qthread_s        **nostealbuffer;
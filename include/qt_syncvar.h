@@ -17,7 +17,7 @@ typedef filter_code (*qt_syncvar_taskfilter_f)(qt_key_t            addr,
                                                qthread_t *restrict waiter,
                                                void *restrict      arg);
 
-void INTERNAL qt_syncvar_subsystem_init(uint_fast8_t need_sync);
+void INTERNAL qt_syncvar_subsystem_init(void);
 int API_FUNC  qthread_syncvar_writeEF_nb(syncvar_t *restrict const      dest,
                                          const uint64_t *restrict const src);
 int API_FUNC qthread_syncvar_writeEF_const_nb(syncvar_t *restrict const dest,
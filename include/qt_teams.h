@@ -42,6 +42,7 @@ typedef struct qt_team_s {
     unsigned int parent_id;
     qt_sinc_t   *parent_subteams_sinc;
     void        *return_loc;
+    struct qarena_s *volatile arena; /* qarena_team(), created on demand */
     uint_fast8_t flags;
 } qt_team_t;
 
@@ -16,6 +16,7 @@ typedef enum threadstate {
     QTHREAD_STATE_TERMINATED,           /* thread function returned */
     QTHREAD_STATE_MIGRATING,            /* thread needs to be moved, otherwise ready-to-run */
     QTHREAD_STATE_SYSCALL,              /* thread performing external blocking operation */
+    QTHREAD_STATE_SLEEPING,             /* insert me into the shepherd's timer wheel */
     QTHREAD_STATE_ILLEGAL,              /* illegal state */
     QTHREAD_STATE_TERM_SHEP,            /* special flag to terminate the shepherd */
     QTHREAD_STATE_NUM_STATES            /* tell performance data how many states there are */
@@ -0,0 +1,31 @@
+#ifndef QT_TIMERS_H
+#define QT_TIMERS_H
+
+/* Internal Headers */
+#include "qt_visibility.h"
+#include "qt_qthread_struct.h"
+#include "qt_shepherd_innards.h"
+
+/* A task that sleeps parks one of these, on its own stack, in its shepherd's
+ * timer wheel; the shepherd's workers put the task back in the ready queue
+ * once the deadline has passed. The nodes of qthread_spawn_after() and
+ * qthread_spawn_periodic() timers have no thread, and fork a task instead. */
+typedef struct qt_timer_node_s {
+    qthread_t               *thread;
+    uint64_t                 deadline; /* in ticks */
+    struct qt_timer_node_s  *next;
+    struct qt_timer_node_s **pprev;    /* NULL unless it is in a slot */
+} qt_timer_node_t;
+
+/* sleepers and timers in all of the wheels, so that shepherds without any can
+ * skip the clock */
+extern aligned_t qt_timers_pending;
+
+void INTERNAL qt_timer_subsystem_init(void);
+void INTERNAL qt_timer_sleep(uint64_t nsec);
+void INTERNAL qt_timer_park(qthread_shepherd_t *shep,
+                            qt_timer_node_t    *node);
+void INTERNAL qt_timer_advance(qthread_shepherd_t *shep);
+
+#endif // ifndef QT_TIMERS_H
+/* vim:set expandtab: */
@@ -1,11 +1,32 @@
 #ifndef QTHREAD_IO_H
 #define QTHREAD_IO_H
 
+#include <stddef.h>                    /* for size_t (according to C89) */
+
 #include <qthread/macros.h>
+#include <qthread/qthread-int.h>       /* for uint64_t */
 
 Q_STARTCXX
+/* A snapshot of the pool of proxy threads that perform blocking calls. It is
+ * read without synchronization, so it is only approximate while the pool is
+ * in use. */
+typedef struct qt_io_stats_s {
+    size_t   proxies;      /* proxy threads running */
+    size_t   idle_proxies; /* of those, waiting for work */
+    size_t   min_proxies;  /* kept running even when idle */
+    size_t   max_proxies;
+    size_t   queued;       /* jobs waiting for a proxy */
+    uint64_t jobs;         /* jobs the proxies have taken */
+    uint64_t coalesced;    /* of those, writes made with an earlier job's call */
+    uint64_t spawned;      /* proxy threads created */
+    uint64_t retired;      /* proxy threads that exited for lack of work */
+    double   wait_avg;     /* seconds jobs waited for a proxy, moving average */
+    double   wait_max;     /* seconds */
+} qt_io_stats_t;
+
 void qt_begin_blocking_action(void);
 void qt_end_blocking_action(void);
+void qt_io_stats(qt_io_stats_t *stats);
 Q_ENDCXX
 
 #endif
@@ -19,6 +19,11 @@ typedef struct dynmapinfo_s dynmapinfo_t;
  * allow you to decide how much memory to use for each allocation at runtime,
  * but have more overhead both in terms of space and time (also, they're very
  * fast to create, initially). */
+/* Both kinds of maps are divided into "streams": each thread allocates from
+ * one stream (threads are dealt streams round-robin), and only turns to the
+ * others when its own is exhausted, so threads on different streams allocate
+ * without contending with each other. Give a map at least as many streams as
+ * there are threads allocating from it. */
 
 /* The following functions are fairly straightforward. If the file specified
  * does not exist, it will be created. If the file specified does exist, it
@@ -41,6 +46,18 @@ void *qalloc_loadmap(const char *filename);
 /* This function sync's the mmap'd regions to disk. */
 void qalloc_checkpoint(void);
 
+/* This function sync's the next "bytes" bytes of the given map to disk (along
+ * with the map's allocation metadata), continuing where the previous call on
+ * that map left off. It returns the number of bytes left before the whole map
+ * has been sync'd, or 0 once it has (and the next call starts over). */
+size_t qalloc_checkpoint_incremental(void  *map,
+                                     size_t bytes);
+
+/* This function sync's just the pages holding the given block to disk. It
+ * returns 0 on success and -1 (setting errno) on failure, like msync(). */
+int qalloc_sync(const void *block,
+                size_t      size);
+
 /* This function performs a checkpoint, and then un-maps all of the currently
  * mapped regions */
 void qalloc_cleanup(void);
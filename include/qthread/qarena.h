@@ -0,0 +1,49 @@
+#ifndef QTHREAD_QARENA_H
+#define QTHREAD_QARENA_H
+
+#include <stddef.h>                    /* for size_t (according to C89) */
+
+#include <qthread/macros.h>
+
+Q_STARTCXX /* */
+
+typedef struct qarena_s qarena;
+
+/* Create an arena that grows in chunks of chunk_size bytes (0 means the
+ * default, 64kB) */
+qarena *qarena_create(size_t chunk_size);
+
+/* release everything allocated from the arena, and the arena itself */
+void qarena_destroy(qarena *arena);
+
+/* release everything allocated from the arena, but keep the arena (and one
+ * chunk) for reuse; must not race with allocations */
+void qarena_reset(qarena *arena);
+
+/* allocate size bytes, 16-byte aligned; safe to call concurrently */
+void *qarena_alloc(qarena *arena,
+                   size_t  size);
+void *qarena_alloc_aligned(qarena *arena,
+                           size_t  size,
+                           size_t  alignment);
+
+/* the calling task's arena, created on first use and destroyed when the task
+ * exits; NULL if the caller is not a task (e.g. a pthread the library did not
+ * create) */
+qarena *qarena_task(void);
+
+/* the calling task's team's arena, created on first use and destroyed when
+ * the team finishes; NULL outside of a team */
+qarena *qarena_team(void);
+
+/* typed allocation (types aligned to more than 16 bytes need
+ * qarena_alloc_aligned()) */
+#define QARENA_NEW(arena, type) \
+    ((type *)qarena_alloc((arena), sizeof(type)))
+#define QARENA_NEW_ARRAY(arena, type, count) \
+    ((type *)qarena_alloc((arena), sizeof(type) * (count)))
+
+Q_ENDCXX /* */
+
+#endif // ifndef QTHREAD_QARENA_H
+/* vim:set expandtab: */
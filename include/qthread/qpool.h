@@ -4,11 +4,30 @@
 #include <stddef.h>                    /* for size_t (according to C89) */
 
 #include <qthread/macros.h>
+#include <qthread/qthread-int.h>       /* for uint64_t */
 
 Q_STARTCXX /* */
 
 typedef struct qt_mpool_s qpool;
 
+/* A snapshot of a pool's usage; counts are in items unless noted. The
+ * per-worker parts are read without synchronization, so they are only
+ * approximate while the pool is in use. */
+typedef struct qpool_stats_s {
+    const char  *name;            /* NULL for unnamed pools */
+    size_t       item_size;       /* bytes, after alignment padding */
+    size_t       items_per_block;
+    size_t       block_bytes;     /* bytes, including any per-node header */
+    size_t       blocks;          /* blocks obtained from the system */
+    size_t       trimmed_blocks;  /* blocks released by trimming, not yet reused */
+    size_t       outstanding;     /* allocated and not yet freed */
+    size_t       cached;          /* free, in per-worker caches */
+    size_t       reusable;        /* free, in the shared free lists */
+    uint64_t     allocs;
+    uint64_t     frees;
+    unsigned int huge_pages;      /* 0: none, 1: transparent, 2: hugetlb */
+} qpool_stats_t;
+
 void *qpool_alloc(qpool *pool);
 
 void qpool_free(qpool *restrict pool,
@@ -20,6 +39,19 @@ qpool *qpool_create_aligned(const size_t item_size,
 
 void qpool_destroy(qpool *pool);
 
+size_t qpool_trim(qpool *pool);
+size_t qpool_trim_all(void);
+void   qpool_set_high_water(qpool *pool,
+                            size_t bytes);
+
+void   qpool_set_name(qpool      *pool,
+                      const char *name);
+void   qpool_stats(qpool         *pool,
+                   qpool_stats_t *stats);
+size_t qpool_stats_all(qpool_stats_t *stats,
+                       size_t         count);
+int    qpool_stats_dump(const char *filename);
+
 Q_ENDCXX /* */
 
 #endif // ifndef QPOOL_H
@@ -3,9 +3,12 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>      /* for struct iovec */
 #include <sys/select.h>   /* for fd_set */
 #include <sys/resource.h> /* for struct rusage */
 #include <poll.h>         /* for struct pollfd and nfds_t */
+#include <time.h>         /* for struct timespec */
+#include <unistd.h>       /* for useconds_t */
 
 #include <qthread/macros.h>
 
@@ -17,6 +20,14 @@ int qt_accept(int                       socket,
 int qt_connect(int                    socket,
                const struct sockaddr *address,
                socklen_t              address_len);
+ssize_t qt_copy_file_range(int          fd_in,
+                           off_t       *off_in,
+                           int          fd_out,
+                           off_t       *off_out,
+                           size_t       len,
+                           unsigned int flags);
+int qt_nanosleep(const struct timespec *rqtp,
+                 struct timespec       *rmtp);
 int qt_poll(struct pollfd fds[],
             nfds_t        nfds,
             int           timeout);
@@ -31,12 +42,37 @@ ssize_t qt_pwrite(int         filedes,
 ssize_t qt_read(int    filedes,
                 void  *buf,
                 size_t nbyte);
+ssize_t qt_readv(int                 filedes,
+                 const struct iovec *iov,
+                 int                 iovcnt);
+ssize_t qt_preadv(int                 filedes,
+                  const struct iovec *iov,
+                  int                 iovcnt,
+                  off_t               offset);
+ssize_t qt_recvmsg(int            socket,
+                   struct msghdr *message,
+                   int            flags);
 int qt_select(int                      nfds,
               fd_set *restrict         readfds,
               fd_set *restrict         writefds,
               fd_set *restrict         errorfds,
               struct timeval *restrict timeout);
+ssize_t qt_sendfile(int    out_fd,
+                    int    in_fd,
+                    off_t *offset,
+                    size_t count);
+ssize_t qt_sendmsg(int                  socket,
+                   const struct msghdr *message,
+                   int                  flags);
+unsigned int qt_sleep(unsigned int seconds);
+ssize_t qt_splice(int          fd_in,
+                  off_t       *off_in,
+                  int          fd_out,
+                  off_t       *off_out,
+                  size_t       len,
+                  unsigned int flags);
 int   qt_system(const char *command);
+int   qt_usleep(useconds_t useconds);
 pid_t qt_wait4(pid_t          pid,
                int           *stat_loc,
                int            options,
@@ -44,6 +80,39 @@ pid_t qt_wait4(pid_t          pid,
 ssize_t qt_write(int         filedes,
                  const void *buf,
                  size_t      nbyte);
+ssize_t qt_writev(int                 filedes,
+                  const struct iovec *iov,
+                  int                 iovcnt);
+ssize_t qt_pwritev(int                 filedes,
+                   const struct iovec *iov,
+                   int                 iovcnt,
+                   off_t               offset);
+
+/* Several reads and writes submitted at once: the calling task is only
+ * descheduled once, and wakes up when all of them are done. */
+enum qt_io_op {
+    QT_IO_READ,
+    QT_IO_WRITE,
+    QT_IO_PREAD,
+    QT_IO_PWRITE,
+    QT_IO_READV,
+    QT_IO_WRITEV,
+    QT_IO_PREADV,
+    QT_IO_PWRITEV
+};
+
+typedef struct qt_io_request_s {
+    enum qt_io_op op;
+    int           fd;
+    void         *buf;    /* a struct iovec array for the vectored ops */
+    size_t        count;  /* bytes, or iovec entries for the vectored ops */
+    off_t         offset; /* only for the positional ops */
+    ssize_t       ret;    /* what the call returned */
+    int           err;    /* errno, if ret < 0 */
+} qt_io_request_t;
+
+int qt_io_batch(qt_io_request_t *reqs,
+                size_t           count);
 
 #ifdef USE_HEADER_SYSCALLS
 # define accept(s, a, l)       qt_accept((s), (a), (l))
@@ -52,10 +121,16 @@ ssize_t qt_write(int         filedes,
 # define pread(f, b, n, o)     qt_pread((f), (b), (n), (o))
 # define pwrite(f, b, n, o)    qt_pwrite((f), (b), (n), (o))
 # define read(f, b, n)         qt_read((f), (b), (n))
+# define readv(f, v, n)        qt_readv((f), (v), (n))
+# define preadv(f, v, n, o)    qt_preadv((f), (v), (n), (o))
+# define recvmsg(s, m, f)      qt_recvmsg((s), (m), (f))
+# define sendmsg(s, m, f)      qt_sendmsg((s), (m), (f))
 # define select(n, r, w, e, t) qt_select((n), (r), (w), (e), (t))
 # define system(c)             qt_system((c))
 # define wait4(p, s, o, r)     qt_wait4((p), (s), (o), (r))
 # define write(f, b, n)        qt_write((f), (b), (n))
+# define writev(f, v, n)       qt_writev((f), (v), (n))
+# define pwritev(f, v, n, o)   qt_pwritev((f), (v), (n), (o))
 #endif // ifdef USE_HEADER_SYSCALLS
 
 Q_ENDCXX /* */
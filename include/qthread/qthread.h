@@ -116,6 +116,24 @@ typedef struct _syncvar_s {
 #define SYNCVAR_INITIALIZE_TO(value)              ((syncvar_t)SYNCVAR_STATIC_INITIALIZE_TO(value))
 #define SYNCVAR_EMPTY_INITIALIZE_TO(value)        ((syncvar_t)SYNCVAR_STATIC_EMPTY_INITIALIZE_TO(value))
 
+/* A 128-bit syncvar keeps the full 64-bit payload in its own word; the second
+ * word holds the lock bit, the FEB state, and (internally) a pointer to the
+ * record of any blocked waiters. It must be 16-byte aligned, because all state
+ * transitions are done with a double-width compare-and-swap. */
+typedef struct _syncvar128_s {
+    uint64_t data;
+    uint64_t state;
+} Q_ALIGNED (16) syncvar128_t;
+
+#define SYNCVAR128_STATIC_INITIALIZER                { 0, 0 }
+#define SYNCVAR128_STATIC_EMPTY_INITIALIZER          { 0, 4 }
+#define SYNCVAR128_STATIC_INITIALIZE_TO(value)       { (value), 0 }
+#define SYNCVAR128_STATIC_EMPTY_INITIALIZE_TO(value) { (value), 4 }
+#define SYNCVAR128_INITIALIZER                       ((syncvar128_t)SYNCVAR128_STATIC_INITIALIZER)
+#define SYNCVAR128_EMPTY_INITIALIZER                 ((syncvar128_t)SYNCVAR128_STATIC_EMPTY_INITIALIZER)
+#define SYNCVAR128_INITIALIZE_TO(value)              ((syncvar128_t)SYNCVAR128_STATIC_INITIALIZE_TO(value))
+#define SYNCVAR128_EMPTY_INITIALIZE_TO(value)        ((syncvar128_t)SYNCVAR128_STATIC_EMPTY_INITIALIZE_TO(value))
+
 #define INT64TOINT60(x)       ((uint64_t)((x) & (uint64_t)0xfffffffffffffffULL))
 #define INT60TOINT64(x)       ((int64_t)(((x) & (uint64_t)0x800000000000000ULL) ? ((x) | (uint64_t)0xf800000000000000ULL) : (x)))
 #define DBL64TODBL60(in, out) do { memcpy(&(out), &(in), 8); out >>= 4; } while (0)
@@ -297,6 +315,22 @@ int qthread_spawn(qthread_f             f,
                   qthread_shepherd_id_t target_shep,
                   unsigned int          feature_flag);
 
+/* These fork f(arg) from a timer: qthread_spawn_after() forks it once, <delay>
+ * nanoseconds from now, and qthread_spawn_periodic() forks it every <period>
+ * nanoseconds, starting one period from now. Both return a handle that must be
+ * passed to qthread_timer_cancel() exactly once, whether or not the timer has
+ * gone off, or NULL on failure. */
+typedef struct qthread_timer_s qthread_timer_t;
+
+qthread_timer_t *qthread_spawn_after(uint64_t    delay,
+                                     qthread_f   f,
+                                     const void *arg,
+                                     aligned_t  *ret);
+qthread_timer_t *qthread_spawn_periodic(uint64_t    period,
+                                        qthread_f   f,
+                                        const void *arg);
+int qthread_timer_cancel(qthread_timer_t *timer);
+
 /* This is a function to move a thread from one shepherd to another. */
 int qthread_migrate_to(const qthread_shepherd_id_t shepherd);
 
@@ -429,6 +463,17 @@ int       qthread_queue_destroy(qthread_queue_t q);
 int qthread_feb_status(const aligned_t *addr);
 int qthread_syncvar_status(syncvar_t *const v);
 
+/* FEB contention profiling. When the QT_FEB_PROFILE environment variable is
+ * set to N > 0, one in every N blocking FEB and syncvar waits is recorded,
+ * keyed by address and waiting task function. This writes the records,
+ * hottest address first, to the named file (or stderr if NULL) and returns
+ * QTHREAD_NOT_ALLOWED if the profiler is off. */
+#define QTHREAD_FEB_PROFILE_CSV  0
+#define QTHREAD_FEB_PROFILE_JSON 1
+int  qthread_feb_profile_dump(const char *filename,
+                              int         format);
+void qthread_feb_profile_reset(void);
+
 /* The empty/fill functions merely assert the empty or full state of the given
  * address. */
 int qthread_empty(const aligned_t *dest);
@@ -1344,6 +1389,52 @@ static QINLINE int64_t qthread_incr_xx(void   *addr,
 uint64_t qthread_syncvar_incrF(syncvar_t *restrict operand,
                                uint64_t            inc);
 
+/* Atomic read-modify-write operations on syncvars. Each of these waits for
+ * the syncvar to be full, applies the operation, and leaves it full, without
+ * ever passing through the empty state (so waiters are not woken). All of them
+ * return the value the syncvar held beforehand. Operands (and results) are
+ * truncated to the 60 bits a syncvar can hold; min and max are unsigned. */
+uint64_t qthread_syncvar_fetch_addF(syncvar_t *restrict operand,
+                                    uint64_t            val);
+uint64_t qthread_syncvar_fetch_andF(syncvar_t *restrict operand,
+                                    uint64_t            val);
+uint64_t qthread_syncvar_fetch_orF(syncvar_t *restrict operand,
+                                   uint64_t            val);
+uint64_t qthread_syncvar_fetch_xorF(syncvar_t *restrict operand,
+                                    uint64_t            val);
+uint64_t qthread_syncvar_fetch_minF(syncvar_t *restrict operand,
+                                    uint64_t            val);
+uint64_t qthread_syncvar_fetch_maxF(syncvar_t *restrict operand,
+                                    uint64_t            val);
+uint64_t qthread_syncvar_swapF(syncvar_t *restrict operand,
+                               uint64_t            val);
+/* stores newval only if the syncvar currently holds oldval */
+uint64_t qthread_syncvar_cmpxchgF(syncvar_t *restrict operand,
+                                  uint64_t            oldval,
+                                  uint64_t            newval);
+
+/* The 128-bit syncvar versions of the syncvar functions. These have exactly
+ * the same semantics as their 64-bit counterparts above, but do not restrict
+ * the value to 60 bits (so, e.g., a double can be stored with memcpy() rather
+ * than with DBL64TODBL60()). */
+int qthread_syncvar128_status(syncvar128_t *const v);
+int qthread_syncvar128_empty(syncvar128_t *restrict dest);
+int qthread_syncvar128_fill(syncvar128_t *restrict dest);
+int qthread_syncvar128_writeEF(syncvar128_t *restrict   dest,
+                               const uint64_t *restrict src);
+int qthread_syncvar128_writeEF_const(syncvar128_t *restrict dest,
+                                     uint64_t               src);
+int qthread_syncvar128_writeF(syncvar128_t *restrict   dest,
+                              const uint64_t *restrict src);
+int qthread_syncvar128_writeF_const(syncvar128_t *restrict dest,
+                                    uint64_t               src);
+int qthread_syncvar128_readFF(uint64_t *restrict     dest,
+                              syncvar128_t *restrict src);
+int qthread_syncvar128_readFE(uint64_t *restrict     dest,
+                              syncvar128_t *restrict src);
+uint64_t qthread_syncvar128_incrF(syncvar128_t *restrict operand,
+                                  uint64_t               inc);
+
 #if !defined(QTHREAD_ATOMIC_CAS) || defined(QTHREAD_MUTEX_INCREMENT)
 static QINLINE uint32_t qthread_cas32(uint32_t *operand,
                                       uint32_t  oldval,
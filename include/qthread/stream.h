@@ -0,0 +1,43 @@
+#ifndef QTHREAD_STREAM_H
+#define QTHREAD_STREAM_H
+
+#include <sys/types.h>                 /* for off_t and ssize_t */
+
+#include <qthread/macros.h>
+
+Q_STARTCXX /* */
+
+/* A reader that keeps the next few chunks of a file in flight while the
+ * caller works on the current one. */
+typedef struct qt_stream_s qt_stream_t;
+
+typedef struct qt_stream_chunk_s {
+    const void *data;
+    size_t      len;
+    off_t       offset; /* in the file */
+    size_t      slot;   /* for qt_stream_release() */
+} qt_stream_chunk_t;
+
+/* Start reading <fd> from <offset> in chunks of <chunk_size> bytes, with
+ * up to <depth> chunks read ahead (returns NULL and sets errno on failure) */
+qt_stream_t *qt_stream_open(int    fd,
+                            off_t  offset,
+                            size_t chunk_size,
+                            size_t depth);
+
+/* Wait for the next chunk, in file order; returns its length, 0 at the end
+ * of the file, or -1 with errno set if it could not be read */
+ssize_t qt_stream_next(qt_stream_t       *s,
+                       qt_stream_chunk_t *chunk);
+
+/* Give a chunk's buffer back, so that it can be used to read ahead */
+void qt_stream_release(qt_stream_t       *s,
+                       qt_stream_chunk_t *chunk);
+
+/* Wait for the reads in flight and free the stream (the file stays open) */
+int qt_stream_close(qt_stream_t *s);
+
+Q_ENDCXX /* */
+
+#endif // ifndef QTHREAD_STREAM_H
+/* vim:set expandtab: */
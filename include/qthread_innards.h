@@ -127,6 +127,7 @@ typedef struct qlib_s {
 } *qlib_t;
 
 extern qlib_t qlib;
+extern int    qaffinity;
 
 void INTERNAL qthread_exec(qthread_t    *t,
                            qt_context_t *c);
@@ -34,6 +34,7 @@ my %config = (
     sinc_stats    => '--enable-profiling=sincs',
     oversubscription => '--enable-oversubscription',
     guard_pages => '--enable-guard-pages',
+    epoch       => '--with-reclamation=epoch --enable-lf-febs',
     chapel_default => '--enable-static --disable-shared --enable-condwait-queue --disable-spawn-cache --with-scheduler=nemesis',
 );
 
@@ -44,6 +44,8 @@ void qt_internal_alignment_init(void) {
   _pagesize = getpagesize();
 }
 
+void qt_internal_alloc_init(void) {}
+
 void *qt_internal_aligned_alloc(size_t        alloc_size,
                                      uint_fast16_t alignment) {
   return chpl_mem_memalign(alignment, alloc_size, CHPL_RT_MD_TASK_LAYER_UNSPEC,
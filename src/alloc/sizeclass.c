@@ -0,0 +1,253 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h> /* for memcpy() and memset() */
+/* System Headers */
+#if (HAVE_MEMALIGN && HAVE_MALLOC_H)
+# include <malloc.h> /* for memalign() */
+#endif
+#ifdef HAVE_GETPAGESIZE
+# include <unistd.h>
+#else
+static QINLINE int getpagesize()
+{
+  return 4096;
+}
+#endif
+
+#include <qthread/qthread-int.h> /* for uintptr_t */
+
+/* Internal Headers */
+#include "qt_alloc.h"
+#include "qt_mpool.h"
+#include "qt_asserts.h"
+#include "qt_debug.h"
+#include "qt_expect.h"
+
+/* A size-class allocator: requests of up to QT_SIZECLASS_MAX bytes (header
+ * included) are served from one qt_mpool per class, so the common case is a
+ * pop from the calling worker's cache with no shared state touched. Larger
+ * requests, and anything allocated before qthread_initialize() has created
+ * the pools, go to libc. Every allocation is preceded by a header naming
+ * its class, so qt_free() needs no lookup.
+ *
+ * Classes are 16, 32, 48, 64 and then two per power of two (96, 128, 192,
+ * 256, ...), which bounds the internal waste at a third. */
+
+#define QT_SIZECLASS_COUNT 22
+#define QT_SIZECLASS_MAX   32768
+#define QT_SIZECLASS_LIBC  0xffffffffu
+
+typedef union qt_sizeclass_header_u {
+  struct {
+    size_t   size;  /* as requested, for qt_realloc() */
+    uint32_t cls;
+  } h;
+  uint8_t pad[16];  /* keeps the 16-byte alignment malloc() guarantees */
+} qt_sizeclass_header_t;
+
+static qt_mpool          qt_sizeclass_pools[QT_SIZECLASS_COUNT];
+static volatile int      qt_sizeclass_ready = 0;
+static const char *const qt_sizeclass_names[QT_SIZECLASS_COUNT] = {
+  "qt_malloc_16", "qt_malloc_32", "qt_malloc_48", "qt_malloc_64",
+  "qt_malloc_96", "qt_malloc_128", "qt_malloc_192", "qt_malloc_256",
+  "qt_malloc_384", "qt_malloc_512", "qt_malloc_768", "qt_malloc_1024",
+  "qt_malloc_1536", "qt_malloc_2048", "qt_malloc_3072", "qt_malloc_4096",
+  "qt_malloc_6144", "qt_malloc_8192", "qt_malloc_12288", "qt_malloc_16384",
+  "qt_malloc_24576", "qt_malloc_32768"
+};
+
+/* local constants */
+size_t _pagesize = 0;
+
+static QINLINE size_t qt_sizeclass_size(unsigned int cls)
+{
+  unsigned int b;
+
+  if (cls < 4) { return 16 * (cls + 1); }
+  b = 6 + (cls - 4) / 2;
+  return (cls & 1) ? ((size_t)1 << (b + 1)) : ((size_t)3 << (b - 1));
+}
+
+/* n must be in (0, QT_SIZECLASS_MAX] */
+static QINLINE unsigned int qt_sizeclass_index(size_t n)
+{
+  unsigned int b;
+
+  if (n <= 64) { return (unsigned int)((n + 15) / 16) - 1; }
+  /* b = floor(log2(n - 1)), so that 2^b < n <= 2^(b+1) */
+#ifdef __GNUC__
+  b = (unsigned int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long)(n - 1));
+#else
+  for (b = 6; ((size_t)2 << b) < n; b++) ;
+#endif
+  return 4 + 2 * (b - 6) + (n > ((size_t)3 << (b - 1)));
+}
+
+void *qt_malloc(size_t size){
+  const size_t           n = size + sizeof(qt_sizeclass_header_t);
+  qt_sizeclass_header_t *h;
+
+  if (QTHREAD_UNLIKELY(n < size)) { return NULL; }
+  if (QTHREAD_LIKELY(qt_sizeclass_ready && (n <= QT_SIZECLASS_MAX))) {
+    const unsigned int cls = qt_sizeclass_index(n);
+
+    h = qt_mpool_alloc(qt_sizeclass_pools[cls]);
+    if (h == NULL) { return NULL; }
+    h->h.cls = cls;
+  } else {
+    h = malloc(n);
+    if (h == NULL) { return NULL; }
+    h->h.cls = QT_SIZECLASS_LIBC;
+  }
+  h->h.size = size;
+  return h + 1;
+}
+
+void qt_free(void *ptr){
+  qt_sizeclass_header_t *h;
+
+  if (ptr == NULL) { return; }
+  h = (qt_sizeclass_header_t *)ptr - 1;
+  if (h->h.cls == QT_SIZECLASS_LIBC) {
+    free(h);
+  } else {
+    assert(h->h.cls < QT_SIZECLASS_COUNT);
+    qt_mpool_free(qt_sizeclass_pools[h->h.cls], h);
+  }
+}
+
+void *qt_calloc(size_t nmemb, size_t size) {
+  void *ret;
+
+  if (size && (nmemb > SIZE_MAX / size)) { return NULL; }
+  ret = qt_malloc(nmemb * size);
+  if (ret) { memset(ret, 0, nmemb * size); }
+  return ret;
+}
+
+void *qt_realloc(void *ptr, size_t size) {
+  qt_sizeclass_header_t *h;
+  void                  *ret;
+
+  if (ptr == NULL) { return qt_malloc(size); }
+  h = (qt_sizeclass_header_t *)ptr - 1;
+  if ((h->h.cls != QT_SIZECLASS_LIBC) &&
+      (size + sizeof(qt_sizeclass_header_t) <= qt_sizeclass_size(h->h.cls)) &&
+      (size + sizeof(qt_sizeclass_header_t) > qt_sizeclass_size(h->h.cls) / 2)) {
+    /* still fits, and not so small that it should move down */
+    h->h.size = size;
+    return ptr;
+  }
+  ret = qt_malloc(size);
+  if (ret == NULL) { return NULL; }
+  memcpy(ret, ptr, (size < h->h.size) ? size : h->h.size);
+  qt_free(ptr);
+  return ret;
+}
+
+void qt_internal_alignment_init(void)
+{
+    _pagesize = getpagesize();
+}
+
+/* Called once the shepherds exist, so the pools get per-worker caches. The
+ * pools are never destroyed: memory from them may be freed after
+ * qthread_finalize(), and a later qthread_initialize() reuses them. */
+void qt_internal_alloc_init(void)
+{
+  if (qt_sizeclass_ready) { return; }
+  for (unsigned int i = 0; i < QT_SIZECLASS_COUNT; i++) {
+    qt_sizeclass_pools[i] = qt_mpool_create_aligned(qt_sizeclass_size(i), 16);
+    assert(qt_sizeclass_pools[i]);
+    qt_mpool_set_name(qt_sizeclass_pools[i], qt_sizeclass_names[i]);
+  }
+  qt_sizeclass_ready = 1;
+}
+
+/* The aligned allocator stays on libc: qt_mpool gets its blocks and its
+ * bookkeeping from here. */
+void *qt_internal_aligned_alloc(size_t        alloc_size,
+                                     uint_fast16_t alignment)
+{
+    void *ret;
+
+    assert(alloc_size > 0);
+    switch (alignment) {
+        case 0:
+            ret = malloc(alloc_size);
+            break;
+#if defined(HAVE_16ALIGNED_MALLOC)
+        case 16:
+        case 8:
+        case 4:
+        case 2:
+            ret = malloc(alloc_size);
+            break;
+#endif
+        default:
+#if defined(HAVE_WORKING_VALLOC)
+            if (alignment == pagesize) {
+                ret = valloc(alloc_size);
+                break;
+            }
+#elif defined(HAVE_PAGE_ALIGNED_MALLOC)
+            if (alignment == pagesize) {
+                ret = malloc(alloc_size);
+                break;
+            }
+#endif
+#if defined(HAVE_MEMALIGN)
+            ret = memalign(alignment, alloc_size);
+#elif defined(HAVE_POSIX_MEMALIGN)
+            posix_memalign(&(ret), alignment, alloc_size);
+#else
+            {
+                uint8_t *tmp = malloc((alloc_size + alignment - 1) + sizeof(void *));
+                if (!tmp) { return NULL; }
+                ret                 = (void *)(((uintptr_t)(tmp + sizeof(void *) + alignment - 1)) & ~(alignment - 1));
+                *((void **)ret - 1) = tmp;
+            }
+            break;
+#endif  /* if defined(HAVE_MEMALIGN) */
+    }
+    assert(ret);
+    assert(((uintptr_t)ret & (alignment - 1)) == 0);
+    return ret;
+}
+
+void qt_internal_aligned_free(void         *ptr,
+                                   uint_fast16_t alignment)
+{
+    assert(ptr);
+    switch (alignment) {
+        case 0:
+            free(ptr);
+            break;
+#if defined(HAVE_16ALIGNED_MALLOC)
+        case 16:
+        case 8:
+        case 4:
+        case 2:
+            free(ptr);
+            break;
+#endif
+        default:
+#if defined(HAVE_WORKING_VALLOC) || defined(HAVE_PAGE_ALIGNED_MALLOC)
+            if (alignment == pagesize) {
+                free(ptr);
+                break;
+            }
+#endif
+#if defined(HAVE_MEMALIGN) || defined(HAVE_POSIX_MEMALIGN)
+            free(ptr);
+#else
+            assert((uintptr_t)*((void **)ptr - 1) > 4096);
+            free(*((void **)ptr - 1));
+#endif
+    }
+}
+
+/* vim:set expandtab: */
@@ -63,6 +63,7 @@ qt_barrier_t API_FUNC *qt_barrier_create(size_t           max_threads,
 #ifndef UNPOOLED
     if (fbp.pool == NULL) {
         qt_mpool bp = qt_mpool_create(sizeof(struct qt_barrier_s));
+        qt_mpool_set_name(bp, "feb_barrier_pool");
         if (QT_CAS_(fbp.vp, NULL, bp, fbp_caslock) != NULL) {
             /* someone else created an mpool first */
             qt_mpool_destroy(bp);
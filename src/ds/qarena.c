@@ -0,0 +1,195 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* API */
+#include <qthread/qthread.h>
+#include <qthread/qarena.h>
+
+/* Internal Headers */
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qt_debug.h"                  /* for MALLOC() and FREE() */
+#include "qt_qthread_struct.h"
+#include "qt_qthread_mgmt.h"           /* for qthread_internal_self() */
+#include "qt_teams.h"
+#include "qt_arena.h"
+
+#define QARENA_ALIGNMENT     16
+#define QARENA_DEFAULT_CHUNK (64 * 1024)
+#define QARENA_ROUND(x)      (((x) + QARENA_ALIGNMENT - 1) & ~(size_t)(QARENA_ALIGNMENT - 1))
+
+/* Allocation is a fetch-and-add on the current chunk's offset; whoever
+ * overshoots the end takes the lock and pushes a fresh chunk. Requests larger
+ * than a quarter of a chunk get a chunk of their own, so they neither waste
+ * the rest of the current chunk nor force it to be replaced. */
+typedef struct qarena_chunk_s {
+    struct qarena_chunk_s *next;
+    size_t                 size;       /* usable bytes */
+    aligned_t              used;
+} qarena_chunk_t;
+
+#define QARENA_CHUNK_HEADER QARENA_ROUND(sizeof(qarena_chunk_t))
+#define QARENA_CHUNK_DATA(c) ((uint8_t *)(c) + QARENA_CHUNK_HEADER)
+
+struct qarena_s {
+    qarena_chunk_t *volatile current;  /* chunks, newest first */
+    qarena_chunk_t          *big;      /* dedicated chunks */
+    size_t                   chunk_size;
+    QTHREAD_FASTLOCK_TYPE    lock;
+};
+
+static qarena_chunk_t *qarena_chunk_new(size_t          size,
+                                        qarena_chunk_t *next)
+{                                      /*{{{ */
+    qarena_chunk_t *c = MALLOC(QARENA_CHUNK_HEADER + size);
+
+    if (c) {
+        c->next = next;
+        c->size = size;
+        c->used = 0;
+    }
+    return c;
+}                                      /*}}} */
+
+static void qarena_chunks_free(qarena_chunk_t *c)
+{                                      /*{{{ */
+    while (c) {
+        qarena_chunk_t *next = c->next;
+        FREE(c, QARENA_CHUNK_HEADER + c->size);
+        c = next;
+    }
+}                                      /*}}} */
+
+qarena *qarena_create(size_t chunk_size)
+{                                      /*{{{ */
+    qarena *a = MALLOC(sizeof(struct qarena_s));
+
+    qassert_ret(a, NULL);
+    a->chunk_size = chunk_size ? QARENA_ROUND(chunk_size) : QARENA_DEFAULT_CHUNK;
+    a->big        = NULL;
+    a->current    = qarena_chunk_new(a->chunk_size, NULL);
+    if (a->current == NULL) {
+        FREE(a, sizeof(struct qarena_s));
+        return NULL;
+    }
+    QTHREAD_FASTLOCK_INIT(a->lock);
+    return a;
+}                                      /*}}} */
+
+void qarena_destroy(qarena *a)
+{                                      /*{{{ */
+    qassert_retvoid(a);
+    qarena_chunks_free(a->current);
+    qarena_chunks_free(a->big);
+    QTHREAD_FASTLOCK_DESTROY(a->lock);
+    FREE(a, sizeof(struct qarena_s));
+}                                      /*}}} */
+
+void qarena_reset(qarena *a)
+{                                      /*{{{ */
+    qassert_retvoid(a);
+    qarena_chunks_free(a->current->next);
+    a->current->next = NULL;
+    a->current->used = 0;
+    qarena_chunks_free(a->big);
+    a->big = NULL;
+}                                      /*}}} */
+
+static QINLINE void *qarena_align(uint8_t *p,
+                                  size_t   alignment)
+{                                      /*{{{ */
+    return (void *)(((uintptr_t)p + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}                                      /*}}} */
+
+void *qarena_alloc_aligned(qarena *a,
+                           size_t  size,
+                           size_t  alignment)
+{                                      /*{{{ */
+    size_t need;
+
+    qassert_ret(a, NULL);
+    qassert_ret(((alignment & (alignment - 1)) == 0), NULL);
+    if (alignment < QARENA_ALIGNMENT) { alignment = QARENA_ALIGNMENT; }
+    need = QARENA_ROUND(size ? size : 1) + (alignment - QARENA_ALIGNMENT);
+    if (need < size) { return NULL; }
+
+    if (need > a->chunk_size / 4) {
+        qarena_chunk_t *c = qarena_chunk_new(need, NULL);
+
+        if (c == NULL) { return NULL; }
+        QTHREAD_FASTLOCK_LOCK(&a->lock);
+        c->next = a->big;
+        a->big  = c;
+        QTHREAD_FASTLOCK_UNLOCK(&a->lock);
+        return qarena_align(QARENA_CHUNK_DATA(c), alignment);
+    }
+    for (;;) {
+        qarena_chunk_t *c   = a->current;
+        const size_t    off = qthread_incr(&c->used, need);
+
+        if (off + need <= c->size) {
+            return qarena_align(QARENA_CHUNK_DATA(c) + off, alignment);
+        }
+        QTHREAD_FASTLOCK_LOCK(&a->lock);
+        if (a->current == c) {
+            qarena_chunk_t *n = qarena_chunk_new(a->chunk_size, c);
+
+            if (n == NULL) {
+                QTHREAD_FASTLOCK_UNLOCK(&a->lock);
+                return NULL;
+            }
+            qthread_cas_ptr(&a->current, c, n);
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&a->lock);
+    }
+}                                      /*}}} */
+
+void *qarena_alloc(qarena *a,
+                   size_t  size)
+{                                      /*{{{ */
+    return qarena_alloc_aligned(a, size, QARENA_ALIGNMENT);
+}                                      /*}}} */
+
+qarena *qarena_task(void)
+{                                      /*{{{ */
+    qthread_t *me = qthread_internal_self();
+
+    if ((me == NULL) || (me->rdata == NULL)) { return NULL; }
+    if (me->rdata->arena == NULL) {
+        me->rdata->arena = qarena_create(0);
+    }
+    return me->rdata->arena;
+}                                      /*}}} */
+
+qarena *qarena_team(void)
+{                                      /*{{{ */
+    qthread_t *me = qthread_internal_self();
+    qarena    *a;
+
+    if ((me == NULL) || (me->team == NULL)) { return NULL; }
+    a = me->team->arena;
+    if (a == NULL) {
+        /* several members may get here at once; one arena wins */
+        qarena *mine = qarena_create(0);
+
+        qassert_ret(mine, NULL);
+        a = qthread_cas_ptr(&me->team->arena, NULL, mine);
+        if (a == NULL) {
+            a = mine;
+        } else {
+            qarena_destroy(mine);
+        }
+    }
+    return a;
+}                                      /*}}} */
+
+void INTERNAL qt_arena_release(qarena **arena)
+{                                      /*{{{ */
+    if (*arena) {
+        qarena_destroy(*arena);
+        *arena = NULL;
+    }
+}                                      /*}}} */
+
+/* vim:set expandtab: */
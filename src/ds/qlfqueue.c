@@ -146,7 +146,10 @@ void *qlfqueue_dequeue(qlfqueue_t *q)
 
         hazardous_ptr(1, next_ptr);
 
-        if (next_ptr == NULL) { return NULL; } /* queue is empty */
+        if (next_ptr == NULL) { /* queue is empty */
+            hazardous_ptr(0, NULL);
+            return NULL;
+        }
         if (head == tail) { /* tail is falling behind! */
             /* advance tail ptr... */
             (void)qthread_cas_ptr((void **)&(q->tail), (void *)tail, next_ptr);
@@ -2,7 +2,10 @@
 # include "config.h"
 #endif
 
+#include <string.h>                    /* for memset() */
+
 /* Internal Headers */
+#include "qthread/qthread.h"           /* for QTHREAD_SUCCESS et al. */
 #include "qthread/qpool.h"
 #include "qt_mpool.h"
 #include "qt_asserts.h"
@@ -66,4 +69,68 @@ void qpool_destroy(qpool *pool)
 #endif
 }
 
+size_t qpool_trim(qpool *pool)
+{
+#ifdef UNPOOLED
+    return 0;
+#else
+    return qt_mpool_trim(pool);
+#endif
+}
+
+size_t qpool_trim_all(void)
+{
+#ifdef UNPOOLED
+    return 0;
+#else
+    return qt_mpool_trim_all();
+#endif
+}
+
+void qpool_set_high_water(qpool *pool,
+                          size_t bytes)
+{
+#ifndef UNPOOLED
+    qt_mpool_set_high_water(pool, bytes);
+#endif
+}
+
+void qpool_set_name(qpool      *pool,
+                    const char *name)
+{
+#ifndef UNPOOLED
+    qt_mpool_set_name(pool, name);
+#endif
+}
+
+void qpool_stats(qpool         *pool,
+                 qpool_stats_t *stats)
+{
+#ifdef UNPOOLED
+    memset(stats, 0, sizeof(qpool_stats_t));
+    stats->item_size = pool->size;
+#else
+    qt_mpool_stats(pool, stats);
+#endif
+}
+
+size_t qpool_stats_all(qpool_stats_t *stats,
+                       size_t         count)
+{
+#ifdef UNPOOLED
+    return 0;
+#else
+    return qt_mpool_stats_all(stats, count);
+#endif
+}
+
+int qpool_stats_dump(const char *filename)
+{
+#ifdef UNPOOLED
+    return QTHREAD_NOT_ALLOWED;
+#else
+    return qt_mpool_stats_dump(filename);
+#endif
+}
+
 /* vim:set expandtab: */
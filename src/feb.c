@@ -21,11 +21,14 @@
 #include "qthread_innards.h" /* for qlib */
 #include "qt_initialized.h"  // for qthread_library_initialized
 #include "qt_profiling.h"
+#include "qt_feb_profile.h"
 #include "qt_qthread_struct.h"
 #include "qt_qthread_mgmt.h"
 #include "qt_blocking_structs.h"
 #include "qt_addrstat.h"
 #include "qt_threadqueues.h"
+#include "qt_shepherd_innards.h" /* for qthread_internal_getworker() */
+#include "qt_envariables.h"
 #include "qt_debug.h"
 #ifdef QTHREAD_USE_EUREKAS
 #include "qt_eurekas.h" // for qthread_internal_assassinate() (used in taskfilter)
@@ -35,6 +38,12 @@
 /********************************************************************
  * Local Variables
  *********************************************************************/
+/* With LOCK_FREE_FEBS, an addrstat found in the hash is only protected by
+ * hazard pointer 0 until it has been locked and found still valid; from then
+ * on, nothing can retire it until it is unlocked. The hazard pointer is
+ * cleared as soon as that is the case, since with epoch reclamation a thread
+ * that is not a worker would otherwise stay pinned, and hold back reclamation
+ * for everyone, from then on. */
 static qt_hash *FEBs;
 #ifdef QTHREAD_COUNT_THREADS
 aligned_t *febs_stripes;
@@ -42,10 +51,39 @@ aligned_t *febs_stripes;
 QTHREAD_FASTLOCK_TYPE *febs_stripes_locks;
 # endif
 #endif
+#ifndef LOCK_FREE_FEBS
+/* QT_FEB_LINGER: how many full, unwaited-on addrstats each stripe may leave in
+ * its hash before the ones that have gone unused are swept out */
+static unsigned long feb_linger     = 0;
+static size_t       *febs_lingering = NULL;
+#endif
 
 /********************************************************************
  * Local Types
  *********************************************************************/
+#ifndef UNPOOLED_ADDRSTAT
+/* Addrstats that come out of the hash are kept in a small cache per worker, so
+ * that the next address to need one does not go back to the pool or set up
+ * its lock again. */
+# define ADDRSTAT_CACHE_SIZE 8
+typedef struct {
+    qthread_addrstat_t *items[ADDRSTAT_CACHE_SIZE];
+    size_t              count;
+    uint8_t             pad[CACHELINE_WIDTH - ((ADDRSTAT_CACHE_SIZE + 1) * sizeof(void *)) % CACHELINE_WIDTH];
+} qt_addrstat_cache_t;
+static qt_addrstat_cache_t *addrstat_caches  = NULL;
+static size_t               addrstat_ncaches = 0;
+#endif
+
+#ifndef LOCK_FREE_FEBS
+typedef struct {
+    void  **cold; /* lingering, not used since the last sweep */
+    void  **warm; /* lingering, used since the last sweep */
+    size_t  ncold;
+    size_t  nwarm;
+    size_t  max;
+} qt_feb_sweep_t;
+#endif
 typedef enum bt {
     PURGE,
     WRITEEF,
@@ -86,6 +124,8 @@ static QINLINE void qthread_gotlock_empty_inner(qthread_shepherd_t *shep,
                                                 void               *maddr,
                                                 const uint_fast8_t  recursive,
                                                 qthread_addrres_t **precond_tasks);
+static void qthread_precond_ready(qthread_t         *t,
+                                  const uint_fast8_t deferred);
 
 /********************************************************************
  * Shared Globals
@@ -121,6 +161,21 @@ static void qt_feb_subsystem_shutdown(void)
 #endif
     }
     FREE(FEBs, sizeof(qt_hash) * QTHREAD_LOCKING_STRIPES);
+#ifndef LOCK_FREE_FEBS
+    FREE(febs_lingering, sizeof(size_t) * QTHREAD_LOCKING_STRIPES);
+    febs_lingering = NULL;
+#endif
+#ifndef UNPOOLED_ADDRSTAT
+    qthread_debug(FEB_DETAILS, "drain the addrstat caches\n");
+    for (size_t i = 0; i < addrstat_ncaches; i++) {
+        while (addrstat_caches[i].count > 0) {
+            qthread_addrstat_delete(addrstat_caches[i].items[--addrstat_caches[i].count]);
+        }
+    }
+    FREE(addrstat_caches, sizeof(qt_addrstat_cache_t) * addrstat_ncaches);
+    addrstat_caches  = NULL;
+    addrstat_ncaches = 0;
+#endif
 #ifdef QTHREAD_COUNT_THREADS
     FREE(febs_stripes, sizeof(aligned_t) * QTHREAD_LOCKING_STRIPES);
 # ifdef QTHREAD_MUTEX_INCREMENT
@@ -143,12 +198,24 @@ void INTERNAL qt_feb_subsystem_init(uint_fast8_t need_sync)
 {
 #if !defined(UNPOOLED_ADDRSTAT) && !defined(UNPOOLED)
     generic_addrstat_pool = qt_mpool_create(sizeof(qthread_addrstat_t));
+    qt_mpool_set_name(generic_addrstat_pool, "generic_addrstat_pool");
 #endif
 #if !defined(UNPOOLED_ADDRRES) && !defined(UNPOOLED)
     generic_addrres_pool = qt_mpool_create(sizeof(qthread_addrres_t));
+    qt_mpool_set_name(generic_addrres_pool, "generic_addrres_pool");
 #endif
     FEBs = MALLOC(sizeof(qt_hash) * QTHREAD_LOCKING_STRIPES);
     assert(FEBs);
+#ifndef UNPOOLED_ADDRSTAT
+    addrstat_ncaches = qlib->nshepherds * qlib->nworkerspershep;
+    addrstat_caches  = qt_calloc(addrstat_ncaches, sizeof(qt_addrstat_cache_t));
+    assert(addrstat_caches);
+#endif
+#ifndef LOCK_FREE_FEBS
+    feb_linger     = qt_internal_get_env_num("FEB_LINGER", 0, 0);
+    febs_lingering = qt_calloc(QTHREAD_LOCKING_STRIPES, sizeof(size_t));
+    assert(febs_lingering);
+#endif
 #ifdef QTHREAD_COUNT_THREADS
     febs_stripes = MALLOC(sizeof(aligned_t) * QTHREAD_LOCKING_STRIPES);
     assert(febs_stripes);
@@ -287,6 +354,7 @@ int API_FUNC qthread_feb_status(const aligned_t *addr)
         QTHREAD_FASTLOCK_UNLOCK(&m->lock);
         break;
     } while (1);
+    hazardous_ptr(0, NULL);
 #else  /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]); {
         m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin],
@@ -303,12 +371,139 @@ int API_FUNC qthread_feb_status(const aligned_t *addr)
     return status;
 }                      /*}}} */
 
+/* Returns a fresh addrstat, from this worker's cache if it has one. */
+static QINLINE qthread_addrstat_t *qt_feb_addrstat_new(void)
+{   /*{{{*/
+#ifndef UNPOOLED_ADDRSTAT
+    qthread_worker_t *w = qthread_internal_getworker();
+
+    if ((w != NULL) && (addrstat_caches != NULL)) {
+        qt_addrstat_cache_t *c = &addrstat_caches[w->packed_worker_id];
+
+        assert(w->packed_worker_id < addrstat_ncaches);
+        if (c->count > 0) {
+            qthread_addrstat_t *ret = c->items[--c->count];
+
+            /* its lock is still initialized and its queues are empty */
+            ret->full      = 1;
+            ret->valid     = 1;
+            ret->lingering = 0;
+            ret->hot       = 0;
+            return ret;
+        }
+    }
+#endif /* ifndef UNPOOLED_ADDRSTAT */
+    return qthread_addrstat_new();
+} /*}}}*/
+
+/* Disposes of an addrstat that is no longer in the hash (and, with lock-free
+ * FEBs, can no longer be reached by anyone) by handing it to this worker's
+ * cache, or freeing it if the cache is full or this is not a worker. */
+static void qt_feb_addrstat_recycle(qthread_addrstat_t *m)
+{   /*{{{*/
+#ifndef UNPOOLED_ADDRSTAT
+    qthread_worker_t *w = qthread_internal_getworker();
+
+    assert(m->EFQ == NULL && m->FEQ == NULL && m->FFQ == NULL && m->FFWQ == NULL);
+    if ((w != NULL) && (addrstat_caches != NULL)) {
+        qt_addrstat_cache_t *c = &addrstat_caches[w->packed_worker_id];
+
+        assert(w->packed_worker_id < addrstat_ncaches);
+        if (c->count < ADDRSTAT_CACHE_SIZE) {
+            c->items[c->count++] = m;
+            return;
+        }
+    }
+#endif /* ifndef UNPOOLED_ADDRSTAT */
+    qthread_addrstat_delete(m);
+} /*}}}*/
+
+#ifndef LOCK_FREE_FEBS
+static void qt_feb_sweep_collect(const qt_key_t      addr,
+                                 qthread_addrstat_t *m,
+                                 qt_feb_sweep_t     *s)
+{   /*{{{*/
+    if (!m->lingering) { return; }
+    if (m->hot) {
+        /* second chance; this races with qthread_FEB_remove() marking it hot
+         * again, which at worst keeps it around for one more sweep */
+        m->hot = 0;
+        if (s->nwarm < s->max) { s->warm[s->nwarm++] = (void *)addr; }
+    } else if (s->ncold < s->max) {
+        s->cold[s->ncold++] = (void *)addr;
+    }
+} /*}}}*/
+
+/* Takes the lingering addrstat for maddr out of the hash, if it is still
+ * full and unwaited-on (and, if cold_only, has not been used since it was
+ * collected). */
+static int qt_feb_linger_evict(void     *maddr,
+                               const int lockbin,
+                               const int cold_only)
+{   /*{{{*/
+    qthread_addrstat_t *m;
+
+    qt_hash_lock(FEBs[lockbin]); {
+        m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], maddr);
+        if (m && m->lingering && !(cold_only && m->hot)) {
+            QTHREAD_FASTLOCK_LOCK(&(m->lock));
+            if ((m->FEQ == NULL) && (m->EFQ == NULL) && (m->FFQ == NULL) && (m->FFWQ == NULL) &&
+                (m->full == 1)) {
+                qassertnot(qt_hash_remove_locked(FEBs[lockbin], maddr), 0);
+                febs_lingering[lockbin]--;
+            } else {
+                QTHREAD_FASTLOCK_UNLOCK(&(m->lock));
+                m = NULL;
+            }
+        } else {
+            m = NULL;
+        }
+    }
+    qt_hash_unlock(FEBs[lockbin]);
+    if (m != NULL) {
+        QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+        qt_feb_addrstat_recycle(m);
+        return 1;
+    }
+    return 0;
+} /*}}}*/
+
+/* A stripe has more than feb_linger addrstats lingering in it. Every one that
+ * has not gone back to full since the last sweep is removed, as are as many
+ * of the rest as it takes to get back down to half of feb_linger; the
+ * survivors must be used again before the next sweep to stay. */
+static void qt_feb_linger_sweep(const int lockbin)
+{   /*{{{*/
+    qt_feb_sweep_t s;
+    const size_t   target = feb_linger / 2;
+
+    s.max   = feb_linger * 2;
+    s.ncold = s.nwarm = 0;
+    s.cold  = MALLOC(sizeof(void *) * s.max * 2);
+    assert(s.cold);
+    s.warm = s.cold + s.max;
+    qt_hash_callback(FEBs[lockbin], (qt_hash_callback_fn)qt_feb_sweep_collect, &s);
+    qthread_debug(FEB_DETAILS, "stripe %i: %lu cold and %lu warm addrstats lingering\n", lockbin, (unsigned long)s.ncold, (unsigned long)s.nwarm);
+    for (size_t i = 0; i < s.ncold; i++) {
+        qt_feb_linger_evict(s.cold[i], lockbin, 1);
+    }
+    for (size_t i = 0; i < s.nwarm && febs_lingering[lockbin] > target; i++) {
+        qt_feb_linger_evict(s.warm[i], lockbin, 0);
+    }
+    FREE(s.cold, sizeof(void *) * s.max * 2);
+} /*}}}*/
+#endif /* ifndef LOCK_FREE_FEBS */
+
 /* this function removes the FEB data structure for the address maddr from the
- * hash table */
+ * hash table; with QT_FEB_LINGER set, it is left there instead until it has
+ * gone unused for a while */
 static QINLINE void qthread_FEB_remove(void *maddr)
 {                      /*{{{ */
     qthread_addrstat_t *m;
     const int           lockbin = QTHREAD_CHOOSE_STRIPE2(maddr);
+#ifndef LOCK_FREE_FEBS
+    int sweep = 0;
+#endif
 
     // qthread_debug(ALWAYS_OUTPUT, "Attempting removal of addr %p\n", maddr);
     qthread_debug(FEB_BEHAVIOR, "maddr=%p: attempting removal\n", maddr);
@@ -319,6 +514,7 @@ static QINLINE void qthread_FEB_remove(void *maddr)
         m = qt_hash_get(FEBs[lockbin], maddr);
 got_m:
         if (!m) {
+            hazardous_ptr(0, NULL);
             qthread_debug(FEB_DETAILS, "maddr=%p: addrstat already gone; someone else removed it!\n", maddr);
             return;
         }
@@ -328,15 +524,18 @@ got_m:
             goto got_m;
         }
         if (!m->valid) {
+            hazardous_ptr(0, NULL);
             qthread_debug(FEB_DETAILS, "maddr=%p: addrstat invalid; someone else invalidated it!\n", maddr);
             return;
         }
         QTHREAD_FASTLOCK_LOCK(&m->lock);
         if (!m->valid) {
             QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+            hazardous_ptr(0, NULL);
             qthread_debug(FEB_DETAILS, "maddr=%p: addrstat invalid; someone else invalidated it!\n", maddr);
             return;
         }
+        hazardous_ptr(0, NULL);
         if ((m->FEQ == NULL) && (m->EFQ == NULL) && (m->FFQ == NULL) && (m->FFWQ == NULL) &&
             (m->full == 1)) {
             qthread_debug(FEB_DETAILS, "maddr=%p: lists are empty, status is full; invalidating and removing (m:%p)\n", maddr, m);
@@ -355,8 +554,19 @@ got_m:
             QTHREAD_FASTLOCK_LOCK(&(m->lock));
             if ((m->FEQ == NULL) && (m->EFQ == NULL) && (m->FFQ == NULL) && (m->FFWQ == NULL) &&
                 (m->full == 1)) {
-                qthread_debug(FEB_DETAILS, "maddr=%p: lists are empty, status is full; invalidating and removing\n", maddr);
-                qassertnot(qt_hash_remove_locked(FEBs[lockbin], maddr), 0);
+                if (feb_linger) {
+                    qthread_debug(FEB_DETAILS, "maddr=%p: lists are empty, status is full; lingering\n", maddr);
+                    m->hot = 1;
+                    if (!m->lingering) {
+                        m->lingering = 1;
+                        sweep        = (++febs_lingering[lockbin] > feb_linger);
+                    }
+                    QTHREAD_FASTLOCK_UNLOCK(&(m->lock));
+                    m = NULL;
+                } else {
+                    qthread_debug(FEB_DETAILS, "maddr=%p: lists are empty, status is full; invalidating and removing\n", maddr);
+                    qassertnot(qt_hash_remove_locked(FEBs[lockbin], maddr), 0);
+                }
             } else {
                 QTHREAD_FASTLOCK_UNLOCK(&(m->lock));
                 qthread_debug(FEB_DETAILS, "maddr=%p: addrstat cannot be removed; in use\n", maddr);
@@ -365,17 +575,22 @@ got_m:
         }
     }
     qt_hash_unlock(FEBs[lockbin]);
+    if (sweep) {
+        qt_feb_linger_sweep(lockbin);
+    }
 #endif /* ifdef LOCK_FREE_FEBS */
     if (m != NULL) {
         QTHREAD_FASTLOCK_UNLOCK(&m->lock);
 #ifdef LOCK_FREE_FEBS
-        hazardous_release_node((hazardous_free_f)qthread_addrstat_delete, m);
+        hazardous_release_node((hazardous_free_f)qt_feb_addrstat_recycle, m);
 #else
-        qthread_addrstat_delete(m);
+        qt_feb_addrstat_recycle(m);
 #endif
     }
 }                      /*}}} */
 
+/* Every task in precond_tasks has had its last precondition satisfied, so it
+ * can be set going. */
 static QINLINE void qthread_precond_launch(qthread_shepherd_t *shep,
                                            qthread_addrres_t  *precond_tasks)
 {   /*{{{*/
@@ -384,14 +599,16 @@ static QINLINE void qthread_precond_launch(qthread_shepherd_t *shep,
     if (precond_tasks != precond_tail) {
         qthread_addrres_t *precond_free = precond_tasks, *precond_head = precond_tasks;
         do {
+            qthread_t *t;
+
             precond_head = precond_head->next;
             FREE_ADDRRES(precond_free);
-            if (qthread_check_feb_preconds(precond_head->waiter) != 1) {
-                if (precond_head->waiter->target_shepherd == NO_SHEPHERD) {
-                    qt_threadqueue_enqueue(shep->ready, precond_head->waiter);
-                } else {
-                    qt_threadqueue_enqueue(qlib->shepherds[precond_head->waiter->target_shepherd].ready, precond_head->waiter);
-                }
+            t = precond_head->waiter;
+            qthread_precond_ready(t, 1);
+            if (t->target_shepherd == NO_SHEPHERD) {
+                qt_threadqueue_enqueue(shep->ready, t);
+            } else {
+                qt_threadqueue_enqueue(qlib->shepherds[t->target_shepherd].ready, t);
             }
             precond_free = precond_head;
         } while(precond_head != precond_tail);
@@ -401,6 +618,25 @@ static QINLINE void qthread_precond_launch(qthread_shepherd_t *shep,
     }
 } /*}}}*/
 
+/* A precondition of the nascent task waiting in X has been satisfied. If it was
+ * the last one, X is appended to the precond_tasks batch to be launched once
+ * the FEB lock is released; otherwise it is simply discarded. */
+static QINLINE void qthread_precond_satisfied(qthread_addrres_t  *X,
+                                              qthread_addrres_t **precond_tasks)
+{   /*{{{*/
+    if (qthread_incr((aligned_t *)X->waiter->preconds, -1) != 1) {
+        FREE_ADDRRES(X);
+        return;
+    }
+    if (*precond_tasks == NULL) {
+        /* create empty head to avoid later checks/branches; use the waiter to find the tail */
+        *precond_tasks           = ALLOC_ADDRRES();
+        (*precond_tasks)->waiter = (void *)(*precond_tasks);
+    }
+    ((qthread_addrres_t *)((*precond_tasks)->waiter))->next = X;
+    (*precond_tasks)->waiter                                = (void *)X;
+} /*}}}*/
+
 static QINLINE void qthread_gotlock_empty_inner(qthread_shepherd_t *shep,
                                                 qthread_addrstat_t *m,
                                                 void               *maddr,
@@ -484,26 +720,12 @@ static QINLINE void qthread_gotlock_fill_inner(qthread_shepherd_t *shep,
         qthread_t *waiter = X->waiter;
         qthread_debug(FEB_DETAILS, "shep(%u), m(%p), maddr(%p), recursive(%u): dQ one from FFWQ (%u releasing tid %u with %u)\n", shep->shepherd_id, m, maddr, recursive, qthread_id(), waiter->thread_id, *(aligned_t *)maddr);
         if (QTHREAD_STATE_NASCENT == waiter->thread_state) {
-            if (*precond_tasks == NULL) {
-                /* create empty head to avoid later checks/branches; use the waiter to find the tail */
-                *precond_tasks           = ALLOC_ADDRRES();
-                (*precond_tasks)->waiter = (void *)(*precond_tasks);
-            }
-            /* Note: the nascent thread is being tossed into a real live ready
-             * queue for one big fat reason: the alternative involves
-             * potentially locking multiple parts of the FEB hash table, not to
-             * mention needing to avoid re-locking the portion we've already
-             * got locked. By allowing the precond thread to have its
-             * conditions checked by a shepherd, we can ensure that we don't
-             * have this problem. Also, this allows the "work" of checking
-             * preconds to be load-balanced by workstealing schedulers, if
-             * that's important or useful.
-             * Changed behavior to batch all tasks with preconditions,
-             * thus avoiding a possible dead-lock but having to launch all
-             * sequentially after releasing the lock. On the plus side,
-             * all tasks present in the ready queue (or cache) are ready to run.*/
-            ((qthread_addrres_t *)((*precond_tasks)->waiter))->next = X;
-            (*precond_tasks)->waiter                                = (void *)X;
+            /* Nascent tasks are registered on all of their unsatisfied
+             * preconditions at once, and count down as those are filled. The
+             * fill that reaches zero batches the task to be launched after
+             * the lock is released, so every task that reaches a ready queue
+             * is ready to run. */
+            qthread_precond_satisfied(X, precond_tasks);
         } else {
             qt_feb_schedule(waiter, shep);
             FREE_ADDRRES(X);
@@ -523,13 +745,7 @@ static QINLINE void qthread_gotlock_fill_inner(qthread_shepherd_t *shep,
         qthread_t *waiter = X->waiter;
         qthread_debug(FEB_DETAILS, "shep(%u), m(%p), maddr(%p), recursive(%u): dQ one from FFQ (%u releasing tid %u with %u)\n", shep->shepherd_id, m, maddr, recursive, qthread_id(), waiter->thread_id, *(aligned_t *)maddr);
         if (QTHREAD_STATE_NASCENT == waiter->thread_state) {
-            if (*precond_tasks == NULL) {
-                /* create empty head to avoid later checks/branches; use the waiter to find the tail */
-                *precond_tasks           = ALLOC_ADDRRES();
-                (*precond_tasks)->waiter = (void *)(*precond_tasks);
-            }
-            ((qthread_addrres_t *)((*precond_tasks)->waiter))->next = X;
-            (*precond_tasks)->waiter                                = (void *)X;
+            qthread_precond_satisfied(X, precond_tasks);
         } else {
             qt_feb_schedule(waiter, shep);
             FREE_ADDRRES(X);
@@ -604,13 +820,13 @@ int API_FUNC qthread_empty(const aligned_t *dest)
         m = qt_hash_get(FEBbin, (void *)alignedaddr);
         if (!m) {
             /* currently full, and must be added to the hash to empty */
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) { return QTHREAD_MALLOC_ERROR; }
             m->full = 0;
             MACHINE_FENCE;
             QTHREAD_EMPTY_TIMER_START(m);
             if (!qt_hash_put(FEBbin, (void *)alignedaddr, m)) {
-                qthread_addrstat_delete(m);
+                qt_feb_addrstat_recycle(m);
                 continue;
             }
             m = NULL;
@@ -632,13 +848,14 @@ int API_FUNC qthread_empty(const aligned_t *dest)
             break;
         }
     } while (1);
+    hazardous_ptr(0, NULL);
 #else  /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBbin);
     {                      /* BEGIN CRITICAL SECTION */
         m = (qthread_addrstat_t *)qt_hash_get_locked(FEBbin, (void *)alignedaddr);
         if (!m) {
             /* currently full, and must be added to the hash to empty */
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) {
                 qt_hash_unlock(FEBbin);
                 return QTHREAD_MALLOC_ERROR;
@@ -702,6 +919,7 @@ int API_FUNC qthread_fill(const aligned_t *dest)
         }
         break;
     } while (1);
+    hazardous_ptr(0, NULL);
 #else  /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]);
     {                      /* BEGIN CRITICAL SECTION */
@@ -765,6 +983,7 @@ got_m:
         }
         break;
     } while (1);
+    hazardous_ptr(0, NULL);
 #else  /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]); {    /* lock hash */
         m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
@@ -824,13 +1043,13 @@ int API_FUNC qthread_purge_to(aligned_t *restrict       dest,
         m = qt_hash_get(FEBbin, (void *)alignedaddr);
         if (!m) {
             /* currently full, and must be added to the hash to empty */
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) { return QTHREAD_MALLOC_ERROR; }
             m->full = 0;
             MACHINE_FENCE;
             QTHREAD_EMPTY_TIMER_START(m);
             if (!qt_hash_put(FEBbin, (void *)alignedaddr, m)) {
-                qthread_addrstat_delete(m);
+                qt_feb_addrstat_recycle(m);
                 continue;
             }
             m = NULL;
@@ -852,13 +1071,14 @@ int API_FUNC qthread_purge_to(aligned_t *restrict       dest,
             break;
         }
     } while (1);
+    hazardous_ptr(0, NULL);
 #else  /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBbin);
     {                      /* BEGIN CRITICAL SECTION */
         m = (qthread_addrstat_t *)qt_hash_get_locked(FEBbin, (void *)alignedaddr);
         if (!m) {
             /* currently full, and must be added to the hash to empty */
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) {
                 qt_hash_unlock(FEBbin);
                 return QTHREAD_MALLOC_ERROR;
@@ -935,7 +1155,7 @@ int API_FUNC qthread_writeEF(aligned_t *restrict       dest,
 got_m:
         if (!m) {
             /* currently full, must add to hash to wait */
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) {
                 // qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): MALLOC FAILURE!!!!!!!!!!\n", dest, src, me->thread_id);
                 return QTHREAD_MALLOC_ERROR;
@@ -944,7 +1164,7 @@ got_m:
             if (!qt_hash_put(FEBs[lockbin], (void *)alignedaddr, m)) {
                 // qthread_debug(FEB_DETAILS, "dest=%p, src=%p (tid=%i): put failure\n", dest, src, me->thread_id);
                 QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                qthread_addrstat_delete(m);
+                qt_feb_addrstat_recycle(m);
                 continue;
             }
             break;
@@ -971,12 +1191,13 @@ got_m:
             break;
         }
     } while(1);
+    hazardous_ptr(0, NULL);
 #else  /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]);
     {
         m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], (void *)alignedaddr);
         if (!m) {
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) {
                 qt_hash_unlock(FEBs[lockbin]);
                 return QTHREAD_MALLOC_ERROR;
@@ -1006,8 +1227,10 @@ got_m:
         me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
         me->rdata->blockedon.addr = m;
         QTHREAD_WAIT_TIMER_START();
+        QTHREAD_FEB_PROFILE_START(me);
         qthread_back_to_master(me);
         QTHREAD_WAIT_TIMER_STOP(me, febwait);
+        QTHREAD_FEB_PROFILE_STOP(alignedaddr, me);
 #ifdef QTHREAD_USE_EUREKAS
         qt_eureka_check(0);
 #endif /* QTHREAD_USE_EUREKAS */
@@ -1063,6 +1286,7 @@ int API_FUNC qthread_writeEF_nb(aligned_t *restrict       dest,
             break;
         }
     } while (1);
+    hazardous_ptr(0, NULL);
 # else /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]);
     {
@@ -1138,6 +1362,7 @@ int API_FUNC qthread_writeFF(aligned_t *restrict       dest,
         }
         break;
     } while(1);
+    hazardous_ptr(0, NULL);
 # else /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]);
     {
@@ -1171,8 +1396,10 @@ int API_FUNC qthread_writeFF(aligned_t *restrict       dest,
         me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
         me->rdata->blockedon.addr = m;
         QTHREAD_WAIT_TIMER_START();
+        QTHREAD_FEB_PROFILE_START(me);
         qthread_back_to_master(me);
         QTHREAD_WAIT_TIMER_STOP(me, febwait);
+        QTHREAD_FEB_PROFILE_STOP(alignedaddr, me);
 #ifdef QTHREAD_USE_EUREKAS
         qt_eureka_check(0);
 #endif /* QTHREAD_USE_EUREKAS */
@@ -1237,6 +1464,7 @@ int API_FUNC qthread_readFF(aligned_t *restrict       dest,
         }
         break;
     } while(1);
+    hazardous_ptr(0, NULL);
 # else /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]);
     {
@@ -1270,8 +1498,10 @@ int API_FUNC qthread_readFF(aligned_t *restrict       dest,
         me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
         me->rdata->blockedon.addr = m;
         QTHREAD_WAIT_TIMER_START();
+        QTHREAD_FEB_PROFILE_START(me);
         qthread_back_to_master(me);
         QTHREAD_WAIT_TIMER_STOP(me, febwait);
+        QTHREAD_FEB_PROFILE_STOP(alignedaddr, me);
 #ifdef QTHREAD_USE_EUREKAS
         qt_eureka_check(0);
 #endif /* QTHREAD_USE_EUREKAS */
@@ -1324,6 +1554,7 @@ got_m:
         }
         break;
     } while(1);
+    hazardous_ptr(0, NULL);
 # else /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]);
     {
@@ -1391,12 +1622,12 @@ int API_FUNC qthread_readFE(aligned_t *restrict       dest,
 got_m:
         if (!m) {
             /* currently full; need to set to empty */
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) { return QTHREAD_MALLOC_ERROR; }
             QTHREAD_FASTLOCK_LOCK(&m->lock);
             if (!qt_hash_put(FEBs[lockbin], alignedaddr, m)) {
                 QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                qthread_addrstat_delete(m);
+                qt_feb_addrstat_recycle(m);
                 continue;
             }
             break;
@@ -1417,12 +1648,13 @@ got_m:
             break;
         }
     } while (1);
+    hazardous_ptr(0, NULL);
 # else /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]);
     {
         m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], alignedaddr);
         if (!m) {
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) {
                 qt_hash_unlock(FEBs[lockbin]);
                 return QTHREAD_MALLOC_ERROR;
@@ -1454,8 +1686,10 @@ got_m:
         /* so that the shepherd will unlock it */
         me->rdata->blockedon.addr = m;
         QTHREAD_WAIT_TIMER_START();
+        QTHREAD_FEB_PROFILE_START(me);
         qthread_back_to_master(me);
         QTHREAD_WAIT_TIMER_STOP(me, febwait);
+        QTHREAD_FEB_PROFILE_STOP(alignedaddr, me);
 #ifdef QTHREAD_USE_EUREKAS
         qt_eureka_check(0);
 #endif /* QTHREAD_USE_EUREKAS */
@@ -1511,12 +1745,12 @@ int API_FUNC qthread_readFE_nb(aligned_t *restrict       dest,
         m = qt_hash_get(FEBs[lockbin], alignedaddr);
         if (!m) {
             /* currently full; need to set to empty */
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) { return QTHREAD_MALLOC_ERROR; }
             QTHREAD_FASTLOCK_LOCK(&m->lock);
             if (!qt_hash_put(FEBs[lockbin], alignedaddr, m)) {
                 QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                qthread_addrstat_delete(m);
+                qt_feb_addrstat_recycle(m);
                 continue;
             }
             break;
@@ -1533,12 +1767,13 @@ int API_FUNC qthread_readFE_nb(aligned_t *restrict       dest,
             break;
         }
     } while (1);
+    hazardous_ptr(0, NULL);
 # else /* ifdef LOCK_FREE_FEBS */
     qt_hash_lock(FEBs[lockbin]);
     {
         m = (qthread_addrstat_t *)qt_hash_get_locked(FEBs[lockbin], alignedaddr);
         if (!m) {
-            m = qthread_addrstat_new();
+            m = qt_feb_addrstat_new();
             if (!m) {
                 qt_hash_unlock(FEBs[lockbin]);
                 return QTHREAD_MALLOC_ERROR;
@@ -1578,16 +1813,59 @@ extern QTHREAD_FASTLOCK_TYPE concurrentthreads_lock;
 extern QTHREAD_FASTLOCK_TYPE effconcurrentthreads_lock;
 #endif
 /*
- * This function walks the list of preconditions. When an empty variable is
- * encountered, it enqueues the "nascent" qthread in the associated FFQ. When
- * all preconditions are satisfied, the qthread state is set as "new".
+ * Marks a nascent task whose preconditions are all satisfied as runnable. Tasks
+ * that were ready at spawn time are counted by qthread_spawn(); deferred ones
+ * are counted here.
+ */
+static void qthread_precond_ready(qthread_t         *t,
+                                  const uint_fast8_t deferred)
+{   /*{{{*/
+    t->thread_state = QTHREAD_STATE_NEW;
+#ifdef QTHREAD_PERFORMANCE
+    if(t->rdata){
+      QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_NEW);
+    }
+#endif
+    qt_free(t->preconds);
+    t->preconds = NULL;
+#ifdef QTHREAD_COUNT_THREADS
+    if (deferred) {
+        QTHREAD_FASTLOCK_LOCK(&concurrentthreads_lock);
+        threadcount++;
+        concurrentthreads++;
+        assert(concurrentthreads <= threadcount);
+        if (concurrentthreads > maxconcurrentthreads) {
+            maxconcurrentthreads = concurrentthreads;
+        }
+        avg_concurrent_threads =
+            (avg_concurrent_threads * (double)(threadcount - 1.0) / threadcount)
+            + ((double)concurrentthreads / threadcount);
+        QTHREAD_FASTLOCK_UNLOCK(&concurrentthreads_lock);
+    }
+#else
+    (void)deferred;
+#endif /* ifdef QTHREAD_COUNT_THREADS */
+} /*}}}*/
+
+/*
+ * This function registers a nascent qthread on all of its preconditions at
+ * once. The first slot of the precondition array (which holds the number of
+ * preconditions) becomes an atomic count of the preconditions that are still
+ * unsatisfied: the qthread is enqueued in the FFQ of every empty address, and
+ * each fill of one of those addresses decrements the count (see
+ * qthread_precond_satisfied()). Whoever brings it to zero launches the
+ * qthread. The count starts one higher than the number of preconditions so
+ * that the qthread cannot be launched while it is still being registered.
  *
- * This is a modified readFF() that does not suspend the calling thread, but
- * simply enqueues the specified qthread in the FFQ associated with the target.
+ * Returns 0 if every precondition was already full (the caller must launch
+ * the qthread), 1 if the qthread will be launched by a later fill.
  */
 int INTERNAL qthread_check_feb_preconds(qthread_t *t)
 {   /*{{{*/
     aligned_t **these_preconds = (aligned_t **)t->preconds;
+    aligned_t  *remaining      = (aligned_t *)t->preconds;
+    aligned_t   satisfied      = 1; /* the registration guard */
+    uintptr_t   npreconds;
 
 #if defined(QTHREAD_FEB_PROFILING)
     qthread_shepherd_t *const curshep = qthread_internal_getshep();
@@ -1596,10 +1874,18 @@ int INTERNAL qthread_check_feb_preconds(qthread_t *t)
 
     qthread_debug(FEB_FUNCTIONS, "t=%p, t->tid=%u\n", t, t->thread_id);
     assert(qthread_library_initialized);
-
-    // Process input preconds
-    while (these_preconds && (these_preconds[0] != NULL)) {
-        aligned_t          *this_sync = these_preconds[(uintptr_t)these_preconds[0]];
+    assert(these_preconds);
+    assert(sizeof(aligned_t) == sizeof(aligned_t *));
+
+    npreconds       = (uintptr_t)these_preconds[0];
+    *remaining      = (aligned_t)npreconds + 1;
+    t->thread_state = QTHREAD_STATE_NASCENT;
+    QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_NASCENT);
+    MACHINE_FENCE;
+
+    // Register on every input precond that is not yet full
+    for (uintptr_t i = 1; i <= npreconds; i++) {
+        aligned_t          *this_sync = these_preconds[i];
         const int           lockbin   = QTHREAD_CHOOSE_STRIPE2(this_sync);
         const aligned_t    *alignedaddr;
         qthread_addrstat_t *m = NULL;
@@ -1622,6 +1908,7 @@ int INTERNAL qthread_check_feb_preconds(qthread_t *t)
             }
             break;
         } while(1);
+        hazardous_ptr(0, NULL);
 #else   /* ifdef LOCK_FREE_FEBS */
         qt_hash_lock(FEBs[lockbin]);
         {
@@ -1634,10 +1921,10 @@ int INTERNAL qthread_check_feb_preconds(qthread_t *t)
 #endif  /* ifdef LOCK_FREE_FEBS */
         qthread_debug(FEB_DETAILS, "precond=%p (tid=%u): data structure locked or null (m=%p, lockbin=%u)\n", this_sync, t->thread_id, m, lockbin);
         if (m == NULL) { /* already full! */
-            these_preconds[0] = (aligned_t *)(((uintptr_t)these_preconds[0]) - 1);
+            satisfied++;
         } else if (m->full == 1) {
             QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-            these_preconds[0] = (aligned_t *)(((uintptr_t)these_preconds[0]) - 1);
+            satisfied++;
         } else {
             // Need to wait on this one, add to appropriate FFQ
             qthread_addrres_t *X = NULL;
@@ -1648,41 +1935,25 @@ int INTERNAL qthread_check_feb_preconds(qthread_t *t)
                 abort();
                 return QTHREAD_MALLOC_ERROR;
             }
-            X->addr         = NULL;
-            X->waiter       = t;
-            X->next         = m->FFQ;
-            m->FFQ          = X;
-            t->thread_state = QTHREAD_STATE_NASCENT;
-            QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_NASCENT);
+            X->addr   = NULL;
+            X->waiter = t;
+            X->next   = m->FFQ;
+            m->FFQ    = X;
             QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-            return 1;
+            qthread_debug(FEB_DETAILS, "precond=%p (tid=%u): waiting\n", this_sync, t->thread_id);
+            continue;
         }
         qthread_debug(FEB_DETAILS, "precond=%p (tid=%u): address already full (m=%p, val=%u)\n", this_sync, t->thread_id, m, *(aligned_t *)this_sync);
     }
 
-    // All input preconds are full
-    t->thread_state = QTHREAD_STATE_NEW;
-#ifdef QTHREAD_PERFORMANCE
-    if(t->rdata){
-      QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_NEW);
+    /* drop the registration guard along with everything that was already
+     * full; if anything is left, the last fill will launch the qthread */
+    if (qthread_incr(remaining, -(saligned_t)satisfied) != satisfied) {
+        return 1;
     }
-#endif
-    qt_free(t->preconds);
-    t->preconds = NULL;
-#ifdef QTHREAD_COUNT_THREADS
-    QTHREAD_FASTLOCK_LOCK(&concurrentthreads_lock);
-    threadcount++;
-    concurrentthreads++;
-    assert(concurrentthreads <= threadcount);
-    if (concurrentthreads > maxconcurrentthreads) {
-        maxconcurrentthreads = concurrentthreads;
-    }
-    avg_concurrent_threads =
-        (avg_concurrent_threads * (double)(threadcount - 1.0) / threadcount)
-        + ((double)concurrentthreads / threadcount);
-    QTHREAD_FASTLOCK_UNLOCK(&concurrentthreads_lock);
-#endif /* ifdef QTHREAD_COUNT_THREADS */
 
+    // All input preconds are full
+    qthread_precond_ready(t, 0);
     return 0;
 } /*}}}*/
 
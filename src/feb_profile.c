@@ -0,0 +1,360 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdio.h>
+#include <stdlib.h>  /* for qsort() */
+#include <string.h>  /* for memset() */
+#include <strings.h> /* for strcasecmp() */
+#include <signal.h>
+
+/* The API */
+#include "qthread/qthread.h"
+
+/* Internal Headers */
+#include "qt_feb_profile.h"
+#include "qt_subsystems.h"
+#include "qt_alloc.h"
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qt_envariables.h"
+#include "qt_qthread_struct.h"
+#include "qt_shepherd_innards.h"
+#include "qthread_innards.h" /* for qlib */
+#include "qt_debug.h"
+#include "qt_output_macros.h"
+
+/* Wait times are histogrammed in power-of-two microsecond buckets: bucket 0
+ * is under 1us, bucket i covers [2^(i-1), 2^i) us, and the last bucket is
+ * open-ended (2^14 us, about 16ms, and up). */
+#define QT_FEB_PROFILE_BUCKETS 16
+
+typedef struct {
+    const void *addr;
+    qthread_f   f;
+    size_t      waits;
+    double      total_time;
+    double      max_time;
+    size_t      hist[QT_FEB_PROFILE_BUCKETS];
+} qt_feb_profile_entry_t;
+
+/* One open-addressed table per shepherd, keyed by (address, task function).
+ * Only sampled waits take the lock, and they are about to context switch
+ * anyway. */
+typedef struct {
+    QTHREAD_FASTLOCK_TYPE   lock;
+    size_t                  ticks;
+    size_t                  used;
+    size_t                  size;
+    qt_feb_profile_entry_t *entries;
+} qt_feb_profile_table_t;
+
+unsigned long                   qt_feb_profile_period = 0;
+volatile sig_atomic_t           qt_feb_profile_dump_requested = 0;
+static qt_feb_profile_table_t  *tables       = NULL;
+static qthread_shepherd_id_t    tables_count = 0;
+static const char              *dump_file    = NULL;
+static int                      dump_format  = QTHREAD_FEB_PROFILE_CSV;
+
+static QINLINE size_t qt_feb_profile_hash(const void *addr,
+                                          qthread_f   f)
+{   /*{{{*/
+    uint64_t key = (uintptr_t)addr ^ ((uint64_t)(uintptr_t)f << 17);
+
+    key ^= key >> 33;
+    key *= UINT64_C(0xff51afd7ed558ccd);
+    key ^= key >> 33;
+    return (size_t)key;
+} /*}}}*/
+
+/* Returns the slot for (addr, f) in entries, which must have a free slot. */
+static qt_feb_profile_entry_t *qt_feb_profile_slot(qt_feb_profile_entry_t *entries,
+                                                   const size_t            size,
+                                                   const void             *addr,
+                                                   qthread_f               f)
+{   /*{{{*/
+    size_t i = qt_feb_profile_hash(addr, f) & (size - 1);
+
+    while (entries[i].addr != NULL &&
+           (entries[i].addr != addr || entries[i].f != f)) {
+        i = (i + 1) & (size - 1);
+    }
+    return &entries[i];
+} /*}}}*/
+
+static int qt_feb_profile_grow(qt_feb_profile_table_t *t)
+{   /*{{{*/
+    const size_t            newsize = t->size * 2;
+    qt_feb_profile_entry_t *e       = calloc(newsize, sizeof(qt_feb_profile_entry_t));
+
+    if (e == NULL) { return 0; }
+    for (size_t i = 0; i < t->size; i++) {
+        if (t->entries[i].addr != NULL) {
+            *qt_feb_profile_slot(e, newsize, t->entries[i].addr, t->entries[i].f) = t->entries[i];
+        }
+    }
+    free(t->entries);
+    t->entries = e;
+    t->size    = newsize;
+    return 1;
+} /*}}}*/
+
+static void qt_feb_profile_merge(qt_feb_profile_entry_t       *dst,
+                                 const qt_feb_profile_entry_t *src)
+{   /*{{{*/
+    dst->addr        = src->addr;
+    dst->f           = src->f;
+    dst->waits      += src->waits;
+    dst->total_time += src->total_time;
+    if (dst->max_time < src->max_time) { dst->max_time = src->max_time; }
+    for (int b = 0; b < QT_FEB_PROFILE_BUCKETS; b++) {
+        dst->hist[b] += src->hist[b];
+    }
+} /*}}}*/
+
+int INTERNAL qt_feb_profile_sample(qthread_t *waiter)
+{   /*{{{*/
+    /* The tick is shared by the shepherd's workers; a lost increment only
+     * shifts the sampling phase. */
+    return (tables[waiter->rdata->shepherd_ptr->shepherd_id].ticks++ % qt_feb_profile_period) == 0;
+} /*}}}*/
+
+void INTERNAL qt_feb_profile_record(const void *addr,
+                                    qthread_t  *waiter,
+                                    double      start)
+{   /*{{{*/
+    const double            secs = qtimer_wtime() - start;
+    double                  usecs = secs * 1e6;
+    int                     bucket = 0;
+    qt_feb_profile_table_t *t;
+    qt_feb_profile_entry_t *e;
+
+    assert(waiter);
+    while (usecs >= 1.0 && bucket < QT_FEB_PROFILE_BUCKETS - 1) {
+        usecs /= 2.0;
+        bucket++;
+    }
+    /* the waiter may have been woken on a different shepherd */
+    t = &tables[waiter->rdata->shepherd_ptr->shepherd_id];
+    QTHREAD_FASTLOCK_LOCK(&t->lock);
+    if (((t->used + 1) * 4 > t->size * 3) && !qt_feb_profile_grow(t)) {
+        QTHREAD_FASTLOCK_UNLOCK(&t->lock);
+        return;
+    }
+    e = qt_feb_profile_slot(t->entries, t->size, addr, waiter->f);
+    if (e->addr == NULL) {
+        e->addr = addr;
+        e->f    = waiter->f;
+        t->used++;
+    }
+    e->waits++;
+    e->total_time += secs;
+    if (e->max_time < secs) { e->max_time = secs; }
+    e->hist[bucket]++;
+    QTHREAD_FASTLOCK_UNLOCK(&t->lock);
+} /*}}}*/
+
+static int qt_feb_profile_cmp(const void *a,
+                              const void *b)
+{   /*{{{*/
+    const qt_feb_profile_entry_t *x = a, *y = b;
+
+    if (x->total_time < y->total_time) { return 1; }
+    if (x->total_time > y->total_time) { return -1; }
+    return (x->waits < y->waits) - (x->waits > y->waits);
+} /*}}}*/
+
+static void qt_feb_profile_write_csv(FILE                         *fp,
+                                     const qt_feb_profile_entry_t *e,
+                                     const size_t                  n)
+{   /*{{{*/
+    fprintf(fp, "# sample_period=%lu\n", qt_feb_profile_period);
+    fprintf(fp, "address,function,waits,total_secs,mean_secs,max_secs");
+    for (int b = 0; b < QT_FEB_PROFILE_BUCKETS; b++) {
+        if (b == 0) {
+            fprintf(fp, ",lt_1us");
+        } else if (b == QT_FEB_PROFILE_BUCKETS - 1) {
+            fprintf(fp, ",ge_%luus", 1UL << (b - 1));
+        } else {
+            fprintf(fp, ",lt_%luus", 1UL << b);
+        }
+    }
+    fprintf(fp, "\n");
+    for (size_t i = 0; i < n; i++) {
+        fprintf(fp, "%p,%p,%lu,%g,%g,%g", e[i].addr, (void *)(uintptr_t)e[i].f,
+                (unsigned long)e[i].waits, e[i].total_time,
+                e[i].total_time / e[i].waits, e[i].max_time);
+        for (int b = 0; b < QT_FEB_PROFILE_BUCKETS; b++) {
+            fprintf(fp, ",%lu", (unsigned long)e[i].hist[b]);
+        }
+        fprintf(fp, "\n");
+    }
+} /*}}}*/
+
+static void qt_feb_profile_write_json(FILE                         *fp,
+                                      const qt_feb_profile_entry_t *e,
+                                      const size_t                  n)
+{   /*{{{*/
+    fprintf(fp, "{\"sample_period\": %lu, \"histogram_usecs\": [0", qt_feb_profile_period);
+    for (int b = 0; b < QT_FEB_PROFILE_BUCKETS - 1; b++) {
+        fprintf(fp, ", %lu", 1UL << b);
+    }
+    fprintf(fp, "],\n \"addresses\": [");
+    for (size_t i = 0; i < n; i++) {
+        fprintf(fp, "%s\n  {\"address\": \"%p\", \"function\": \"%p\", \"waits\": %lu, "
+                "\"total_secs\": %g, \"mean_secs\": %g, \"max_secs\": %g, \"histogram\": [",
+                (i == 0) ? "" : ",", e[i].addr, (void *)(uintptr_t)e[i].f,
+                (unsigned long)e[i].waits, e[i].total_time,
+                e[i].total_time / e[i].waits, e[i].max_time);
+        for (int b = 0; b < QT_FEB_PROFILE_BUCKETS; b++) {
+            fprintf(fp, "%s%lu", (b == 0) ? "" : ", ", (unsigned long)e[i].hist[b]);
+        }
+        fprintf(fp, "]}");
+    }
+    fprintf(fp, "\n ]}\n");
+} /*}}}*/
+
+int API_FUNC qthread_feb_profile_dump(const char *filename,
+                                      int         format)
+{   /*{{{*/
+    qt_feb_profile_table_t  m;
+    qt_feb_profile_entry_t *merged;
+    size_t                  used = 0, n = 0;
+    FILE                   *fp;
+
+    if (qt_feb_profile_period == 0) { return QTHREAD_NOT_ALLOWED; }
+    if ((format != QTHREAD_FEB_PROFILE_CSV) &&
+        (format != QTHREAD_FEB_PROFILE_JSON)) { return QTHREAD_BADARGS; }
+
+    /* Sized like the per-shepherd tables (a power of two, at most 3/4 full)
+     * for the entries there are now; it grows if more turn up while the
+     * tables are being merged. */
+    for (qthread_shepherd_id_t s = 0; s < tables_count; s++) {
+        used += tables[s].used;
+    }
+    m.used = 0;
+    m.size = 16;
+    while (m.size < used * 2) { m.size *= 2; }
+    m.entries = calloc(m.size, sizeof(qt_feb_profile_entry_t));
+    if (m.entries == NULL) { return QTHREAD_MALLOC_ERROR; }
+    for (qthread_shepherd_id_t s = 0; s < tables_count; s++) {
+        qt_feb_profile_table_t *t = &tables[s];
+
+        QTHREAD_FASTLOCK_LOCK(&t->lock);
+        for (size_t i = 0; i < t->size; i++) {
+            qt_feb_profile_entry_t *e;
+
+            if (t->entries[i].addr == NULL) { continue; }
+            if (((m.used + 1) * 4 > m.size * 3) && !qt_feb_profile_grow(&m)) {
+                QTHREAD_FASTLOCK_UNLOCK(&t->lock);
+                free(m.entries);
+                return QTHREAD_MALLOC_ERROR;
+            }
+            e = qt_feb_profile_slot(m.entries, m.size, t->entries[i].addr, t->entries[i].f);
+            if (e->addr == NULL) { m.used++; }
+            qt_feb_profile_merge(e, &t->entries[i]);
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&t->lock);
+    }
+    merged = m.entries;
+    for (size_t i = 0; i < m.size; i++) {
+        if (merged[i].addr != NULL) { merged[n++] = merged[i]; }
+    }
+    qsort(merged, n, sizeof(qt_feb_profile_entry_t), qt_feb_profile_cmp);
+
+    fp = (filename == NULL) ? stderr : fopen(filename, "w");
+    if (fp == NULL) {
+        free(merged);
+        return QTHREAD_BADARGS;
+    }
+    if (format == QTHREAD_FEB_PROFILE_JSON) {
+        qt_feb_profile_write_json(fp, merged, n);
+    } else {
+        qt_feb_profile_write_csv(fp, merged, n);
+    }
+    if (filename == NULL) {
+        fflush(fp);
+    } else {
+        fclose(fp);
+    }
+    free(merged);
+    return QTHREAD_SUCCESS;
+} /*}}}*/
+
+void API_FUNC qthread_feb_profile_reset(void)
+{   /*{{{*/
+    for (qthread_shepherd_id_t s = 0; s < tables_count; s++) {
+        qt_feb_profile_table_t *t = &tables[s];
+
+        QTHREAD_FASTLOCK_LOCK(&t->lock);
+        memset(t->entries, 0, sizeof(qt_feb_profile_entry_t) * t->size);
+        t->used = 0;
+        QTHREAD_FASTLOCK_UNLOCK(&t->lock);
+    }
+} /*}}}*/
+
+/* Called by the workers between tasks, where it is safe to use stdio. Every
+ * worker may see the request; the one that takes it back writes the dump. */
+void INTERNAL qt_feb_profile_dump_pending(void)
+{   /*{{{*/
+    if (qthread_cas(&qt_feb_profile_dump_requested, 1, 0) != 1) { return; }
+    qthread_feb_profile_dump(dump_file, dump_format);
+} /*}}}*/
+
+static void qt_feb_profile_signal_handler(int sig)
+{   /*{{{*/
+    (void)sig;
+    qt_feb_profile_dump_requested = 1;
+} /*}}}*/
+
+static void qt_feb_profile_subsystem_shutdown(void)
+{   /*{{{*/
+    qthread_debug(CORE_CALLS, "begin\n");
+    if (qt_internal_get_env_bool("FEB_PROFILE_DUMP_AT_EXIT", 1)) {
+        qthread_feb_profile_dump(dump_file, dump_format);
+    }
+    qt_feb_profile_period = 0;
+    for (qthread_shepherd_id_t s = 0; s < tables_count; s++) {
+        QTHREAD_FASTLOCK_DESTROY(tables[s].lock);
+        free(tables[s].entries);
+    }
+    FREE(tables, sizeof(qt_feb_profile_table_t) * tables_count);
+    tables       = NULL;
+    tables_count = 0;
+    qthread_debug(CORE_CALLS, "end\n");
+} /*}}}*/
+
+void INTERNAL qt_feb_profile_subsystem_init(void)
+{   /*{{{*/
+    const char   *format;
+    unsigned long sig;
+
+    qt_feb_profile_period = qt_internal_get_env_num("FEB_PROFILE", 0, 0);
+    if (qt_feb_profile_period == 0) { return; }
+
+    dump_file = qt_internal_get_env_str("FEB_PROFILE_FILE", NULL);
+    format    = qt_internal_get_env_str("FEB_PROFILE_FORMAT", "csv");
+    if (format && !strcasecmp(format, "json")) {
+        dump_format = QTHREAD_FEB_PROFILE_JSON;
+    }
+    tables_count = qlib->nshepherds;
+    tables       = MALLOC(sizeof(qt_feb_profile_table_t) * tables_count);
+    assert(tables);
+    for (qthread_shepherd_id_t s = 0; s < tables_count; s++) {
+        QTHREAD_FASTLOCK_INIT(tables[s].lock);
+        tables[s].ticks   = 0;
+        tables[s].used    = 0;
+        tables[s].size    = 64;
+        tables[s].entries = calloc(tables[s].size, sizeof(qt_feb_profile_entry_t));
+        assert(tables[s].entries);
+    }
+    sig = qt_internal_get_env_num("FEB_PROFILE_SIGNAL", 0, 0);
+    if (sig != 0) {
+        signal((int)sig, qt_feb_profile_signal_handler);
+    }
+    qthread_debug(CORE_DETAILS, "sampling 1 in %lu blocking waits\n", qt_feb_profile_period);
+    qthread_internal_cleanup(qt_feb_profile_subsystem_shutdown);
+} /*}}}*/
+
+/* vim:set expandtab: */
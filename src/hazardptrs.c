@@ -17,6 +17,8 @@
 #include "qt_asserts.h"
 #include "qt_subsystems.h"
 
+#ifndef QTHREAD_EPOCH_RECLAMATION
+
 static TLS_DECL_INIT(uintptr_t *, ts_hazard_ptrs);
 
 static uintptr_t *QTHREAD_CASLOCK(hzptr_list);
@@ -200,4 +202,210 @@ void INTERNAL hazardous_release_node(void  (*freefunc)(void *),
     }
 }/*}}}*/
 
+#else /* ifndef QTHREAD_EPOCH_RECLAMATION */
+
+/* retirements between a thread's attempts to advance the global epoch */
+# define HAZARD_EPOCH_BATCH 64
+
+static TLS_DECL_INIT(hazard_epoch_t *, ts_hazard_epoch);
+
+static hazard_epoch_t *QTHREAD_CASLOCK(external_list);
+static aligned_t global_epoch = 0;
+
+static void hazard_limbo_empty(hazard_limbo_t *l)
+{/*{{{*/
+    for (unsigned int i = 0; i < l->count; ++i) {
+        l->freelist[i].freefunc(l->freelist[i].ptr);
+    }
+    l->count = 0;
+}/*}}}*/
+
+static void hazard_epoch_destroy(hazard_epoch_t *rec)
+{/*{{{*/
+    /* the pools the nodes came from are torn down on their own */
+    for (unsigned int i = 0; i < HAZARD_EPOCHS; ++i) {
+        qt_free(rec->limbo[i].freelist);
+    }
+}/*}}}*/
+
+static void hazardptr_internal_teardown(void)
+{   /*{{{*/
+    for (qthread_shepherd_id_t i = 0; i < qthread_num_shepherds(); ++i) {
+        for (qthread_worker_id_t j = 0; j < qlib->nworkerspershep; ++j) {
+            hazard_epoch_destroy(&qlib->shepherds[i].workers[j].hazard_epoch);
+        }
+    }
+    TLS_DELETE(ts_hazard_epoch);
+    while (external_list != NULL) {
+        hazard_epoch_t *tmp = external_list;
+        external_list = tmp->next;
+        hazard_epoch_destroy(tmp);
+        qt_free(tmp);
+    }
+    QTHREAD_CASLOCK_DESTROY(external_list);
+} /*}}}*/
+
+void INTERNAL initialize_hazardptrs(void)
+{/*{{{*/
+    global_epoch = 0;
+    for (qthread_shepherd_id_t i = 0; i < qthread_num_shepherds(); ++i) {
+        for (qthread_worker_id_t j = 0; j < qlib->nworkerspershep; ++j) {
+            memset(&qlib->shepherds[i].workers[j].hazard_epoch, 0, sizeof(hazard_epoch_t));
+        }
+    }
+    TLS_INIT(ts_hazard_epoch);
+    QTHREAD_CASLOCK_INIT(external_list, NULL);
+    qthread_internal_cleanup(hazardptr_internal_teardown);
+}/*}}}*/
+
+static hazard_epoch_t *hazard_epoch_mine(void)
+{/*{{{*/
+    hazard_epoch_t *rec = TLS_GET(ts_hazard_epoch);
+
+    if (rec == NULL) {
+        qthread_worker_t *wkr = qthread_internal_getworker();
+        if (wkr == NULL) {
+            rec = qt_calloc(1, sizeof(hazard_epoch_t));
+            assert(rec);
+            do {
+                rec->next = QTHREAD_CASLOCK_READ(external_list);
+            } while (QT_CAS(external_list, rec->next, rec) != (void *)rec->next);
+        } else {
+            rec = &wkr->hazard_epoch;
+        }
+        TLS_SET(ts_hazard_epoch, rec);
+    }
+    return rec;
+}/*}}}*/
+
+/* With nothing else held, the announcement is brought up to date, so that a
+ * thread that keeps pinning (a long-running task, or a thread that is not a
+ * worker and never goes back to a scheduler) does not hold the epoch back. */
+static QINLINE void hazard_pin(hazard_epoch_t *rec,
+                               const int       holding)
+{/*{{{*/
+    if (!holding || (rec->announce == 0)) {
+        const aligned_t announce = (global_epoch << 1) | 1;
+
+        if (rec->announce != announce) {
+            rec->announce = announce;
+            /* nothing may be read from a node before the announcement is seen */
+            MACHINE_FENCE;
+        }
+    }
+}/*}}}*/
+
+static QINLINE void hazard_unpin(hazard_epoch_t *rec)
+{/*{{{*/
+    if ((rec->slots == 0) && (rec->nest == 0) && (rec->announce != 0)) {
+        MACHINE_FENCE;
+        rec->announce = 0;
+    }
+}/*}}}*/
+
+void INTERNAL hazardous_ptr(unsigned int which,
+                            void        *ptr)
+{/*{{{*/
+    hazard_epoch_t *rec = hazard_epoch_mine();
+
+    assert(which < HAZARD_PTRS_PER_SHEP);
+    if (ptr != NULL) {
+        const int holding = (rec->nest != 0) || (rec->slots & ~(1u << which));
+
+        rec->slots |= 1u << which;
+        hazard_pin(rec, holding);
+    } else {
+        rec->slots &= ~(1u << which);
+        hazard_unpin(rec);
+    }
+}/*}}}*/
+
+void INTERNAL hazardous_enter(void)
+{/*{{{*/
+    hazard_epoch_t *rec = hazard_epoch_mine();
+
+    const int holding = (rec->nest != 0) || (rec->slots != 0);
+
+    rec->nest++;
+    hazard_pin(rec, holding);
+}/*}}}*/
+
+void INTERNAL hazardous_exit(void)
+{/*{{{*/
+    hazard_epoch_t *rec = hazard_epoch_mine();
+
+    assert(rec->nest > 0);
+    rec->nest--;
+    hazard_unpin(rec);
+}/*}}}*/
+
+void INTERNAL hazardous_quiescent(void)
+{/*{{{*/
+    hazard_epoch_t *rec = TLS_GET(ts_hazard_epoch);
+
+    if (rec != NULL) {
+        assert(rec->nest == 0);
+        rec->slots = 0;
+        hazard_unpin(rec);
+    }
+}/*}}}*/
+
+/* The global epoch can move on once every pinned thread has seen it. Returns
+ * the global epoch, advanced or not. */
+static aligned_t hazard_try_advance(void)
+{/*{{{*/
+    const aligned_t epoch  = global_epoch;
+    const aligned_t pinned = (epoch << 1) | 1;
+
+    for (qthread_shepherd_id_t i = 0; i < qthread_num_shepherds(); ++i) {
+        for (qthread_worker_id_t j = 0; j < qlib->nworkerspershep; ++j) {
+            const aligned_t a = qlib->shepherds[i].workers[j].hazard_epoch.announce;
+            if ((a != 0) && (a != pinned)) { return epoch; }
+        }
+    }
+    for (hazard_epoch_t *rec = QTHREAD_CASLOCK_READ(external_list); rec != NULL; rec = rec->next) {
+        const aligned_t a = rec->announce;
+        if ((a != 0) && (a != pinned)) { return epoch; }
+    }
+    (void)qthread_cas(&global_epoch, epoch, epoch + 1);
+    return global_epoch;
+}/*}}}*/
+
+void INTERNAL hazardous_release_node(void  (*freefunc)(void *),
+                                     void *ptr)
+{/*{{{*/
+    hazard_epoch_t *rec   = hazard_epoch_mine();
+    aligned_t       epoch = global_epoch;
+    hazard_limbo_t *l     = &rec->limbo[epoch % HAZARD_EPOCHS];
+
+    assert(ptr != NULL);
+    assert(freefunc != NULL);
+    if (l->epoch != epoch) {
+        /* whatever is here was retired at least HAZARD_EPOCHS epochs ago */
+        hazard_limbo_empty(l);
+        l->epoch = epoch;
+    }
+    if (l->count == l->size) {
+        l->size     = l->size ? (2 * l->size) : HAZARD_EPOCH_BATCH;
+        l->freelist = qt_realloc(l->freelist, l->size * sizeof(hazard_freelist_entry_t));
+        assert(l->freelist);
+    }
+    l->freelist[l->count].freefunc = freefunc;
+    l->freelist[l->count].ptr      = ptr;
+    l->count++;
+    rec->slots = 0;
+    hazard_unpin(rec);
+    if (++rec->retired >= HAZARD_EPOCH_BATCH) {
+        rec->retired = 0;
+        epoch        = hazard_try_advance();
+        for (unsigned int i = 0; i < HAZARD_EPOCHS; ++i) {
+            if (rec->limbo[i].count && (rec->limbo[i].epoch + 2 <= epoch)) {
+                hazard_limbo_empty(&rec->limbo[i]);
+            }
+        }
+    }
+}/*}}}*/
+
+#endif /* ifndef QTHREAD_EPOCH_RECLAMATION */
+
 /* vim:set expandtab: */
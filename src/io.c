@@ -6,7 +6,9 @@
 #include <qthread/qthread-int.h>       /* for uint64_t */
 #include <stdio.h>                     /* for fprintf() */
 #include <stdlib.h>                    /* for abort() */
+#include <string.h>                    /* for memset() */
 #include <sys/time.h>                  /* for gettimeofday() */
+#include <errno.h>
 #ifdef HAVE_SYS_SYSCALL_H
 /* - syscall(2) */
 # include <sys/syscall.h>
@@ -25,6 +27,12 @@
 #include <sys/uio.h>
 /* - select(2) */
 #include <sys/select.h>
+/* - splice(2) */
+#include <fcntl.h>
+/* - sendfile(2) */
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 /* - wait4(2) */
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -39,32 +47,78 @@
 #include "qt_debug.h"
 #include "qt_envariables.h"
 #include "qt_subsystems.h"
+#include "qt_affinity.h"
+#include "qt_shepherd_innards.h"
+#include "qthread/qtimer.h"
 
+/* One queue of syscall jobs per shepherd, so that workers on different
+ * shepherds do not fight over a single lock to hand off their calls. Proxy
+ * threads are spawned on behalf of a shepherd, are pinned near it, and serve
+ * its queue first, stealing from the others when it is empty; only proxies
+ * with nothing to do anywhere touch the (global) lock they sleep on. */
 typedef struct {
+    QTHREAD_FASTLOCK_TYPE     lock;
     qt_blocking_queue_node_t *head;
     qt_blocking_queue_node_t *tail;
-    saligned_t                length;
-    pthread_mutex_t           lock;
-    pthread_cond_t            notempty;
+    uint8_t                   pad[CACHELINE_WIDTH - (sizeof(QTHREAD_FASTLOCK_TYPE) + 2 * sizeof(void *)) % CACHELINE_WIDTH];
 } qt_blocking_queue_t;
 
-static qt_blocking_queue_t theQueue;
-static saligned_t          io_worker_count = -1;
-static saligned_t          io_worker_max   = 10;
+static qt_blocking_queue_t  *queues       = NULL; /* one per shepherd */
+static qthread_shepherd_id_t nqueues      = 0;
+static saligned_t            queued       = 0; /* jobs in all of the queues */
+static saligned_t            idle_proxies = 0;
+static pthread_mutex_t       idle_lock;
+static pthread_cond_t        notempty;
+static saligned_t            io_worker_count = -1;
+static saligned_t            io_worker_min   = 1;
+static saligned_t            io_worker_max   = 10;
 #if !defined(UNPOOLED)
 qt_mpool syscall_job_pool = NULL;
 #endif
 static unsigned long timeout    = 100; // in microseconds
 static int           proxy_exit = 0;
+
+/* The pool grows when a job is queued with no proxy to take it, or when one
+ * has waited longer than spawn_latency for a proxy to come free; it starts
+ * with io_worker_min warm proxies and keeps them, and beyond those, proxies that have been idle
+ * for the timeout retire one at a time, no sooner than shrink_interval after
+ * the pool last grew or shrank, so that bursts do not turn into a stream of
+ * thread creations and exits. */
+static double    spawn_latency   = 50e-6;  // in seconds
+static aligned_t shrink_interval = 10000;  // in microseconds
+static aligned_t last_resize     = 0;      // in microseconds
+
+/* Writes to the same descriptor that sit next to each other in a queue (a
+ * stream of write()s, or pwrite()s of consecutive ranges) are taken by one
+ * proxy and made with a single writev()/pwritev(), up to coalesce_max jobs
+ * and QT_IO_COALESCE_BYTES at a time. */
+#define QT_IO_COALESCE_MAX   64
+#define QT_IO_COALESCE_BYTES (1 << 20)
+static saligned_t coalesce_max = 16;
+
+static struct {
+    aligned_t jobs;
+    aligned_t coalesced;
+    aligned_t spawned;
+    aligned_t retired;
+    double    wait_avg; /* seconds; exponential moving average */
+    double    wait_max;
+} io_stats;
+
+static QINLINE aligned_t qt_blocking_now_usec(void)
+{   /*{{{*/
+    return (aligned_t)(qtimer_wtime() * 1e6);
+} /*}}}*/
 TLS_DECL_INIT(qthread_t *, IO_task_struct);
 
 static void qt_blocking_subsystem_internal_stopwork(void)
 {   /*{{{*/
     proxy_exit = 1;
     MACHINE_FENCE;
+    QTHREAD_LOCK(&idle_lock);
+    QTHREAD_COND_BCAST(notempty);
+    QTHREAD_UNLOCK(&idle_lock);
     while (io_worker_count != 0) SPINLOCK_BODY();
-    QTHREAD_LOCK(&theQueue.lock);
-    QTHREAD_UNLOCK(&theQueue.lock);
 } /*}}}*/
 
 static void qt_blocking_subsystem_internal_freemem(void)
@@ -72,16 +126,237 @@ static void qt_blocking_subsystem_internal_freemem(void)
 #if !defined(UNPOOLED)
     qt_mpool_destroy(syscall_job_pool);
 #endif
-    QTHREAD_DESTROYLOCK(&theQueue.lock);
-    QTHREAD_DESTROYCOND(&theQueue.notempty);
+    for (qthread_shepherd_id_t i = 0; i < nqueues; i++) {
+        QTHREAD_FASTLOCK_DESTROY(queues[i].lock);
+    }
+    FREE(queues, nqueues * sizeof(qt_blocking_queue_t));
+    queues  = NULL;
+    nqueues = 0;
+    QTHREAD_DESTROYLOCK(&idle_lock);
+    QTHREAD_DESTROYCOND(&notempty);
 } /*}}}*/
 
-static void *qt_blocking_subsystem_proxy_thread(void *QUNUSED(arg))
+static QINLINE size_t qt_blocking_write_len(const qt_blocking_queue_node_t *job)
 {   /*{{{*/
-    while (proxy_exit == 0) {
-        if (qt_process_blocking_call()) {
-            break;
+    size_t len;
+
+    memcpy(&len, &job->args[2], sizeof(size_t));
+    return len;
+} /*}}}*/
+
+/* Whether <job> can be written with the same call as <prev>, which came just
+ * before it in the queue. */
+static QINLINE int qt_blocking_coalescible(const qt_blocking_queue_node_t *prev,
+                                           const qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    int   prev_fd, fd;
+    off_t prev_offset, offset;
+
+    if ((job->op != prev->op) || ((job->op != WRITE) && (job->op != PWRITE))) {
+        return 0;
+    }
+    memcpy(&prev_fd, &prev->args[0], sizeof(int));
+    memcpy(&fd, &job->args[0], sizeof(int));
+    if (fd != prev_fd) { return 0; }
+    if (job->op == PWRITE) {
+        memcpy(&prev_offset, &prev->args[3], sizeof(off_t));
+        memcpy(&offset, &job->args[3], sizeof(off_t));
+        return offset == prev_offset + (off_t)qt_blocking_write_len(prev);
+    }
+    return 1;
+} /*}}}*/
+
+/* Takes the job at the head of the queue, along with any writes right behind
+ * it that can be coalesced with it; those stay linked through next. */
+static qt_blocking_queue_node_t *qt_blocking_queue_pop(qt_blocking_queue_t *q,
+                                                       saligned_t          *count)
+{   /*{{{*/
+    qt_blocking_queue_node_t *item, *last;
+
+    if (q->head == NULL) { return NULL; }
+    QTHREAD_FASTLOCK_LOCK(&q->lock);
+    item = q->head;
+    if (item != NULL) {
+        size_t bytes = 0;
+
+        last   = item;
+        *count = 1;
+        if ((item->op == WRITE) || (item->op == PWRITE)) {
+            bytes = qt_blocking_write_len(item);
+            while ((*count < coalesce_max) && (last->next != NULL) &&
+                   qt_blocking_coalescible(last, last->next) &&
+                   (bytes + qt_blocking_write_len(last->next) <= QT_IO_COALESCE_BYTES)) {
+                last   = last->next;
+                bytes += qt_blocking_write_len(last);
+                (*count)++;
+            }
+        }
+        q->head    = last->next;
+        last->next = NULL;
+        if (q->head == NULL) {
+            q->tail = NULL;
+        }
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&q->lock);
+    return item;
+} /*}}}*/
+
+/* The home shepherd's queue first, then everyone else's. */
+static qt_blocking_queue_node_t *qt_blocking_queue_find(qthread_shepherd_id_t home,
+                                                        saligned_t           *count)
+{   /*{{{*/
+    for (qthread_shepherd_id_t i = 0; i < nqueues; i++) {
+        qt_blocking_queue_node_t *item = qt_blocking_queue_pop(&queues[(home + i) % nqueues], count);
+
+        if (item != NULL) {
+            (void)qthread_incr(&queued, -*count);
+            qthread_debug(IO_DETAILS, "dequeued item:%p (%i jobs) from shepherd %u's queue (home %u)\n", item, (int)*count, (unsigned)((home + i) % nqueues), (unsigned)home);
+            return item;
+        }
+    }
+    return NULL;
+} /*}}}*/
+
+static void qt_blocking_write_one(qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    int    fd;
+    size_t len = qt_blocking_write_len(job);
+
+    memcpy(&fd, &job->args[0], sizeof(int));
+    if (job->op == WRITE) {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_WRITE
+        job->ret = syscall(SYS_write,
+                           fd,
+                           (const void *)job->args[1],
+                           len);
+#else
+        job->ret = write(fd,
+                         (const void *)job->args[1],
+                         len);
+#endif
+    } else {
+        off_t offset;
+
+        memcpy(&offset, &job->args[3], sizeof(off_t));
+#if HAVE_SYSCALL && HAVE_DECL_SYS_PWRITE
+        job->ret = syscall(SYS_pwrite,
+                           fd,
+                           (const void *)job->args[1],
+                           len,
+                           offset);
+#else
+        job->ret = pwrite(fd,
+                          (const void *)job->args[1],
+                          len,
+                          offset);
+#endif
+    }
+    if (job->ret < 0) {
+        job->err = errno;
+    }
+} /*}}}*/
+
+/* Makes a chain of coalesced writes with one call and gives each job its
+ * share of what was written. Whatever that call did not get to, or all of it
+ * if the call failed, is then written one job at a time, so every task sees
+ * what it would have seen had its write been made on its own. */
+static void qt_blocking_coalesced_write(qt_blocking_queue_node_t *first,
+                                        int                       count)
+{   /*{{{*/
+    struct iovec              iov[QT_IO_COALESCE_MAX];
+    qt_blocking_queue_node_t *job;
+    int                       fd, i;
+    ssize_t                   ret;
+
+    assert(count <= QT_IO_COALESCE_MAX);
+    for (job = first, i = 0; job != NULL; job = job->next, i++) {
+        iov[i].iov_base = (void *)job->args[1];
+        iov[i].iov_len  = qt_blocking_write_len(job);
+    }
+    assert(i == count);
+    memcpy(&fd, &first->args[0], sizeof(int));
+    if (first->op == WRITE) {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_WRITEV
+        ret = syscall(SYS_writev, fd, iov, count);
+#else
+        ret = writev(fd, iov, count);
+#endif
+    } else {
+        off_t offset;
+
+        memcpy(&offset, &first->args[3], sizeof(off_t));
+#if HAVE_SYSCALL && HAVE_DECL_SYS_PWRITEV
+        ret = syscall(SYS_pwritev, fd, iov, count, QT_SYSCALL_OFFSET(offset));
+#else
+        ret = pwritev(fd, iov, count, offset);
+#endif
+    }
+    qthread_debug(IO_DETAILS, "coalesced %i writes to fd %i: %i\n", count, fd, (int)ret);
+    (void)qthread_incr(&io_stats.coalesced, count - 1);
+    if (ret < 0) { ret = 0; }
+    for (job = first, i = 0; job != NULL; i++) {
+        qt_blocking_queue_node_t *next = job->next;
+
+        job->next = NULL;
+        if ((ret > 0) || (iov[i].iov_len == 0)) {
+            job->ret = ((size_t)ret < iov[i].iov_len) ? ret : (ssize_t)iov[i].iov_len;
+            ret     -= job->ret;
+        } else {
+            qt_blocking_write_one(job);
         }
+        /* the syscall wrappers free their own jobs */
+        qt_blocking_complete(job);
+        job = next;
+    }
+} /*}}}*/
+
+/* Gives up an idle proxy thread's slot, unless it is one of the warm ones,
+ * the pool was resized too recently, or a job showed up in the meantime (the
+ * enqueuer may have counted on this thread to take it). */
+static int qt_blocking_proxy_retire(void)
+{   /*{{{*/
+    aligned_t now, last;
+
+    if (proxy_exit) {
+        (void)qthread_incr(&io_worker_count, -1);
+        return 1;
+    }
+    if (io_worker_count <= io_worker_min) { return 0; }
+    now  = qt_blocking_now_usec();
+    last = last_resize;
+    if ((now - last < shrink_interval) ||
+        (qthread_cas(&last_resize, last, now) != last)) {
+        return 0;
+    }
+    (void)qthread_incr(&io_worker_count, -1);
+    MACHINE_FENCE;
+    if (proxy_exit || (queued == 0)) {
+        qthread_debug(IO_BEHAVIOR, "------------------------------------- exit()\n");
+        (void)qthread_incr(&io_stats.retired, 1);
+        return 1;
+    }
+    (void)qthread_incr(&io_worker_count, 1);
+    return 0;
+} /*}}}*/
+
+/* Counts a new proxy thread in, if there is room for one. */
+static int qt_blocking_proxy_reserve(void)
+{   /*{{{*/
+    if (qthread_incr(&io_worker_count, 1) < io_worker_max) { return 1; }
+    (void)qthread_incr(&io_worker_count, -1);
+    return 0;
+} /*}}}*/
+
+static void *qt_blocking_subsystem_proxy_thread(void *arg)
+{   /*{{{*/
+    const qthread_shepherd_id_t home = (qthread_shepherd_id_t)(uintptr_t)arg;
+
+    if (qaffinity && (qlib->shepherds[home].node != UINT_MAX)) {
+        /* close to the workers it serves, which is where the tasks and their
+         * buffers are */
+        qt_affinity_set(&qlib->shepherds[home].workers[0], qlib->nworkerspershep);
+    }
+    while (qt_process_blocking_call(home) == 0) {
         COMPILER_FENCE;
     }
     qthread_debug(IO_DETAILS, "proxy_exit = %i, exiting\n", proxy_exit);
@@ -89,93 +364,138 @@ static void *qt_blocking_subsystem_proxy_thread(void *QUNUSED(arg))
     return 0;
 } /*}}}*/
 
-static void qt_blocking_subsystem_spawnworker(void)
+/* The caller has already counted the new thread with
+ * qt_blocking_proxy_reserve(). */
+static void qt_blocking_subsystem_spawnworker(qthread_shepherd_id_t home)
 {   /*{{{*/
     int       r;
     pthread_t thr;
 
-    if ((r = pthread_create(&thr, NULL, qt_blocking_subsystem_proxy_thread, NULL)) != 0) {
+    if ((r = pthread_create(&thr, NULL, qt_blocking_subsystem_proxy_thread, (void *)(uintptr_t)home)) != 0) {
         fprintf(stderr, "qt_blocking_subsystem_init: pthread_create() failed (%d)\n", r);
         perror("qt_blocking_subsystem_init spawning proxy thread");
         abort();
     }
-    (void)qthread_incr(&io_worker_count, 1);
     pthread_detach(thr);
+    (void)qthread_incr(&io_stats.spawned, 1);
+    last_resize = qt_blocking_now_usec();
 } /*}}}*/
 
 void INTERNAL qt_blocking_subsystem_init(void)
 {   /*{{{*/
 #if !defined(UNPOOLED)
     syscall_job_pool = qt_mpool_create(sizeof(qt_blocking_queue_node_t));
+    qt_mpool_set_name(syscall_job_pool, "syscall_job_pool");
 #endif
-    theQueue.head   = NULL;
-    theQueue.tail   = NULL;
+    nqueues = qlib->nshepherds;
+    queues  = qt_calloc(nqueues, sizeof(qt_blocking_queue_t));
+    assert(queues);
+    for (qthread_shepherd_id_t i = 0; i < nqueues; i++) {
+        QTHREAD_FASTLOCK_INIT(queues[i].lock);
+    }
+    queued          = 0;
+    idle_proxies    = 0;
     io_worker_count = 0;
+    proxy_exit      = 0;
     io_worker_max   = qt_internal_get_env_num("MAX_IO_WORKERS", 10, 1);
+    io_worker_min   = qt_internal_get_env_num("MIN_IO_WORKERS", 1, 0);
+    if (io_worker_min > io_worker_max) {
+        io_worker_min = io_worker_max;
+    }
     timeout         = qt_internal_get_env_num("IO_TIMEOUT", 100, 100);
+    shrink_interval = qt_internal_get_env_num("IO_SHRINK_INTERVAL", 10000, 0);
+    spawn_latency   = qt_internal_get_env_num("IO_SPAWN_LATENCY", 50, 0) * 1e-6;
+    coalesce_max    = qt_internal_get_env_num("IO_COALESCE", 16, 1);
+    if (coalesce_max > QT_IO_COALESCE_MAX) {
+        coalesce_max = QT_IO_COALESCE_MAX;
+    }
+    last_resize     = 0;
+    memset(&io_stats, 0, sizeof(io_stats));
     TLS_INIT(IO_task_struct);
-    qassert(pthread_mutex_init(&theQueue.lock, NULL), 0);
-    qassert(pthread_cond_init(&theQueue.notempty, NULL), 0);
+    qassert(pthread_mutex_init(&idle_lock, NULL), 0);
+    qassert(pthread_cond_init(&notempty, NULL), 0);
     /* thread(s) must be stopped *before* shepherds die, to keep them from
      * trying to push orphan threads into shepherd queues */
     qthread_internal_cleanup_early(qt_blocking_subsystem_internal_stopwork);
     /* must be torn down *after* shepherds die, because live shepherd might try
      * to enqueue into my queue during shutdown */
     qthread_internal_cleanup(qt_blocking_subsystem_internal_freemem);
+#ifdef QTHREAD_USE_IO_URING
+    qt_io_uring_init();
+#endif
+#ifdef QTHREAD_USE_IO_EPOLL
+    qt_io_epoll_init();
+#endif
+    /* the warm proxies are there before the first burst, not left behind by
+     * it */
+    for (saligned_t i = 0; i < io_worker_min; i++) {
+        if (!qt_blocking_proxy_reserve()) { break; }
+        qt_blocking_subsystem_spawnworker((qthread_shepherd_id_t)(i % nqueues));
+    }
 } /*}}}*/
 
-int INTERNAL qt_process_blocking_call(void)
+int INTERNAL qt_process_blocking_call(qthread_shepherd_id_t home)
 {   /*{{{*/
     qt_blocking_queue_node_t *item;
+    qthread_t                *t;
+    unsigned long             wait  = timeout;
+    saligned_t                count = 0;
+    double                    waited;
 
-    QTHREAD_LOCK(&theQueue.lock);
-    while (theQueue.head == NULL) {
-        struct timeval  tv;
-        struct timespec ts;
-        int             ret;
+    while ((item = qt_blocking_queue_find(home, &count)) == NULL) {
+        int ret = 0;
 
-        COMPILER_FENCE;
-        gettimeofday(&tv, NULL);
-        ts.tv_sec  = tv.tv_sec;
-        ts.tv_nsec = (tv.tv_usec + timeout) * 1000;
-        ret        = pthread_cond_timedwait(&theQueue.notempty, &theQueue.lock, &ts);
-        switch(ret) {
-            case ETIMEDOUT:
-                qthread_debug(IO_BEHAVIOR, "condwait timed out\n");
-                if (theQueue.head == NULL) {
-                    qthread_debug(IO_BEHAVIOR, "------------------------------------- exit()\n");
-#ifdef QTHREAD_DEBUG
-                    unsigned ct = qthread_incr(&io_worker_count, -1);
-                    qthread_debug(IO_BEHAVIOR, "worker_count post exit is %u\n", (unsigned)ct - 1);
-#else
-                    (void)qthread_incr(&io_worker_count, -1);
-#endif
-                    QTHREAD_UNLOCK(&theQueue.lock);
-                    return 1;
-                } else {
-                    QTHREAD_UNLOCK(&theQueue.lock);
-                    return 0;
-                }
-
-            case EINVAL:
-                /* chances are, this is because ts is in the past */
-                qthread_debug(IO_DETAILS, "condwait returned EINVAL\n");
-                break;
-
-            default:
-                break;
+        if (proxy_exit) {
+            if (qt_blocking_proxy_retire()) { return 1; }
+            continue;
         }
+        QTHREAD_LOCK(&idle_lock);
+        (void)qthread_incr(&idle_proxies, 1);
+        MACHINE_FENCE;
+        /* an enqueuer either sees this thread idle and signals it, or bumped
+         * queued before the check */
+        if ((queued == 0) && !proxy_exit) {
+            if (io_worker_count <= io_worker_min) {
+                /* warm proxies have no reason to wake up on their own */
+                ret = pthread_cond_wait(&notempty, &idle_lock);
+            } else {
+                struct timeval  tv;
+                struct timespec ts;
+
+                gettimeofday(&tv, NULL);
+                ts.tv_sec  = tv.tv_sec + (tv.tv_usec + wait) / 1000000;
+                ts.tv_nsec = ((tv.tv_usec + wait) % 1000000) * 1000;
+                ret        = pthread_cond_timedwait(&notempty, &idle_lock, &ts);
+            }
+        }
+        (void)qthread_incr(&idle_proxies, -1);
+        QTHREAD_UNLOCK(&idle_lock);
+        if (ret == ETIMEDOUT) {
+            qthread_debug(IO_BEHAVIOR, "condwait timed out\n");
+            if ((queued == 0) && qt_blocking_proxy_retire()) {
+                qthread_debug(IO_BEHAVIOR, "worker_count post exit is %u\n", (unsigned)io_worker_count);
+                return 1;
+            }
+            /* not allowed to go yet; no point checking back any sooner */
+            wait = (shrink_interval > timeout) ? shrink_interval : timeout;
+        }
+    }
+    /* the stats are updated without synchronization; they are approximate */
+    waited = qtimer_wtime() - item->queued_at;
+    (void)qthread_incr(&io_stats.jobs, count);
+    io_stats.wait_avg += (waited - io_stats.wait_avg) / 16;
+    if (waited > io_stats.wait_max) {
+        io_stats.wait_max = waited;
     }
-    item = theQueue.head;
-    assert(item != NULL);
-    theQueue.head = item->next;
-    if (theQueue.tail == item) {
-        theQueue.tail = theQueue.head;
+    if ((waited > spawn_latency) && (queued > 0) && (idle_proxies == 0) &&
+        qt_blocking_proxy_reserve()) {
+        qthread_debug(IO_DETAILS, "job waited %g s for a proxy; spawning another\n", waited);
+        qt_blocking_subsystem_spawnworker(home);
+    }
+    if (item->next != NULL) {
+        qt_blocking_coalesced_write(item, (int)count);
+        return 0;
     }
-    theQueue.length--;
-    qthread_debug(IO_DETAILS, "dequeue... theQueue.head = %p, .tail = %p, item:%p, thread:%p, rdata:%p\n", theQueue.head, theQueue.tail, item, item->thread, item->thread->rdata);
-    QTHREAD_UNLOCK(&theQueue.lock);
-    item->next = NULL;
     /* do something with <item> */
     switch(item->op) {
         default:
@@ -264,6 +584,192 @@ int INTERNAL qt_process_blocking_call(void)
                               (void *)item->args[1],
                               (size_t)item->args[2],
                               offset);
+#endif
+            break;
+        }
+        case READV:
+        case WRITEV:
+        {
+            int fd, iovcnt;
+            memcpy(&fd, &item->args[0], sizeof(int));
+            memcpy(&iovcnt, &item->args[2], sizeof(int));
+            if (item->op == READV) {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_READV
+                item->ret = syscall(SYS_readv,
+                                    fd,
+                                    (const struct iovec *)item->args[1],
+                                    iovcnt);
+#else
+                item->ret = readv(fd,
+                                  (const struct iovec *)item->args[1],
+                                  iovcnt);
+#endif
+            } else {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_WRITEV
+                item->ret = syscall(SYS_writev,
+                                    fd,
+                                    (const struct iovec *)item->args[1],
+                                    iovcnt);
+#else
+                item->ret = writev(fd,
+                                   (const struct iovec *)item->args[1],
+                                   iovcnt);
+#endif
+            }
+            break;
+        }
+        case PREADV:
+        case PWRITEV:
+        {
+            int   fd, iovcnt;
+            off_t offset;
+            memcpy(&fd, &item->args[0], sizeof(int));
+            memcpy(&iovcnt, &item->args[2], sizeof(int));
+            memcpy(&offset, &item->args[3], sizeof(off_t));
+            if (item->op == PREADV) {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_PREADV
+                item->ret = syscall(SYS_preadv,
+                                    fd,
+                                    (const struct iovec *)item->args[1],
+                                    iovcnt,
+                                    QT_SYSCALL_OFFSET(offset));
+#else
+                item->ret = preadv(fd,
+                                   (const struct iovec *)item->args[1],
+                                   iovcnt,
+                                   offset);
+#endif
+            } else {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_PWRITEV
+                item->ret = syscall(SYS_pwritev,
+                                    fd,
+                                    (const struct iovec *)item->args[1],
+                                    iovcnt,
+                                    QT_SYSCALL_OFFSET(offset));
+#else
+                item->ret = pwritev(fd,
+                                    (const struct iovec *)item->args[1],
+                                    iovcnt,
+                                    offset);
+#endif
+            }
+            break;
+        }
+        case RECVMSG:
+        case SENDMSG:
+        {
+            int socket, flags;
+            memcpy(&socket, &item->args[0], sizeof(int));
+            memcpy(&flags, &item->args[2], sizeof(int));
+            if (item->op == RECVMSG) {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_RECVMSG
+                item->ret = syscall(SYS_recvmsg,
+                                    socket,
+                                    (struct msghdr *)item->args[1],
+                                    flags);
+#else
+                item->ret = recvmsg(socket,
+                                    (struct msghdr *)item->args[1],
+                                    flags);
+#endif
+            } else {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_SENDMSG
+                item->ret = syscall(SYS_sendmsg,
+                                    socket,
+                                    (const struct msghdr *)item->args[1],
+                                    flags);
+#else
+                item->ret = sendmsg(socket,
+                                    (const struct msghdr *)item->args[1],
+                                    flags);
+#endif
+            }
+            break;
+        }
+        case SPLICE:
+        case COPY_FILE_RANGE:
+        {
+            /* the offsets, if any, are copies owned by the wrapper */
+            int          fd_in, fd_out;
+            size_t       len;
+            unsigned int flags;
+            memcpy(&fd_in, &item->args[0], sizeof(int));
+            memcpy(&fd_out, &item->args[2], sizeof(int));
+            memcpy(&len, &item->args[4], sizeof(size_t));
+            memcpy(&flags, &item->args[5], sizeof(unsigned int));
+            if (item->op == SPLICE) {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_SPLICE
+                item->ret = syscall(SYS_splice,
+                                    fd_in,
+                                    (off_t *)item->args[1],
+                                    fd_out,
+                                    (off_t *)item->args[3],
+                                    len,
+                                    flags);
+#elif HAVE_SPLICE
+                item->ret = splice(fd_in,
+                                   (loff_t *)item->args[1],
+                                   fd_out,
+                                   (loff_t *)item->args[3],
+                                   len,
+                                   flags);
+#else
+                errno     = ENOSYS;
+                item->ret = -1;
+#endif
+            } else {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_COPY_FILE_RANGE
+                item->ret = syscall(SYS_copy_file_range,
+                                    fd_in,
+                                    (off_t *)item->args[1],
+                                    fd_out,
+                                    (off_t *)item->args[3],
+                                    len,
+                                    flags);
+#elif HAVE_COPY_FILE_RANGE
+                item->ret = copy_file_range(fd_in,
+                                            (loff_t *)item->args[1],
+                                            fd_out,
+                                            (loff_t *)item->args[3],
+                                            len,
+                                            flags);
+#else
+                errno     = ENOSYS;
+                item->ret = -1;
+#endif
+            }
+            break;
+        }
+        case SENDFILE:
+        {
+            int    out_fd, in_fd;
+            size_t count;
+            memcpy(&out_fd, &item->args[0], sizeof(int));
+            memcpy(&in_fd, &item->args[1], sizeof(int));
+            memcpy(&count, &item->args[3], sizeof(size_t));
+#if HAVE_SYSCALL && HAVE_DECL_SYS_SENDFILE
+# ifdef SYS_sendfile64
+            /* where there are two, this is the one with a 64-bit offset */
+            item->ret = syscall(SYS_sendfile64,
+                                out_fd,
+                                in_fd,
+                                (off_t *)item->args[2],
+                                count);
+# else
+            item->ret = syscall(SYS_sendfile,
+                                out_fd,
+                                in_fd,
+                                (off_t *)item->args[2],
+                                count);
+# endif
+#elif HAVE_SENDFILE && HAVE_SYS_SENDFILE_H
+            item->ret = sendfile(out_fd,
+                                 in_fd,
+                                 (off_t *)item->args[2],
+                                 count);
+#else
+            errno     = ENOSYS;
+            item->ret = -1;
 #endif
             break;
         }
@@ -321,29 +827,8 @@ int INTERNAL qt_process_blocking_call(void)
             break;
         }
         case WRITE:
-#if HAVE_SYSCALL && HAVE_DECL_SYS_WRITE
-            item->ret = syscall(SYS_write,
-                                (int)item->args[0],
-                                (const void *)item->args[1],
-                                (size_t)item->args[2]);
-#else
-            item->ret = write((int)item->args[0],
-                              (const void *)item->args[1],
-                              (size_t)item->args[2]);
-#endif
         case PWRITE:
-#if HAVE_SYSCALL && HAVE_DECL_SYS_PWRITE
-            item->ret = syscall(SYS_pwrite,
-                                (int)item->args[0],
-                                (const void *)item->args[1],
-                                (size_t)item->args[2],
-                                (off_t)item->args[3]);
-#else
-            item->ret = pwrite((int)item->args[0],
-                               (const void *)item->args[1],
-                               (size_t)item->args[2],
-                               (off_t)item->args[3]);
-#endif
+            qt_blocking_write_one(item);
             break;
         case USER_DEFINED:
         {
@@ -357,41 +842,111 @@ int INTERNAL qt_process_blocking_call(void)
             break;
         }
     }
-    /* and now, re-queue */
-    qt_threadqueue_enqueue(item->thread->rdata->shepherd_ptr->ready, item->thread);
-    FREE_SYSCALLJOB(item);
+    if (item->op == USER_DEFINED) {
+        t = item->thread;
+        FREE_SYSCALLJOB(item);
+        qt_threadqueue_enqueue(t->rdata->shepherd_ptr->ready, t);
+        return 0;
+    }
+    if (item->ret < 0) {
+        item->err = errno;
+    }
+    /* and now, re-queue; the syscall wrappers free their own jobs, so item
+     * must not be touched after this */
+    qt_blocking_complete(item);
     return 0;
 } /*}}}*/
 
-void INTERNAL qt_blocking_subsystem_enqueue(qt_blocking_queue_node_t *job)
+static void qt_blocking_subsystem_enqueue_one(qt_blocking_queue_node_t *job)
 {   /*{{{*/
-    qt_blocking_queue_node_t *prev;
-
     qthread_debug(IO_FUNCTIONS, "entering, job = %p, thread:%p, rdata:%p\n", job, job->thread, job->thread->rdata);
     assert(job->next == NULL);
     assert(job->thread->rdata);
-    QTHREAD_LOCK(&theQueue.lock);
-    qthread_debug(IO_DETAILS, "1) theQueue.head = %p, .tail = %p, job = %p\n", theQueue.head, theQueue.tail, job);
-    prev          = theQueue.tail;
-    theQueue.tail = job;
-    if (prev == NULL) {
-        theQueue.head = job;
+#ifdef QTHREAD_USE_IO_URING
+    if (qt_io_uring_submit(job, job->batch != NULL)) {
+        qthread_debug(IO_FUNCTIONS, "exiting, job = %p went to the ring\n", job);
+        return;
+    }
+#endif
+#ifdef QTHREAD_USE_IO_EPOLL
+    if (qt_io_epoll_submit(job)) {
+        qthread_debug(IO_FUNCTIONS, "exiting, job = %p went to the reactor\n", job);
+        return;
+    }
+#endif
+    qt_blocking_subsystem_enqueue_proxy(job);
+} /*}}}*/
+
+void INTERNAL qt_blocking_subsystem_enqueue_proxy(qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    qthread_shepherd_id_t home;
+    qt_blocking_queue_t  *q;
+    saligned_t            n;
+
+    home           = job->thread->rdata->shepherd_ptr->shepherd_id % nqueues;
+    q              = &queues[home];
+    job->queued_at = qtimer_wtime();
+    QTHREAD_FASTLOCK_LOCK(&q->lock);
+    if (q->tail == NULL) {
+        q->head = job;
     } else {
-        prev->next = job;
-    }
-    theQueue.length++;
-    qthread_debug(IO_DETAILS, "2) theQueue.head = %p, .tail = %p, job = %p\n", theQueue.head, theQueue.tail, job);
-    if (io_worker_count < theQueue.length) {
-        if (io_worker_count < io_worker_max) {
-            qthread_debug(IO_DETAILS, "++++++++++++++++++++ I think I oughta spawn a worker\n");
-            qt_blocking_subsystem_spawnworker();
+        q->tail->next = job;
+    }
+    q->tail = job;
+    QTHREAD_FASTLOCK_UNLOCK(&q->lock);
+    n = qthread_incr(&queued, 1) + 1;
+    MACHINE_FENCE;
+    if (idle_proxies > 0) {
+        QTHREAD_LOCK(&idle_lock);
+        QTHREAD_COND_SIGNAL(notempty);
+        QTHREAD_UNLOCK(&idle_lock);
+    } else if (io_worker_count < n) {
+        if (qt_blocking_proxy_reserve()) {
+            qthread_debug(IO_DETAILS, "++++++++++++++++++++ I think I oughta spawn a worker for shepherd %u\n", (unsigned)home);
+            qt_blocking_subsystem_spawnworker(home);
+        } else {
+            qthread_debug(IO_DETAILS, "%u jobs queued, there are %u workers\n", (unsigned)n, (unsigned)io_worker_count);
         }
-    } else {
-        qthread_debug(IO_DETAILS, "Queue is %u long, there are %u workers\n", (unsigned)theQueue.length, (unsigned)io_worker_count);
-        QTHREAD_COND_SIGNAL(theQueue.notempty);
     }
-    QTHREAD_UNLOCK(&theQueue.lock);
     qthread_debug(IO_FUNCTIONS, "exiting, job = %p\n", job);
 } /*}}}*/
 
+void INTERNAL qt_blocking_subsystem_enqueue(qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    if (job->batch == NULL) {
+        qt_blocking_subsystem_enqueue_one(job);
+        return;
+    }
+    /* The task is not woken before every job in the batch is done, so the
+     * jobs are all still there until the last of them is handed off. */
+    qthread_debug(IO_FUNCTIONS, "batch of %u jobs\n", (unsigned)job->batch->remaining);
+    while (job) {
+        qt_blocking_queue_node_t *next = job->batch_next;
+
+        qt_blocking_subsystem_enqueue_one(job);
+        job = next;
+    }
+#ifdef QTHREAD_USE_IO_URING
+    qt_io_uring_flush();
+#endif
+} /*}}}*/
+
+void qt_io_stats(qt_io_stats_t *stats)
+{   /*{{{*/
+    assert(stats);
+    memset(stats, 0, sizeof(qt_io_stats_t));
+    if (queues == NULL) { return; }
+    stats->proxies      = (io_worker_count > 0) ? (size_t)io_worker_count : 0;
+    stats->idle_proxies = (size_t)idle_proxies;
+    stats->min_proxies  = (size_t)io_worker_min;
+    stats->max_proxies  = (size_t)io_worker_max;
+    stats->queued       = (queued > 0) ? (size_t)queued : 0;
+    stats->jobs         = io_stats.jobs;
+    stats->coalesced    = io_stats.coalesced;
+    stats->spawned      = io_stats.spawned;
+    stats->retired      = io_stats.retired;
+    stats->wait_avg     = io_stats.wait_avg;
+    stats->wait_max     = io_stats.wait_max;
+} /*}}}*/
+
 /* vim:set expandtab: */
@@ -0,0 +1,495 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdio.h>                     /* for fprintf() */
+#include <stdlib.h>                    /* for abort() */
+#include <string.h>                    /* for memcpy() */
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>              /* for getrlimit() */
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+
+/* Internal Headers */
+#include "qt_io.h"
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qthread_innards.h"
+#include "qt_threadqueues.h"
+#include "qt_envariables.h"
+#include "qt_subsystems.h"
+#include "qt_debug.h"
+
+/* The reactor: socket calls are first tried without blocking by the worker
+ * that picked them up in qthread_master(). Those that would block are parked
+ * on their descriptor, which is registered (one-shot) with a single epoll set,
+ * and a reactor pthread retries them when epoll says the socket is ready.
+ * Parked tasks hold no thread at all, so the number of connections that can be
+ * waited on is not bounded by the number of proxy threads. */
+#define QT_EPOLL_CHUNK  256 /* descriptors per lazily allocated table chunk */
+#define QT_EPOLL_EVENTS 64
+#define QT_EPOLL_STOP   ((uint64_t)-1)
+
+/* what an attempt at a call came to */
+#define QT_EPOLL_DONE    1 /* ret and err are set */
+#define QT_EPOLL_WAIT    0 /* it would have blocked */
+#define QT_EPOLL_DECLINE -1 /* not a socket; let a proxy thread do it */
+
+typedef struct {
+    QTHREAD_FASTLOCK_TYPE     lock;
+    /* parked jobs, oldest first */
+    qt_blocking_queue_node_t *rd_head;
+    qt_blocking_queue_node_t *rd_tail;
+    qt_blocking_queue_node_t *wr_head;
+    qt_blocking_queue_node_t *wr_tail;
+    uint32_t                  armed;      /* events the epoll set is waiting for */
+    uint8_t                   registered; /* fd has been added to the epoll set */
+} qt_epoll_fd_t;
+
+static int             epfd           = -1;
+static int             stopfd         = -1;
+static int             reactor_active = 0;
+static pthread_t       reactor;
+static qt_epoll_fd_t **fd_chunks  = NULL;
+static size_t          fd_nchunks = 0;
+
+static qt_epoll_fd_t *qt_io_epoll_fd(int fd)
+{   /*{{{*/
+    size_t         c = (size_t)fd / QT_EPOLL_CHUNK;
+    qt_epoll_fd_t *chunk;
+
+    if ((fd < 0) || (c >= fd_nchunks)) { return NULL; }
+    chunk = fd_chunks[c];
+    if (chunk == NULL) {
+        qt_epoll_fd_t *old;
+
+        chunk = qt_calloc(QT_EPOLL_CHUNK, sizeof(qt_epoll_fd_t));
+        assert(chunk);
+        for (size_t i = 0; i < QT_EPOLL_CHUNK; i++) {
+            QTHREAD_FASTLOCK_INIT(chunk[i].lock);
+        }
+        old = qthread_cas_ptr(&fd_chunks[c], NULL, chunk);
+        if (old != NULL) {
+            for (size_t i = 0; i < QT_EPOLL_CHUNK; i++) {
+                QTHREAD_FASTLOCK_DESTROY(chunk[i].lock);
+            }
+            FREE(chunk, QT_EPOLL_CHUNK * sizeof(qt_epoll_fd_t));
+            chunk = old;
+        }
+    }
+    return &chunk[fd % QT_EPOLL_CHUNK];
+} /*}}}*/
+
+/* accept() and connect() have no per-call way to not block, so the socket is
+ * made non-blocking just for the call; this always happens under the fd's
+ * lock, so the reactor's own calls cannot see each other's flags. */
+static int qt_io_epoll_nonblock(int fd)
+{   /*{{{*/
+    int flags = fcntl(fd, F_GETFL);
+
+    if ((flags >= 0) && !(flags & O_NONBLOCK)) {
+        if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) { return -1; }
+    }
+    return flags;
+} /*}}}*/
+
+static void qt_io_epoll_restore(int fd,
+                                int flags)
+{   /*{{{*/
+    int err = errno;
+
+    if (!(flags & O_NONBLOCK)) {
+        (void)fcntl(fd, F_SETFL, flags);
+    }
+    errno = err;
+} /*}}}*/
+
+/* a socket the user made non-blocking expects EAGAIN, not to wait */
+static QINLINE int qt_io_epoll_user_nonblock(int fd)
+{   /*{{{*/
+    int flags = fcntl(fd, F_GETFL);
+
+    return (flags >= 0) && (flags & O_NONBLOCK);
+} /*}}}*/
+
+static int qt_io_epoll_fail(qt_blocking_queue_node_t *job,
+                            int                       err)
+{   /*{{{*/
+    job->ret = -1;
+    job->err = err;
+    return QT_EPOLL_DONE;
+} /*}}}*/
+
+/* Makes the call without blocking. <first> is set when the worker is trying it
+ * straight out of qthread_master(), the only time it may be declined. */
+static int qt_io_epoll_try(qt_blocking_queue_node_t *job,
+                           int                       first)
+{   /*{{{*/
+    int     fd;
+    ssize_t r;
+
+    memcpy(&fd, &job->args[0], sizeof(int));
+    switch(job->op) {
+        case READ:
+            do {
+                r = recv(fd, (void *)job->args[1], (size_t)job->args[2], MSG_DONTWAIT);
+            } while (r < 0 && errno == EINTR);
+            if (r >= 0) {
+                job->ret = r;
+                return QT_EPOLL_DONE;
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                if (first && qt_io_epoll_user_nonblock(fd)) { return qt_io_epoll_fail(job, EAGAIN); }
+                return QT_EPOLL_WAIT;
+            }
+            if (first && (errno == ENOTSOCK)) { return QT_EPOLL_DECLINE; }
+            return qt_io_epoll_fail(job, errno);
+
+        case WRITE:
+            /* like a blocking write(2), only done when all of it is sent
+             * (unless the user made the socket non-blocking); the job's ret
+             * counts what has been sent so far */
+            while ((size_t)job->args[2] > 0) {
+                r = send(fd, (const void *)job->args[1], (size_t)job->args[2], MSG_DONTWAIT);
+                if (r > 0) {
+                    job->ret     += r;
+                    job->args[1] += (uintptr_t)r;
+                    job->args[2] -= (uintptr_t)r;
+                    continue;
+                }
+                if ((r < 0) && (errno == EINTR)) { continue; }
+                if ((r < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+                    if (first && qt_io_epoll_user_nonblock(fd)) {
+                        /* a short count, or EAGAIN if nothing went out */
+                        if (job->ret > 0) { return QT_EPOLL_DONE; }
+                        return qt_io_epoll_fail(job, EAGAIN);
+                    }
+                    return QT_EPOLL_WAIT;
+                }
+                if (first && (job->ret == 0) && (errno == ENOTSOCK)) { return QT_EPOLL_DECLINE; }
+                if (job->ret == 0) { return qt_io_epoll_fail(job, errno); }
+                break; /* report what made it out, as write(2) would */
+            }
+            return QT_EPOLL_DONE;
+
+        case ACCEPT:
+        {
+            int flags = qt_io_epoll_nonblock(fd);
+
+            if (flags < 0) { return qt_io_epoll_fail(job, errno); }
+            do {
+#if HAVE_SYSCALL && HAVE_DECL_SYS_ACCEPT
+                r = syscall(SYS_accept, fd, (struct sockaddr *)job->args[1], (socklen_t *)job->args[2]);
+#else
+                r = accept(fd, (struct sockaddr *)job->args[1], (socklen_t *)job->args[2]);
+#endif
+            } while (r < 0 && errno == EINTR);
+            qt_io_epoll_restore(fd, flags);
+            if (r >= 0) {
+                job->ret = r;
+                return QT_EPOLL_DONE;
+            }
+            if (((errno == EAGAIN) || (errno == EWOULDBLOCK)) && !(flags & O_NONBLOCK)) {
+                return QT_EPOLL_WAIT;
+            }
+            return qt_io_epoll_fail(job, errno);
+        }
+
+        case CONNECT:
+        {
+            int       flags, err = 0;
+            socklen_t len = sizeof(err);
+
+            if (job->args[3]) {
+                /* in progress; the socket is writable once it is done */
+                if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) { return qt_io_epoll_fail(job, errno); }
+                if (err != 0) { return qt_io_epoll_fail(job, err); }
+                job->ret = 0;
+                return QT_EPOLL_DONE;
+            }
+            if ((flags = qt_io_epoll_nonblock(fd)) < 0) { return qt_io_epoll_fail(job, errno); }
+#if HAVE_SYSCALL && HAVE_DECL_SYS_CONNECT
+            r = syscall(SYS_connect, fd, (const struct sockaddr *)job->args[1], (socklen_t)job->args[2]);
+#else
+            r = connect(fd, (const struct sockaddr *)job->args[1], (socklen_t)job->args[2]);
+#endif
+            qt_io_epoll_restore(fd, flags);
+            if (r == 0) {
+                job->ret = 0;
+                return QT_EPOLL_DONE;
+            }
+            if (((errno == EINPROGRESS) || (errno == EINTR)) && !(flags & O_NONBLOCK)) {
+                job->args[3] = 1;
+                return QT_EPOLL_WAIT;
+            }
+            /* a full AF_UNIX backlog; a blocking connect() would wait it out */
+            if (first && (errno == EAGAIN) && !(flags & O_NONBLOCK)) { return QT_EPOLL_DECLINE; }
+            return qt_io_epoll_fail(job, errno);
+        }
+
+        default:
+            return QT_EPOLL_DECLINE;
+    }
+} /*}}}*/
+
+/* Moves every job in the list onto <done>, failing it with <err>. */
+static void qt_io_epoll_fail_all(qt_blocking_queue_node_t **head,
+                                 qt_blocking_queue_node_t **tail,
+                                 qt_blocking_queue_node_t **done,
+                                 int                        err)
+{   /*{{{*/
+    while (*head) {
+        qt_blocking_queue_node_t *job = *head;
+
+        *head     = job->next;
+        job->ret  = -1;
+        job->err  = err;
+        job->next = *done;
+        *done     = job;
+    }
+    *tail = NULL;
+} /*}}}*/
+
+/* Registers for whatever the parked jobs on fd are waiting for. Must hold the
+ * fd's lock. If the kernel will not watch the fd, its jobs fail. */
+static void qt_io_epoll_arm(int                        fd,
+                            qt_epoll_fd_t             *e,
+                            qt_blocking_queue_node_t **done)
+{   /*{{{*/
+    struct epoll_event ev;
+    uint32_t           want = 0;
+    int                r;
+
+    if (e->rd_head) { want |= EPOLLIN; }
+    if (e->wr_head) { want |= EPOLLOUT; }
+    if ((want == 0) || (want == e->armed)) { return; }
+    ev.events   = want | EPOLLONESHOT;
+    ev.data.u64 = (uint64_t)fd;
+    /* the fd may have been closed and reused since it was registered, which
+     * takes it out of the set behind our back */
+    r = epoll_ctl(epfd, e->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+    if ((r < 0) && (errno == ENOENT)) {
+        r = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    } else if ((r < 0) && (errno == EEXIST)) {
+        r = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+    if (r < 0) {
+        int err = errno;
+
+        qthread_debug(IO_DETAILS, "cannot watch fd %i (%i)\n", fd, err);
+        e->registered = 0;
+        e->armed      = 0;
+        qt_io_epoll_fail_all(&e->rd_head, &e->rd_tail, done, err);
+        qt_io_epoll_fail_all(&e->wr_head, &e->wr_tail, done, err);
+        return;
+    }
+    e->registered = 1;
+    e->armed      = want;
+} /*}}}*/
+
+/* Once completed, a job belongs to its task again, so next is read first. */
+static void qt_io_epoll_wake(qt_blocking_queue_node_t *done)
+{   /*{{{*/
+    while (done) {
+        qt_blocking_queue_node_t *next = done->next;
+
+        qt_blocking_complete(done);
+        done = next;
+    }
+} /*}}}*/
+
+int INTERNAL qt_io_epoll_submit(qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    qt_epoll_fd_t             *e;
+    qt_blocking_queue_node_t **head, **tail;
+    qt_blocking_queue_node_t  *done = NULL;
+    int                        fd;
+
+    if (!reactor_active) { return 0; }
+    switch(job->op) {
+        case READ:
+        case WRITE:
+        case ACCEPT:
+        case CONNECT:
+            break;
+        default:
+            return 0;
+    }
+    memcpy(&fd, &job->args[0], sizeof(int));
+    if ((e = qt_io_epoll_fd(fd)) == NULL) { return 0; }
+    if (job->op == WRITE) {
+        job->ret = 0;
+    } else if (job->op == CONNECT) {
+        job->args[3] = 0;
+    }
+    if ((job->op == READ) || (job->op == ACCEPT)) {
+        head = &e->rd_head;
+        tail = &e->rd_tail;
+    } else {
+        head = &e->wr_head;
+        tail = &e->wr_tail;
+    }
+    QTHREAD_FASTLOCK_LOCK(&e->lock);
+    /* jobs already parked on this fd go first */
+    if (*head == NULL) {
+        switch(qt_io_epoll_try(job, 1)) {
+            case QT_EPOLL_DECLINE:
+                QTHREAD_FASTLOCK_UNLOCK(&e->lock);
+                return 0;
+
+            case QT_EPOLL_DONE:
+                QTHREAD_FASTLOCK_UNLOCK(&e->lock);
+                qthread_debug(IO_DETAILS, "job %p (op %u) on fd %i did not have to wait\n", job, (unsigned)job->op, fd);
+                job->next = NULL;
+                qt_io_epoll_wake(job);
+                return 1;
+
+            default:
+                break;
+        }
+    }
+    job->next = NULL;
+    if (*tail) {
+        (*tail)->next = job;
+    } else {
+        *head = job;
+    }
+    *tail = job;
+    qt_io_epoll_arm(fd, e, &done);
+    QTHREAD_FASTLOCK_UNLOCK(&e->lock);
+    qthread_debug(IO_DETAILS, "job %p (op %u) parked on fd %i\n", job, (unsigned)job->op, fd);
+    qt_io_epoll_wake(done);
+    return 1;
+} /*}}}*/
+
+/* Retries the parked jobs in one direction, oldest first, until one of them
+ * would still block. */
+static void qt_io_epoll_retry(qt_blocking_queue_node_t **head,
+                              qt_blocking_queue_node_t **tail,
+                              qt_blocking_queue_node_t **done)
+{   /*{{{*/
+    while (*head && qt_io_epoll_try(*head, 0) != QT_EPOLL_WAIT) {
+        qt_blocking_queue_node_t *job = *head;
+
+        *head     = job->next;
+        job->next = *done;
+        *done     = job;
+    }
+    if (*head == NULL) { *tail = NULL; }
+} /*}}}*/
+
+static void *qt_io_epoll_reactor(void *QUNUSED(arg))
+{   /*{{{*/
+    struct epoll_event events[QT_EPOLL_EVENTS];
+
+    while (1) {
+        int n = epoll_wait(epfd, events, QT_EPOLL_EVENTS, -1);
+
+        if (n < 0) {
+            if (errno == EINTR) { continue; }
+            perror("qt_io_epoll_reactor: epoll_wait");
+            abort();
+        }
+        for (int i = 0; i < n; i++) {
+            qt_blocking_queue_node_t *done = NULL;
+            qt_epoll_fd_t            *e;
+            uint32_t                  ev = events[i].events;
+            int                       fd;
+
+            if (events[i].data.u64 == QT_EPOLL_STOP) {
+                qthread_debug(IO_DETAILS, "reactor exiting\n");
+                return NULL;
+            }
+            fd = (int)events[i].data.u64;
+            e  = qt_io_epoll_fd(fd);
+            QTHREAD_FASTLOCK_LOCK(&e->lock);
+            e->armed = 0; /* one-shot */
+            if (ev & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                qt_io_epoll_retry(&e->rd_head, &e->rd_tail, &done);
+            }
+            if (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                qt_io_epoll_retry(&e->wr_head, &e->wr_tail, &done);
+            }
+            qt_io_epoll_arm(fd, e, &done);
+            QTHREAD_FASTLOCK_UNLOCK(&e->lock);
+            qt_io_epoll_wake(done);
+        }
+    }
+    return NULL;
+} /*}}}*/
+
+static void qt_io_epoll_stop(void)
+{   /*{{{*/
+    uint64_t one = 1;
+
+    reactor_active = 0;
+    MACHINE_FENCE;
+    while (write(stopfd, &one, sizeof(one)) < 0 && errno == EINTR) ;
+    qassert(pthread_join(reactor, NULL), 0);
+} /*}}}*/
+
+static void qt_io_epoll_freemem(void)
+{   /*{{{*/
+    for (size_t c = 0; c < fd_nchunks; c++) {
+        if (fd_chunks[c]) {
+            for (size_t i = 0; i < QT_EPOLL_CHUNK; i++) {
+                QTHREAD_FASTLOCK_DESTROY(fd_chunks[c][i].lock);
+            }
+            FREE(fd_chunks[c], QT_EPOLL_CHUNK * sizeof(qt_epoll_fd_t));
+        }
+    }
+    FREE(fd_chunks, fd_nchunks * sizeof(qt_epoll_fd_t *));
+    fd_chunks  = NULL;
+    fd_nchunks = 0;
+    close(stopfd);
+    close(epfd);
+} /*}}}*/
+
+void INTERNAL qt_io_epoll_init(void)
+{   /*{{{*/
+    struct epoll_event ev;
+    struct rlimit      rl;
+    size_t             maxfds = 1 << 16;
+    int                r;
+
+    reactor_active = 0;
+    if (!qt_internal_get_env_bool("IO_EPOLL", 1)) { return; }
+    if ((getrlimit(RLIMIT_NOFILE, &rl) == 0) && (rl.rlim_cur != RLIM_INFINITY)) {
+        maxfds = (size_t)rl.rlim_cur;
+    }
+    if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        qthread_debug(IO_DETAILS, "epoll_create1 failed (%i); using proxy threads only\n", errno);
+        return;
+    }
+    if ((stopfd = eventfd(0, EFD_CLOEXEC)) < 0) {
+        qthread_debug(IO_DETAILS, "eventfd failed (%i); using proxy threads only\n", errno);
+        close(epfd);
+        return;
+    }
+    ev.events   = EPOLLIN;
+    ev.data.u64 = QT_EPOLL_STOP;
+    qassert(epoll_ctl(epfd, EPOLL_CTL_ADD, stopfd, &ev), 0);
+    fd_nchunks = (maxfds + QT_EPOLL_CHUNK - 1) / QT_EPOLL_CHUNK;
+    fd_chunks  = qt_calloc(fd_nchunks, sizeof(qt_epoll_fd_t *));
+    assert(fd_chunks);
+
+    if ((r = pthread_create(&reactor, NULL, qt_io_epoll_reactor, NULL)) != 0) {
+        fprintf(stderr, "qt_io_epoll_init: pthread_create() failed (%d)\n", r);
+        abort();
+    }
+    reactor_active = 1;
+    qthread_debug(IO_DETAILS, "epoll reactor ready for %u descriptors\n", (unsigned)maxfds);
+    /* like the proxy threads, the reactor must be gone before the shepherds */
+    qthread_internal_cleanup_early(qt_io_epoll_stop);
+    qthread_internal_cleanup(qt_io_epoll_freemem);
+} /*}}}*/
+
+/* vim:set expandtab: */
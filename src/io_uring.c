@@ -0,0 +1,481 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdio.h>                     /* for fprintf() */
+#include <stdlib.h>                    /* for abort() */
+#include <string.h>                    /* for memset() */
+#include <errno.h>
+#include <fcntl.h>                     /* for fcntl() */
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>                      /* for struct pollfd */
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* Internal Headers */
+#include "qt_io.h"
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qthread_innards.h"
+#include "qt_threadqueues.h"
+#include "qt_envariables.h"
+#include "qt_subsystems.h"
+#include "qt_debug.h"
+
+/* One ring is shared by every worker. Workers submit to it directly from
+ * qthread_master() when a task makes a blocking call, and one reaper pthread
+ * sleeps in the kernel until something completes, then re-enqueues the tasks
+ * that are done. So however many calls are outstanding, they cost one thread
+ * instead of one proxy thread apiece. */
+typedef struct {
+    int                   fd;
+    unsigned int          features;
+    /* submission side, protected by sq_lock */
+    QTHREAD_FASTLOCK_TYPE sq_lock;
+    volatile unsigned    *sq_head;
+    volatile unsigned    *sq_tail;
+    unsigned int          sq_mask;
+    unsigned int          sq_entries;
+    struct io_uring_sqe  *sqes;
+    /* completion side, only touched by the reaper */
+    volatile unsigned    *cq_head;
+    volatile unsigned    *cq_tail;
+    unsigned int          cq_mask;
+    struct io_uring_cqe  *cqes;
+    /* mappings */
+    void                 *sq_ring;
+    size_t                sq_ring_size;
+    void                 *cq_ring;
+    size_t                cq_ring_size;
+    size_t                sqes_size;
+    /* jobs in the kernel; never more than the CQ can hold */
+    saligned_t            inflight;
+    unsigned int          max_inflight;
+    uint8_t               supported[IORING_OP_LAST];
+    pthread_t             reaper;
+} qt_io_ring_t;
+
+static qt_io_ring_t ring;
+static int          ring_active = 0;
+
+static QINLINE int qt_io_uring_enter(unsigned int to_submit,
+                                     unsigned int min_complete,
+                                     unsigned int flags)
+{   /*{{{*/
+    return (int)syscall(SYS_io_uring_enter, ring.fd, to_submit, min_complete, flags, NULL, 0);
+} /*}}}*/
+
+/* Fills in sqe for job; returns 0 if the kernel cannot do it for us. */
+static int qt_io_uring_prep(struct io_uring_sqe      *sqe,
+                            qt_blocking_queue_node_t *job)
+{   /*{{{*/
+    int fd;
+
+    memcpy(&fd, &job->args[0], sizeof(int));
+    switch(job->op) {
+        case READ:
+        case WRITE:
+            if (!(ring.features & IORING_FEAT_RW_CUR_POS)) { return 0; }
+            sqe->off = (uint64_t)-1; /* from the file position, like read(2) */
+            /* fall through */
+        case PREAD:
+        case PWRITE:
+        {
+            size_t nbyte;
+
+            memcpy(&nbyte, &job->args[2], sizeof(size_t));
+            if (nbyte > UINT32_MAX) { return 0; }
+            sqe->opcode = ((job->op == READ) || (job->op == PREAD)) ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->fd     = fd;
+            sqe->addr   = (uint64_t)job->args[1];
+            sqe->len    = (uint32_t)nbyte;
+            if ((job->op == PREAD) || (job->op == PWRITE)) {
+                off_t offset;
+
+                memcpy(&offset, &job->args[3], sizeof(off_t));
+                sqe->off = (uint64_t)offset;
+            }
+            break;
+        }
+        case READV:
+        case WRITEV:
+            if (!(ring.features & IORING_FEAT_RW_CUR_POS)) { return 0; }
+            sqe->off = (uint64_t)-1;
+            /* fall through */
+        case PREADV:
+        case PWRITEV:
+        {
+            int iovcnt;
+
+            memcpy(&iovcnt, &job->args[2], sizeof(int));
+            if (iovcnt < 0) { return 0; }
+            sqe->opcode = ((job->op == READV) || (job->op == PREADV)) ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->fd     = fd;
+            sqe->addr   = (uint64_t)job->args[1];
+            sqe->len    = (uint32_t)iovcnt;
+            if ((job->op == PREADV) || (job->op == PWRITEV)) {
+                off_t offset;
+
+                memcpy(&offset, &job->args[3], sizeof(off_t));
+                sqe->off = (uint64_t)offset;
+            }
+            break;
+        }
+        case RECVMSG:
+        case SENDMSG:
+        {
+            int flags;
+
+            memcpy(&flags, &job->args[2], sizeof(int));
+            sqe->opcode    = (job->op == RECVMSG) ? IORING_OP_RECVMSG : IORING_OP_SENDMSG;
+            sqe->fd        = fd;
+            sqe->addr      = (uint64_t)job->args[1];
+            sqe->len       = 1;
+            sqe->msg_flags = (uint32_t)flags;
+            break;
+        }
+        case SPLICE:
+        {
+            /* the ring takes the offsets by value, and the wrapper moves them
+             * along afterwards */
+            const off_t *off_in  = (const off_t *)job->args[1];
+            const off_t *off_out = (const off_t *)job->args[3];
+            int          fd_out;
+            size_t       len;
+            unsigned int flags;
+
+            memcpy(&fd_out, &job->args[2], sizeof(int));
+            memcpy(&len, &job->args[4], sizeof(size_t));
+            memcpy(&flags, &job->args[5], sizeof(unsigned int));
+            if ((len > UINT32_MAX) || (flags & SPLICE_F_FD_IN_FIXED)) { return 0; }
+            sqe->opcode        = IORING_OP_SPLICE;
+            sqe->splice_fd_in  = fd;
+            sqe->splice_off_in = off_in ? (uint64_t)*off_in : (uint64_t)-1;
+            sqe->fd            = fd_out;
+            sqe->off           = off_out ? (uint64_t)*off_out : (uint64_t)-1;
+            sqe->len           = (uint32_t)len;
+            sqe->splice_flags  = flags;
+            break;
+        }
+        case ACCEPT:
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->fd     = fd;
+            sqe->addr   = (uint64_t)job->args[1];
+            sqe->addr2  = (uint64_t)job->args[2]; /* socklen_t * */
+            break;
+        case CONNECT:
+            sqe->opcode = IORING_OP_CONNECT;
+            sqe->fd     = fd;
+            sqe->addr   = (uint64_t)job->args[1];
+            sqe->off    = (uint64_t)job->args[2]; /* socklen_t */
+            break;
+        case POLL:
+        {
+            /* only the common case of waiting forever on a single fd */
+            struct pollfd *fds = (struct pollfd *)job->args[0];
+            nfds_t         nfds;
+            int            timeout;
+
+            memcpy(&nfds, &job->args[1], sizeof(nfds_t));
+            memcpy(&timeout, &job->args[2], sizeof(int));
+            if ((nfds != 1) || (timeout >= 0) || (fds[0].fd < 0)) { return 0; }
+            sqe->opcode        = IORING_OP_POLL_ADD;
+            sqe->fd            = fds[0].fd;
+            sqe->poll32_events = (uint32_t)(unsigned short)fds[0].events;
+            break;
+        }
+        default:
+            return 0;
+    }
+    if (!ring.supported[sqe->opcode]) { return 0; }
+    if (job->op != POLL) {
+        /* the ring waits for a socket or pipe to be ready even if the user
+         * made it non-blocking, where the call should fail with EAGAIN or
+         * come back short instead */
+        const int flags = fcntl(fd, F_GETFL);
+
+        if ((flags >= 0) && (flags & O_NONBLOCK)) { return 0; }
+    }
+    return 1;
+} /*}}}*/
+
+/* Hands the kernel everything in the SQ that it has not consumed yet. Whatever
+ * it will not take right now (EAGAIN/EBUSY) is taken back out of the SQ and
+ * returned, linked through next, for the proxy threads to do instead: left in
+ * the SQ, it would wait for whatever made the next submission, which may be
+ * nothing. Without SQPOLL, the kernel only reads the SQ when it is entered
+ * to submit, which is always done under sq_lock, so the entries it did not
+ * consume are still ours. Must hold sq_lock. */
+static qt_blocking_queue_node_t *qt_io_uring_flush_locked(void)
+{   /*{{{*/
+    qt_blocking_queue_node_t *rejected = NULL;
+    unsigned int              tail     = *ring.sq_tail;
+    int                       ret;
+
+    do {
+        ret = qt_io_uring_enter(tail - *ring.sq_head, 0, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (tail != *ring.sq_head) {
+        qthread_debug(IO_DETAILS, "the ring did not take %u entries (errno %i); handing them to the proxies\n", tail - *ring.sq_head, (ret < 0) ? errno : 0);
+        while (tail != *ring.sq_head) {
+            qt_blocking_queue_node_t *job;
+
+            tail--;
+            job       = (qt_blocking_queue_node_t *)(uintptr_t)ring.sqes[tail & ring.sq_mask].user_data;
+            job->next = rejected;
+            rejected  = job;
+            (void)qthread_incr(&ring.inflight, -1);
+        }
+        MACHINE_FENCE;
+        *ring.sq_tail = tail;
+    }
+    return rejected;
+} /*}}}*/
+
+static void qt_io_uring_reject(qt_blocking_queue_node_t *rejected)
+{   /*{{{*/
+    while (rejected) {
+        qt_blocking_queue_node_t *next = rejected->next;
+
+        rejected->next = NULL;
+        qt_blocking_subsystem_enqueue_proxy(rejected);
+        rejected = next;
+    }
+} /*}}}*/
+
+void INTERNAL qt_io_uring_flush(void)
+{   /*{{{*/
+    qt_blocking_queue_node_t *rejected = NULL;
+
+    if (!ring_active) { return; }
+    QTHREAD_FASTLOCK_LOCK(&ring.sq_lock);
+    if (ring_active && (*ring.sq_tail != *ring.sq_head)) {
+        rejected = qt_io_uring_flush_locked();
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&ring.sq_lock);
+    qt_io_uring_reject(rejected);
+} /*}}}*/
+
+int INTERNAL qt_io_uring_submit(qt_blocking_queue_node_t *job,
+                                int                       defer)
+{   /*{{{*/
+    qt_blocking_queue_node_t *rejected = NULL;
+    struct io_uring_sqe      *sqe;
+    unsigned int              tail;
+
+    if (!ring_active) { return 0; }
+    QTHREAD_FASTLOCK_LOCK(&ring.sq_lock);
+    tail = *ring.sq_tail;
+    if (!ring_active || ((unsigned int)ring.inflight >= ring.max_inflight) ||
+        (tail - *ring.sq_head >= ring.sq_entries - 1)) {
+        QTHREAD_FASTLOCK_UNLOCK(&ring.sq_lock);
+        return 0;
+    }
+    sqe = &ring.sqes[tail & ring.sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    if (!qt_io_uring_prep(sqe, job)) {
+        QTHREAD_FASTLOCK_UNLOCK(&ring.sq_lock);
+        return 0;
+    }
+    sqe->user_data = (uint64_t)(uintptr_t)job;
+    (void)qthread_incr(&ring.inflight, 1);
+    MACHINE_FENCE;
+    *ring.sq_tail = tail + 1;
+    MACHINE_FENCE;
+    if (!defer) {
+        rejected = qt_io_uring_flush_locked();
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&ring.sq_lock);
+    qthread_debug(IO_DETAILS, "job %p (op %u) %s the ring\n", job, (unsigned)job->op, defer ? "queued in" : "submitted to");
+    /* the job has been taken care of either way */
+    qt_io_uring_reject(rejected);
+    return 1;
+} /*}}}*/
+
+static void *qt_io_uring_reaper(void *QUNUSED(arg))
+{   /*{{{*/
+    int done = 0;
+
+    while (!done) {
+        unsigned int head, tail;
+
+        if ((qt_io_uring_enter(0, 1, IORING_ENTER_GETEVENTS) < 0) && (errno != EINTR)) {
+            perror("qt_io_uring_reaper: io_uring_enter");
+            abort();
+        }
+        head = *ring.cq_head;
+        tail = *ring.cq_tail;
+        MACHINE_FENCE;
+        for (; head != tail; head++) {
+            struct io_uring_cqe      *cqe = &ring.cqes[head & ring.cq_mask];
+            qt_blocking_queue_node_t *job = (qt_blocking_queue_node_t *)(uintptr_t)cqe->user_data;
+
+            if (job == NULL) {
+                /* the wake-up from qt_io_uring_stop() */
+                done = 1;
+                continue;
+            }
+            if (cqe->res < 0) {
+                job->ret = -1;
+                job->err = -cqe->res;
+            } else if (job->op == POLL) {
+                ((struct pollfd *)job->args[0])->revents = (short)cqe->res;
+                job->ret                                 = 1;
+            } else {
+                job->ret = cqe->res;
+            }
+            (void)qthread_incr(&ring.inflight, -1);
+            qt_blocking_complete(job);
+        }
+        MACHINE_FENCE;
+        *ring.cq_head = head;
+    }
+    qthread_debug(IO_DETAILS, "reaper exiting\n");
+    return NULL;
+} /*}}}*/
+
+static void qt_io_uring_stop(void)
+{   /*{{{*/
+    struct io_uring_sqe *sqe;
+    unsigned int         tail;
+
+    QTHREAD_FASTLOCK_LOCK(&ring.sq_lock);
+    ring_active = 0;
+    /* there is always room for this: submissions leave a slot free for it */
+    tail = *ring.sq_tail;
+    sqe  = &ring.sqes[tail & ring.sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_NOP;
+    MACHINE_FENCE;
+    *ring.sq_tail = tail + 1;
+    MACHINE_FENCE;
+    /* nothing else is submitted any more, so this must not be taken back */
+    while (*ring.sq_head != tail + 1) {
+        if ((qt_io_uring_enter(tail + 1 - *ring.sq_head, 0, 0) < 0) &&
+            (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+            perror("qt_io_uring_stop: io_uring_enter");
+            abort();
+        }
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&ring.sq_lock);
+    qassert(pthread_join(ring.reaper, NULL), 0);
+} /*}}}*/
+
+static void qt_io_uring_freemem(void)
+{   /*{{{*/
+    munmap(ring.sqes, ring.sqes_size);
+    if (ring.cq_ring != ring.sq_ring) {
+        munmap(ring.cq_ring, ring.cq_ring_size);
+    }
+    munmap(ring.sq_ring, ring.sq_ring_size);
+    close(ring.fd);
+    QTHREAD_FASTLOCK_DESTROY(ring.sq_lock);
+} /*}}}*/
+
+/* Asks the kernel which operations it supports; old kernels that cannot
+ * answer get no ring at all. */
+static int qt_io_uring_probe(void)
+{   /*{{{*/
+    const size_t           size  = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = MALLOC(size);
+    int                    ret;
+
+    if (probe == NULL) { return 0; }
+    memset(probe, 0, size);
+    ret = (int)syscall(SYS_io_uring_register, ring.fd, IORING_REGISTER_PROBE, probe, 256);
+    if (ret == 0) {
+        for (unsigned int i = 0; i < probe->ops_len && i < IORING_OP_LAST; i++) {
+            ring.supported[i] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED) ? 1 : 0;
+        }
+    }
+    FREE(probe, size);
+    return (ret == 0);
+} /*}}}*/
+
+void INTERNAL qt_io_uring_init(void)
+{   /*{{{*/
+    struct io_uring_params p;
+    unsigned int           entries;
+    int                    r;
+
+    ring_active = 0;
+    if (!qt_internal_get_env_bool("IO_URING", 1)) { return; }
+    entries = qt_internal_get_env_num("IO_URING_ENTRIES", 256, 256);
+    memset(&ring, 0, sizeof(ring));
+    memset(&p, 0, sizeof(p));
+    ring.fd = (int)syscall(SYS_io_uring_setup, entries, &p);
+    if (ring.fd < 0) {
+        qthread_debug(IO_DETAILS, "io_uring_setup failed (%i); using proxy threads only\n", errno);
+        return;
+    }
+    if (!qt_io_uring_probe() || !ring.supported[IORING_OP_NOP]) {
+        qthread_debug(IO_DETAILS, "io_uring cannot be probed; using proxy threads only\n");
+        close(ring.fd);
+        return;
+    }
+    ring.features     = p.features;
+    ring.sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring.cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring.cq_ring_size > ring.sq_ring_size) {
+            ring.sq_ring_size = ring.cq_ring_size;
+        }
+        ring.cq_ring_size = ring.sq_ring_size;
+    }
+    ring.sq_ring = mmap(NULL, ring.sq_ring_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    if (ring.sq_ring == MAP_FAILED) { goto nomap; }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring.cq_ring = ring.sq_ring;
+    } else {
+        ring.cq_ring = mmap(NULL, ring.cq_ring_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+        if (ring.cq_ring == MAP_FAILED) { goto nomap_cq; }
+    }
+    ring.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes      = mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED) { goto nomap_sqes; }
+
+    ring.sq_head    = (unsigned *)((char *)ring.sq_ring + p.sq_off.head);
+    ring.sq_tail    = (unsigned *)((char *)ring.sq_ring + p.sq_off.tail);
+    ring.sq_mask    = *(unsigned *)((char *)ring.sq_ring + p.sq_off.ring_mask);
+    ring.sq_entries = p.sq_entries;
+    /* sqe i always sits in slot i */
+    for (unsigned int i = 0; i < p.sq_entries; i++) {
+        ((unsigned *)((char *)ring.sq_ring + p.sq_off.array))[i] = i;
+    }
+    ring.cq_head = (unsigned *)((char *)ring.cq_ring + p.cq_off.head);
+    ring.cq_tail = (unsigned *)((char *)ring.cq_ring + p.cq_off.tail);
+    ring.cq_mask = *(unsigned *)((char *)ring.cq_ring + p.cq_off.ring_mask);
+    ring.cqes    = (struct io_uring_cqe *)((char *)ring.cq_ring + p.cq_off.cqes);
+    /* leave room in the CQ for the stop NOP, and in the SQ to submit it */
+    ring.max_inflight = ((p.cq_entries < p.sq_entries) ? p.cq_entries : p.sq_entries) - 1;
+    QTHREAD_FASTLOCK_INIT(ring.sq_lock);
+
+    if ((r = pthread_create(&ring.reaper, NULL, qt_io_uring_reaper, NULL)) != 0) {
+        fprintf(stderr, "qt_io_uring_init: pthread_create() failed (%d)\n", r);
+        abort();
+    }
+    ring_active = 1;
+    qthread_debug(IO_DETAILS, "io_uring ready: %u SQ entries, %u CQ entries, features %x\n", p.sq_entries, p.cq_entries, p.features);
+    /* like the proxy threads, the reaper must be gone before the shepherds */
+    qthread_internal_cleanup_early(qt_io_uring_stop);
+    qthread_internal_cleanup(qt_io_uring_freemem);
+    return;
+
+nomap_sqes:
+    if (ring.cq_ring != ring.sq_ring) {
+        munmap(ring.cq_ring, ring.cq_ring_size);
+    }
+nomap_cq:
+    munmap(ring.sq_ring, ring.sq_ring_size);
+nomap:
+    qthread_debug(IO_DETAILS, "io_uring cannot be mapped; using proxy threads only\n");
+    close(ring.fd);
+} /*}}}*/
+
+/* vim:set expandtab: */
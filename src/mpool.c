@@ -6,8 +6,13 @@
 #include <pthread.h>
 
 #include <stddef.h>                    /* for size_t (according to C89) */
+#include <stdio.h>                     /* for fprintf() */
 #include <stdlib.h>                    /* for calloc() and malloc() */
 #include <string.h>
+#include <strings.h>                   /* for strcasecmp() */
+#if defined(HAVE_MMAP) || defined(HAVE_MADVISE)
+# include <sys/mman.h>                 /* for mmap(), munmap() and madvise() */
+#endif
 
 /* External Headers */
 #ifdef QTHREAD_USE_VALGRIND
@@ -35,42 +40,78 @@
 #include "qt_visibility.h"
 #include "qt_alloc.h"
 #include "qt_subsystems.h"
-
-/* Seems SLIGHTLY faster without TLS, and a whole lot safer and cleaner */
-#ifdef TLS
-# undef TLS
-#endif
+#include "qt_shepherd_innards.h"       /* for qthread_internal_getshep() */
+#include "qthread_innards.h"           /* for qlib */
+#include "qt_affinity.h"               /* for qt_affinity_mem_tonode() */
 
 typedef struct threadlocal_cache_s qt_mpool_threadlocal_cache_t;
 
-#ifdef TLS
-static TLS_DECL_INIT(qt_mpool_threadlocal_cache_t *, pool_caches);
-static TLS_DECL_INIT(uintptr_t, pool_cache_count);
-static aligned_t                      pool_cache_global_max = 1;
-static qt_mpool_threadlocal_cache_t **pool_cache_array      = NULL;
-#endif
+/* Pools are split into per-NUMA-node arenas (the node being the shepherd's
+ * node field). Each arena has its own reuse pool, and items freed by a thread
+ * on another node are pushed onto the owning arena's remote_frees stack, which
+ * the owner drains before touching its reuse pool. With a single node, this
+ * is just the old global reuse pool. */
+#define QT_MPOOL_MAX_NODES 64
+
+/* Blocks whose items were all sitting in a reuse pool when the pool was
+ * trimmed; their pages have been handed back to the OS and they are reused
+ * like fresh blocks. */
+typedef struct qt_mpool_trimmed_s {
+    uint8_t                   *items;
+    struct qt_mpool_trimmed_s *next;
+} qt_mpool_trimmed_t;
+
+typedef struct qt_mpool_node_s {
+    QTHREAD_FASTLOCK_TYPE reuse_lock;
+    void                 *reuse_pool;
+    size_t                reuse_items;
+    qt_mpool_trimmed_t   *trimmed;
+    void *volatile        remote_frees;
+    aligned_t             trimming;
+} qt_mpool_node_t;
+
+/* In multi-node pools, each block starts with a header recording its node
+ * and is aligned to block_span, so the owner of any item can be found by
+ * masking its address. */
+typedef struct qt_mpool_block_header_s {
+    unsigned int node;
+} qt_mpool_block_header_t;
 
 struct qt_mpool_s {
     size_t item_size;
     size_t alloc_size;
     size_t items_per_alloc;
     size_t alignment;
+    const char *name;
+    size_t block_alignment;  // single-node only: page-aligned when possible, so blocks can be trimmed
 
-#ifdef TLS
-    size_t                        offset;
-#else
-    pthread_key_t                 threadlocal_cache;
-#endif
-    qt_mpool_threadlocal_cache_t *caches;  // for cleanup
+    unsigned int     nnodes;
+    unsigned int     huge;             // QT_MPOOL_HUGE_*
+    size_t           block_bytes;      // mapped only: header + items, in (huge) pages
+    size_t           block_span;       // mapped only: block alignment
+    qt_mpool_node_t *nodes;
 
-    QTHREAD_FASTLOCK_TYPE         reuse_lock;
-    void                         *reuse_pool;
+    /* Workers find their cache by packed_worker_id; other threads (and
+     * workers of a pool created before qthread_initialize()) fall back to a
+     * pthread key. */
+    union qt_mpool_worker_cache_u *worker_caches;
+    qthread_worker_id_t            nworker_caches;
+    pthread_key_t                  threadlocal_cache;
+    qt_mpool_threadlocal_cache_t  *caches;  // for cleanup
 
     QTHREAD_FASTLOCK_TYPE         pool_lock;
     void                        **alloc_list;
     size_t                        alloc_list_pos;
+    size_t                        nblocks;
+
+    /* free bytes a node's reuse pool may hold before it is trimmed */
+    size_t                        high_water;
+    struct qt_mpool_s            *next_pool;  // all pools, for qt_mpool_trim_all()
 };
 
+static pthread_mutex_t pool_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static qt_mpool        pool_list      = NULL;
+
 typedef struct qt_mpool_cache_entry_s {
     struct qt_mpool_cache_entry_s *next;
     struct qt_mpool_cache_entry_s *block_tail;
@@ -82,34 +123,82 @@ struct threadlocal_cache_s {
     uint_fast16_t                 count;
     uint8_t                      *block;
     uint_fast32_t                 i;
+    unsigned int                  node;
     qt_mpool_threadlocal_cache_t *next;  // for cleanup
+    /* only ever written by the owning thread; read racily by
+     * qt_mpool_stats() */
+    uint64_t                      allocs;
+    uint64_t                      frees;
 };
 
-#ifdef TLS
-static void qt_mpool_subsystem_shutdown(void)
-{
-    qthread_debug(MPOOL_FUNCTIONS, "deleting pool_caches\n");
-    TLS_DELETE(pool_caches);
-    TLS_DELETE(pool_cache_count);
-    for (int i = 0; i < qthread_readstate(TOTAL_WORKERS); ++i) {
-        if (pool_cache_array[i]) {
-            qt_free(pool_cache_array[i]);
-        }
-    }
-    FREE(pool_cache_array, sizeof(void *) * qthread_readstate(TOTAL_WORKERS));
-}
-#endif /* ifdef TLS */
+/* padded so that neighbouring workers do not share a cache line */
+union qt_mpool_worker_cache_u {
+    qt_mpool_threadlocal_cache_t tc;
+    uint8_t                      pad[CACHELINE_WIDTH];
+};
+
+/* Pools made with qt_mpool_create_huge() back their blocks with huge pages
+ * when QT_HUGEPAGES asks for it: "thp" asks for transparent huge pages,
+ * "explicit" maps from the hugetlb reserve and falls back to THP when the
+ * reserve is empty. */
+#define QT_MPOOL_HUGE_NONE     0
+#define QT_MPOOL_HUGE_THP      1
+#define QT_MPOOL_HUGE_EXPLICIT 2
+
+static unsigned int qt_mpool_huge_mode = QT_MPOOL_HUGE_NONE;
+static size_t       qt_mpool_hugepage_size = 2 * 1024 * 1024;
+
+/* QT_MPOOL_NODES splits pools into that many arenas whatever the topology,
+ * with shepherds dealt out among them round-robin, so that the multi-node
+ * paths can be exercised on a single-node machine. The arenas are not bound
+ * to real nodes. */
+static unsigned int qt_mpool_forced_nodes = 0;
+
+/* Blocks of mapped pools come from mmap() rather than the aligned allocator:
+ * multi-node pools, for the node header and span alignment, and huge-page
+ * pools. */
+#define QT_MPOOL_MAPPED(pool) (((pool)->nnodes > 1) || (pool)->huge)
+
+static void qt_mpool_stats_at_exit(void)
+{                                      /*{{{ */
+    qt_mpool_stats_dump(qt_internal_get_env_str("MPOOL_STATS_FILE", NULL));
+}                                      /*}}} */
 
 void INTERNAL qt_mpool_subsystem_init(void)
-{
-#ifdef TLS
-    assert(TLS_GET(pool_caches) == NULL);
-    assert(TLS_GET(pool_cache_count) == 0);
-    pool_cache_array = qt_calloc(sizeof(void *),
-                                 qthread_readstate(TOTAL_WORKERS));
-    qthread_internal_cleanup_late(qt_mpool_subsystem_shutdown);
+{                                      /*{{{ */
+#if defined(HAVE_MMAP) && (defined(MADV_HUGEPAGE) || defined(MAP_HUGETLB))
+    const char *huge = qt_internal_get_env_str("HUGEPAGES", "no");
+
+    if (huge == NULL) {
+        qt_mpool_huge_mode = QT_MPOOL_HUGE_NONE;
+    } else if (!strcasecmp(huge, "thp") || !strcasecmp(huge, "yes")) {
+        qt_mpool_huge_mode = QT_MPOOL_HUGE_THP;
+    } else if (!strcasecmp(huge, "explicit")) {
+# ifdef MAP_HUGETLB
+        qt_mpool_huge_mode = QT_MPOOL_HUGE_EXPLICIT;
+# else
+        qt_mpool_huge_mode = QT_MPOOL_HUGE_THP;
+# endif
+    } else {
+        qt_mpool_huge_mode = QT_MPOOL_HUGE_NONE;
+    }
+    qt_mpool_hugepage_size = qt_internal_get_env_num("HUGEPAGE_SIZE", 2 * 1024 * 1024, 2 * 1024 * 1024);
+    if ((qt_mpool_hugepage_size < pagesize) || (qt_mpool_hugepage_size & (qt_mpool_hugepage_size - 1))) {
+        qt_mpool_hugepage_size = 2 * 1024 * 1024;
+    }
+    qthread_debug(MPOOL_DETAILS, "huge page mode %u, size %lu\n", qt_mpool_huge_mode, (unsigned long)qt_mpool_hugepage_size);
+#endif
+#ifdef HAVE_MMAP
+    qt_mpool_forced_nodes = qt_internal_get_env_num("MPOOL_NODES", 0, 0);
+    if (qt_mpool_forced_nodes > QT_MPOOL_MAX_NODES) {
+        qt_mpool_forced_nodes = QT_MPOOL_MAX_NODES;
+    }
 #endif
-}
+    /* early, so that the runtime's pools still exist */
+    if (qt_internal_get_env_bool("MPOOL_STATS_AT_EXIT", 0)) {
+        qthread_internal_cleanup_early(qt_mpool_stats_at_exit);
+    }
+}                                      /*}}} */
 
 /* local funcs */
 static QINLINE void *qt_mpool_internal_aligned_alloc(size_t alloc_size,
@@ -127,13 +216,171 @@ static QINLINE void qt_mpool_internal_aligned_free(void  *freeme,
     qt_internal_aligned_free(freeme, alignment);
 }                                      /*}}} */
 
+/* Pool bookkeeping does not go through qt_malloc(), because qt_malloc()
+ * itself may be built on pools (see alloc/sizeclass.c). */
+static QINLINE void *qt_mpool_internal_meta_alloc(size_t size)
+{                                      /*{{{ */
+    return qt_internal_aligned_alloc(size, sizeof(void *));
+}                                      /*}}} */
+
+static QINLINE void qt_mpool_internal_meta_free(void *freeme)
+{                                      /*{{{ */
+    qt_internal_aligned_free(freeme, sizeof(void *));
+}                                      /*}}} */
+
+/* The number of distinct shepherd nodes, or 1 if pools should not be split. */
+/* The arena that shepherd <shep>'s workers allocate from. */
+static QINLINE unsigned int qt_mpool_internal_shepnode(const qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    if (qt_mpool_forced_nodes > 1) { return shep % qt_mpool_forced_nodes; }
+    return qlib->shepherds[shep].node;
+}                                      /*}}} */
+
+static unsigned int qt_mpool_internal_nnodes(void)
+{                                      /*{{{ */
+    unsigned int nnodes = 1;
+
+#ifdef HAVE_MMAP
+    if ((qlib == NULL) || (qlib->shepherds == NULL) ||
+        !qt_internal_get_env_bool("MPOOL_NUMA", 1)) {
+        return 1;
+    }
+    if (qt_mpool_forced_nodes > 1) { return qt_mpool_forced_nodes; }
+    for (qthread_shepherd_id_t i = 0; i < qlib->nshepherds; i++) {
+        const unsigned int node = qlib->shepherds[i].node;
+        if ((node < QT_MPOOL_MAX_NODES) && (node >= nnodes)) {
+            nnodes = node + 1;
+        }
+    }
+#endif
+    return nnodes;
+}                                      /*}}} */
+
+static QINLINE unsigned int qt_mpool_internal_mynode(const qt_mpool pool)
+{                                      /*{{{ */
+    qthread_shepherd_t *shep;
+    unsigned int        node;
+
+    if (pool->nnodes == 1) { return 0; }
+    shep = qthread_internal_getshep();
+    if (shep == NULL) { return 0; }
+    node = qt_mpool_internal_shepnode(shep->shepherd_id);
+    return (node < pool->nnodes) ? node : 0;
+}                                      /*}}} */
+
+static QINLINE unsigned int qt_mpool_internal_owner(const qt_mpool pool,
+                                                    const void    *mem)
+{                                      /*{{{ */
+    if (pool->nnodes == 1) { return 0; }
+    return ((qt_mpool_block_header_t *)((uintptr_t)mem & ~(uintptr_t)(pool->block_span - 1)))->node;
+}                                      /*}}} */
+
+/* Allocates a fresh block for the given node, records it for
+ * qt_mpool_destroy(), and returns a pointer to its first item. */
+static void *qt_mpool_internal_block_alloc(qt_mpool     pool,
+                                           unsigned int node)
+{                                      /*{{{ */
+    uint8_t *block;
+    uint8_t *items;
+
+    if (!QT_MPOOL_MAPPED(pool)) {
+        block = qt_mpool_internal_aligned_alloc(pool->alloc_size, pool->block_alignment);
+        qassert_ret((block != NULL), NULL);
+        items = block;
+    } else {
+#ifdef HAVE_MMAP
+        /* over-map by block_span and trim to get span alignment; spans are
+         * multiples of the huge page size in huge-page pools, so the trims
+         * stay on huge page boundaries */
+        const size_t span = pool->block_span;
+        unsigned int huge = pool->huge;
+        uint8_t     *map  = MAP_FAILED;
+        size_t       lead;
+
+# ifdef MAP_HUGETLB
+        if (huge == QT_MPOOL_HUGE_EXPLICIT) {
+            map = mmap(NULL, pool->block_bytes + span, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (map == MAP_FAILED) {
+                qthread_debug(MPOOL_BEHAVIOR, "hugetlb reserve exhausted; falling back to THP\n");
+                /* other threads may be allocating blocks at the same time */
+                huge = QT_MPOOL_HUGE_THP;
+                QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
+                pool->huge = huge;
+                QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
+            }
+        }
+# endif
+        if (map == MAP_FAILED) {
+            map = mmap(NULL, pool->block_bytes + span, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        qassert_ret((map != MAP_FAILED), NULL);
+        block = (uint8_t *)(((uintptr_t)map + span - 1) & ~(uintptr_t)(span - 1));
+        lead  = block - map;
+        if (lead) { munmap(map, lead); }
+        munmap(block + pool->block_bytes, span - lead);
+# ifdef MADV_HUGEPAGE
+        if (huge == QT_MPOOL_HUGE_THP) {
+            madvise(block, pool->block_bytes, MADV_HUGEPAGE);
+        }
+# endif
+# ifdef QTHREAD_HAVE_MEM_AFFINITY
+        /* bind before the header write touches the first page; without
+         * memory affinity support, first touch by the node's own workers
+         * places the pages */
+        if (qt_mpool_forced_nodes <= 1) {
+            qt_affinity_mem_tonode(block, pool->block_bytes, node);
+        }
+# endif
+        if (pool->nnodes > 1) {
+            ((qt_mpool_block_header_t *)block)->node = node;
+            items = block + pool->alignment;
+        } else {
+            items = block;
+        }
+        VALGRIND_MAKE_MEM_NOACCESS(items, pool->alloc_size);
+#else
+        abort();
+#endif  /* ifdef HAVE_MMAP */
+    }
+    assert((((uintptr_t)items) & (pool->alignment - 1)) == 0);
+    QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
+    if (pool->alloc_list_pos == (pagesize / sizeof(void *) - 1)) {
+        void **tmp = qt_internal_aligned_alloc(pagesize, pagesize);
+        qassert_ret((tmp != NULL), NULL);
+        memset(tmp, 0, pagesize);
+        tmp[pagesize / sizeof(void *) - 1] = pool->alloc_list;
+        pool->alloc_list                   = tmp;
+        pool->alloc_list_pos               = 0;
+    }
+    pool->alloc_list[pool->alloc_list_pos] = block;
+    pool->alloc_list_pos++;
+    pool->nblocks++;
+    QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
+    return items;
+}                                      /*}}} */
+
+static void qt_mpool_internal_block_free(qt_mpool pool,
+                                         void    *block)
+{                                      /*{{{ */
+#ifdef HAVE_MMAP
+    if (QT_MPOOL_MAPPED(pool)) {
+        munmap(block, pool->block_bytes);
+        return;
+    }
+#endif
+    qt_mpool_internal_aligned_free(block, pool->block_alignment);
+}                                      /*}}} */
+
 // sync means lock-protected
 // item_size is how many bytes to return
 // ...memory is always allocated in multiples of getpagesize()
-qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
-                                          size_t alignment)
+static qt_mpool qt_mpool_internal_create(size_t       item_size,
+                                         size_t       alignment,
+                                         unsigned int huge)
 {                                      /*{{{ */
-    qt_mpool pool = (qt_mpool)MALLOC(sizeof(struct qt_mpool_s));
+    qt_mpool pool = (qt_mpool)qt_mpool_internal_meta_alloc(sizeof(struct qt_mpool_s));
 
     size_t alloc_size = 0;
     /* Allow a user to specify a max_alloc_size. If no limit was specified
@@ -168,6 +415,7 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
 
     pool->item_size = item_size;
     pool->alignment = alignment;
+    pool->name      = NULL;
     /* next, we find the least-common-multiple in sizes between item_size and
      * pagesize. If this is less than 128 items (an arbitrary number), we
      * increase the alloc_size until it is at least that big. This guarantees
@@ -202,114 +450,520 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
     }
     pool->alloc_size      = alloc_size;
     pool->items_per_alloc = alloc_size / item_size;
-    pool->reuse_pool      = NULL;
-    QTHREAD_FASTLOCK_INIT(pool->reuse_lock);
+    pool->block_alignment = ((alloc_size % pagesize == 0) && (alignment <= pagesize)) ? pagesize : alignment;
+    pool->nnodes          = qt_mpool_internal_nnodes();
+    pool->huge            = huge;
+    pool->block_bytes     = 0;
+    pool->block_span      = 0;
+    if (QT_MPOOL_MAPPED(pool)) {
+        const size_t header = (pool->nnodes > 1) ? alignment : 0;
+        const size_t unit   = huge ? qt_mpool_hugepage_size : pagesize;
+
+        pool->block_bytes = header + alloc_size;
+        if (pool->block_bytes % unit) {
+            pool->block_bytes += unit - (pool->block_bytes % unit);
+        }
+        if (huge) {
+            /* fill the huge pages with items rather than leave slack */
+            pool->items_per_alloc = (pool->block_bytes - header) / item_size;
+            pool->alloc_size      = pool->items_per_alloc * item_size;
+        }
+        /* multi-node pools find a block's header by masking, so their
+         * span is a power of two covering the block */
+        pool->block_span = unit;
+        while ((pool->nnodes > 1) && (pool->block_span < pool->block_bytes)) {
+            pool->block_span *= 2;
+        }
+    }
+    pool->nodes = qt_internal_aligned_alloc(sizeof(qt_mpool_node_t) * pool->nnodes, CACHELINE_WIDTH);
+    qassert_goto((pool->nodes != NULL), errexit);
+    for (unsigned int n = 0; n < pool->nnodes; n++) {
+        QTHREAD_FASTLOCK_INIT(pool->nodes[n].reuse_lock);
+        pool->nodes[n].reuse_pool   = NULL;
+        pool->nodes[n].reuse_items  = 0;
+        pool->nodes[n].trimmed      = NULL;
+        pool->nodes[n].remote_frees = NULL;
+        pool->nodes[n].trimming     = 0;
+    }
+    qthread_debug(MPOOL_DETAILS, "%u nodes, block_bytes:%u block_span:%u\n", pool->nnodes, (unsigned)pool->block_bytes, (unsigned)pool->block_span);
     QTHREAD_FASTLOCK_INIT(pool->pool_lock);
-#ifdef TLS
-    pool->offset = qthread_incr(&pool_cache_global_max, 1);
-#else
     pthread_key_create(&pool->threadlocal_cache, NULL);
-#endif
+    pool->worker_caches  = NULL;
+    pool->nworker_caches = 0;
+    if (qlib && qlib->shepherds) {
+        const qthread_worker_id_t wps = qlib->nworkerspershep;
+
+        pool->nworker_caches = qlib->nshepherds * wps;
+        pool->worker_caches  = qt_internal_aligned_alloc(sizeof(union qt_mpool_worker_cache_u) * pool->nworker_caches,
+                                                         CACHELINE_WIDTH);
+        qassert_goto((pool->worker_caches != NULL), errexit);
+        memset(pool->worker_caches, 0, sizeof(union qt_mpool_worker_cache_u) * pool->nworker_caches);
+        /* packed_worker_id is shepherd * workers-per-shepherd + worker */
+        for (qthread_worker_id_t w = 0; w < pool->nworker_caches; w++) {
+            const unsigned int node = qt_mpool_internal_shepnode(w / wps);
+            pool->worker_caches[w].tc.node = (node < pool->nnodes) ? node : 0;
+        }
+    }
     /* this assumes that pagesize is a multiple of sizeof(void*) */
     assert(pagesize % sizeof(void *) == 0);
     pool->alloc_list = qt_internal_aligned_alloc(pagesize, pagesize);
     qassert_goto((pool->alloc_list != NULL), errexit);
     memset(pool->alloc_list, 0, pagesize);
     pool->alloc_list_pos = 0;
+    pool->nblocks        = 0;
+    {
+        static size_t high_water = 0;
+        if (high_water == 0) {
+            high_water = qt_internal_get_env_num("MPOOL_HIGH_WATER", 64 * 1024 * 1024, SIZE_MAX);
+        }
+        pool->high_water = high_water;
+    }
 
     pool->caches = NULL;
+    pthread_mutex_lock(&pool_list_lock);
+    pool->next_pool = pool_list;
+    pool_list       = pool;
+    pthread_mutex_unlock(&pool_list_lock);
     return pool;
 
     qgoto(errexit);
     if (pool) {
-        FREE(pool, sizeof(struct qt_mpool_s));
+        if (pool->nodes) {
+            qt_internal_aligned_free(pool->nodes, CACHELINE_WIDTH);
+        }
+        qt_mpool_internal_meta_free(pool);
     }
     return NULL;
 }                                      /*}}} */
 
-static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
-{
-    qt_mpool_threadlocal_cache_t *tc;
+qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
+                                          size_t alignment)
+{                                      /*{{{ */
+    return qt_mpool_internal_create(item_size, alignment, QT_MPOOL_HUGE_NONE);
+}                                      /*}}} */
+
+qt_mpool INTERNAL qt_mpool_create_huge(size_t item_size,
+                                       size_t alignment)
+{                                      /*{{{ */
+    return qt_mpool_internal_create(item_size, alignment, qt_mpool_huge_mode);
+}                                      /*}}} */
+
+int INTERNAL qt_mpool_is_huge(const qt_mpool pool)
+{                                      /*{{{ */
+    return pool->huge != QT_MPOOL_HUGE_NONE;
+}                                      /*}}} */
+
+static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache_slow(qt_mpool pool)
+{   /*{{{*/
+    qt_mpool_threadlocal_cache_t *tc = pthread_getspecific(pool->threadlocal_cache);
 
-#ifdef TLS
-    tc = TLS_GET(pool_caches);
-    {
-        uintptr_t count_caches = (uintptr_t)TLS_GET(pool_cache_count);
-        qthread_debug(MPOOL_DETAILS, "-> count_caches = %i, pool->offset = %i\n", (int)count_caches, (int)pool->offset);
-        if (count_caches < pool->offset) {
-# if !defined(QTHREAD_NO_ASSERTS) || defined(QTHREAD_DEBUG)
-            qthread_worker_id_t wkr = qthread_readstate(CURRENT_UNIQUE_WORKER);
-            /* I don't fully understand why this is necessary. I *suspect* that
-             * on thread 0, the initialization routine isn't happening
-             * properly, so pool_caches gets a bogus value. However, that makes
-             * no sense to me. */
-            if ((wkr == 0) && (pool_cache_array[0] == NULL) && (tc != NULL)) {
-                qthread_debug(MPOOL_DETAILS, "%u -> resetting tc to NULL (was %p)\n", wkr, tc);
-                tc = NULL;
-            }
-# endif
-            ASSERT_ONLY(if (wkr != NO_WORKER) {
-                            assert(pool_cache_array[wkr] == tc);
-                        }
-                        )
-            qthread_debug(MPOOL_DETAILS, "%u -> realloc-ing the tc (%p)\n", wkr, tc);
-            qt_mpool_threadlocal_cache_t *newtc = qt_realloc(tc,
-                                                             sizeof(qt_mpool_threadlocal_cache_t) * pool->offset);
-            qthread_debug(MPOOL_DETAILS, "%u ->     new tc (%p)\n", wkr, newtc);
-            assert(newtc);
-            if (tc != newtc) {
-                qthread_worker_id_t wkr = qthread_readstate(CURRENT_UNIQUE_WORKER);
-                tc = newtc;
-                TLS_SET(pool_caches, newtc);
-                if (wkr != NO_WORKER) {
-                    pool_cache_array[wkr] = newtc;
-                    qthread_debug(MPOOL_DETAILS, "setting pool_cache_array[%u] -> %p\n", wkr, pool_cache_array[wkr]);
-                } else {
-                    qthread_debug(MPOOL_DETAILS, "leaking memory (%p)\n", newtc);
-                }
-            }
-            memset(tc + count_caches, 0, sizeof(qt_mpool_threadlocal_cache_t) * (pool->offset - count_caches));
-            count_caches = pool->offset;
-            TLS_SET(pool_cache_count, count_caches);
-        } else if (tc == NULL) {
-            qthread_debug(MPOOL_DETAILS, "tc was NULL despite count_caches being big enough!?! (%p)\n", tc);
-# if !defined(QTHREAD_NO_ASSERTS)
-            qthread_worker_id_t wkr = qthread_readstate(CURRENT_UNIQUE_WORKER);
-            /* I don't fully understand why this is necessary. I *suspect* that
-             * on thread 0, the initialization routine isn't happening
-             * properly, so pool_caches gets a bogus value. However, that makes
-             * no sense to me. */
-            if ((wkr == 0) && (pool_cache_array[0] == NULL) && (tc != NULL)) {
-                qthread_debug(MPOOL_DETAILS, "%u -> resetting tc to NULL (was %p)\n", wkr, tc);
-                tc = NULL;
-            }
-            if (wkr != NO_WORKER) {
-                qthread_debug(MPOOL_DETAILS, "pool_cache_array[%u] -> %p\n", wkr, pool_cache_array[wkr]);
-                assert(pool_cache_array[wkr] == tc);
-            }
-# endif
-        }
-    }
-    assert(tc);
-    tc += (pool->offset - 1);
-#else /* ifdef TLS */
-    tc = pthread_getspecific(pool->threadlocal_cache);
     if (NULL == tc) {
         tc = qt_internal_aligned_alloc(sizeof(qt_mpool_threadlocal_cache_t), CACHELINE_WIDTH);
         assert(tc);
         tc->cache = NULL;
         tc->count = 0;
         tc->block = NULL;
-        tc->i     = 0;
+        tc->i      = 0;
+        tc->node   = qt_mpool_internal_mynode(pool);
+        tc->allocs = 0;
+        tc->frees  = 0;
         do {
             tc->next = pool->caches;
         } while (qthread_cas_ptr(&pool->caches, tc->next, tc) != tc->next);
         qthread_debug(MPOOL_DETAILS, "added %p to caches\n", tc);
         pthread_setspecific(pool->threadlocal_cache, tc);
     }
-#endif /* ifdef TLS */
     return tc;
-}
+} /*}}}*/
+
+static QINLINE qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
+{   /*{{{*/
+    qthread_worker_t *w = qthread_internal_getworker();
+
+    if (QTHREAD_LIKELY(w && (w->packed_worker_id < pool->nworker_caches))) {
+        return &pool->worker_caches[w->packed_worker_id].tc;
+    }
+    return qt_mpool_internal_getcache_slow(pool);
+} /*}}}*/
+
+static QINLINE uint8_t *qt_mpool_internal_block_items(const qt_mpool pool,
+                                                      void          *block)
+{                                      /*{{{ */
+    return (pool->nnodes > 1) ? (uint8_t *)block + pool->alignment : (uint8_t *)block;
+}                                      /*}}} */
+
+static int qt_mpool_internal_ptr_cmp(const void *a,
+                                     const void *b)
+{                                      /*{{{ */
+    const uintptr_t x = *(const uintptr_t *)a, y = *(const uintptr_t *)b;
+
+    return (x > y) - (x < y);
+}                                      /*}}} */
+
+/* Returns the index in the sorted blocks array of the block holding mem. */
+static size_t qt_mpool_internal_find_block(uint8_t *const *blocks,
+                                           size_t          nblocks,
+                                           const void     *mem)
+{                                      /*{{{ */
+    size_t lo = 0, hi = nblocks;
+
+    while (hi - lo > 1) {
+        const size_t mid = (lo + hi) / 2;
+        if ((uintptr_t)blocks[mid] <= (uintptr_t)mem) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}                                      /*}}} */
+
+/* Returns the pages of blocks that are entirely free in node n's reuse pool
+ * to the OS, until at most target bytes of free items are left there.
+ * Returns the number of bytes released. */
+static size_t qt_mpool_internal_trim_node(qt_mpool     pool,
+                                          unsigned int n,
+                                          size_t       target)
+{                                      /*{{{ */
+    size_t             released = 0;
+#ifdef HAVE_MADVISE
+    qt_mpool_node_t   *node            = &pool->nodes[n];
+    const size_t       items_per_alloc = pool->items_per_alloc;
+    qt_mpool_cache_t  *list, *keep = NULL, *keep_tail = NULL;
+    size_t             cnt, kept = 0, nblocks = 0;
+    uint8_t          **blocks;
+    size_t            *counts;
+
+    if (qthread_cas(&node->trimming, 0, 1) != 0) { return 0; }
+    QTHREAD_FASTLOCK_LOCK(&node->reuse_lock);
+    list              = node->reuse_pool;
+    cnt               = node->reuse_items;
+    node->reuse_pool  = NULL;
+    node->reuse_items = 0;
+    QTHREAD_FASTLOCK_UNLOCK(&node->reuse_lock);
+    if (cnt * pool->item_size <= target) { goto put_back; }
+
+    /* snapshot the block list, sorted by item address */
+    QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
+    blocks = qt_mpool_internal_meta_alloc(sizeof(uint8_t *) * (pool->nblocks + 1));
+    counts = qt_mpool_internal_meta_alloc(sizeof(size_t) * (pool->nblocks + 1));
+    if (blocks && counts) {
+        memset(counts, 0, sizeof(size_t) * (pool->nblocks + 1));
+        void **al  = pool->alloc_list;
+        size_t pos = pool->alloc_list_pos;
+
+        while (al) {
+            for (size_t i = 0; i < pos; i++) {
+                blocks[nblocks++] = qt_mpool_internal_block_items(pool, al[i]);
+            }
+            al  = al[pagesize / sizeof(void *) - 1];
+            pos = pagesize / sizeof(void *) - 1;
+        }
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
+    if ((blocks == NULL) || (counts == NULL) || (nblocks == 0)) { goto cleanup; }
+    qsort(blocks, nblocks, sizeof(uint8_t *), qt_mpool_internal_ptr_cmp);
+
+    for (qt_mpool_cache_t *c = list; c; c = c->next) {
+        counts[qt_mpool_internal_find_block(blocks, nblocks, c)]++;
+    }
+    /* pick the fully-free blocks to release */
+    for (size_t b = 0; b < nblocks && cnt * pool->item_size > target; b++) {
+        if (counts[b] == items_per_alloc) {
+            counts[b] = SIZE_MAX;  /* marks the block as released */
+            cnt      -= items_per_alloc;
+        }
+    }
+    /* rebuild the reuse list from the items of the blocks that stay; its
+     * length is still a multiple of items_per_alloc */
+    while (list) {
+        qt_mpool_cache_t *next = list->next;
+        if (counts[qt_mpool_internal_find_block(blocks, nblocks, list)] != SIZE_MAX) {
+            list->next = keep;
+            keep       = list;
+            if (keep_tail == NULL) { keep_tail = list; }
+            kept++;
+        }
+        list = next;
+    }
+    assert(kept == cnt);
+    assert(kept % items_per_alloc == 0);
+    /* every item in a chunk points at the chunk's last item */
+    {
+        qt_mpool_cache_t *chunk = keep;
+        while (chunk) {
+            qt_mpool_cache_t *tail = chunk;
+            for (size_t i = 1; i < items_per_alloc; i++) {
+                tail = tail->next;
+            }
+            for (qt_mpool_cache_t *c = chunk; c != tail->next; c = c->next) {
+                c->block_tail = tail;
+            }
+            chunk = tail->next;
+        }
+    }
+    list = keep;
+    for (size_t b = 0; b < nblocks; b++) {
+        if (counts[b] == SIZE_MAX) {
+            uint8_t *start = (uint8_t *)(((uintptr_t)blocks[b] + pagesize - 1) & ~(uintptr_t)(pagesize - 1));
+            uint8_t *end   = (uint8_t *)(((uintptr_t)blocks[b] + pool->alloc_size) & ~(uintptr_t)(pagesize - 1));
+            qt_mpool_trimmed_t *t = qt_mpool_internal_meta_alloc(sizeof(qt_mpool_trimmed_t));
+
+            assert(t);
+            if ((end > start) && (madvise(start, end - start, MADV_DONTNEED) == 0)) {
+                released += end - start;
+            }
+            VALGRIND_MAKE_MEM_NOACCESS(blocks[b], pool->alloc_size);
+            t->items = blocks[b];
+            QTHREAD_FASTLOCK_LOCK(&node->reuse_lock);
+            t->next       = node->trimmed;
+            node->trimmed = t;
+            QTHREAD_FASTLOCK_UNLOCK(&node->reuse_lock);
+        }
+    }
+    qthread_debug(MPOOL_BEHAVIOR, "pool %p node %u: released %lu bytes, %lu items left\n", pool, n, (unsigned long)released, (unsigned long)kept);
+cleanup:
+    if (blocks) { qt_mpool_internal_meta_free(blocks); }
+    if (counts) { qt_mpool_internal_meta_free(counts); }
+put_back:
+    if (list) {
+        qt_mpool_cache_t *tail = (list == keep) ? keep_tail : NULL;
+        if (tail == NULL) {
+            for (tail = list; tail->next; tail = tail->next) ;
+        }
+        QTHREAD_FASTLOCK_LOCK(&node->reuse_lock);
+        tail->next         = node->reuse_pool;
+        node->reuse_pool   = list;
+        node->reuse_items += cnt;
+        QTHREAD_FASTLOCK_UNLOCK(&node->reuse_lock);
+    }
+    node->trimming = 0;
+#endif  /* ifdef HAVE_MADVISE */
+    return released;
+}                                      /*}}} */
+
+size_t INTERNAL qt_mpool_trim(qt_mpool pool)
+{                                      /*{{{ */
+    size_t released = 0;
+
+    qassert_ret((pool != NULL), 0);
+    for (unsigned int n = 0; n < pool->nnodes; n++) {
+        released += qt_mpool_internal_trim_node(pool, n, 0);
+    }
+    return released;
+}                                      /*}}} */
+
+size_t INTERNAL qt_mpool_trim_all(void)
+{                                      /*{{{ */
+    size_t released = 0;
+
+    pthread_mutex_lock(&pool_list_lock);
+    for (qt_mpool pool = pool_list; pool; pool = pool->next_pool) {
+        released += qt_mpool_trim(pool);
+    }
+    pthread_mutex_unlock(&pool_list_lock);
+    return released;
+}                                      /*}}} */
+
+void INTERNAL qt_mpool_set_high_water(qt_mpool pool,
+                                      size_t   bytes)
+{                                      /*{{{ */
+    qassert_retvoid((pool != NULL));
+    pool->high_water = bytes;
+}                                      /*}}} */
+
+void INTERNAL qt_mpool_set_name(qt_mpool    pool,
+                                const char *name)
+{                                      /*{{{ */
+    qassert_retvoid((pool != NULL));
+    pool->name = name;
+}                                      /*}}} */
+
+static void qt_mpool_internal_stats_tc(const qt_mpool                      pool,
+                                       const qt_mpool_threadlocal_cache_t *tc,
+                                       qpool_stats_t                      *stats)
+{                                      /*{{{ */
+    stats->allocs += tc->allocs;
+    stats->frees  += tc->frees;
+    stats->cached += tc->count;
+    if (tc->block) {
+        stats->cached += pool->items_per_alloc - tc->i;
+    }
+}                                      /*}}} */
+
+void INTERNAL qt_mpool_stats(qt_mpool       pool,
+                             qpool_stats_t *stats)
+{                                      /*{{{ */
+    qassert_retvoid((pool != NULL));
+    qassert_retvoid((stats != NULL));
+    memset(stats, 0, sizeof(qpool_stats_t));
+    stats->name            = pool->name;
+    stats->item_size       = pool->item_size;
+    stats->items_per_block = pool->items_per_alloc;
+    stats->block_bytes     = pool->block_bytes ? pool->block_bytes : pool->alloc_size;
+    QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
+    stats->blocks     = pool->nblocks;
+    stats->huge_pages = pool->huge;
+    QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
+    for (qthread_worker_id_t w = 0; w < pool->nworker_caches; w++) {
+        qt_mpool_internal_stats_tc(pool, &pool->worker_caches[w].tc, stats);
+    }
+    for (const qt_mpool_threadlocal_cache_t *tc = pool->caches; tc; tc = tc->next) {
+        qt_mpool_internal_stats_tc(pool, tc, stats);
+    }
+    for (unsigned int n = 0; n < pool->nnodes; n++) {
+        qt_mpool_node_t *node = &pool->nodes[n];
+
+        QTHREAD_FASTLOCK_LOCK(&node->reuse_lock);
+        stats->reusable += node->reuse_items;
+        for (const qt_mpool_trimmed_t *t = node->trimmed; t; t = t->next) {
+            stats->trimmed_blocks++;
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&node->reuse_lock);
+    }
+    /* an item may be freed by a different thread than allocated it, so only
+     * the totals are meaningful */
+    stats->outstanding = (stats->allocs > stats->frees) ? stats->allocs - stats->frees : 0;
+}                                      /*}}} */
+
+size_t INTERNAL qt_mpool_stats_all(qpool_stats_t *stats,
+                                   size_t         count)
+{                                      /*{{{ */
+    size_t npools = 0;
+
+    pthread_mutex_lock(&pool_list_lock);
+    for (qt_mpool pool = pool_list; pool; pool = pool->next_pool) {
+        if (npools < count) {
+            qt_mpool_stats(pool, &stats[npools]);
+        }
+        npools++;
+    }
+    pthread_mutex_unlock(&pool_list_lock);
+    return npools;
+}                                      /*}}} */
+
+static int qt_mpool_internal_stats_cmp(const void *a,
+                                       const void *b)
+{                                      /*{{{ */
+    const qpool_stats_t *x = a, *y = b;
+    const size_t         xb = x->outstanding * x->item_size;
+    const size_t         yb = y->outstanding * y->item_size;
+
+    return (xb < yb) - (xb > yb);
+}                                      /*}}} */
+
+int INTERNAL qt_mpool_stats_dump(const char *filename)
+{                                      /*{{{ */
+    qpool_stats_t *stats;
+    size_t         npools, n;
+    FILE          *fp;
+
+    /* pools may be created between the two calls; a short list is fine */
+    npools = qt_mpool_stats_all(NULL, 0);
+    stats  = MALLOC(sizeof(qpool_stats_t) * (npools ? npools : 1));
+    qassert_ret((stats != NULL), QTHREAD_MALLOC_ERROR);
+    n = qt_mpool_stats_all(stats, npools);
+    if (n > npools) { n = npools; }
+    qsort(stats, n, sizeof(qpool_stats_t), qt_mpool_internal_stats_cmp);
+
+    fp = (filename == NULL) ? stderr : fopen(filename, "w");
+    if (fp == NULL) {
+        FREE(stats, sizeof(qpool_stats_t) * (npools ? npools : 1));
+        return QTHREAD_BADARGS;
+    }
+    fprintf(fp, "# qthreads memory pools: %lu\n", (unsigned long)n);
+    fprintf(fp, "name,item_size,items_per_block,blocks,trimmed_blocks,outstanding,cached,reusable,allocs,frees\n");
+    for (size_t i = 0; i < n; i++) {
+        fprintf(fp, "%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%llu,%llu\n",
+                stats[i].name ? stats[i].name : "(unnamed)",
+                (unsigned long)stats[i].item_size,
+                (unsigned long)stats[i].items_per_block,
+                (unsigned long)stats[i].blocks,
+                (unsigned long)stats[i].trimmed_blocks,
+                (unsigned long)stats[i].outstanding,
+                (unsigned long)stats[i].cached,
+                (unsigned long)stats[i].reusable,
+                (unsigned long long)stats[i].allocs,
+                (unsigned long long)stats[i].frees);
+    }
+    if (fp != stderr) {
+        fclose(fp);
+    } else {
+        fflush(fp);
+    }
+    FREE(stats, sizeof(qpool_stats_t) * (npools ? npools : 1));
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+/* Pushes n onto the thread-local cache tc, handing a full block's worth of
+ * items to the node's reuse pool when the cache gets too big. */
+static QINLINE void qt_mpool_internal_cache_push(qt_mpool                      pool,
+                                                 qt_mpool_threadlocal_cache_t *tc,
+                                                 qt_mpool_cache_t             *n)
+{   /*{{{*/
+    qt_mpool_cache_t *cache           = tc->cache;
+    size_t            cnt             = tc->count;
+    const size_t      items_per_alloc = pool->items_per_alloc;
+
+    qthread_debug(MPOOL_DETAILS, "->cache:%p (bt:%p) cnt:%u\n", cache, cache ? cache->block_tail : NULL, (unsigned int)cnt);
+    if (cache) {
+        assert(cnt != 0);
+        n->next       = cache;
+        n->block_tail = cache->block_tail; // cache is likely to be IN cache, so this won't be slow
+    } else {
+        assert(cnt == 0);
+        n->next       = NULL;
+        n->block_tail = n;
+    }
+    cnt++;
+    if (cnt >= (items_per_alloc * 2)) {
+        qt_mpool_node_t  *node = &pool->nodes[tc->node];
+        qt_mpool_cache_t *toglobal;
+        /* push to global */
+        qthread_debug(MPOOL_BEHAVIOR, "->push to global! cnt:%u\n", (unsigned)cnt);
+        assert(n);
+        assert(n->block_tail);
+        toglobal            = n->block_tail->next;
+        n->block_tail->next = NULL;
+        assert(toglobal);
+        assert(toglobal->block_tail);
+        QTHREAD_FASTLOCK_LOCK(&node->reuse_lock);
+        toglobal->block_tail->next = node->reuse_pool;
+        node->reuse_pool           = toglobal;
+        node->reuse_items         += items_per_alloc;
+        QTHREAD_FASTLOCK_UNLOCK(&node->reuse_lock);
+        cnt -= items_per_alloc;
+        if (QTHREAD_UNLIKELY(node->reuse_items * pool->item_size > pool->high_water)) {
+            /* trim down to half the mark, so that a pool hovering around
+             * it is not trimmed on every push */
+            qt_mpool_internal_trim_node(pool, tc->node, pool->high_water / 2);
+        }
+    } else if (cnt == items_per_alloc + 1) {
+        qthread_debug(MPOOL_BEHAVIOR, "->chop_block\n");
+        n->block_tail = n;
+    }
+    tc->cache = n;
+    tc->count = cnt;
+    qthread_debug(MPOOL_DETAILS, "->free count = %zu\n", (size_t)cnt);
+} /*}}}*/
+
+/* Moves everything other nodes have freed back to this node into tc. */
+static void qt_mpool_internal_drain_remote(qt_mpool                      pool,
+                                           qt_mpool_threadlocal_cache_t *tc)
+{   /*{{{*/
+    qt_mpool_node_t  *node = &pool->nodes[tc->node];
+    qt_mpool_cache_t *list;
+
+    do {
+        list = node->remote_frees;
+    } while (list && qthread_cas_ptr(&node->remote_frees, list, NULL) != list);
+    qthread_debug(MPOOL_BEHAVIOR, "->drained remote frees:%p\n", list);
+    while (list) {
+        qt_mpool_cache_t *next = list->next;
+        qt_mpool_internal_cache_push(pool, tc, list);
+        list = next;
+    }
+} /*}}}*/
 
 void INTERNAL *qt_mpool_alloc(qt_mpool pool)
 {   /*{{{*/
@@ -321,6 +975,11 @@ void INTERNAL *qt_mpool_alloc(qt_mpool pool)
 
     tc = qt_mpool_internal_getcache(pool);
     qthread_debug(MPOOL_BEHAVIOR, "->tc:%p cache:%p (bt:%p) cnt:%u\n", tc, tc->cache, tc->cache ? tc->cache->block_tail : NULL, (unsigned int)tc->count);
+    tc->allocs++;
+    if ((tc->cache == NULL) && (tc->block == NULL) &&
+        pool->nodes[tc->node].remote_frees) {
+        qt_mpool_internal_drain_remote(pool, tc);
+    }
     if (tc->cache) {
         qt_mpool_cache_t *cache = tc->cache;
         qthread_debug(MPOOL_DETAILS, "->...cached count:%zu\n", (size_t)tc->count - 1);
@@ -338,44 +997,47 @@ void INTERNAL *qt_mpool_alloc(qt_mpool pool)
         return ret;
     } else {
         const size_t      items_per_alloc = pool->items_per_alloc;
+        qt_mpool_node_t  *node            = &pool->nodes[tc->node];
         qt_mpool_cache_t *cache           = NULL;
 
         cnt = 0;
         /* cache is empty; need to fill it */
-        if (pool->reuse_pool) { // global cache
+        if (node->reuse_pool) { // node-wide cache
             qthread_debug(MPOOL_BEHAVIOR, "->...pull from reuse\n");
-            QTHREAD_FASTLOCK_LOCK(&pool->reuse_lock);
-            if (pool->reuse_pool) {
-                cache                   = pool->reuse_pool;
-                pool->reuse_pool        = cache->block_tail->next;
+            QTHREAD_FASTLOCK_LOCK(&node->reuse_lock);
+            if (node->reuse_pool) {
+                cache                   = node->reuse_pool;
+                node->reuse_pool        = cache->block_tail->next;
+                node->reuse_items      -= items_per_alloc;
                 cache->block_tail->next = NULL;
                 cnt                     = items_per_alloc;
             }
-            QTHREAD_FASTLOCK_UNLOCK(&pool->reuse_lock);
+            QTHREAD_FASTLOCK_UNLOCK(&node->reuse_lock);
         }
         if (NULL == cache) {
-            uint8_t *p;
-            // const size_t item_size = pool->item_size;
-
-            /* need to allocate a new block and record that I did so in the central pool */
-            qthread_debug(MPOOL_BEHAVIOR, "->...allocating new block\n");
-            p = qt_mpool_internal_aligned_alloc(pool->alloc_size,
-                                                pool->alignment);
-            qassert_ret((p != NULL), NULL);
-            assert(pool->alignment == 0 ||
-                   (((uintptr_t)p) & (pool->alignment - 1)) == 0);
-            QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
-            if (pool->alloc_list_pos == (pagesize / sizeof(void *) - 1)) {
-                void **tmp = qt_internal_aligned_alloc(pagesize, pagesize);
-                qassert_ret((tmp != NULL), NULL);
-                memset(tmp, 0, pagesize);
-                tmp[pagesize / sizeof(void *) - 1] = pool->alloc_list;
-                pool->alloc_list                   = tmp;
-                pool->alloc_list_pos               = 0;
+            uint8_t *p = NULL;
+
+            if (node->trimmed) {
+                qt_mpool_trimmed_t *t = NULL;
+
+                QTHREAD_FASTLOCK_LOCK(&node->reuse_lock);
+                if (node->trimmed) {
+                    t             = node->trimmed;
+                    node->trimmed = t->next;
+                }
+                QTHREAD_FASTLOCK_UNLOCK(&node->reuse_lock);
+                if (t) {
+                    qthread_debug(MPOOL_BEHAVIOR, "->...reusing trimmed block %p\n", t->items);
+                    p = t->items;
+                    qt_mpool_internal_meta_free(t);
+                }
+            }
+            if (p == NULL) {
+                /* need to allocate a new block and record that I did so in the central pool */
+                qthread_debug(MPOOL_BEHAVIOR, "->...allocating new block on node %u\n", tc->node);
+                p = qt_mpool_internal_block_alloc(pool, tc->node);
+                qassert_ret((p != NULL), NULL);
             }
-            pool->alloc_list[pool->alloc_list_pos] = p;
-            pool->alloc_list_pos++;
-            QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
             /* store the block for later allocation */
             tc->block = p;
             tc->i     = 1;
@@ -397,51 +1059,29 @@ void INTERNAL qt_mpool_free(qt_mpool pool,
                             void    *mem)
 {   /*{{{*/
     qt_mpool_threadlocal_cache_t *tc;
-    qt_mpool_cache_t             *cache = NULL;
-    qt_mpool_cache_t             *n     = (qt_mpool_cache_t *)mem;
-    size_t                        cnt;
-    const size_t                  items_per_alloc = pool->items_per_alloc;
+    qt_mpool_cache_t             *n = (qt_mpool_cache_t *)mem;
+    unsigned int                  owner;
 
     qthread_debug(MPOOL_CALLS, "pool=%p mem=%p\n", pool, mem);
     qassert_retvoid((mem != NULL));
     qassert_retvoid((pool != NULL));
     FREE_SCRIBBLE(mem, pool->item_size);
     tc    = qt_mpool_internal_getcache(pool);
-    cache = tc->cache;
-    cnt   = tc->count;
-    qthread_debug(MPOOL_DETAILS, "->cache:%p (bt:%p) cnt:%u\n", cache, cache ? cache->block_tail : NULL, (unsigned int)cnt);
-    if (cache) {
-        assert(cnt != 0);
-        n->next       = cache;
-        n->block_tail = cache->block_tail; // cache is likely to be IN cache, so this won't be slow
+    owner = qt_mpool_internal_owner(pool, mem);
+    tc->frees++;
+    if (owner != tc->node) {
+        qt_mpool_node_t *node = &pool->nodes[owner];
+        void            *head;
+
+        assert(owner < pool->nnodes);
+        qthread_debug(MPOOL_BEHAVIOR, "->remote free to node %u\n", owner);
+        do {
+            head    = node->remote_frees;
+            n->next = head;
+        } while (qthread_cas_ptr(&node->remote_frees, head, n) != head);
     } else {
-        assert(cnt == 0);
-        n->next       = NULL;
-        n->block_tail = n;
+        qt_mpool_internal_cache_push(pool, tc, n);
     }
-    cnt++;
-    if (cnt >= (items_per_alloc * 2)) {
-        qt_mpool_cache_t *toglobal;
-        /* push to global */
-        qthread_debug(MPOOL_BEHAVIOR, "->push to global! cnt:%u\n", (unsigned)cnt);
-        assert(n);
-        assert(n->block_tail);
-        toglobal            = n->block_tail->next;
-        n->block_tail->next = NULL;
-        assert(toglobal);
-        assert(toglobal->block_tail);
-        QTHREAD_FASTLOCK_LOCK(&pool->reuse_lock);
-        toglobal->block_tail->next = pool->reuse_pool;
-        pool->reuse_pool           = toglobal;
-        QTHREAD_FASTLOCK_UNLOCK(&pool->reuse_lock);
-        cnt -= items_per_alloc;
-    } else if (cnt == items_per_alloc + 1) {
-        qthread_debug(MPOOL_BEHAVIOR, "->chop_block\n");
-        n->block_tail = n;
-    }
-    tc->cache = n;
-    tc->count = cnt;
-    qthread_debug(MPOOL_DETAILS, "->free count = %zu\n", (size_t)cnt);
     VALGRIND_MEMPOOL_FREE(pool, mem);
 } /*}}}*/
 
@@ -449,14 +1089,29 @@ void INTERNAL qt_mpool_destroy(qt_mpool pool)
 {                                      /*{{{ */
     qthread_debug(MPOOL_CALLS, "pool:%p\n", pool);
     qassert_retvoid((pool != NULL));
+    pthread_mutex_lock(&pool_list_lock);
+    {
+        qt_mpool *pp = &pool_list;
+        while (*pp != pool) {
+            pp = &(*pp)->next_pool;
+        }
+        *pp = pool->next_pool;
+    }
+    pthread_mutex_unlock(&pool_list_lock);
+    for (unsigned int n = 0; n < pool->nnodes; n++) {
+        while (pool->nodes[n].trimmed) {
+            qt_mpool_trimmed_t *t = pool->nodes[n].trimmed;
+            pool->nodes[n].trimmed = t->next;
+            qt_mpool_internal_meta_free(t);
+        }
+    }
     while (pool->alloc_list) {
         unsigned int i = 0;
 
         void *p = pool->alloc_list[0];
 
         while (p && i < (pagesize / sizeof(void *) - 1)) {
-            qt_mpool_internal_aligned_free(p,
-                                           pool->alignment);
+            qt_mpool_internal_block_free(pool, p);
             i++;
             p = pool->alloc_list[i];
         }
@@ -465,6 +1120,9 @@ void INTERNAL qt_mpool_destroy(qt_mpool pool)
         FREE_SCRIBBLE(p, pagesize);
         qt_internal_aligned_free(p, pagesize);
     }
+    if (pool->worker_caches) {
+        qt_internal_aligned_free(pool->worker_caches, CACHELINE_WIDTH);
+    }
     qthread_debug(MPOOL_DETAILS, "begin free TLS caches\n");
     while (pool->caches) {
         qt_mpool_threadlocal_cache_t *freeme = pool->caches;
@@ -472,13 +1130,14 @@ void INTERNAL qt_mpool_destroy(qt_mpool pool)
         qt_internal_aligned_free(freeme, CACHELINE_WIDTH);
     }
     qthread_debug(MPOOL_DETAILS, "done freeing TLS caches\n");
-#ifndef TLS
     pthread_key_delete(pool->threadlocal_cache);
-#endif
     QTHREAD_FASTLOCK_DESTROY(pool->pool_lock);
-    QTHREAD_FASTLOCK_DESTROY(pool->reuse_lock);
+    for (unsigned int n = 0; n < pool->nnodes; n++) {
+        QTHREAD_FASTLOCK_DESTROY(pool->nodes[n].reuse_lock);
+    }
+    qt_internal_aligned_free(pool->nodes, CACHELINE_WIDTH);
     VALGRIND_DESTROY_MEMPOOL(pool);
-    FREE(pool, sizeof(struct qt_mpool_s));
+    qt_mpool_internal_meta_free(pool);
 }                                      /*}}} */
 
 /* vim:set expandtab: */
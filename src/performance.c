@@ -429,12 +429,13 @@ static const char* qthread_state_names[] ={
     "QTHREAD_STATE_TERMINATED",           /* thread function returned */
     "QTHREAD_STATE_MIGRATING",            /* thread needs to be moved, otherwise ready-to-run */
     "QTHREAD_STATE_SYSCALL",              /* thread performing external blocking operation */
+    "QTHREAD_STATE_SLEEPING",             /* insert me into the shepherd's timer wheel */
     "QTHREAD_STATE_ILLEGAL",              /* illegal state */
     "QTHREAD_STATE_TERM_SHEP"             /* special flag to terminate the shepherd */
 };
 
 void qtperf_set_instrument_qthreads(bool yes_no) {
-  QTPERF_ASSERT(QTHREAD_STATE_NUM_STATES == 16
+  QTPERF_ASSERT(QTHREAD_STATE_NUM_STATES == 17
                 && "threadstate_t has changed, check to make sure all states are represented in qthread_state_names in performance.c" );// make sure we're still current with our names array.
   qtperf_should_instrument_qthreads = yes_no;
 
@@ -17,9 +17,12 @@
 #include <string.h>                    /* for memset() */
 #include <errno.h>
 
+#include "qthread/qthread.h"         /* for qthread_incr() */
+
 #include "qt_alloc.h"
 #include "qt_asserts.h"
 #include "qt_int_ceil.h"
+#include "qt_macros.h"
 
 #ifndef PTHREAD_MUTEX_SMALL_ENOUGH
 # warning The pthread_mutex_t structure is either too big or hasn't been checked. If you're compiling by hand, you can probably ignore this warning, or define PTHREAD_MUTEX_SMALL_ENOUGH to make it go away.
@@ -41,7 +44,7 @@
 
 #define SMALLBLOCK_SLICE_SIZE  64
 #define SMALLBLOCK_SLICE_COUNT (1920 / SMALLBLOCK_SLICE_SIZE)
-#define SMALLBLOCK_BITMAP_LEN  (SMALLBLOCK_SLICE_COUNT / 8) + (((SMALLBLOCK_SLICE_COUNT % 8) > 0) ? 1 : 0)
+#define SMALLBLOCK_BITMAP_LEN  ((SMALLBLOCK_SLICE_COUNT / 8) + (((SMALLBLOCK_SLICE_COUNT % 8) > 0) ? 1 : 0))
 typedef char smallslice_t[SMALLBLOCK_SLICE_SIZE];
 typedef struct smallblock_s {
     struct smallblock_s *next;
@@ -53,7 +56,7 @@ typedef struct smallblock_s {
 smallblock_t;
 
 #define BIGBLOCK_ENTRY_COUNT (1920 / (sizeof(void *) + sizeof(unsigned int)))
-#define BIGBLOCK_BITMAP_LEN  (BIGBLOCK_ENTRY_COUNT / 8) + (((BIGBLOCK_ENTRY_COUNT % 8) > 0) ? 1 : 0)
+#define BIGBLOCK_BITMAP_LEN  ((BIGBLOCK_ENTRY_COUNT / 8) + (((BIGBLOCK_ENTRY_COUNT % 8) > 0) ? 1 : 0))
 typedef struct bigblock_header_s {
     struct bigblock_header_s *next;
     pthread_mutex_t           lock __attribute__ ((packed));
@@ -65,6 +68,13 @@ typedef struct bigblock_header_s {
     } entries[BIGBLOCK_ENTRY_COUNT] /*__attribute__ ((packed))*/;
 } bigblock_header_t;
 
+/* The block bitmap of a dynamic map is split into one sub-heap per stream,
+ * each a run of whole 64-bit words of the bitmap guarded by its own
+ * (process-local) lock, so that threads on different streams never contend
+ * for it. The in-file bitmap_lock is only kept for the sake of the file
+ * format. */
+#define QALLOC_BLOCK_SIZE 2048
+
 struct dynmapinfo_s {
     char                 dynflag;
     void                *map;
@@ -78,6 +88,10 @@ struct dynmapinfo_s {
     size_t               bitmaplength;
     pthread_mutex_t     *bitmap_lock;
     void                *base;
+    size_t               blockcount;  /* blocks that fit between base and the end of the map */
+    size_t               heapblocks;  /* blocks per sub-heap */
+    pthread_mutex_t     *heap_locks;
+    size_t               sync_cursor; /* for qalloc_checkpoint_incremental() */
 };
 
 struct mapinfo_s {
@@ -88,6 +102,7 @@ struct mapinfo_s {
     size_t            streamcount;
     void           ***streams;
     pthread_mutex_t  *stream_locks;
+    size_t            sync_cursor;
 };
 
 static struct mapinfo_s    *mmaps    = NULL;
@@ -108,6 +123,54 @@ typedef struct stat statstruct_t;
 #define QALLOC_LOCK(l)   qassert(pthread_mutex_lock(l), 0)
 #define QALLOC_UNLOCK(l) qassert(pthread_mutex_unlock(l), 0)
 
+/* Threads are dealt streams round-robin the first time they allocate, which
+ * spreads them evenly (pthread_self() values are aligned pointers, so taking
+ * them modulo the stream count tends to put every thread on one stream). */
+static aligned_t qalloc_next_ticket = 0;
+static TLS_DECL_INIT(uintptr_t, qalloc_ticket);
+#ifndef TLS
+static pthread_once_t qalloc_ticket_once = PTHREAD_ONCE_INIT;
+
+static void qalloc_ticket_init(void)
+{                                      /*{{{ */
+    TLS_INIT(qalloc_ticket);
+}                                      /*}}} */
+#endif
+
+static inline size_t qalloc_stream(size_t streamcount)
+{                                      /*{{{ */
+    uintptr_t ticket;
+
+#ifndef TLS
+    qassert(pthread_once(&qalloc_ticket_once, qalloc_ticket_init), 0);
+#endif
+    ticket = (uintptr_t)TLS_GET(qalloc_ticket);
+    if (ticket == 0) {
+        /* stored off by one, so that 0 means "not yet dealt" */
+        ticket = (uintptr_t)qthread_incr(&qalloc_next_ticket, 1) + 1;
+        TLS_SET(qalloc_ticket, ticket);
+    }
+    return (size_t)(ticket - 1) % streamcount;
+}                                      /*}}} */
+
+/* sets up the process-local half of a dynamic map */
+static void qalloc_dyn_setup(struct dynmapinfo_s *m)
+{                                      /*{{{ */
+    size_t i;
+
+    m->blockcount = ((size_t)((char *)m->map + m->size - (char *)m->base)) / QALLOC_BLOCK_SIZE;
+    if (m->blockcount > m->bitmaplength * 8) {
+        m->blockcount = m->bitmaplength * 8;
+    }
+    /* whole words, so that sub-heaps never share a byte of the bitmap */
+    m->heapblocks  = (QT_CEIL_RATIO(m->blockcount, m->streamcount) + 63) & ~(size_t)63;
+    m->heap_locks  = (pthread_mutex_t *)qt_malloc(sizeof(pthread_mutex_t) * m->streamcount);
+    m->sync_cursor = 0;
+    for (i = 0; i < m->streamcount; ++i) {
+        qassert(pthread_mutex_init(m->heap_locks + i, NULL), 0);
+    }
+}                                      /*}}} */
+
 static inline void *qalloc_getfile(const off_t filesize,
                                    void       *addr,
                                    const char *filename,
@@ -205,6 +268,7 @@ void *qalloc_makestatmap(const off_t  filesize,
         mi->streams      = (void ***)(ptr + 3);
         mi->stream_locks = (pthread_mutex_t *)(ptr + 3 + streams);
         mi->streamcount  = streams;
+        mi->sync_cursor  = 0;
         mi->next         = mmaps;
         mmaps            = mi;
         /* initialize the streams */
@@ -251,6 +315,7 @@ void *qalloc_makestatmap(const off_t  filesize,
         m->streams      = (void ***)(((void **)ret) + 3);
         m->stream_locks = (pthread_mutex_t *)(((void **)ret) + 3 + streams);
         m->streamcount  = streams;
+        m->sync_cursor  = 0;
         m->next         = mmaps;
         mmaps           = m;
         return m;
@@ -298,6 +363,7 @@ void *qalloc_makedynmap(const off_t  filesize,
         /* initialize the use bitmap */
         memset(mi->bitmap, 0, mi->bitmaplength);
         qassert(pthread_mutex_init(mi->bitmap_lock, NULL), 0);
+        qalloc_dyn_setup(mi);
         mi->next = dynmmaps;
         dynmmaps = mi;
         return mi;
@@ -321,6 +387,7 @@ void *qalloc_makedynmap(const off_t  filesize,
         m->bitmap       = (unsigned char *)(m->bitmap_lock + 1);
         m->bitmaplength = QT_CEIL_DIV8(filesize/2048);
         m->base         = ((char *)(m->bitmap)) + m->bitmaplength;
+        qalloc_dyn_setup(m);
 
         m->next  = dynmmaps;
         dynmmaps = m;
@@ -388,6 +455,10 @@ void qalloc_cleanup(void)
         }
         m        = dynmmaps;
         dynmmaps = dynmmaps->next;
+        for (size_t i = 0; i < m->streamcount; ++i) {
+            qassert(pthread_mutex_destroy(m->heap_locks + i), 0);
+        }
+        qt_free(m->heap_locks);
         qt_free(m);
     }
 }                                      /*}}} */
@@ -398,15 +469,16 @@ void qalloc_cleanup(void)
  * that becomes a problem */
 void *qalloc_statmalloc(struct mapinfo_s *m)
 {                                      /*{{{ */
-    pthread_t me          = pthread_self();
-    size_t    stream      = (size_t)me % m->streamcount;
-    size_t    firststream = stream;
-    void    **ret         = NULL;
+    size_t stream      = qalloc_stream(m->streamcount);
+    size_t firststream = stream;
+    void **ret         = NULL;
 
     while (ret == NULL) {
         QALLOC_LOCK(m->stream_locks + stream);
-        ret                = m->streams[stream];
-        m->streams[stream] = (void **)(*(m->streams[stream]));
+        ret = m->streams[stream];
+        if (ret) {
+            m->streams[stream] = (void **)(*ret);
+        }
         QALLOC_UNLOCK(m->stream_locks + stream);
         if (ret == NULL) {
             /* no more memory left in this stream */
@@ -473,144 +545,140 @@ static inline void qalloc_markbits(unsigned char *array,
     }
 }                                      /*}}} */
 
-/* this function finds the first 0 bit in the array, toggles it, and returns
- * the index of the toggled bit. if no 0 bits are in the array, it returns
- * (a_len * 8 + 8) */
-static inline size_t qalloc_findmark_bit(unsigned char *array,
-                                         size_t         bits)
+/* The bitmaps are MSB-first (bit i is 0x80 >> (i % 8) in byte i / 8), so they
+ * are scanned a 64-bit word at a time with the first bit of each word loaded
+ * into its most significant position; counting the leading zeros of the word,
+ * or of its complement, then finds the first set, or clear, bit. */
+static inline uint64_t qalloc_loadword(const unsigned char *array,
+                                       size_t               byte,
+                                       size_t               bytes)
 {                                      /*{{{ */
-    size_t i;
-    size_t bytes = bits / 8;
-
-    for (i = 0; i < bytes && array[i] == 0xff; ++i) ;
-    if (i == bytes) {
-        return bytes * 8 + 8;
-    } else if ((array[i] & 0x80) == 0) {
-        array[i] |= 0x80;
-        return i * 8;
-    } else if ((array[i] & 0x40) == 0) {
-        array[i] |= 0x40;
-        return i * 8 + 1;
-    } else if ((array[i] & 0x20) == 0) {
-        array[i] |= 0x20;
-        return i * 8 + 2;
-    } else if ((array[i] & 0x10) == 0) {
-        array[i] |= 0x10;
-        return i * 8 + 3;
-    } else if ((array[i] & 0x08) == 0) {
-        array[i] |= 0x08;
-        return i * 8 + 4;
-    } else if ((array[i] & 0x04) == 0) {
-        array[i] |= 0x04;
-        return i * 8 + 5;
-    } else if ((array[i] & 0x02) == 0) {
-        array[i] |= 0x02;
-        return i * 8 + 6;
-    } else if ((array[i] & 0x01) == 0) {
-        array[i] |= 0x01;
-        return i * 8 + 7;
-    }
-    /* this should never happen */
-    return (size_t)-1;
+    uint64_t w = 0;
+    size_t   i;
+
+    /* bytes past the end read as in-use */
+    for (i = byte; i < byte + 8; ++i) {
+        w = (w << 8) | ((i < bytes) ? array[i] : 0xff);
+    }
+    return w;
+}                                      /*}}} */
+
+static inline unsigned int qalloc_clz64(uint64_t w)
+{                                      /*{{{ */
+#ifdef __GNUC__
+    return (unsigned int)__builtin_clzll(w);
+#else
+    unsigned int n = 0;
+
+    while (!(w & ((uint64_t)1 << 63))) {
+        w <<= 1;
+        ++n;
+    }
+    return n;
+#endif
+}                                      /*}}} */
+
+/* returns the index of the first bit in [start, end) that is set (if set is
+ * nonzero) or clear (if set is zero), or end if there is none */
+static inline size_t qalloc_findbit(const unsigned char *array,
+                                    size_t               start,
+                                    size_t               end,
+                                    int                  set)
+{                                      /*{{{ */
+    const size_t bytes = QT_CEIL_DIV8(end);
+    size_t       byte  = start / 8;
+    uint64_t     w;
+
+    if (start >= end) {
+        return end;
+    }
+    w  = qalloc_loadword(array, byte, bytes);
+    w  = set ? w : ~w;
+    w &= ~(uint64_t)0 >> (start % 8);
+    while (w == 0) {
+        byte += 8;
+        if (byte >= bytes) {
+            return end;
+        }
+        w = qalloc_loadword(array, byte, bytes);
+        w = set ? w : ~w;
+    }
+    start = byte * 8 + qalloc_clz64(w);
+    return (start < end) ? start : end;
 }                                      /*}}} */
 
-/* this function is identical to qalloc_findmark_bit, except that it searches
- * for a string of count 0 bits, and returns the index of the first one found. */
+/* this function finds the first run of count 0 bits in [start, end), marks
+ * them, and returns the index of the first one; if there is no such run, it
+ * returns (size_t)-1 */
 static inline size_t qalloc_findmark_bits(unsigned char *array,
-                                          size_t         a_len,
+                                          size_t         start,
+                                          size_t         end,
                                           size_t         count)
 {                                      /*{{{ */
-    size_t byte     = 0;
-    size_t startbit = (size_t)-1;       /* all FF's, no matter what size architecture */
+    while (start < end) {
+        size_t first = qalloc_findbit(array, start, end, 0);
+        size_t last;
+
+        if (end - first < count) {
+            break;
+        }
+        last = qalloc_findbit(array, first, first + count, 1);
+        if (last == first + count) {
+            qalloc_markbits(array, first, last - 1);
+            return first;
+        }
+        start = last;
+    }
+    return (size_t)-1;                 /* all FF's, no matter what size architecture */
+}                                      /*}}} */
 
-    if (count < 8) {
-        for (byte = 0; byte < a_len; ++byte) {
-            char mask = (0xff00 >> count) & 0xff;
-            char bit  = 0;
+/* takes count contiguous blocks, preferring the given stream's sub-heap */
+static size_t qalloc_dyn_getblocks(struct dynmapinfo_s *m,
+                                   size_t               stream,
+                                   size_t               count)
+{                                      /*{{{ */
+    size_t offset = (size_t)-1;
+    size_t i;
 
-            while ((!mask) & 0x1) {
-                char xorbyte = mask ^ array[byte];
+    for (i = 0; i < m->streamcount && offset == (size_t)-1; ++i) {
+        const size_t heap  = (stream + i) % m->streamcount;
+        const size_t start = heap * m->heapblocks;
+        const size_t end   = (start + m->heapblocks < m->blockcount) ? (start + m->heapblocks) : m->blockcount;
 
-                if ((array[byte] & xorbyte) == array[byte]) {
-                    startbit = byte * 8 + bit;
-                    qalloc_markbits(array, startbit, startbit + count - 1);
-                    return startbit;
-                }
-                mask >>= 1;
-                bit++;
-            }
+        if (start + count > end) {
+            continue;
         }
-        return (size_t)-1;             /* all FF's, no matter what size architecture */
-    } else {
-        long int left_to_find;
-
-stageone:
-        left_to_find = (long int)count;
-        /* step 1: find bytes ending in 0's: */
-        for (; byte < a_len; ++byte) {
-            char available = 0;
-
-            if (array[byte] & 0x1) {
-                continue;
-            } else if (!(array[byte] & 0xff)) {
-                available = 8;
-            } else if (!(array[byte] & 0x7f)) {
-                available = 7;
-            } else if (!(array[byte] & 0x3f)) {
-                available = 6;
-            } else if (!(array[byte] & 0x1f)) {
-                available = 5;
-            } else if (!(array[byte] & 0x0f)) {
-                available = 4;
-            } else if (!(array[byte] & 0x07)) {
-                available = 3;
-            } else if (!(array[byte] & 0x03)) {
-                available = 2;
-            } else if (!(array[byte] & 0x01)) {
-                available = 1;
-            }
-            if (available != 0) {
-                /* got a live one! */
-                startbit      = (byte * 8) + (8 - available);
-                left_to_find -= available;
-                if (left_to_find == 0) {
-                    array[byte] = 0xff;
-                    return startbit;
-                } else if (left_to_find < 8) {
-                    goto stagethree;
-                } else {
-                    goto stagetwo;
-                }
-            }
+        QALLOC_LOCK(m->heap_locks + heap);
+        offset = qalloc_findmark_bits(m->bitmap, start, end, count);
+        QALLOC_UNLOCK(m->heap_locks + heap);
+    }
+    if ((offset == (size_t)-1) && (count > 1) && (m->streamcount > 1)) {
+        /* the only room left may span sub-heaps */
+        for (i = 0; i < m->streamcount; ++i) {
+            QALLOC_LOCK(m->heap_locks + i);
         }
-        return (size_t)-1;             /* all FF's, no matter what size architecture */
-
-stagetwo:
-        byte++;
-        /* step 2: make sure we have enough blank bytes next */
-        for (; byte < a_len; ++byte) {
-            if (array[byte] == 0) {
-                left_to_find -= 8;
-                if (left_to_find < 8) {
-                    goto stagethree;
-                }
-            } else {
-                goto stageone;
-            }
+        offset = qalloc_findmark_bits(m->bitmap, 0, m->blockcount, count);
+        for (i = 0; i < m->streamcount; ++i) {
+            QALLOC_UNLOCK(m->heap_locks + i);
         }
-        return (size_t)-1;             /* all FF's, no matter what size architecture */
+    }
+    return offset;
+}                                      /*}}} */
 
-stagethree:
-        byte++;
-        /* step 3: make sure the last byte has enough blanks */
-        if (array[byte] & (0xff & (0xff00 >> left_to_find))) {
-            /* not enough */
-            goto stageone;
-        } else {
-            /* huzzah! we found enough space! */
-            qalloc_markbits(array, startbit, startbit + count - 1);
-            return startbit;
-        }
+static void qalloc_dyn_putblocks(struct dynmapinfo_s *m,
+                                 size_t               offset,
+                                 size_t               count)
+{                                      /*{{{ */
+    const size_t first = offset / m->heapblocks;
+    const size_t last  = (offset + count - 1) / m->heapblocks;
+    size_t       i;
+
+    for (i = first; i <= last; ++i) {
+        QALLOC_LOCK(m->heap_locks + i);
+    }
+    qalloc_unmarkbits(m->bitmap, offset, count);
+    for (i = first; i <= last; ++i) {
+        QALLOC_UNLOCK(m->heap_locks + i);
     }
 }                                      /*}}} */
 
@@ -630,9 +698,9 @@ static inline smallblock_t *qalloc_find_smallblock_entry(struct dynmapinfo_s
     /* chase down a smallblock slice */
     while (sb != NULL &&
            ((*offset =
-                 qalloc_findmark_bit(sb->bitmap,
-                                     SMALLBLOCK_SLICE_COUNT)) >
-            SMALLBLOCK_SLICE_COUNT)) {
+                 qalloc_findmark_bits(sb->bitmap, 0,
+                                      SMALLBLOCK_SLICE_COUNT, 1)) ==
+            (size_t)-1)) {
         smallblock_t *sb_prev = sb;
 
         sb = sb->next;
@@ -664,9 +732,9 @@ static inline bigblock_header_t *qalloc_find_bigblock_header_entry(struct
     /* chase down a block entry */
     while (bbh != NULL &&
            ((*offset =
-                 qalloc_findmark_bit(bbh->bitmap,
-                                     BIGBLOCK_ENTRY_COUNT)) >
-            BIGBLOCK_ENTRY_COUNT)) {
+                 qalloc_findmark_bits(bbh->bitmap, 0,
+                                      BIGBLOCK_ENTRY_COUNT, 1)) ==
+            (size_t)-1)) {
         bigblock_header_t *bbh_prev = bbh;
 
         bbh = bbh->next;
@@ -681,23 +749,20 @@ static inline bigblock_header_t *qalloc_find_bigblock_header_entry(struct
 void *qalloc_dynmalloc(struct dynmapinfo_s *m,
                        size_t               size)
 {                                      /*{{{ */
-    pthread_t me     = pthread_self();
-    size_t    stream = (size_t)me % m->streamcount;
-    size_t    original_stream;
-    void     *ret = NULL;
+    size_t stream = qalloc_stream(m->streamcount);
+    size_t original_stream;
+    void  *ret = NULL;
 
     original_stream = stream;
-    if (size <= 64) {
+    if (size <= SMALLBLOCK_SLICE_SIZE) {
         size_t        offset = 0;
         smallblock_t *sb     = NULL;
 
         sb = qalloc_find_smallblock_entry(m, stream, &offset);
         while (sb == NULL) {
             /* allocate a new smallblock */
-            QALLOC_LOCK(m->bitmap_lock);
-            offset = qalloc_findmark_bit(m->bitmap, m->bitmaplength * 8);
-            QALLOC_UNLOCK(m->bitmap_lock);
-            if (offset > m->bitmaplength * 8) {
+            offset = qalloc_dyn_getblocks(m, stream, 1);
+            if (offset == (size_t)-1) {
                 /* could not allocate a new smallblock... */
                 if ((m->streamcount > 1) &&
                     ((stream + 1) % m->streamcount != original_stream)) {
@@ -711,9 +776,8 @@ void *qalloc_dynmalloc(struct dynmapinfo_s *m,
                     return NULL;
                 }
             } else {
-                sb            = ((smallblock_t *)(m->base)) + offset;
-                sb->bitmap[0] = 0;
-                sb->bitmap[1] = 0;
+                sb = ((smallblock_t *)(m->base)) + offset;
+                memset(sb->bitmap, 0, SMALLBLOCK_BITMAP_LEN);
                 qassert(pthread_mutex_init(&sb->lock, NULL), 0);
                 QALLOC_LOCK(m->stream_locks + stream);
                 sb->next               = m->smallblocks[stream];
@@ -730,47 +794,34 @@ void *qalloc_dynmalloc(struct dynmapinfo_s *m,
         QALLOC_UNLOCK(&sb->lock);
     } else {
         /* a BIG allocation */
-        size_t             offset, blocks = QT_CEIL_POW2(size, 11);
+        size_t             offset, slot = 0, blocks = QT_CEIL_POW2(size, 11);
         bigblock_header_t *bbh = NULL;
 
-        /* lock the bitmap */
-        QALLOC_LOCK(m->bitmap_lock); {
-            /* find the necessary free block(s) and mark them in-use */
-            if (blocks > 1) {
-                offset =
-                    qalloc_findmark_bits(m->bitmap, m->bitmaplength, blocks);
-            } else {
-                offset = qalloc_findmark_bit(m->bitmap, m->bitmaplength * 8);
-            }
-        }
-        QALLOC_UNLOCK(m->bitmap_lock);
-        if (offset > m->bitmaplength * 8) {
-            /* trying other streams won't help, because the bitmap isn't
-             * stream-specific (bottleneck!) */
+        /* find the necessary free block(s) and mark them in-use */
+        offset = qalloc_dyn_getblocks(m, stream, blocks);
+        if (offset == (size_t)-1) {
             return NULL;
         }
         ret = ((bigblock_header_t *)(m->base)) + offset;
-        bbh = qalloc_find_bigblock_header_entry(m, stream, &offset);
+        bbh = qalloc_find_bigblock_header_entry(m, stream, &slot);
         while (bbh == NULL) {
             size_t newoffset;
 
             /* allocate a new bigblock header */
-            QALLOC_LOCK(m->bitmap_lock);
-            newoffset = qalloc_findmark_bit(m->bitmap, m->bitmaplength * 8);
-            QALLOC_UNLOCK(m->bitmap_lock);
-            if (newoffset > m->bitmaplength * 8) {
+            newoffset = qalloc_dyn_getblocks(m, stream, 1);
+            if (newoffset == (size_t)-1) {
                 /* could not allocate a new bigblock header... */
                 if ((m->streamcount > 1) &&
                     ((stream + 1) % m->streamcount != original_stream)) {
                     /* ...so we'll try the other streams */
                     stream = (stream + 1) % m->streamcount;
                     bbh    =
-                        qalloc_find_bigblock_header_entry(m, stream, &offset);
+                        qalloc_find_bigblock_header_entry(m, stream, &slot);
                 } else {
                     /* either we don't have multiple streams, or we've searched
                      * all of them, thus, the only thing we can do is return
                      * NULL */
-                    qalloc_unmarkbits(m->bitmap, offset, blocks);
+                    qalloc_dyn_putblocks(m, offset, blocks);
                     return NULL;
                 }
             } else {
@@ -782,12 +833,12 @@ void *qalloc_dynmalloc(struct dynmapinfo_s *m,
                 m->bigblocks[stream] = bbh;
                 QALLOC_LOCK(&bbh->lock);
                 QALLOC_UNLOCK(m->stream_locks + stream);
-                offset =
-                    qalloc_findmark_bit(bbh->bitmap, BIGBLOCK_ENTRY_COUNT);
+                bbh->bitmap[0] = 0x80;
+                slot           = 0;
             }
         }
-        bbh->entries[offset].entry       = ret;
-        bbh->entries[offset].block_count = blocks;
+        bbh->entries[slot].entry       = ret;
+        bbh->entries[slot].block_count = blocks;
         QALLOC_UNLOCK(&bbh->lock);
     }
     return ret;
@@ -806,9 +857,8 @@ void *qalloc_malloc(void  *mapinfo,
 void qalloc_statfree(void             *block,
                      struct mapinfo_s *m)
 {                                      /*{{{ */
-    pthread_t me     = pthread_self();
-    size_t    stream = (size_t)me % m->streamcount;
-    void    **b      = (void **)block;
+    size_t stream = qalloc_stream(m->streamcount);
+    void **b      = (void **)block;
 
     QALLOC_LOCK(m->stream_locks + stream);
     *b                 = m->streams[stream];
@@ -816,10 +866,50 @@ void qalloc_statfree(void             *block,
     QALLOC_UNLOCK(m->stream_locks + stream);
 }                                      /*}}} */
 
+/* removes block from the bigblock headers of the given stream, returning the
+ * number of blocks it covered, or 0 if it is not on that stream */
+static size_t qalloc_forget_bigblock(struct dynmapinfo_s *m,
+                                     size_t               stream,
+                                     void                *block)
+{                                      /*{{{ */
+    bigblock_header_t *bbh;
+
+    QALLOC_LOCK(m->stream_locks + stream);
+    bbh = m->bigblocks[stream];
+    if (bbh) {
+        QALLOC_LOCK(&bbh->lock);
+    }
+    QALLOC_UNLOCK(m->stream_locks + stream);
+    /* chase down the bigblock header containing this ptr */
+    while (bbh) {
+        size_t             slot;
+        bigblock_header_t *next;
+
+        for (slot = 0; slot < BIGBLOCK_ENTRY_COUNT; ++slot) {
+            if (bbh->entries[slot].entry == block) {
+                size_t blocks = bbh->entries[slot].block_count;
+
+                qalloc_unmarkbits(bbh->bitmap, slot, 1);
+                bbh->entries[slot].entry       = NULL;
+                bbh->entries[slot].block_count = 0;
+                QALLOC_UNLOCK(&bbh->lock);
+                return blocks;
+            }
+        }
+        next = bbh->next;
+        if (next) {
+            QALLOC_LOCK(&next->lock);
+        }
+        QALLOC_UNLOCK(&bbh->lock);
+        bbh = next;
+    }
+    return 0;
+}                                      /*}}} */
+
 void qalloc_dynfree(void                *block,
                     struct dynmapinfo_s *m)
 {                                                     /*{{{ */
-    if (((size_t)block - (size_t)(m->base)) % 2048) { /* unaligned */
+    if (((size_t)block - (size_t)(m->base)) % QALLOC_BLOCK_SIZE) { /* unaligned */
         /* must be small */
         /* this figures out the sb pointer from the address being free'd */
         smallblock_t *sb =
@@ -841,54 +931,19 @@ void qalloc_dynfree(void                *block,
         *byte &= ~(0x80 >> slot);
         QALLOC_UNLOCK(&sb->lock);
     } else {                           /* aligned */
-        /* must be big */
-        pthread_t          me     = pthread_self();
-        size_t             stream = (size_t)me & m->streamcount;
-        bigblock_header_t *bbh;
-        size_t             blocks       = 0;
-        int                stillLooking = 1;
+        /* must be big; it was recorded on the allocating thread's stream,
+         * which is most likely (but not necessarily) this thread's */
+        size_t stream = qalloc_stream(m->streamcount);
+        size_t blocks = 0;
+        size_t i;
 
-        QALLOC_LOCK(m->stream_locks + stream);
-        bbh = m->bigblocks[stream];
-        if (bbh) {
-            QALLOC_LOCK(&bbh->lock);
-        }
-        QALLOC_UNLOCK(m->stream_locks + stream);
-        /* chase down the bigblock header containing this ptr */
-        while (bbh && stillLooking) {
-            size_t             slot;
-            bigblock_header_t *next;
-
-            for (slot = 0; slot < BIGBLOCK_ENTRY_COUNT; ++slot) {
-                if (bbh->entries[slot].entry == block) {
-                    unsigned char *byte = bbh->bitmap + (slot / 8);
-                    unsigned char  bit  = slot - ((slot / 8) * 8);
-
-                    *byte                         &= ~(0x80 >> bit);
-                    blocks                         = bbh->entries[slot].block_count;
-                    bbh->entries[slot].entry       = NULL;
-                    bbh->entries[slot].block_count = 0;
-                    stillLooking                   = 0;
-                    break;
-                }
-            }
-            if (stillLooking) {
-                break;
-            }
-            next = bbh->next;
-            if (next) {
-                QALLOC_LOCK(&next->lock);
-            }
-            QALLOC_UNLOCK(&bbh->lock);
-            bbh = next;
+        for (i = 0; i < m->streamcount && blocks == 0; ++i) {
+            blocks = qalloc_forget_bigblock(m, (stream + i) % m->streamcount, block);
         }
-        if ((blocks > 0) && !stillLooking) {
-            /* lock the bitmap and unmark the corresponding bits */
-            QALLOC_LOCK(m->bitmap_lock);
-            qalloc_unmarkbits(m->bitmap,
-                              ((size_t)block - (size_t)(m->base)) / 2048,
-                              blocks);
-            QALLOC_UNLOCK(m->bitmap_lock);
+        if (blocks > 0) {
+            qalloc_dyn_putblocks(m,
+                                 ((size_t)block - (size_t)(m->base)) / QALLOC_BLOCK_SIZE,
+                                 blocks);
         }
     }
     /* XXX: consider freeing unused smallblocks or bigblock header blocks */
@@ -925,4 +980,63 @@ void qalloc_checkpoint(void)
     }
 }                                      /*}}} */
 
+int qalloc_sync(const void *block,
+                size_t      size)
+{                                      /*{{{ */
+    const uintptr_t pgsize   = (uintptr_t)getpagesize();
+    const uintptr_t start    = (uintptr_t)block & ~(pgsize - 1);
+    const uintptr_t end      = ((uintptr_t)block + size + pgsize - 1) & ~(pgsize - 1);
+
+    if (size == 0) {
+        return 0;
+    }
+    return msync((void *)start, (size_t)(end - start), MS_SYNC);
+}                                      /*}}} */
+
+size_t qalloc_checkpoint_incremental(void  *mapinfo,
+                                     size_t bytes)
+{                                      /*{{{ */
+    const size_t pgsize = (size_t)getpagesize();
+    char        *map;
+    size_t       size, header, start;
+    size_t      *cursor;
+
+    if (((struct mapinfo_s *)mapinfo)->dynflag == 0) {
+        struct mapinfo_s *m = (struct mapinfo_s *)mapinfo;
+
+        map    = m->map;
+        size   = m->size;
+        header = (size_t)((char *)(m->stream_locks + m->streamcount) - map);
+        cursor = &m->sync_cursor;
+    } else {
+        struct dynmapinfo_s *m = (struct dynmapinfo_s *)mapinfo;
+
+        map    = m->map;
+        size   = m->size;
+        header = (size_t)((char *)m->base - map);
+        cursor = &m->sync_cursor;
+    }
+    /* the allocator's own state goes out with every step, so that what is on
+     * disk always describes which parts of the map are in use */
+    if (qalloc_sync(map, header) != 0) {
+        perror("checkpoint");
+    }
+    bytes = (bytes + pgsize - 1) & ~(pgsize - 1);
+    if (bytes == 0) {
+        bytes = pgsize;
+    }
+    start = *cursor;
+    if (bytes > size - start) {
+        bytes = size - start;
+    }
+    if (qalloc_sync(map + start, bytes) != 0) {
+        perror("checkpoint");
+    }
+    *cursor = start + bytes;
+    if (*cursor >= size) {
+        *cursor = 0;
+    }
+    return (*cursor == 0) ? 0 : (size - *cursor);
+}                                      /*}}} */
+
 /* vim:set expandtab: */
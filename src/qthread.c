@@ -67,12 +67,15 @@
 #include "qt_threadqueue_scheduler.h"
 #include "qt_affinity.h"
 #include "qt_io.h"
+#include "qt_timers.h"
 #include "qt_debug.h"
 #include "qt_envariables.h"
 #include "qt_queue.h"
 #include "qt_feb.h"
 #include "qt_syncvar.h"
+#include "qt_feb_profile.h"
 #include "qt_spawncache.h"
+#include "qt_arena.h"
 #ifdef QTHREAD_MULTINODE
 # include "qt_multinode_innards.h"
 #endif
@@ -209,7 +212,7 @@ static QINLINE void FREE_STACK(void *t)
                     PROT_READ | PROT_WRITE) != 0) {
             perror("mprotect in FREE_STACK (2)");
         }
-        FREE(tmp, qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s) + (2 * getpagesize()));
+        qt_internal_aligned_free(tmp, getpagesize());
     } else {
         FREE(t, qlib->qthread_stack_size); /* XXX: this size seems wrong */
     }
@@ -222,6 +225,20 @@ static QINLINE void FREE_STACK(void *t)
 #else /* if defined(UNPOOLED_STACKS) || defined(UNPOOLED) */
 static qt_mpool generic_stack_pool = NULL;
 # ifdef QTHREAD_GUARD_PAGES
+/* Protecting a guard page inside a huge page would split it back into small
+ * pages (or fail outright on hugetlb), so huge-page stacks keep the guard
+ * page layout but only check a canary at the top of the lower guard page,
+ * which is where an overflowing stack writes first. That detects overflows
+ * when the task exits rather than trapping them. */
+static int stack_canaries = 0;
+#  define STACK_CANARY_WORDS 8
+#  define STACK_CANARY       ((uintptr_t)0x5ac4ca9a5ac4ca9aULL)
+
+static QINLINE uintptr_t *STACK_CANARY_BASE(uint8_t *tmp)
+{                      /*{{{ */
+    return (uintptr_t *)(tmp + getpagesize()) - STACK_CANARY_WORDS;
+}                      /*}}} */
+
 static QINLINE void *ALLOC_STACK(void)
 {                      /*{{{ */
     if (GUARD_PAGES) {
@@ -231,6 +248,13 @@ static QINLINE void *ALLOC_STACK(void)
         if (tmp == NULL) {
             return NULL;
         }
+        if (stack_canaries) {
+            uintptr_t *c = STACK_CANARY_BASE(tmp);
+            for (int i = 0; i < STACK_CANARY_WORDS; i++) {
+                c[i] = STACK_CANARY;
+            }
+            return tmp + getpagesize();
+        }
         if (mprotect(tmp, getpagesize(), PROT_NONE) != 0) {
             perror("mprotect in ALLOC_STACK (1)");
         }
@@ -247,7 +271,20 @@ static QINLINE void *ALLOC_STACK(void)
 
 static QINLINE void FREE_STACK(void *t)
 {                      /*{{{ */
-    if (GUARD_PAGES) {
+    if (GUARD_PAGES && stack_canaries) {
+        uintptr_t *c;
+
+        assert(t);
+        t = (uint8_t*)t - getpagesize();
+        c = STACK_CANARY_BASE(t);
+        for (int i = 0; i < STACK_CANARY_WORDS; i++) {
+            if (c[i] != STACK_CANARY) {
+                fprintf(stderr, "qthreads: stack overflow detected in the stack at %p; "
+                        "consider increasing QT_STACK_SIZE\n", (uint8_t *)t + getpagesize());
+                abort();
+            }
+        }
+    } else if (GUARD_PAGES) {
         assert(t);
         t = (uint8_t*)t - getpagesize();
         if (mprotect(t, getpagesize(), PROT_READ | PROT_WRITE) != 0) {
@@ -353,6 +390,7 @@ static QINLINE void alloc_rdata(qthread_shepherd_t *me,
     }
     rdata->tasklocal_size = 0;
     rdata->criticalsect   = 0;
+    rdata->arena          = NULL;
     rdata->stack          = stack;
     rdata->shepherd_ptr   = me;
     rdata->blockedon.io   = NULL;
@@ -467,6 +505,11 @@ static void *qthread_master(void *arg)
         while (!QTHREAD_CASLOCK_READ_UI(me_worker->active)) {
             SPINLOCK_BODY();
         }
+        QTHREAD_FEB_PROFILE_CHECK_DUMP();
+        hazardous_quiescent(); /* no task is running, so no node is in use */
+        if (qt_timers_pending) {
+            qt_timer_advance(me);
+        }
 #ifdef QTHREAD_LOCAL_PRIORITY
         t = qt_scheduler_get_thread(threadqueue, localpriorityqueue, localqueue, QTHREAD_CASLOCK_READ_UI(me->active));
 #else
@@ -487,10 +530,10 @@ static void *qthread_master(void *arg)
                       "id(%u): dequeued thread %p: id %d/state %d\n",
                       my_id, t, t->thread_id, t->thread_state);
 
-        // Process input preconditions if this is a NASCENT thread
+        // NASCENT threads are launched by the fill of their last precondition
         if (t->thread_state == QTHREAD_STATE_NASCENT) {
             assert(0 && "All preconditions should be satisfied before reaching the main scheduling loop");
-            if (qthread_check_feb_preconds(t) == 1) { continue; }
+            continue;
         }
 
         if (t->thread_state == QTHREAD_STATE_TERM_SHEP) {
@@ -678,6 +721,16 @@ static void *qthread_master(void *arg)
                                       my_id, t->thread_id);
                         qt_blocking_subsystem_enqueue(t->rdata->blockedon.io);
                         break;
+                    case QTHREAD_STATE_SLEEPING:
+                        t->thread_state = QTHREAD_STATE_RUNNING;
+#ifdef QTHREAD_PERFORMANCE
+                        QTPERF_QTHREAD_ENTER_STATE(t->rdata->performance_data, QTHREAD_STATE_RUNNING);
+#endif /*  ifdef QTHREAD_PERFORMANCE */
+                        qthread_debug(THREAD_DETAILS | SHEPHERD_DETAILS,
+                                      "id(%u): thread %i went to sleep\n",
+                                      my_id, t->thread_id);
+                        qt_timer_park(me, t->rdata->blockedon.timer);
+                        break;
 #ifdef QTHREAD_USE_EUREKAS
                     case QTHREAD_STATE_ASSASSINATED:
                         qthread_debug(THREAD_DETAILS | SHEPHERD_DETAILS,
@@ -817,6 +870,8 @@ int API_FUNC qthread_initialize(void)
     }
     qlib = (qlib_t)MALLOC(sizeof(struct qlib_s));
     qassert_ret(qlib, QTHREAD_MALLOC_ERROR);
+    /* pools created before the shepherds exist look for them */
+    memset(qlib, 0, sizeof(struct qlib_s));
 
 #if defined(QTHREAD_MUTEX_INCREMENT) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC32)
     qlib->atomic_locks = MALLOC(sizeof(QTHREAD_FASTLOCK_TYPE) * QTHREAD_LOCKING_STRIPES);
@@ -960,25 +1015,35 @@ int API_FUNC qthread_initialize(void)
                                                            sizeof(void *));
     qthread_debug(CORE_DETAILS, "qthread task-local size: %u\n", qlib->qthread_tasklocal_size);
 
+    qt_internal_alloc_init();
 #ifndef UNPOOLED
-    generic_qthread_pool     = qt_mpool_create_aligned(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size, qthread_cacheline());
+    generic_qthread_pool     = qt_mpool_create_huge(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size, qthread_cacheline());
     generic_big_qthread_pool = qt_mpool_create(sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size);
     if (GUARD_PAGES) {
         generic_stack_pool =
-            qt_mpool_create_aligned(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s) +
-                                    (2 * getpagesize()), getpagesize());
+            qt_mpool_create_huge(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s) +
+                                 (2 * getpagesize()), getpagesize());
+# ifdef QTHREAD_GUARD_PAGES
+        stack_canaries = qt_mpool_is_huge(generic_stack_pool);
+# endif
     } else {
-        generic_stack_pool = qt_mpool_create_aligned(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s), QTHREAD_STACK_ALIGNMENT);     // stacks on most platforms must be 16-byte aligned (or less)
+        generic_stack_pool = qt_mpool_create_huge(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s), QTHREAD_STACK_ALIGNMENT);     // stacks on most platforms must be 16-byte aligned (or less)
     }
     generic_rdata_pool = qt_mpool_create(sizeof(struct qthread_runtime_data_s));
+    qt_mpool_set_name(generic_qthread_pool, "generic_qthread_pool");
+    qt_mpool_set_name(generic_big_qthread_pool, "generic_big_qthread_pool");
+    qt_mpool_set_name(generic_stack_pool, "generic_stack_pool");
+    qt_mpool_set_name(generic_rdata_pool, "generic_rdata_pool");
 #endif /* ifndef UNPOOLED */
     initialize_hazardptrs();
     qt_internal_teams_init();
     qthread_queue_subsystem_init();
     qt_feb_subsystem_init(need_sync);
-    qt_syncvar_subsystem_init(need_sync);
+    qt_syncvar_subsystem_init();
+    qt_feb_profile_subsystem_init();
     qt_threadqueue_subsystem_init();
     qt_blocking_subsystem_init();
+    qt_timer_subsystem_init();
 
 /* Set up agg methods*/
     qlib->agg_cost = qthread_default_agg_cost;
@@ -1054,6 +1119,7 @@ int API_FUNC qthread_initialize(void)
     qlib->mccoy_thread->rdata->shepherd_ptr   = &(qlib->shepherds[0]);
     qlib->mccoy_thread->rdata->stack          = NULL;
     qlib->mccoy_thread->rdata->tasklocal_size = 0;
+    qlib->mccoy_thread->rdata->arena          = NULL;
 
     qthread_debug(CORE_DETAILS, "enqueueing mccoy thread\n");
     TLS_SET(shepherd_structs, (qthread_shepherd_t *)&(qlib->shepherds[0].workers[0]));
@@ -1491,6 +1557,11 @@ void API_FUNC qthread_finalize(void)
             FREE(shep0->workers[0].nostealbuffer, STEAL_BUFFER_LENGTH * sizeof(qthread_t *));
             FREE(shep0->workers[0].stealbuffer, STEAL_BUFFER_LENGTH * sizeof(qthread_t *));
         }
+        if (i == 0) {
+            /* worker 0's struct is about to go away; later pool operations on
+             * this thread must not find their cache through it */
+            TLS_SET(shepherd_structs, NULL);
+        }
         FREE(qlib->shepherds[i].workers, qlib->nworkerspershep * sizeof(qthread_worker_t));
         if (i == 0) { continue; }
         QTHREAD_CASLOCK_DESTROY(shep->active);
@@ -1634,10 +1705,11 @@ void API_FUNC qthread_finalize(void)
         FREE(*(void **)&qlib->mccoy_thread->data[0], qlib->mccoy_thread->rdata->tasklocal_size);
     }
     qthread_debug(CORE_DETAILS, "destroy mccoy thread structure\n");
+    qt_arena_release(&qlib->mccoy_thread->rdata->arena);
     FREE(qlib->mccoy_thread->rdata, sizeof(struct qthread_runtime_data_s));
     FREE_QTHREAD(qlib->mccoy_thread);
     qthread_debug(CORE_DETAILS, "destroy master stack\n");
-    FREE(qlib->master_stack, qlib->master_stack_size);
+    qt_internal_aligned_free(qlib->master_stack, QTHREAD_STACK_ALIGNMENT);
     qthread_debug(CORE_DETAILS, "calling late cleanup functions\n");
     while (qt_cleanup_late_funcs != NULL) {
         struct qt_cleanup_funcs_s *tmp = qt_cleanup_late_funcs;
@@ -2014,6 +2086,7 @@ void qthread_thread_free(qthread_t *t)
                 *(void **)&t->data[0] = NULL;
             }
         }
+        qt_arena_release(&t->rdata->arena);
 #ifdef QTHREAD_USE_VALGRIND
         VALGRIND_STACK_DEREGISTER(t->rdata->valgrind_stack_id);
 #endif
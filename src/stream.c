@@ -0,0 +1,190 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <errno.h>
+#include <stdint.h>
+
+/* API */
+#include <qthread/qthread.h>
+#include <qthread/qt_syscalls.h>
+#include <qthread/sinc.h>
+#include <qthread/stream.h>
+
+/* Internal Headers */
+#include "qt_asserts.h"
+#include "qt_alloc.h"
+#include "qt_debug.h"
+
+/* Every buffer that the caller is not holding has a task reading the next
+ * chunk due in it, with qt_pread(), so the reads go to io_uring or the proxy
+ * threads like any other blocking call. A slot's FEB is full once its read is
+ * done; the reader empties it when it takes the chunk, and handing the chunk
+ * back starts the read of the chunk <depth> further along into the same
+ * buffer. */
+typedef struct {
+    aligned_t    ready;
+    qt_stream_t *stream;
+    uint8_t     *buf;
+    size_t       index; /* which chunk of the file the slot holds */
+    ssize_t      len;
+    int          err;
+} qt_stream_slot_t;
+
+struct qt_stream_s {
+    int              fd;
+    off_t            offset;
+    size_t           chunk_size;
+    size_t           depth;
+    aligned_t        order;   /* readers wait for chunks one at a time, in order */
+    size_t           next;    /* the next chunk to hand out */
+    qt_sinc_t        fetches; /* reads in flight */
+    uint8_t         *bufs;
+    qt_stream_slot_t slots[];
+};
+
+static aligned_t qt_stream_fetch(void *arg)
+{   /*{{{*/
+    qt_stream_slot_t *slot  = (qt_stream_slot_t *)arg;
+    qt_stream_t      *s     = slot->stream;
+    const off_t       start = s->offset + (off_t)(slot->index * s->chunk_size);
+    size_t            got   = 0;
+
+    slot->err = 0;
+    /* a short read only means the end of the file if nothing more comes */
+    while (got < s->chunk_size) {
+        ssize_t r = qt_pread(s->fd, slot->buf + got, s->chunk_size - got, start + (off_t)got);
+
+        if (r > 0) {
+            got += r;
+        } else if ((r < 0) && (errno == EINTR)) {
+            continue;
+        } else {
+            if (r < 0) { slot->err = errno; }
+            break;
+        }
+    }
+    slot->len = ((got == 0) && slot->err) ? -1 : (ssize_t)got;
+    qthread_debug(IO_DETAILS, "stream %p chunk %lu: %li\n", s, (unsigned long)slot->index, (long)slot->len);
+    qthread_fill(&slot->ready);
+    qt_sinc_submit(&s->fetches, NULL);
+    return 0;
+} /*}}}*/
+
+static void qt_stream_fetch_start(qt_stream_t      *s,
+                                  qt_stream_slot_t *slot)
+{   /*{{{*/
+    qt_sinc_expect(&s->fetches, 1);
+    if (qthread_fork(qt_stream_fetch, slot, NULL) != QTHREAD_SUCCESS) {
+        /* read it here, rather than leave the slot (and qt_stream_close())
+         * waiting for a task that will never run */
+        qthread_debug(IO_DETAILS, "stream %p chunk %lu: no task to read it ahead\n", s, (unsigned long)slot->index);
+        qt_stream_fetch(slot);
+    }
+} /*}}}*/
+
+qt_stream_t *qt_stream_open(int    fd,
+                            off_t  offset,
+                            size_t chunk_size,
+                            size_t depth)
+{   /*{{{*/
+    qt_stream_t *s;
+
+    if ((fd < 0) || (offset < 0) || (chunk_size == 0) || (depth == 0) ||
+        (chunk_size > SIZE_MAX / depth) || (chunk_size > SSIZE_MAX)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    s = qt_malloc(sizeof(qt_stream_t) + depth * sizeof(qt_stream_slot_t));
+    if (s == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    s->bufs = qt_internal_aligned_alloc(depth * chunk_size, pagesize);
+    if (s->bufs == NULL) {
+        qt_free(s);
+        errno = ENOMEM;
+        return NULL;
+    }
+    s->fd         = fd;
+    s->offset     = offset;
+    s->chunk_size = chunk_size;
+    s->depth      = depth;
+    s->order      = 0;
+    s->next       = 0;
+    qt_sinc_init(&s->fetches, 0, NULL, NULL, 0);
+    for (size_t i = 0; i < depth; i++) {
+        qt_stream_slot_t *slot = &s->slots[i];
+
+        slot->stream = s;
+        slot->buf    = s->bufs + i * chunk_size;
+        slot->index  = i;
+        qthread_empty(&slot->ready);
+        qt_stream_fetch_start(s, slot);
+    }
+    return s;
+} /*}}}*/
+
+ssize_t qt_stream_next(qt_stream_t       *s,
+                       qt_stream_chunk_t *chunk)
+{   /*{{{*/
+    qt_stream_slot_t *slot;
+    size_t            index;
+    ssize_t           len;
+
+    assert(s);
+    assert(chunk);
+    qthread_lock(&s->order);
+    index = s->next++;
+    slot  = &s->slots[index % s->depth];
+    /* if the chunk <depth> before this one has not been released yet, the
+     * slot is still empty, and this waits for it to be released and read */
+    qthread_readFE(NULL, &slot->ready);
+    qthread_unlock(&s->order);
+    assert(slot->index == index);
+
+    len           = slot->len;
+    chunk->data   = slot->buf;
+    chunk->len    = (len > 0) ? (size_t)len : 0;
+    chunk->offset = s->offset + (off_t)(slot->index * s->chunk_size);
+    chunk->slot   = slot - s->slots;
+    if (len <= 0) {
+        /* there is nothing in it for the caller to hand back */
+        const int err = slot->err;
+
+        qt_stream_release(s, chunk);
+        if (len < 0) { errno = err; }
+    }
+    return len;
+} /*}}}*/
+
+void qt_stream_release(qt_stream_t       *s,
+                       qt_stream_chunk_t *chunk)
+{   /*{{{*/
+    qt_stream_slot_t *slot;
+
+    assert(s);
+    assert(chunk);
+    assert(chunk->slot < s->depth);
+    slot         = &s->slots[chunk->slot];
+    slot->index += s->depth;
+    qt_stream_fetch_start(s, slot);
+} /*}}}*/
+
+int qt_stream_close(qt_stream_t *s)
+{   /*{{{*/
+    qassert_ret((s != NULL), QTHREAD_BADARGS);
+    qt_sinc_wait(&s->fetches, NULL);
+    for (size_t i = 0; i < s->depth; i++) {
+        /* leave nothing behind in the FEB table, even for a chunk the caller
+         * never handed back */
+        qthread_fill(&s->slots[i].ready);
+    }
+    qt_sinc_fini(&s->fetches);
+    qt_internal_aligned_free(s->bufs, pagesize);
+    qt_free(s);
+    return QTHREAD_SUCCESS;
+} /*}}}*/
+
+/* vim:set expandtab: */
@@ -15,11 +15,11 @@
 
 /* Internal Headers */
 #include "qt_subsystems.h"
-#include "qt_hash.h"
 #include "qt_asserts.h"
 #include "qthread_innards.h"
 #include "qt_initialized.h" // for qthread_library_initialized
 #include "qt_profiling.h"
+#include "qt_feb_profile.h"
 #include "qt_blocking_structs.h"
 #include "qt_addrstat.h"
 #include "qt_qthread_struct.h"
@@ -30,17 +30,6 @@
 #include "qt_eurekas.h"
 #endif /* QTHREAD_USE_EUREKAS */
 
-/* Internal Prototypes */
-static QINLINE void qthread_syncvar_gotlock_fill(qthread_shepherd_t *shep,
-                                                 qthread_addrstat_t *m,
-                                                 syncvar_t          *maddr,
-                                                 const uint64_t      ret);
-static QINLINE void qthread_syncvar_gotlock_empty(qthread_shepherd_t *shep,
-                                                  qthread_addrstat_t *m,
-                                                  syncvar_t          *maddr,
-                                                  const uint64_t      ret);
-static QINLINE void qthread_syncvar_remove(void *maddr);
-
 /* Internal Structs */
 typedef struct {
     unsigned int cf : 1; // there was a timeout
@@ -70,8 +59,38 @@ typedef struct {
     int             retval;
 } qthread_syncvar_blocker_t;
 
+/* While threads are queued on a syncvar (states 1 and 3), its 60-bit data
+ * field holds a pointer to this record instead of the syncvar's value, and the
+ * value is parked in the record until the last waiter is released. The record
+ * is only ever reached through the syncvar, which must be locked to follow
+ * the pointer, so blocked syncvars never need a global lookup table. Records
+ * are also linked into a per-shepherd registry so that the taskfilter and
+ * callback interfaces can still enumerate every blocked thread. */
+typedef struct qt_syncvar_waiters_s {
+    qthread_addrstat_t           m; /* must be first: blockedon.addr points here */
+    uint64_t                     data;
+    syncvar_t                   *addr;
+    struct qt_syncvar_waiters_s *prev;
+    struct qt_syncvar_waiters_s *next;
+    qthread_shepherd_id_t        registry;
+} qt_syncvar_waiters_t;
+
+typedef struct {
+    QTHREAD_FASTLOCK_TYPE lock;
+    qt_syncvar_waiters_t *head;
+} qt_syncvar_registry_t;
+
 /* Internal Variables */
-static qt_hash *syncvars;
+static qt_syncvar_registry_t *waiter_registry = NULL;
+static qthread_shepherd_id_t  waiter_registry_count = 0;
+#if !defined(UNPOOLED_ADDRSTAT) && !defined(UNPOOLED)
+static qt_mpool syncvar_waiters_pool = NULL;
+# define ALLOC_SYNCVAR_WAITERS() (qt_syncvar_waiters_t *)qt_mpool_alloc(syncvar_waiters_pool)
+# define FREE_SYNCVAR_WAITERS(t) qt_mpool_free(syncvar_waiters_pool, t)
+#else
+# define ALLOC_SYNCVAR_WAITERS() (qt_syncvar_waiters_t *)MALLOC(sizeof(qt_syncvar_waiters_t))
+# define FREE_SYNCVAR_WAITERS(t) FREE(t, sizeof(qt_syncvar_waiters_t))
+#endif
 #ifdef QTHREAD_COUNT_THREADS
 extern aligned_t *febs_stripes;
 # ifdef QTHREAD_MUTEX_INCREMENT
@@ -83,6 +102,8 @@ extern unsigned int QTHREAD_LOCKING_STRIPES;
 /* Internal Macros */
 #define BUILD_UNLOCKED_SYNCVAR(data, state) (((data) << 4) | ((state) << 1))
 #define QTHREAD_CHOOSE_STRIPE(addr)         (((size_t)addr >> 4) & (QTHREAD_LOCKING_STRIPES - 1))
+#define SYNCVAR_DATA_MASK                   ((UINT64_C(1) << 60) - 1)
+#define SYNCVAR_WAITERS(data)               ((qt_syncvar_waiters_t *)(uintptr_t)(data))
 
 #if (QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64)
 # define UNLOCK_THIS_UNMODIFIED_SYNCVAR(addr, unlocked) do { \
@@ -119,7 +140,8 @@ extern unsigned int QTHREAD_LOCKING_STRIPES;
 static uint64_t qthread_mwaitc(syncvar_t *const restrict addr,
                                unsigned char const       statemask,
                                unsigned int              timeout,
-                               eflags_t *const restrict  err)
+                               eflags_t *const restrict  err,
+                               qt_syncvar_waiters_t    **w)
 {                                      /*{{{ */
 #if ((QTHREAD_ASSEMBLY_ARCH != QTHREAD_TILEPRO) && \
     (QTHREAD_ASSEMBLY_ARCH != QTHREAD_POWERPC32))
@@ -198,6 +220,14 @@ loop_start:
             e.of = (unsigned char)((locked.u.s.state >> 2) & 1);
             *err = e;
             qthread_debug(SYNCVAR_DETAILS, "returning locked... (%i)\n", (int)locked.u.s.data);
+            if (locked.u.s.state & 1) {
+                /* the data field points at the waiter record, which is
+                 * holding the real value */
+                qt_syncvar_waiters_t *waiters = SYNCVAR_WAITERS(locked.u.s.data);
+                if (w) { *w = waiters; }
+                return waiters->data;
+            }
+            if (w) { *w = NULL; }
             return locked.u.s.data;
         } else {
             /* this is NOT a state of interest, so unlock the locked bit */
@@ -217,26 +247,121 @@ errexit:
     return 0;
 }                                      /*}}} */
 
+
+static qt_syncvar_waiters_t *qt_syncvar_waiters_new(syncvar_t *const          addr,
+                                                    const qthread_shepherd_id_t shep)
+{                                      /*{{{ */
+    qt_syncvar_waiters_t  *w = ALLOC_SYNCVAR_WAITERS();
+    qt_syncvar_registry_t *r;
+
+    if (w == NULL) { return NULL; }
+    QTHREAD_FASTLOCK_INIT(w->m.lock);
+    w->m.full  = 1;
+    w->m.valid = 1;
+    w->m.EFQ   = NULL;
+    w->m.FEQ   = NULL;
+    w->m.FFQ   = NULL;
+    w->m.FFWQ  = NULL;
+    QTHREAD_EMPTY_TIMER_INIT(&w->m);
+    w->data     = 0;
+    w->addr     = addr;
+    w->prev     = NULL;
+    w->registry = shep;
+
+    assert(shep < waiter_registry_count);
+    r = &waiter_registry[shep];
+    QTHREAD_FASTLOCK_LOCK(&r->lock);
+    w->next = r->head;
+    if (r->head) { r->head->prev = w; }
+    r->head = w;
+    QTHREAD_FASTLOCK_UNLOCK(&r->lock);
+    return w;
+}                                      /*}}} */
+
+static void qt_syncvar_waiters_free(qt_syncvar_waiters_t *w)
+{                                      /*{{{ */
+#ifdef QTHREAD_FEB_PROFILING
+    qtimer_destroy(w->m.empty_timer);
+#endif
+    QTHREAD_FASTLOCK_DESTROY(w->m.lock);
+    FREE_SYNCVAR_WAITERS(w);
+}                                      /*}}} */
+
+/* The registry must be locked. */
+static QINLINE void qt_syncvar_waiters_unlink(qt_syncvar_registry_t *r,
+                                              qt_syncvar_waiters_t  *w)
+{                                      /*{{{ */
+    if (w->prev) {
+        w->prev->next = w->next;
+    } else {
+        r->head = w->next;
+    }
+    if (w->next) { w->next->prev = w->prev; }
+}                                      /*}}} */
+
+/* Only called on records that are no longer reachable from their syncvar. */
+static void qt_syncvar_waiters_delete(qt_syncvar_waiters_t *w)
+{                                      /*{{{ */
+    qt_syncvar_registry_t *r = &waiter_registry[w->registry];
+
+    assert(w->m.EFQ == NULL && w->m.FEQ == NULL && w->m.FFQ == NULL);
+    QTHREAD_FASTLOCK_LOCK(&r->lock);
+    qt_syncvar_waiters_unlink(r, w);
+    QTHREAD_FASTLOCK_UNLOCK(&r->lock);
+    qt_syncvar_waiters_free(w);
+}                                      /*}}} */
+
+/* Unlocks a locked syncvar, storing val and state into it. If the new state
+ * has waiters, the value is parked in their record. */
+static QINLINE void qt_syncvar_unlock(syncvar_t *restrict            addr,
+                                      qt_syncvar_waiters_t *restrict w,
+                                      uint64_t                       val,
+                                      const unsigned int             state)
+{                                      /*{{{ */
+    if (state & 1) {
+        assert(w);
+        w->data = val & SYNCVAR_DATA_MASK;
+        val     = (uintptr_t)w;
+        assert((val >> 60) == 0);
+    }
+    UNLOCK_THIS_MODIFIED_SYNCVAR(addr, val, state);
+}                                      /*}}} */
+
 static void qt_syncvar_subsystem_shutdown(void)
 {
     qthread_debug(CORE_CALLS, "begin\n");
-    qthread_debug(SYNCVAR_DETAILS, "destroy syncvar infrastructure arrays\n");
-    for (unsigned i = 0; i < QTHREAD_LOCKING_STRIPES; i++) {
-        qt_hash_destroy_deallocate(syncvars[i],
-                                   (qt_hash_deallocator_fn)
-                                   qthread_addrstat_delete);
+    qthread_debug(SYNCVAR_DETAILS, "destroy syncvar waiter registry\n");
+    for (qthread_shepherd_id_t i = 0; i < waiter_registry_count; i++) {
+        qt_syncvar_waiters_t *w = waiter_registry[i].head;
+        while (w) {
+            qt_syncvar_waiters_t *next = w->next;
+            qt_syncvar_waiters_free(w);
+            w = next;
+        }
+        QTHREAD_FASTLOCK_DESTROY(waiter_registry[i].lock);
     }
-    FREE(syncvars, sizeof(qt_hash) * QTHREAD_LOCKING_STRIPES);
+    FREE(waiter_registry, sizeof(qt_syncvar_registry_t) * waiter_registry_count);
+    waiter_registry       = NULL;
+    waiter_registry_count = 0;
+#if !defined(UNPOOLED_ADDRSTAT) && !defined(UNPOOLED)
+    qt_mpool_destroy(syncvar_waiters_pool);
+    syncvar_waiters_pool = NULL;
+#endif
     qthread_debug(CORE_CALLS, "end\n");
 }
 
-void INTERNAL qt_syncvar_subsystem_init(uint_fast8_t need_sync)
+void INTERNAL qt_syncvar_subsystem_init(void)
 {
-    syncvars = MALLOC(sizeof(qt_hash) * QTHREAD_LOCKING_STRIPES);
-    assert(syncvars);
-    for (unsigned i = 0; i < QTHREAD_LOCKING_STRIPES; i++) {
-        syncvars[i] = qt_hash_create(need_sync);
-        assert(syncvars[i]);
+#if !defined(UNPOOLED_ADDRSTAT) && !defined(UNPOOLED)
+    syncvar_waiters_pool = qt_mpool_create(sizeof(qt_syncvar_waiters_t));
+    qt_mpool_set_name(syncvar_waiters_pool, "syncvar_waiters_pool");
+#endif
+    waiter_registry_count = qlib->nshepherds;
+    waiter_registry       = MALLOC(sizeof(qt_syncvar_registry_t) * waiter_registry_count);
+    assert(waiter_registry);
+    for (qthread_shepherd_id_t i = 0; i < waiter_registry_count; i++) {
+        QTHREAD_FASTLOCK_INIT(waiter_registry[i].lock);
+        waiter_registry[i].head = NULL;
     }
     qthread_internal_cleanup_late(qt_syncvar_subsystem_shutdown);
 }
@@ -247,11 +372,11 @@ int qthread_syncvar_status(syncvar_t *const v)
     unsigned int realret;
 
 #if (QTHREAD_ASSEMBLY_ARCH == QTHREAD_TILEPRO)
-    uint64_t ret = qthread_mwaitc(v, 0xff, INT_MAX, &e);
+    qt_syncvar_waiters_t *w;
+    uint64_t              ret = qthread_mwaitc(v, 0xff, INT_MAX, &e, &w);
     qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
     realret = (e.of << 2) | (e.pf << 1) | e.sf;
-    MACHINE_FENCE;
-    v->u.w = BUILD_UNLOCKED_SYNCVAR(ret, realret);
+    qt_syncvar_unlock(v, w, ret, realret);
     return (realret & 0x2) ? 0 : 1;
 
 #else
@@ -272,7 +397,7 @@ int qthread_syncvar_status(syncvar_t *const v)
         }
     }
 # endif /* if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64)) */
-    (void)qthread_mwaitc(v, 0xff, INT_MAX, &e);
+    (void)qthread_mwaitc(v, 0xff, INT_MAX, &e, NULL);
     qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
     realret = v->u.s.state;
     UNLOCK_THIS_UNMODIFIED_SYNCVAR(v, BUILD_UNLOCKED_SYNCVAR(v->u.s.data, v->u.s.state));
@@ -342,6 +467,8 @@ static int qthread_syncvar_blocker_func(void        *dest,
  * state 2: empty, no waiters
  * state 3: empty, queued waiters (who are waiting for it to be full)
  * state 4-7: undefined
+ *
+ * In states 1 and 3 the data field holds the waiter record, not the value.
  */
 /* ops */
 /* fff */
@@ -358,13 +485,174 @@ static int qthread_syncvar_blocker_func(void        *dest,
 #define SYNCFEB_STATE_EMPTY_NO_WAITERS   0x2
 #define SYNCFEB_STATE_EMPTY_WITH_WAITERS 0x3
 
+
+
+static QINLINE void qthread_syncvar_schedule(qthread_t          *waiter,
+                                             qthread_shepherd_t *shep)
+{   /*{{{*/
+    assert(waiter);
+    assert(shep);
+    waiter->thread_state = QTHREAD_STATE_RUNNING;
+    QTPERF_QTHREAD_ENTER_STATE(waiter->rdata->performance_data, QTHREAD_STATE_RUNNING);
+    if (waiter->flags & QTHREAD_UNSTEALABLE) {
+        qt_threadqueue_enqueue(waiter->rdata->shepherd_ptr->ready, waiter);
+    } else {
+#ifdef QTHREAD_USE_SPAWNCACHE
+        if (!qt_spawncache_spawn(waiter, shep->ready))
+#endif
+        qt_threadqueue_enqueue(shep->ready, waiter);
+    }
+} /*}}}*/
+
+/* Must be called with addr locked; w is its waiter record (NULL if it has
+ * none yet) and val its current value. Queues me on one of the waiter lists
+ * (creating the record if necessary), unlocks addr into the given "with
+ * waiters" state, and blocks until a matching transition wakes me up. */
+static int qthread_syncvar_enqueue_and_block(syncvar_t *restrict  addr,
+                                             qt_syncvar_waiters_t *w,
+                                             const uint64_t       val,
+                                             qthread_t *restrict  me,
+                                             const blocker_type   queue,
+                                             void                *xaddr,
+                                             const unsigned int   state)
+{   /*{{{*/
+    QTHREAD_WAIT_TIMER_DECLARATION;
+    qthread_addrres_t *X = ALLOC_ADDRRES();
+
+    assert(state & 1);
+    if (!X) {
+        qt_syncvar_unlock(addr, w, val, w ? state : (state & ~1U));
+        return QTHREAD_MALLOC_ERROR;
+    }
+    if (!w) {
+        w = qt_syncvar_waiters_new(addr, me->rdata->shepherd_ptr->shepherd_id);
+        if (!w) {
+            FREE_ADDRRES(X);
+            qt_syncvar_unlock(addr, NULL, val, state & ~1U);
+            return QTHREAD_MALLOC_ERROR;
+        }
+    }
+    X->addr   = (aligned_t *)xaddr;
+    X->waiter = me;
+    /* The addrstat lock is held until this thread has been swapped out; the
+     * shepherd unlocks it, so nobody can wake me up before I'm asleep. */
+    QTHREAD_FASTLOCK_LOCK(&w->m.lock);
+    switch (queue) {
+        case READFF:  X->next = w->m.FFQ; w->m.FFQ = X; break;
+        case READFE:  X->next = w->m.FEQ; w->m.FEQ = X; break;
+        case WRITEEF: X->next = w->m.EFQ; w->m.EFQ = X; break;
+        default: QTHREAD_TRAP();
+    }
+    qt_syncvar_unlock(addr, w, val, state);
+    qthread_debug(SYNCVAR_DETAILS, "addr(%p) back to parent\n", addr);
+    me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
+    QTPERF_QTHREAD_ENTER_STATE(me->rdata->performance_data, QTHREAD_STATE_FEB_BLOCKED);
+    me->rdata->blockedon.addr = &w->m;
+    QTHREAD_WAIT_TIMER_START();
+    QTHREAD_FEB_PROFILE_START(me);
+    qthread_back_to_master(me);
+    QTHREAD_WAIT_TIMER_STOP(me, febwait);
+    QTHREAD_FEB_PROFILE_STOP(addr, me);
+#ifdef QTHREAD_USE_EUREKAS
+    qt_eureka_check(0);
+#endif /* QTHREAD_USE_EUREKAS */
+    qthread_debug(SYNCVAR_DETAILS, "addr(%p) woke up\n", addr);
+    return QTHREAD_SUCCESS;
+} /*}}}*/
+
+/* Must be called with addr locked and empty with waiters (w). Fills it with
+ * val: every readFF waiter gets val, and then at most one readFE waiter
+ * consumes it (leaving addr empty again). Unlocks addr. */
+static void qthread_syncvar_release_fill(syncvar_t *restrict  addr,
+                                         qt_syncvar_waiters_t *w,
+                                         const uint64_t       val,
+                                         qthread_shepherd_t  *shep)
+{   /*{{{*/
+    qthread_addrres_t *ffq, *fe;
+    int                still_waiting;
+
+    assert(w);
+    qthread_debug(SYNCVAR_FUNCTIONS, "w(%p), addr(%p)\n", w, addr);
+    QTHREAD_FASTLOCK_LOCK(&w->m.lock);
+    assert(w->m.EFQ == NULL);          // someone snuck in!
+    qthread_debug(SYNCVAR_DETAILS, "dQ all FFQ\n");
+    ffq      = w->m.FFQ;
+    w->m.FFQ = NULL;
+    fe       = w->m.FEQ;
+    if (fe) {
+        qthread_debug(SYNCVAR_DETAILS, "dQ 1 FEQ\n");
+        w->m.FEQ = fe->next;
+    }
+    still_waiting = (w->m.FEQ != NULL);
+    QTHREAD_FASTLOCK_UNLOCK(&w->m.lock);
+    if (still_waiting) {
+        qt_syncvar_unlock(addr, w, val, SYNCFEB_STATE_EMPTY_WITH_WAITERS);
+    } else {
+        qt_syncvar_unlock(addr, NULL, val, fe ? SYNCFEB_STATE_EMPTY_NO_WAITERS
+                          : SYNCFEB_STATE_FULL_NO_WAITERS);
+        qt_syncvar_waiters_delete(w);
+    }
+    /* the dequeued waiters are no longer reachable from the syncvar, so they
+     * can be woken without holding any locks */
+    while (ffq) {
+        qthread_addrres_t *X = ffq;
+        ffq = X->next;
+        if (X->addr) { *(uint64_t *)X->addr = val; }
+        qthread_syncvar_schedule(X->waiter, shep);
+        FREE_ADDRRES(X);
+    }
+    if (fe) {
+        if (fe->addr) { *(uint64_t *)fe->addr = val; }
+        qthread_syncvar_schedule(fe->waiter, shep);
+        FREE_ADDRRES(fe);
+    }
+} /*}}}*/
+
+/* Must be called with addr locked and full with waiters (w); val is its
+ * current value. Empties it, which immediately lets one writeEF waiter fill it
+ * again. Unlocks addr. */
+static void qthread_syncvar_release_empty(syncvar_t *restrict  addr,
+                                          qt_syncvar_waiters_t *w,
+                                          uint64_t             val,
+                                          qthread_shepherd_t  *shep)
+{   /*{{{*/
+    qthread_addrres_t *X;
+    int                still_waiting;
+
+    assert(w);
+    qthread_debug(SYNCVAR_FUNCTIONS, "w(%p), addr(%p)\n", w, addr);
+    QTHREAD_FASTLOCK_LOCK(&w->m.lock);
+    assert(w->m.FFQ == NULL && w->m.FEQ == NULL); // someone snuck in!
+    X = w->m.EFQ;
+    if (X) {
+        qthread_debug(SYNCVAR_DETAILS, "dQ 1 EFQ\n");
+        w->m.EFQ = X->next;
+        val      = *(uint64_t *)X->addr;
+    }
+    still_waiting = (w->m.EFQ != NULL);
+    QTHREAD_FASTLOCK_UNLOCK(&w->m.lock);
+    if (still_waiting) {
+        qt_syncvar_unlock(addr, w, val, SYNCFEB_STATE_FULL_WITH_WAITERS);
+    } else {
+        /* if a taskfilter removed the last writer, nobody refills it */
+        qt_syncvar_unlock(addr, NULL, val, X ? SYNCFEB_STATE_FULL_NO_WAITERS
+                          : SYNCFEB_STATE_EMPTY_NO_WAITERS);
+        qt_syncvar_waiters_delete(w);
+    }
+    if (X) {
+        qthread_syncvar_schedule(X->waiter, shep);
+        FREE_ADDRRES(X);
+    }
+} /*}}}*/
+
 int API_FUNC qthread_syncvar_readFF(uint64_t *restrict  dest,
                                     syncvar_t *restrict src)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
-    eflags_t   e = { 0, 0, 0, 0, 0 };
-    uint64_t   ret;
-    qthread_t *me = qthread_internal_self();
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    uint64_t              ret;
+    qt_syncvar_waiters_t *w;
+    qthread_t            *me = qthread_internal_self();
     QTHREAD_FEB_TIMER_DECLARATION(febblock);
 
     assert(src);
@@ -383,11 +671,12 @@ int API_FUNC qthread_syncvar_readFF(uint64_t *restrict  dest,
     {
         /* I'm being optimistic here; this only works if a basic 64-bit load is
          * atomic (on most platforms it is). Thus, if I've done an atomic read
-         * and the syncvar is both unlocked and full, then I figure I can trust
-         * that state and do not need to do a locked atomic operation of any
-         * kind (e.g. cas) */
+         * and the syncvar is unlocked, full, and has no waiters (whose record
+         * would be holding the value), then I figure I can trust that state
+         * and do not need to do a locked atomic operation of any kind (e.g.
+         * cas) */
         syncvar_t local_copy_of_src = *src;
-        if ((local_copy_of_src.u.s.lock == 0) && ((local_copy_of_src.u.s.state & 2) == 0)) {        /* full and unlocked */
+        if ((local_copy_of_src.u.s.lock == 0) && (local_copy_of_src.u.s.state == SYNCFEB_STATE_FULL_NO_WAITERS)) {
             /* short-circuit */
             if (dest) {
                 *dest = local_copy_of_src.u.s.data;
@@ -396,90 +685,28 @@ int API_FUNC qthread_syncvar_readFF(uint64_t *restrict  dest,
         }
     }
 #endif /* if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64)) */
-    ret = qthread_mwaitc(src, SYNCFEB_FULL, INITIAL_TIMEOUT, &e);
+    ret = qthread_mwaitc(src, SYNCFEB_FULL, INITIAL_TIMEOUT, &e, &w);
     qthread_debug(SYNCVAR_DETAILS, "2 src(%p) = %x, ret = %x\n", src,
                   (uintptr_t)src->u.w, ret);
     if (e.cf) {                        /* there was a timeout */
-        QTHREAD_WAIT_TIMER_DECLARATION;
-        const int           lockbin = QTHREAD_CHOOSE_STRIPE(src);
-        qthread_addrstat_t *m;
-        qthread_addrres_t  *X;
+        int rv;
 
-        ret = qthread_mwaitc(src, SYNCFEB_ANY, INT_MAX, &e);
+        ret = qthread_mwaitc(src, SYNCFEB_ANY, INT_MAX, &e, &w);
         qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
         if (e.pf == 0) {                         /* it got full! */
             goto locked_full;
         }
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-        qthread_debug(SYNCVAR_DETAILS,
-                      "3 src(%p) = %x (queued waiter waiting for full)\n",
-                      src, (uintptr_t)BUILD_UNLOCKED_SYNCVAR(ret, SYNCFEB_STATE_EMPTY_WITH_WAITERS));
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)src);
-got_m:
-            if (!m) {
-                m = qthread_addrstat_new();
-                if (!m) { return QTHREAD_MALLOC_ERROR; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                qassertnot(qt_hash_put(syncvars[lockbin], (void *)src, m), 0);
-            } else {
-                qthread_addrstat_t *m2;
-                hazardous_ptr(0, m);
-                if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)src))) {
-                    m = m2;
-                    goto got_m;
-                }
-                if (!m->valid) { continue; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                if (!m->valid) {
-                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                    continue;
-                }
-            }
-            break;
-        } while (1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        /* Note that locking the hash table is unnecessary because we have
-         * locked the syncvar itself. */
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-        m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)src);
-        if (!m) {
-            m = qthread_addrstat_new();
-            assert(m);
-            if (!m) { return QTHREAD_MALLOC_ERROR; }
-            qassertnot(qt_hash_put(syncvars[lockbin], (void *)src, m), 0);
-        }
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
-#endif  /* ifdef LOCK_FREE_FEBS */
-        UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, SYNCFEB_STATE_EMPTY_WITH_WAITERS);
-        X = ALLOC_ADDRRES();
-        assert(X);
-        if (!X) {
-            qthread_syncvar_remove(src);
-            return ENOMEM;
-        }
-        X->addr   = (aligned_t *)dest;
-        X->waiter = me;
-        X->next   = m->FFQ;
-        m->FFQ    = X;
-        qthread_debug(SYNCVAR_DETAILS, "back to parent\n");
-        me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
-        QTPERF_QTHREAD_ENTER_STATE(me->rdata->performance_data, QTHREAD_STATE_FEB_BLOCKED);
-        me->rdata->blockedon.addr = m;
-        QTHREAD_WAIT_TIMER_START();
-        qthread_back_to_master(me);
-        QTHREAD_WAIT_TIMER_STOP(me, febwait);
-#ifdef QTHREAD_USE_EUREKAS
-        qt_eureka_check(0);
-#endif /* QTHREAD_USE_EUREKAS */
-        qthread_debug(SYNCVAR_DETAILS, "src(%p) woke up\n", src);
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(src));
+        qthread_debug(SYNCVAR_DETAILS, "3 src(%p) (queued waiter waiting for full)\n", src);
+        rv = qthread_syncvar_enqueue_and_block(src, w, ret, me, READFF, dest,
+                                               SYNCFEB_STATE_EMPTY_WITH_WAITERS);
+        if (rv != QTHREAD_SUCCESS) { return rv; }
     } else {
         qthread_debug(SYNCVAR_DETAILS, "locked/full on the first try; word=%x, state = %x, ret=%x\n", (unsigned int)src->u.w, (int)src->u.s.state, (int)ret);
 locked_full:
         /* at this point, the syncvar is locked and e.pf should be 0 */
         assert(e.pf == 0);
-        UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, e.sf);
+        qt_syncvar_unlock(src, w, ret, e.sf);
         if (dest) { *dest = ret; }
     }
     QTHREAD_FEB_TIMER_STOP(febblock, me);
@@ -489,9 +716,10 @@ locked_full:
 int API_FUNC qthread_syncvar_readFF_nb(uint64_t *restrict  dest,
                                        syncvar_t *restrict src)
 {                                      /*{{{ */
-    eflags_t   e = { 0, 0, 0, 0, 0 };
-    uint64_t   ret;
-    qthread_t *me = qthread_internal_self();
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    uint64_t              ret;
+    qt_syncvar_waiters_t *w;
+    qthread_t            *me = qthread_internal_self();
 
     assert(src);
     qthread_debug(SYNCVAR_CALLS, "me(%p), dest(%p), src(%p) = %x\n", me, dest, src, (uintptr_t)src->u.w);
@@ -507,11 +735,12 @@ int API_FUNC qthread_syncvar_readFF_nb(uint64_t *restrict  dest,
     {
         /* I'm being optimistic here; this only works if a basic 64-bit load is
          * atomic (on most platforms it is). Thus, if I've done an atomic read
-         * and the syncvar is both unlocked and full, then I figure I can trust
-         * that state and do not need to do a locked atomic operation of any
-         * kind (e.g. cas) */
+         * and the syncvar is unlocked, full, and has no waiters (whose record
+         * would be holding the value), then I figure I can trust that state
+         * and do not need to do a locked atomic operation of any kind (e.g.
+         * cas) */
         syncvar_t local_copy_of_src = *src;
-        if ((local_copy_of_src.u.s.lock == 0) && ((local_copy_of_src.u.s.state & 2) == 0)) {        /* full and unlocked */
+        if ((local_copy_of_src.u.s.lock == 0) && (local_copy_of_src.u.s.state == SYNCFEB_STATE_FULL_NO_WAITERS)) {
             /* short-circuit */
             if (dest) {
                 *dest = local_copy_of_src.u.s.data;
@@ -520,7 +749,7 @@ int API_FUNC qthread_syncvar_readFF_nb(uint64_t *restrict  dest,
         }
     }
 #endif /* if ((QTHREAD_ASSEMBLY_ARCH == QTHREAD_AMD64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_IA64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_POWERPC64) || (QTHREAD_ASSEMBLY_ARCH == QTHREAD_SPARCV9_64)) */
-    ret = qthread_mwaitc(src, SYNCFEB_FULL, 1, &e);
+    ret = qthread_mwaitc(src, SYNCFEB_FULL, 1, &e, &w);
     qthread_debug(SYNCVAR_DETAILS, "2 src(%p) = %x, ret = %x\n", src,
                   (uintptr_t)src->u.w, ret);
     if (e.cf) {                        /* there was a timeout */
@@ -530,7 +759,7 @@ int API_FUNC qthread_syncvar_readFF_nb(uint64_t *restrict  dest,
         qthread_debug(SYNCVAR_DETAILS, "locked/full on the first try; word=%x, state = %x, ret=%x\n", (unsigned int)src->u.w, (int)src->u.s.state, (int)ret);
         /* at this point, the syncvar is locked and e.pf should be 0 */
         assert(e.pf == 0);
-        UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, e.sf);
+        qt_syncvar_unlock(src, w, ret, e.sf);
         if (dest) { *dest = ret; }
     }
     return QTHREAD_SUCCESS;
@@ -539,9 +768,10 @@ int API_FUNC qthread_syncvar_readFF_nb(uint64_t *restrict  dest,
 int API_FUNC qthread_syncvar_fill(syncvar_t *restrict addr)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
-    eflags_t            e = { 0, 0, 0, 0, 0 };
-    uint64_t            ret;
-    qthread_shepherd_t *shep = qthread_internal_getshep();
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    uint64_t              ret;
+    qt_syncvar_waiters_t *w;
+    qthread_shepherd_t   *shep = qthread_internal_getshep();
 
     assert(addr);
 
@@ -550,67 +780,19 @@ int API_FUNC qthread_syncvar_fill(syncvar_t *restrict addr)
     if (!shep) {
         return qthread_syncvar_nonblocker_func(addr, NULL, FILL);
     }
-    ret = qthread_mwaitc(addr, SYNCFEB_ANY, INT_MAX, &e);
+    ret = qthread_mwaitc(addr, SYNCFEB_ANY, INT_MAX, &e, &w);
     qthread_debug(SYNCVAR_DETAILS, "shep(%p), addr(%p) = %x (b)\n", shep, addr,
                   (uintptr_t)addr->u.w);
     qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
     if (e.pf == 1) {                         /* currently empty, so it needs to change state */
         if (e.sf == 1) {                     /* waiters! */
-            const int           lockbin = QTHREAD_CHOOSE_STRIPE(addr);
-            qthread_addrstat_t *m;
-
-            QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-            e.sf = 0;                  // I'm releasing waiters
-            e.pf = 0;                  // I'm going to mark this as full
-#ifdef LOCK_FREE_FEBS
-            do {
-                m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)addr);
-got_m:
-                if (!m) {
-                    m = qthread_addrstat_new();
-                    if (!m) { return QTHREAD_MALLOC_ERROR; }
-                    QTHREAD_FASTLOCK_LOCK(&m->lock);
-                    qassertnot(qt_hash_put(syncvars[lockbin], (void *)addr, m), 0);
-                } else {
-                    qthread_addrstat_t *m2;
-                    hazardous_ptr(0, m);
-                    if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)addr))) {
-                        m = m2;
-                        goto got_m;
-                    }
-                    if (!m->valid) { continue; }
-                    QTHREAD_FASTLOCK_LOCK(&m->lock);
-                    if (!m->valid) {
-                        QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                        continue;
-                    }
-                }
-                break;
-            } while (1);
-#else       /* ifdef LOCK_FREE_FEBS */
-            /* Note that locking the hash table is unnecessary because we have
-             * locked the syncvar itself. */
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)addr);
-            assert(m);                 // otherwise there weren't really any waiters
-            QTHREAD_FASTLOCK_LOCK(&(m->lock));
-#endif      /* ifdef LOCK_FREE_FEBS */
-            if (m->FEQ) {
-                e.pf = 1;                      // back to being empty
-                if (m->FEQ->next) {
-                    e.sf = 1;          // only one will be dequeued, so it'll still have waiters
-                }
-            }
-            UNLOCK_THIS_MODIFIED_SYNCVAR(addr, ret, (e.pf << 1) | e.sf);
-            assert(m->FFQ || m->FEQ);      // otherwise there weren't really any waiters
-            assert(m->EFQ == NULL);        // someone snuck in!
-            qthread_syncvar_gotlock_fill(shep, m, addr, ret);
+            QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(addr));
+            qthread_syncvar_release_fill(addr, w, ret, shep);
         } else {
-            assert(e.sf == 0);         /* no waiters */
-            UNLOCK_THIS_MODIFIED_SYNCVAR(addr, ret, 0);
+            qt_syncvar_unlock(addr, NULL, ret, SYNCFEB_STATE_FULL_NO_WAITERS);
         }
     } else { /* already full, so just release the lock */
-        assert(e.pf == 0);
-        UNLOCK_THIS_MODIFIED_SYNCVAR(addr, ret, e.sf);
+        qt_syncvar_unlock(addr, w, ret, e.sf);
     }
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
@@ -618,9 +800,10 @@ got_m:
 int API_FUNC qthread_syncvar_empty(syncvar_t *restrict addr)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
-    eflags_t            e = { 0, 0, 0, 0, 0 };
-    uint64_t            ret;
-    qthread_shepherd_t *shep = qthread_internal_getshep();
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    uint64_t              ret;
+    qt_syncvar_waiters_t *w;
+    qthread_shepherd_t   *shep = qthread_internal_getshep();
 
     assert(addr);
 
@@ -628,67 +811,19 @@ int API_FUNC qthread_syncvar_empty(syncvar_t *restrict addr)
     if (!shep) {
         return qthread_syncvar_nonblocker_func(addr, NULL, EMPTY);
     }
-    ret = qthread_mwaitc(addr, SYNCFEB_ANY, INT_MAX, &e);
+    ret = qthread_mwaitc(addr, SYNCFEB_ANY, INT_MAX, &e, &w);
     qthread_debug(SYNCVAR_DETAILS, "shep(%p), addr(%p) = %x (b)\n", shep, addr, (uintptr_t)addr->u.w);
     qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
     if (e.pf == 0) {                         /* currently full, so it needs to change state */
         if (e.sf == 1) {                     /* waiters! */
-            const int           lockbin = QTHREAD_CHOOSE_STRIPE(addr);
-            qthread_addrstat_t *m;
-
-            QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-            e.sf = 0;                  // released!
+            QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(addr));
             // wanted to mark it empty, but the waiters will fill it
-#ifdef LOCK_FREE_FEBS
-            do {
-                m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)addr);
-got_m:
-                if (!m) {
-                    m = qthread_addrstat_new();
-                    if (!m) { return QTHREAD_MALLOC_ERROR; }
-                    QTHREAD_FASTLOCK_LOCK(&m->lock);
-                    qassertnot(qt_hash_put(syncvars[lockbin], (void *)addr, m), 0);
-                } else {
-                    qthread_addrstat_t *m2;
-                    hazardous_ptr(0, m);
-                    if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)addr))) {
-                        m = m2;
-                        goto got_m;
-                    }
-                    if (!m->valid) { continue; }
-                    QTHREAD_FASTLOCK_LOCK(&m->lock);
-                    if (!m->valid) {
-                        QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                        continue;
-                    }
-                }
-                break;
-            } while (1);
-#else       /* ifdef LOCK_FREE_FEBS */
-            /* Note that locking the hash table is unnecessary because we have
-             * locked the syncvar itself. */
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)addr);
-            assert(m);             // otherwise, there weren't any waiters
-            QTHREAD_FASTLOCK_LOCK(&(m->lock));
-#endif                                                /* ifdef LOCK_FREE_FEBS */
-            assert(m->EFQ);                           // otherwise there weren't really any waiters
-            assert(m->FFQ == NULL && m->FEQ == NULL); // someone snuck in!
-            if (m->EFQ->next) {
-                e.sf = 1;
-            }
-            qthread_debug(SYNCVAR_DETAILS, "m->FEQ = %p, m->FFQ = %p, m->EFQ = %p\n",
-                          m->FEQ, m->FFQ, m->EFQ);
-            // addr->u.w = BUILD_UNLOCKED_SYNCVAR(ret, e.sf); // this must be done by gotlock_empty so we know what value to write
-            qthread_syncvar_gotlock_empty(shep, m, addr, e.sf);
-            qthread_debug(SYNCVAR_DETAILS, "empty(%p) => %x\n", addr,
-                          (uintptr_t)BUILD_UNLOCKED_SYNCVAR(ret, (e.pf << 1) | e.sf));
+            qthread_syncvar_release_empty(addr, w, ret, shep);
         } else {
-            assert(e.sf == 0);         /* no waiters */
-            UNLOCK_THIS_MODIFIED_SYNCVAR(addr, ret, SYNCFEB_STATE_EMPTY_NO_WAITERS);
+            qt_syncvar_unlock(addr, NULL, ret, SYNCFEB_STATE_EMPTY_NO_WAITERS);
         }
     } else { /* already empty, so just release the lock */
-        assert(e.pf == 1);
-        UNLOCK_THIS_MODIFIED_SYNCVAR(addr, ret, SYNCFEB_STATE_EMPTY_NO_WAITERS | e.sf);
+        qt_syncvar_unlock(addr, w, ret, SYNCFEB_STATE_EMPTY_NO_WAITERS | e.sf);
     }
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
@@ -697,10 +832,10 @@ int API_FUNC qthread_syncvar_readFE(uint64_t *restrict  dest,
                                     syncvar_t *restrict src)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
-    eflags_t   e = { 0, 0, 0, 0, 0 };
-    uint64_t   ret;
-    const int  lockbin = QTHREAD_CHOOSE_STRIPE(src);
-    qthread_t *me      = qthread_internal_self();
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    uint64_t              ret;
+    qt_syncvar_waiters_t *w;
+    qthread_t            *me = qthread_internal_self();
     QTHREAD_FEB_TIMER_DECLARATION(febblock);
 
     assert(src);
@@ -718,15 +853,13 @@ int API_FUNC qthread_syncvar_readFE(uint64_t *restrict  dest,
                   src, (uintptr_t)src->u.w);
     QTHREAD_FEB_UNIQUERECORD(feb, src, me);
     QTHREAD_FEB_TIMER_START(febblock);
-    ret = qthread_mwaitc(src, SYNCFEB_FULL, INITIAL_TIMEOUT, &e);
+    ret = qthread_mwaitc(src, SYNCFEB_FULL, INITIAL_TIMEOUT, &e, &w);
     qthread_debug(SYNCVAR_DETAILS, "2 src(%p) = %x\n", src,
                   (uintptr_t)src->u.w);
     if (e.cf) {                        /* there was a timeout */
-        QTHREAD_WAIT_TIMER_DECLARATION;
-        qthread_addrstat_t *m;
-        qthread_addrres_t  *X;
+        int rv;
 
-        ret = qthread_mwaitc(src, SYNCFEB_ANY, INT_MAX, &e);
+        ret = qthread_mwaitc(src, SYNCFEB_ANY, INT_MAX, &e, &w);
         qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
         if (e.pf == 0) {                         /* it got full! */
             if (e.sf == 1) {                     /* it got full with waiters! */
@@ -735,128 +868,21 @@ int API_FUNC qthread_syncvar_readFE(uint64_t *restrict  dest,
                 goto locked_full;
             }
         }
-        qthread_debug(SYNCVAR_DETAILS, "3 src(%p) = %x (queued waiter waiting for full)\n",
-                      src, (uintptr_t)BUILD_UNLOCKED_SYNCVAR(ret, SYNCFEB_STATE_EMPTY_WITH_WAITERS));
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)src);
-got_m:
-            if (!m) {
-                m = qthread_addrstat_new();
-                if (!m) { return QTHREAD_MALLOC_ERROR; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                qassertnot(qt_hash_put(syncvars[lockbin], (void *)src, m), 0);
-            } else {
-                qthread_addrstat_t *m2;
-                hazardous_ptr(0, m);
-                if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)src))) {
-                    m = m2;
-                    goto got_m;
-                }
-                if (!m->valid) { continue; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                if (!m->valid) {
-                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                    continue;
-                }
-            }
-            break;
-        } while (1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        /* Note that locking the hash table is unnecessary because we have
-         * locked the syncvar itself. */
-        qt_hash_lock(syncvars[lockbin]);
-        {
-            m = (qthread_addrstat_t *)qt_hash_get_locked(syncvars[lockbin], (void *)src);
-            if (!m) {
-                m = qthread_addrstat_new();
-                assert(m);
-                if (!m) {
-                    return ENOMEM;
-                }
-                qassertnot(qt_hash_put_locked(syncvars[lockbin], (void *)src, m), 0);
-            }
-            QTHREAD_FASTLOCK_LOCK(&(m->lock));
-        }
-        qt_hash_unlock(syncvars[lockbin]);
-#endif  /* ifdef LOCK_FREE_FEBS */
-        UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, SYNCFEB_STATE_EMPTY_WITH_WAITERS);
-        X = ALLOC_ADDRRES();
-        assert(X);
-        if (!X) {
-            qthread_syncvar_remove(src);
-            return ENOMEM;
-        }
-        X->addr   = (aligned_t *)&ret;
-        X->waiter = me;
-        X->next   = m->FEQ;
-        m->FEQ    = X;
-        qthread_debug(SYNCVAR_DETAILS, "back to parent\n");
-        me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
-        QTPERF_QTHREAD_ENTER_STATE(me->rdata->performance_data, QTHREAD_STATE_FEB_BLOCKED);
-        me->rdata->blockedon.addr = m;
-        QTHREAD_WAIT_TIMER_START();
-        qthread_back_to_master(me);
-        QTHREAD_WAIT_TIMER_STOP(me, febwait);
-#ifdef QTHREAD_USE_EUREKAS
-        qt_eureka_check(0);
-#endif /* QTHREAD_USE_EUREKAS */
-        qthread_debug(SYNCVAR_DETAILS, "src(%p) woke up\n", src);
+        qthread_debug(SYNCVAR_DETAILS, "3 src(%p) (queued waiter waiting for full)\n", src);
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(src));
+        rv = qthread_syncvar_enqueue_and_block(src, w, ret, me, READFE, &ret,
+                                               SYNCFEB_STATE_EMPTY_WITH_WAITERS);
+        if (rv != QTHREAD_SUCCESS) { return rv; }
     } else if (e.sf == 1) {            /* waiters! */
-        qthread_addrstat_t *m;
-
 locked_full_waiters:
         assert(e.pf == 0);             // otherwise we should have gotten a timeout
-        e.sf = 0;                      // released!
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(src));
         // wanted to mark it empty (pf=1), but the waiters will fill it
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)src);
-got_m2:
-            if (!m) {
-                m = qthread_addrstat_new();
-                if (!m) { return QTHREAD_MALLOC_ERROR; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                qassertnot(qt_hash_put(syncvars[lockbin], (void *)src, m), 0);
-            } else {
-                qthread_addrstat_t *m2;
-                hazardous_ptr(0, m);
-                if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)src))) {
-                    m = m2;
-                    goto got_m2;
-                }
-                if (!m->valid) { continue; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                if (!m->valid) {
-                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                    continue;
-                }
-            }
-            break;
-        } while (1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        /* Note that locking the hash table is unnecessary because we have
-         * locked the syncvar itself. */
-        m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)src);
-        assert(m);                 // otherwise, there weren't any waiters
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
-#endif  /* ifdef LOCK_FREE_FEBS */
-        assert(m->EFQ);                           // otherwise there weren't really any waiters
-        assert(m->FFQ == NULL && m->FEQ == NULL); // someone snuck in!
-        if (m->EFQ->next) {                       // there will be a waiter still waiting
-            e.sf = 1;
-        }
-        qthread_debug(SYNCVAR_DETAILS, "m->FEQ = %p, m->FFQ = %p, m->EFQ = %p\n",
-                      m->FEQ, m->FFQ, m->EFQ);
-        // src->u.w = BUILD_UNLOCKED_SYNCVAR(ret, e.sf); // this must be done by gotlock_empty so we know what value to write
-        qthread_syncvar_gotlock_empty(me->rdata->shepherd_ptr, m, src, e.sf);
-        qthread_debug(SYNCVAR_DETAILS, "src(%p) => %x\n", src,
-                      (uintptr_t)BUILD_UNLOCKED_SYNCVAR(ret, e.sf));
+        qthread_syncvar_release_empty(src, w, ret, me->rdata->shepherd_ptr);
     } else {
 locked_full:
         assert(e.pf == 0);             // otherwise this isn't really full
-        UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, SYNCFEB_STATE_EMPTY_NO_WAITERS);
+        qt_syncvar_unlock(src, NULL, ret, SYNCFEB_STATE_EMPTY_NO_WAITERS);
     }
     if (dest) {
         *dest = ret;
@@ -869,10 +895,10 @@ locked_full:
 int API_FUNC qthread_syncvar_readFE_nb(uint64_t *restrict  dest,
                                        syncvar_t *restrict src)
 {                                      /*{{{ */
-    eflags_t   e = { 0, 0, 0, 0, 0 };
-    uint64_t   ret;
-    const int  lockbin = QTHREAD_CHOOSE_STRIPE(src);
-    qthread_t *me      = qthread_internal_self();
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    uint64_t              ret;
+    qt_syncvar_waiters_t *w;
+    qthread_t            *me = qthread_internal_self();
 
     assert(src);
 
@@ -887,65 +913,20 @@ int API_FUNC qthread_syncvar_readFE_nb(uint64_t *restrict  dest,
 
     qthread_debug(SYNCVAR_BEHAVIOR, "me(%p), dest(%p), src(%p) = %x\n", me, dest,
                   src, (uintptr_t)src->u.w);
-    ret = qthread_mwaitc(src, SYNCFEB_FULL, 1, &e);
+    ret = qthread_mwaitc(src, SYNCFEB_FULL, 1, &e, &w);
     qthread_debug(SYNCVAR_DETAILS, "2 src(%p) = %x\n", src,
                   (uintptr_t)src->u.w);
     if (e.cf) {                        /* there was a timeout */
         qthread_debug(SYNCVAR_BEHAVIOR, "tid %u non-blocking fail\n", me->thread_id);
         return QTHREAD_OPFAIL;
     } else if (e.sf == 1) {            /* waiters! */
-        qthread_addrstat_t *m;
-
         assert(e.pf == 0);             // otherwise we should have gotten a timeout
-        e.sf = 0;                      // released!
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(src));
         // wanted to mark it empty (pf=1), but the waiters will fill it
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)src);
-got_m:
-            if (!m) {
-                m = qthread_addrstat_new();
-                if (!m) { return QTHREAD_MALLOC_ERROR; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                qassertnot(qt_hash_put(syncvars[lockbin], (void *)src, m), 0);
-            } else {
-                qthread_addrstat_t *m2;
-                hazardous_ptr(0, m);
-                if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)src))) {
-                    m = m2;
-                    goto got_m;
-                }
-                if (!m->valid) { continue; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                if (!m->valid) {
-                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                    continue;
-                }
-            }
-            break;
-        } while (1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        /* Note that locking the hash table is unnecessary because we have
-         * locked the syncvar itself. */
-        m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)src);
-        assert(m);                 // otherwise, there weren't any waiters
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
-#endif  /* ifdef LOCK_FREE_FEBS */
-        assert(m->EFQ);                           // otherwise there weren't really any waiters
-        assert(m->FFQ == NULL && m->FEQ == NULL); // someone snuck in!
-        if (m->EFQ->next) {                       // there will be a waiter still waiting
-            e.sf = 1;
-        }
-        qthread_debug(SYNCVAR_DETAILS, "m->FEQ = %p, m->FFQ = %p, m->EFQ = %p\n",
-                      m->FEQ, m->FFQ, m->EFQ);
-        // src->u.w = BUILD_UNLOCKED_SYNCVAR(ret, e.sf); // this must be done by gotlock_empty so we know what value to write
-        qthread_syncvar_gotlock_empty(me->rdata->shepherd_ptr, m, src, e.sf);
-        qthread_debug(SYNCVAR_DETAILS, "src(%p) => %x\n", src,
-                      (uintptr_t)BUILD_UNLOCKED_SYNCVAR(ret, e.sf));
+        qthread_syncvar_release_empty(src, w, ret, me->rdata->shepherd_ptr);
     } else {
         assert(e.pf == 0);             // otherwise this isn't really full
-        UNLOCK_THIS_MODIFIED_SYNCVAR(src, ret, SYNCFEB_STATE_EMPTY_NO_WAITERS);
+        qt_syncvar_unlock(src, NULL, ret, SYNCFEB_STATE_EMPTY_NO_WAITERS);
     }
     if (dest) {
         *dest = ret;
@@ -954,178 +935,14 @@ got_m:
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
 
-static QINLINE void qthread_syncvar_schedule(qthread_t          *waiter,
-                                             qthread_shepherd_t *shep)
-{   /*{{{*/
-    assert(waiter);
-    assert(shep);
-    waiter->thread_state = QTHREAD_STATE_RUNNING;
-    QTPERF_QTHREAD_ENTER_STATE(waiter->rdata->performance_data, QTHREAD_STATE_RUNNING);
-    if (waiter->flags & QTHREAD_UNSTEALABLE) {
-        qt_threadqueue_enqueue(waiter->rdata->shepherd_ptr->ready, waiter);
-    } else {
-#ifdef QTHREAD_USE_SPAWNCACHE
-        if (!qt_spawncache_spawn(waiter, shep->ready))
-#endif
-        qt_threadqueue_enqueue(shep->ready, waiter);
-    }
-} /*}}}*/
-
-static QINLINE void qthread_syncvar_remove(void *maddr)
-{   /*{{{*/
-    const int           lockbin = QTHREAD_CHOOSE_STRIPE(maddr);
-    qthread_addrstat_t *m;
-
-    qthread_debug(SYNCVAR_FUNCTIONS, "maddr=%p\n", maddr);
-#ifdef LOCK_FREE_FEBS
-    {
-        qthread_addrstat_t *m2;
-        m = qt_hash_get(syncvars[lockbin], (void *)maddr);
-got_m:
-        if (!m) {
-            qthread_debug(SYNCVAR_DETAILS, "maddr=%p: addrstat already gone; someone else removed it!\n", maddr);
-            return;
-        }
-        hazardous_ptr(0, m);
-        if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)maddr))) {
-            m = m2;
-            goto got_m;
-        }
-        if (!m->valid) {
-            qthread_debug(SYNCVAR_DETAILS, "maddr=%p: addrstat invalid; someone else invalidated it!\n", maddr);
-            return;
-        }
-        QTHREAD_FASTLOCK_LOCK(&m->lock);
-        if (!m->valid) {
-            qthread_debug(SYNCVAR_DETAILS, "maddr=%p: addrstat invalid; someone else invalidated it!\n", maddr);
-            return;
-        }
-        if ((m->FEQ == NULL) && (m->EFQ == NULL) && (m->FFQ == NULL)) {
-            qthread_debug(SYNCVAR_DETAILS, "maddr=%p: all lists are empty\n", maddr);
-            m->valid = 0;
-            qassertnot(qt_hash_remove(syncvars[lockbin], (void *)maddr), 0);
-        } else {
-            QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-            qthread_debug(SYNCVAR_DETAILS, "maddr=%p: address cannot be removed; in use\n", maddr);
-            return;
-        }
-    }
-    assert(m);
-#else /* ifdef LOCK_FREE_FEBS */
-    qt_hash_lock(syncvars[lockbin]);
-    m = (qthread_addrstat_t *)qt_hash_get_locked(syncvars[lockbin], (void *)maddr);
-    if (m) {
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
-        if ((m->FEQ == NULL) && (m->EFQ == NULL) && (m->FFQ == NULL)) {
-            qthread_debug(SYNCVAR_DETAILS, "all lists are empty\n");
-            qt_hash_remove_locked(syncvars[lockbin], (void *)maddr);
-        } else {
-            QTHREAD_FASTLOCK_UNLOCK(&(m->lock));
-            qthread_debug(SYNCVAR_DETAILS, "address cannot be removed; in use\n");
-            m = NULL;
-        }
-    }
-    qt_hash_unlock(syncvars[lockbin]);
-#endif /* ifdef LOCK_FREE_FEBS */
-    if (m != NULL) {
-        QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-#ifdef LOCK_FREE_FEBS
-        hazardous_release_node((hazardous_free_f)qthread_addrstat_delete, m);
-#else
-        qthread_addrstat_delete(m);
-#endif
-    }
-} /*}}}*/
-
-static QINLINE void qthread_syncvar_gotlock_empty(qthread_shepherd_t *shep,
-                                                  qthread_addrstat_t *m,
-                                                  syncvar_t          *maddr,
-                                                  const uint64_t      sf)
-{                                      /*{{{ */
-    qthread_addrres_t *X = NULL;
-    int                removeable;
-
-    qthread_debug(SYNCVAR_DETAILS, "m(%p), addr(%p)\n", m, maddr);
-    m->full = 0;
-    QTHREAD_EMPTY_TIMER_START(m);
-    if (m->EFQ != NULL) {
-        /* dequeue one EFQ, do its operation, and schedule the thread */
-        qthread_debug(SYNCVAR_DETAILS, "dQ 1 EFQ\n");
-        X      = m->EFQ;
-        m->EFQ = X->next;
-        /* op */
-        if (maddr && (maddr != (syncvar_t *)X->addr)) {
-            UNLOCK_THIS_MODIFIED_SYNCVAR(maddr, *((uint64_t *)X->addr), sf);
-        }
-        qthread_syncvar_schedule(X->waiter, shep);
-        FREE_ADDRRES(X);
-    }
-    if ((m->EFQ == NULL) && (m->FEQ == NULL) && (m->FFQ == NULL)) {
-        removeable = 1;
-    } else {
-        removeable = 0;
-    }
-    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-    if (removeable) {
-        qthread_syncvar_remove(maddr);
-    }
-}                                      /*}}} */
-
-static QINLINE void qthread_syncvar_gotlock_fill(qthread_shepherd_t *shep,
-                                                 qthread_addrstat_t *m,
-                                                 syncvar_t          *maddr,
-                                                 const uint64_t      ret)
-{                                      /*{{{ */
-    qthread_addrres_t *X = NULL;
-    int                removeable;
-
-    qthread_debug(SYNCVAR_FUNCTIONS, "m(%p), addr(%p)\n", m, maddr);
-    m->full = 1;
-    QTHREAD_EMPTY_TIMER_STOP(m);
-    /* dequeue all FFQ, do their operation, and schedule them */
-    qthread_debug(SYNCVAR_DETAILS, "dQ all FFQ\n");
-    while (m->FFQ != NULL) {
-        /* dQ */
-        X      = m->FFQ;
-        m->FFQ = X->next;
-        /* op */
-        if (X->addr) {
-            *(uint64_t *)X->addr = ret;
-        }
-        /* schedule */
-        qthread_syncvar_schedule(X->waiter, shep);
-        FREE_ADDRRES(X);
-    }
-    if (m->FEQ != NULL) {
-        /* dequeue one FEQ, do their operation, and reschedule them */
-        qthread_debug(SYNCVAR_DETAILS, "dQ 1 FEQ\n");
-        X      = m->FEQ;
-        m->FEQ = X->next;
-        /* op */
-        if (X->addr) {
-            *(uint64_t *)X->addr = ret;
-        }
-        qthread_syncvar_schedule(X->waiter, shep);
-        FREE_ADDRRES(X);
-    }
-    if ((m->EFQ == NULL) && (m->FEQ == NULL) && (m->FFQ == NULL)) {
-        removeable = 1;
-    } else {
-        removeable = 0;
-    }
-    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-    if (removeable) {
-        qthread_syncvar_remove(maddr);
-    }
-}                                      /*}}} */
-
 int API_FUNC qthread_syncvar_writeF(syncvar_t *restrict      dest,
                                     const uint64_t *restrict src)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
-    eflags_t            e    = { 0, 0, 0, 0, 0 };
-    uint64_t            ret  = *src;
-    qthread_shepherd_t *shep = qthread_internal_getshep();
+    eflags_t              e    = { 0, 0, 0, 0, 0 };
+    uint64_t              ret  = *src;
+    qt_syncvar_waiters_t *w;
+    qthread_shepherd_t   *shep = qthread_internal_getshep();
 
     qassert_ret((*src >> 60) == 0, QTHREAD_OVERFLOW);
 
@@ -1135,59 +952,16 @@ int API_FUNC qthread_syncvar_writeF(syncvar_t *restrict      dest,
         return qthread_syncvar_nonblocker_func(dest, (void *)src, WRITEF);
     }
     QTHREAD_FEB_UNIQUERECORD2(feb, dest, shep);
-    qthread_mwaitc(dest, SYNCFEB_ANY, INT_MAX, &e);
+    (void)qthread_mwaitc(dest, SYNCFEB_ANY, INT_MAX, &e, &w);
     qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
     if ((e.pf == 1) && (e.sf == 1)) {        /* there are waiters to release */
-        const int           lockbin = QTHREAD_CHOOSE_STRIPE(dest);
-        qthread_addrstat_t *m;
-
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-        e.sf = 0;                      // I'm releasing waiters
-        e.pf = 0;                      // I'm going to mark this as full
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)dest);
-got_m:
-            if (!m) {
-                m = qthread_addrstat_new();
-                if (!m) { return QTHREAD_MALLOC_ERROR; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                qassertnot(qt_hash_put(syncvars[lockbin], (void *)dest, m), 0);
-            } else {
-                qthread_addrstat_t *m2;
-                hazardous_ptr(0, m);
-                if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)dest))) {
-                    m = m2;
-                    goto got_m;
-                }
-                if (!m->valid) { continue; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                if (!m->valid) {
-                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                    continue;
-                }
-            }
-            break;
-        } while (1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        /* Note that locking the hash table is unnecessary because we have
-         * locked the syncvar itself. */
-        m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)dest);
-        assert(m);                     // otherwise there weren't really any waiters
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
-#endif  /* ifdef LOCK_FREE_FEBS */
-        if (m->FEQ) {
-            e.pf = 1;                  // back to being empty
-            if (m->FEQ->next) {
-                e.sf = 1;              // only one will be dequeued, so it'll still have waiters
-            }
-        }
-        UNLOCK_THIS_MODIFIED_SYNCVAR(dest, ret, (e.pf << 1) | e.sf);
-        assert(m->FFQ || m->FEQ);      // otherwise there weren't really any waiters
-        assert(m->EFQ == NULL);        // someone snuck in!
-        qthread_syncvar_gotlock_fill(shep, m, dest, ret);
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(dest));
+        qthread_syncvar_release_fill(dest, w, ret, shep);
+    } else if (e.pf == 1) {
+        qt_syncvar_unlock(dest, NULL, ret, SYNCFEB_STATE_FULL_NO_WAITERS);
     } else {
-        UNLOCK_THIS_MODIFIED_SYNCVAR(dest, ret, 0);
+        /* already full; any queued writeEF waiters keep waiting */
+        qt_syncvar_unlock(dest, w, ret, e.sf);
     }
 
     return QTHREAD_SUCCESS;
@@ -1204,9 +978,9 @@ int API_FUNC qthread_syncvar_writeEF(syncvar_t *restrict      dest,
                                      const uint64_t *restrict src)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
-    eflags_t   e = { 0, 0, 0, 0, 0 };
-    const int  lockbin = QTHREAD_CHOOSE_STRIPE(dest);
-    qthread_t *me      = qthread_internal_self();
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    qt_syncvar_waiters_t *w;
+    qthread_t            *me = qthread_internal_self();
     QTHREAD_FEB_TIMER_DECLARATION(febblock);
 
     qassert_ret((*src >> 60) == 0, QTHREAD_OVERFLOW);
@@ -1217,13 +991,11 @@ int API_FUNC qthread_syncvar_writeEF(syncvar_t *restrict      dest,
     }
     QTHREAD_FEB_UNIQUERECORD(feb, dest, me);
     QTHREAD_FEB_TIMER_START(febblock);
-    (void)qthread_mwaitc(dest, SYNCFEB_EMPTY, INITIAL_TIMEOUT, &e);
+    (void)qthread_mwaitc(dest, SYNCFEB_EMPTY, INITIAL_TIMEOUT, &e, &w);
     if (e.cf) {                        /* there was a timeout */
-        QTHREAD_WAIT_TIMER_DECLARATION;
-        qthread_addrstat_t *m;
-        qthread_addrres_t  *X;
+        int      rv;
+        uint64_t ret = qthread_mwaitc(dest, SYNCFEB_ANY, INT_MAX, &e, &w);
 
-        uint64_t ret = qthread_mwaitc(dest, SYNCFEB_ANY, INT_MAX, &e);
         qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
         if (e.pf == 1) {                         /* it got empty! */
             if (e.sf == 1) {                     /* not just empty, but with waiters! */
@@ -1232,133 +1004,25 @@ int API_FUNC qthread_syncvar_writeEF(syncvar_t *restrict      dest,
                 goto locked_empty;
             }
         }
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-        /* Note that locking the hash table is unnecessary because we have
-         * locked the syncvar itself. */
-        qthread_debug(SYNCVAR_DETAILS, "writeEF(c) dest(%p) = %x (queued waiter waiting for empty)\n",
-                      dest, (uintptr_t)BUILD_UNLOCKED_SYNCVAR(ret, SYNCFEB_STATE_FULL_WITH_WAITERS));
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)dest);
-got_m:
-            if (!m) {
-                m = qthread_addrstat_new();
-                if (!m) { return QTHREAD_MALLOC_ERROR; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                qassertnot(qt_hash_put(syncvars[lockbin], (void *)dest, m), 0);
-            } else {
-                qthread_addrstat_t *m2;
-                hazardous_ptr(0, m);
-                if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)dest))) {
-                    m = m2;
-                    goto got_m;
-                }
-                if (!m->valid) { continue; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                if (!m->valid) {
-                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                    continue;
-                }
-            }
-            break;
-        } while (1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        qt_hash_lock(syncvars[lockbin]);
-        m = (qthread_addrstat_t *)qt_hash_get_locked(syncvars[lockbin], (void *)dest);
-        if (!m) {
-            m = qthread_addrstat_new();
-            assert(m);
-            if (!m) { return QTHREAD_MALLOC_ERROR; }
-            qassertnot(qt_hash_put_locked(syncvars[lockbin], (void *)dest, m), 0);
-        }
-        /* lock the addrstat (already within the hash) and then unlock the syncvar */
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
-        qt_hash_unlock(syncvars[lockbin]);
-#endif  /* ifdef LOCK_FREE_FEBS */
-        UNLOCK_THIS_MODIFIED_SYNCVAR(dest, ret, SYNCFEB_STATE_FULL_WITH_WAITERS);
-        X = ALLOC_ADDRRES();
-        assert(X);
-        X->addr   = (aligned_t *)src;
-        X->waiter = me;
-        X->next   = m->EFQ;
-        m->EFQ    = X;
-        qthread_debug(SYNCVAR_DETAILS, ": back to parent\n");
-        me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
-        QTPERF_QTHREAD_ENTER_STATE(me->rdata->performance_data, QTHREAD_STATE_FEB_BLOCKED);
-        me->rdata->blockedon.addr = m;
-        QTHREAD_WAIT_TIMER_START();
-        qthread_back_to_master(me);
-        QTHREAD_WAIT_TIMER_STOP(me, febwait);
-#ifdef QTHREAD_USE_EUREKAS
-        qt_eureka_check(0);
-#endif /* QTHREAD_USE_EUREKAS */
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(dest));
+        qthread_debug(SYNCVAR_DETAILS, "writeEF(c) dest(%p) (queued waiter waiting for empty)\n", dest);
+        rv = qthread_syncvar_enqueue_and_block(dest, w, ret, me, WRITEEF, (void *)src,
+                                               SYNCFEB_STATE_FULL_WITH_WAITERS);
+        if (rv != QTHREAD_SUCCESS) { return rv; }
         qthread_debug(SYNCVAR_DETAILS, "writeEF(%p) woke up\n", dest);
     } else if (e.sf == 1) {            /* there are waiters to release! */
-        qthread_addrstat_t *m;
-
 locked_empty_waiters:
         assert(e.pf == 1);             // otherwise it wasn't really empty
-        e.pf = 0;                      // mark full
-        e.sf = 0;                      // released!
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)dest);
-got_m2:
-            if (!m) {
-                m = qthread_addrstat_new();
-                if (!m) { return QTHREAD_MALLOC_ERROR; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                qassertnot(qt_hash_put(syncvars[lockbin], (void *)dest, m), 0);
-            } else {
-                qthread_addrstat_t *m2;
-                hazardous_ptr(0, m);
-                if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)dest))) {
-                    m = m2;
-                    goto got_m2;
-                }
-                if (!m->valid) { continue; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                if (!m->valid) {
-                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                    continue;
-                }
-            }
-            break;
-        } while (1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        /* Note that locking the hash table is unnecessary because we have
-         * locked the syncvar itself. */
-        m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)dest);
-        assert(m);                     // otherwise there weren't really any waiters
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
-#endif  /* ifdef LOCK_FREE_FEBS */
-        assert(m->FFQ || m->FEQ);      // otherwise there weren't really any waiters
-        assert(m->EFQ == NULL);        // someone snuck in!
-        if (m->FEQ) {
-            e.pf = 1;
-            if (m->FEQ->next) {
-                e.sf = 1;
-            }
-        }
-        qthread_debug(SYNCVAR_DETAILS, "m->FEQ = %p, m->FFQ = %p, m->EFQ = %p\n",
-                      m->FEQ, m->FFQ, m->EFQ);
-        {
-            uint64_t val = *src;
-            UNLOCK_THIS_MODIFIED_SYNCVAR(dest, val, (e.pf << 1) | e.sf);
-            qthread_syncvar_gotlock_fill(me->rdata->shepherd_ptr, m, dest, val);
-            qthread_debug(SYNCVAR_DETAILS, "writeEF(%p) => %x ...1\n", dest,
-                          (uintptr_t)BUILD_UNLOCKED_SYNCVAR(val, (e.pf << 1) | e.sf));
-        }
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(dest));
+        qthread_syncvar_release_fill(dest, w, *src, me->rdata->shepherd_ptr);
+        qthread_debug(SYNCVAR_DETAILS, "writeEF(%p) => %x ...1\n", dest, (uintptr_t)*src);
     } else {
-        uint64_t val;
 locked_empty:
         assert(e.pf == 1);             // otherwise it wasn't really empty
         assert(e.sf == 0);
-        val = *src;
-        // e.pf = 0;                    // now mark it full
-        UNLOCK_THIS_MODIFIED_SYNCVAR(dest, val, SYNCFEB_STATE_FULL_NO_WAITERS);
+        qt_syncvar_unlock(dest, NULL, *src, SYNCFEB_STATE_FULL_NO_WAITERS);
         qthread_debug(SYNCVAR_DETAILS, "writeEF(%p) => %x ...2\n", dest,
-                      (uintptr_t)BUILD_UNLOCKED_SYNCVAR(val, SYNCFEB_STATE_FULL_NO_WAITERS));
+                      (uintptr_t)BUILD_UNLOCKED_SYNCVAR(*src, SYNCFEB_STATE_FULL_NO_WAITERS));
     }
     QTHREAD_FEB_TIMER_STOP(febblock, me);
     return QTHREAD_SUCCESS;
@@ -1374,9 +1038,9 @@ int API_FUNC qthread_syncvar_writeEF_const(syncvar_t *restrict dest,
 int qthread_syncvar_writeEF_nb(syncvar_t *restrict      dest,
                                         const uint64_t *restrict src)
 {                                      /*{{{ */
-    eflags_t   e       = { 0, 0, 0, 0, 0 };
-    const int  lockbin = QTHREAD_CHOOSE_STRIPE(dest);
-    qthread_t *me      = qthread_internal_self();
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    qt_syncvar_waiters_t *w;
+    qthread_t            *me = qthread_internal_self();
 
     qassert_ret((*src >> 60) == 0, QTHREAD_OVERFLOW);
 
@@ -1384,75 +1048,21 @@ int qthread_syncvar_writeEF_nb(syncvar_t *restrict      dest,
     if (!me) {
         return qthread_syncvar_blocker_func(dest, (void *)src, WRITEEF_NB);
     }
-    (void)qthread_mwaitc(dest, SYNCFEB_EMPTY, 1, &e);
+    (void)qthread_mwaitc(dest, SYNCFEB_EMPTY, 1, &e, &w);
     if (e.cf) {                        /* there was a timeout */
         qthread_debug(SYNCVAR_BEHAVIOR, "tid %u non-blocking fail\n", me->thread_id);
         return QTHREAD_OPFAIL;
     } else if (e.sf == 1) {            /* there are waiters to release! */
-        qthread_addrstat_t *m;
-
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
         assert(e.pf == 1);             // otherwise it wasn't really empty
-        e.pf = 0;                      // mark full
-        e.sf = 0;                      // released!
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)dest);
-got_m:
-            if (!m) {
-                m = qthread_addrstat_new();
-                if (!m) { return QTHREAD_MALLOC_ERROR; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                qassertnot(qt_hash_put(syncvars[lockbin], (void *)dest, m), 0);
-            } else {
-                qthread_addrstat_t *m2;
-                hazardous_ptr(0, m);
-                if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)dest))) {
-                    m = m2;
-                    goto got_m;
-                }
-                if (!m->valid) { continue; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                if (!m->valid) {
-                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                    continue;
-                }
-            }
-            break;
-        } while (1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        /* Note that locking the hash table is unnecessary because we have
-         * locked the syncvar itself. */
-        m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)dest);
-        assert(m);                     // otherwise there weren't really any waiters
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
-#endif  /* ifdef LOCK_FREE_FEBS */
-        assert(m->FFQ || m->FEQ);      // otherwise there weren't really any waiters
-        assert(m->EFQ == NULL);        // someone snuck in!
-        if (m->FEQ) {
-            e.pf = 1;
-            if (m->FEQ->next) {
-                e.sf = 1;
-            }
-        }
-        qthread_debug(SYNCVAR_DETAILS, "m->FEQ = %p, m->FFQ = %p, m->EFQ = %p\n",
-                      m->FEQ, m->FFQ, m->EFQ);
-        {
-            uint64_t val = *src;
-            UNLOCK_THIS_MODIFIED_SYNCVAR(dest, val, (e.pf << 1) | e.sf);
-            qthread_syncvar_gotlock_fill(me->rdata->shepherd_ptr, m, dest, val);
-            qthread_debug(SYNCVAR_DETAILS, "writeEF(%p) => %x ...1\n", dest,
-                          (uintptr_t)BUILD_UNLOCKED_SYNCVAR(val, (e.pf << 1) | e.sf));
-        }
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(dest));
+        qthread_syncvar_release_fill(dest, w, *src, me->rdata->shepherd_ptr);
+        qthread_debug(SYNCVAR_DETAILS, "writeEF(%p) => %x ...1\n", dest, (uintptr_t)*src);
     } else {
-        uint64_t val;
         assert(e.pf == 1);             // otherwise it wasn't really empty
         assert(e.sf == 0);
-        val = *src;
-        // e.pf = 0;                    // now mark it full
-        UNLOCK_THIS_MODIFIED_SYNCVAR(dest, val, SYNCFEB_STATE_FULL_NO_WAITERS);
+        qt_syncvar_unlock(dest, NULL, *src, SYNCFEB_STATE_FULL_NO_WAITERS);
         qthread_debug(SYNCVAR_DETAILS, "writeEF(%p) => %x ...2\n", dest,
-                      (uintptr_t)BUILD_UNLOCKED_SYNCVAR(val, SYNCFEB_STATE_FULL_NO_WAITERS));
+                      (uintptr_t)BUILD_UNLOCKED_SYNCVAR(*src, SYNCFEB_STATE_FULL_NO_WAITERS));
     }
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
@@ -1467,9 +1077,10 @@ uint64_t API_FUNC qthread_syncvar_incrF(syncvar_t *restrict operand,
                                         const uint64_t      inc)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
-    eflags_t   e = { 0, 0, 0, 0, 0 };
-    uint64_t   newv;
-    qthread_t *me = qthread_internal_self();
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    uint64_t              newv;
+    qt_syncvar_waiters_t *w;
+    qthread_t            *me = qthread_internal_self();
 
     assert(operand);
     qthread_debug(SYNCVAR_BEHAVIOR, "me(%p), operand(%p), inc(%lu) = %x\n", me,
@@ -1477,64 +1088,143 @@ uint64_t API_FUNC qthread_syncvar_incrF(syncvar_t *restrict operand,
     if (!me) {
         return qthread_syncvar_blocker_func(operand, (void *)&inc, INCR);
     }
-    qthread_mwaitc(operand, SYNCFEB_ANY, INT_MAX, &e);
+    newv = qthread_mwaitc(operand, SYNCFEB_ANY, INT_MAX, &e, &w) + inc;
     qassert_ret(e.cf == 0, QTHREAD_TIMEOUT); /* there better not have been a timeout */
     if ((e.pf == 1) && (e.sf == 1)) {        /* there are waiters to release */
-        const int           lockbin = QTHREAD_CHOOSE_STRIPE(operand);
-        qthread_addrstat_t *m;
+        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, QTHREAD_CHOOSE_STRIPE(operand));
+        qthread_syncvar_release_fill(operand, w, newv, me->rdata->shepherd_ptr);
+    } else {
+        qt_syncvar_unlock(operand, w, newv, (e.pf << 1) | e.sf);
+    }
 
-        QTHREAD_COUNT_THREADS_BINCOUNTER(febs, lockbin);
-        e.sf = 0;                      // I'm releasing waiters
-        e.pf = 0;                      // I'm going to mark this as full
-#ifdef LOCK_FREE_FEBS
-        do {
-            m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)operand);
-got_m:
-            if (!m) {
-                m = qthread_addrstat_new();
-                if (!m) { return QTHREAD_MALLOC_ERROR; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                qassertnot(qt_hash_put(syncvars[lockbin], (void *)operand, m), 0);
-            } else {
-                qthread_addrstat_t *m2;
-                hazardous_ptr(0, m);
-                if (m != (m2 = qt_hash_get(syncvars[lockbin], (void *)operand))) {
-                    m = m2;
-                    goto got_m;
-                }
-                if (!m->valid) { continue; }
-                QTHREAD_FASTLOCK_LOCK(&m->lock);
-                if (!m->valid) {
-                    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
-                    continue;
+    return newv;
+}                                      /*}}} */
+
+typedef enum {
+    SYNCVAR_RMW_ADD,
+    SYNCVAR_RMW_AND,
+    SYNCVAR_RMW_OR,
+    SYNCVAR_RMW_XOR,
+    SYNCVAR_RMW_MIN,
+    SYNCVAR_RMW_MAX,
+    SYNCVAR_RMW_SWAP,
+    SYNCVAR_RMW_CMPXCHG
+} qt_syncvar_rmw_op;
+
+static QINLINE uint64_t qt_syncvar_rmw_apply(const qt_syncvar_rmw_op op,
+                                             const uint64_t          cur,
+                                             const uint64_t          a,
+                                             const uint64_t          b)
+{                                      /*{{{ */
+    switch (op) {
+        case SYNCVAR_RMW_ADD:     return (cur + a) & SYNCVAR_DATA_MASK;
+        case SYNCVAR_RMW_AND:     return cur & a;
+        case SYNCVAR_RMW_OR:      return (cur | a) & SYNCVAR_DATA_MASK;
+        case SYNCVAR_RMW_XOR:     return (cur ^ a) & SYNCVAR_DATA_MASK;
+        case SYNCVAR_RMW_MIN:     return (cur < (a & SYNCVAR_DATA_MASK)) ? cur : (a & SYNCVAR_DATA_MASK);
+        case SYNCVAR_RMW_MAX:     return (cur > (a & SYNCVAR_DATA_MASK)) ? cur : (a & SYNCVAR_DATA_MASK);
+        case SYNCVAR_RMW_SWAP:    return a & SYNCVAR_DATA_MASK;
+        case SYNCVAR_RMW_CMPXCHG: return (cur == (a & SYNCVAR_DATA_MASK)) ? (b & SYNCVAR_DATA_MASK) : cur;
+    }
+    QTHREAD_TRAP();
+    return cur;
+}                                      /*}}} */
+
+/* Waits for operand to be full, then replaces its value with op(value) and
+ * returns the old one. The syncvar stays full throughout, so none of its
+ * waiters are disturbed. When it is full with no waiters (the common case),
+ * this is a single CAS on the syncvar word; the lock is only taken when
+ * writeEF waiters are parking the value in their record. */
+static uint64_t qt_syncvar_rmw(syncvar_t *restrict     operand,
+                               const qt_syncvar_rmw_op op,
+                               const uint64_t          a,
+                               const uint64_t          b)
+{                                      /*{{{ */
+    assert(qthread_library_initialized);
+    assert(operand);
+    qthread_debug(SYNCVAR_CALLS, "operand(%p), op(%i), a(%lu), b(%lu)\n", operand,
+                  (int)op, (unsigned long)a, (unsigned long)b);
+    do {
+        syncvar_t cur = *operand;
+
+        if (cur.u.s.lock == 0) {
+            if (cur.u.s.state == SYNCFEB_STATE_FULL_NO_WAITERS) {
+                const uint64_t old  = cur.u.s.data;
+                const uint64_t newv = qt_syncvar_rmw_apply(op, old, a, b);
+
+                if (qthread_cas64(&operand->u.w, cur.u.w,
+                                  BUILD_UNLOCKED_SYNCVAR(newv, SYNCFEB_STATE_FULL_NO_WAITERS)) == cur.u.w) {
+                    return old;
                 }
+                continue;
             }
-            break;
-        } while (1);
-#else   /* ifdef LOCK_FREE_FEBS */
-        /* Note that locking the hash table is unnecessary because we have
-         * locked the syncvar itself. */
-        m = (qthread_addrstat_t *)qt_hash_get(syncvars[lockbin], (void *)operand);
-        assert(m);                     // otherwise there weren't really any waiters
-        QTHREAD_FASTLOCK_LOCK(&(m->lock));
-#endif  /* ifdef LOCK_FREE_FEBS */
-        if (m->FEQ) {
-            e.pf = 1;                  // back to being empty
-            if (m->FEQ->next) {
-                e.sf = 1;              // only one will be dequeued, so it'll still have waiters
+            if (cur.u.s.state & 2) {
+                /* empty; wait for someone to fill it and try again */
+                qthread_syncvar_readFF(NULL, operand);
+                continue;
             }
         }
-        newv = operand->u.s.data + inc;
-        UNLOCK_THIS_MODIFIED_SYNCVAR(operand, newv, (e.pf << 1) | e.sf);
-        assert(m->FFQ || m->EFQ);      // otherwise there weren't really any waiters
-        assert(m->FEQ == NULL);        // someone snuck in!
-        qthread_syncvar_gotlock_fill(me->rdata->shepherd_ptr, m, operand, newv);
-    } else {
-        newv = operand->u.s.data + inc;
-        UNLOCK_THIS_MODIFIED_SYNCVAR(operand, newv, (e.pf << 1) | e.sf);
-    }
+        {
+            eflags_t              e = { 0, 0, 0, 0, 0 };
+            qt_syncvar_waiters_t *w;
+            const uint64_t        old = qthread_mwaitc(operand, SYNCFEB_FULL, INITIAL_TIMEOUT, &e, &w);
+
+            if (e.cf == 0) {
+                assert(e.pf == 0);
+                qt_syncvar_unlock(operand, w, qt_syncvar_rmw_apply(op, old, a, b), e.sf);
+                return old;
+            }
+        }
+    } while (1);
+}                                      /*}}} */
 
-    return newv;
+uint64_t API_FUNC qthread_syncvar_fetch_addF(syncvar_t *restrict operand,
+                                             const uint64_t      val)
+{                                      /*{{{ */
+    return qt_syncvar_rmw(operand, SYNCVAR_RMW_ADD, val, 0);
+}                                      /*}}} */
+
+uint64_t API_FUNC qthread_syncvar_fetch_andF(syncvar_t *restrict operand,
+                                             const uint64_t      val)
+{                                      /*{{{ */
+    return qt_syncvar_rmw(operand, SYNCVAR_RMW_AND, val, 0);
+}                                      /*}}} */
+
+uint64_t API_FUNC qthread_syncvar_fetch_orF(syncvar_t *restrict operand,
+                                            const uint64_t      val)
+{                                      /*{{{ */
+    return qt_syncvar_rmw(operand, SYNCVAR_RMW_OR, val, 0);
+}                                      /*}}} */
+
+uint64_t API_FUNC qthread_syncvar_fetch_xorF(syncvar_t *restrict operand,
+                                             const uint64_t      val)
+{                                      /*{{{ */
+    return qt_syncvar_rmw(operand, SYNCVAR_RMW_XOR, val, 0);
+}                                      /*}}} */
+
+uint64_t API_FUNC qthread_syncvar_fetch_minF(syncvar_t *restrict operand,
+                                             const uint64_t      val)
+{                                      /*{{{ */
+    return qt_syncvar_rmw(operand, SYNCVAR_RMW_MIN, val, 0);
+}                                      /*}}} */
+
+uint64_t API_FUNC qthread_syncvar_fetch_maxF(syncvar_t *restrict operand,
+                                             const uint64_t      val)
+{                                      /*{{{ */
+    return qt_syncvar_rmw(operand, SYNCVAR_RMW_MAX, val, 0);
+}                                      /*}}} */
+
+uint64_t API_FUNC qthread_syncvar_swapF(syncvar_t *restrict operand,
+                                        const uint64_t      val)
+{                                      /*{{{ */
+    return qt_syncvar_rmw(operand, SYNCVAR_RMW_SWAP, val, 0);
+}                                      /*}}} */
+
+uint64_t API_FUNC qthread_syncvar_cmpxchgF(syncvar_t *restrict operand,
+                                           const uint64_t      oldval,
+                                           const uint64_t      newval)
+{                                      /*{{{ */
+    return qt_syncvar_rmw(operand, SYNCVAR_RMW_CMPXCHG, oldval, newval);
 }                                      /*}}} */
 
 static filter_code qt_syncvar_tf_call_cb(const qt_key_t            addr,
@@ -1580,9 +1270,9 @@ static void qt_syncvar_call_tf(const qt_key_t      addr,
             case 1: curs = m->FEQ; base = &m->FEQ; break;
             case 2: curs = m->FFQ; base = &m->FFQ; break;
         }
-        for (; curs != NULL; curs = curs->next) {
+        for (qthread_addrres_t *next; curs != NULL; curs = next) {
             qthread_t *waiter = curs->waiter;
-            void      *tls;
+            next = curs->next;
             switch(tf(addr, waiter, f_arg)) {
                 case 0: // ignore, move to the next one
                     base = &curs->next;
@@ -1592,7 +1282,7 @@ static void qt_syncvar_call_tf(const qt_key_t      addr,
 #ifdef QTHREAD_USE_EUREKAS
                     qthread_internal_assassinate(waiter);
 #endif /* QTHREAD_USE_EUREKAS */
-                    *base = curs->next;
+                    *base = next;
                     FREE_ADDRRES(curs);
                     break;
                 }
@@ -1606,14 +1296,102 @@ static void qt_syncvar_call_tf(const qt_key_t      addr,
     }
 } /*}}}*/
 
+/* Puts a syncvar whose waiters have all been removed back into the matching
+ * "no waiters" state, and frees its record. */
+static void qt_syncvar_reset_emptied(syncvar_t *addr)
+{   /*{{{*/
+    eflags_t              e = { 0, 0, 0, 0, 0 };
+    qt_syncvar_waiters_t *w;
+    uint64_t              val;
+    unsigned int          state;
+
+    val   = qthread_mwaitc(addr, 0xff, INT_MAX, &e, &w);
+    state = (e.of << 2) | (e.pf << 1) | e.sf;
+    if (w == NULL) {
+        /* a release got there first */
+        qt_syncvar_unlock(addr, NULL, val, state);
+        return;
+    }
+    QTHREAD_FASTLOCK_LOCK(&w->m.lock);
+    if (w->m.EFQ || w->m.FEQ || w->m.FFQ) {
+        /* someone has started waiting since */
+        QTHREAD_FASTLOCK_UNLOCK(&w->m.lock);
+        qt_syncvar_unlock(addr, w, val, state);
+        return;
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&w->m.lock);
+    qt_syncvar_unlock(addr, NULL, val, state & ~1U);
+    qt_syncvar_waiters_delete(w);
+} /*}}}*/
+
+/* The serial taskfilter runs while every other worker is stopped, perhaps
+ * with a syncvar locked, so it resets the syncvars it emptied without locking
+ * them, and leaves alone any that are locked; whoever holds one copes with an
+ * empty record when it releases it. The registry must be locked. */
+static void qt_syncvar_registry_reset_serial(qt_syncvar_registry_t *r)
+{   /*{{{*/
+    qt_syncvar_waiters_t *next;
+
+    for (qt_syncvar_waiters_t *w = r->head; w != NULL; w = next) {
+        const syncvar_t cur = *w->addr;
+
+        next = w->next;
+        if (w->m.EFQ || w->m.FEQ || w->m.FFQ || cur.u.s.lock ||
+            !(cur.u.s.state & 1) || (SYNCVAR_WAITERS(cur.u.s.data) != w)) {
+            continue;
+        }
+        w->addr->u.w = BUILD_UNLOCKED_SYNCVAR(w->data, cur.u.s.state & ~1U);
+        qt_syncvar_waiters_unlink(r, w);
+        qt_syncvar_waiters_free(w);
+    }
+} /*}}}*/
+
+#define QT_SYNCVAR_RESET_BATCH 64
+
+static void qt_syncvar_registry_call_tf(void **pass)
+{   /*{{{*/
+    const uintptr_t sync = (uintptr_t)pass[2];
+
+    for (qthread_shepherd_id_t i = 0; i < waiter_registry_count; i++) {
+        qt_syncvar_registry_t *r = &waiter_registry[i];
+        syncvar_t             *emptied[QT_SYNCVAR_RESET_BATCH];
+        size_t                 n;
+
+        QTHREAD_FASTLOCK_LOCK(&r->lock);
+        for (qt_syncvar_waiters_t *w = r->head; w != NULL; w = w->next) {
+            qt_syncvar_call_tf(w->addr, &w->m, pass);
+        }
+        if (!sync) {
+            qt_syncvar_registry_reset_serial(r);
+            QTHREAD_FASTLOCK_UNLOCK(&r->lock);
+            continue;
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&r->lock);
+        /* syncvars are locked before the registry, so the ones the filter
+         * left without waiters are collected and reset afterward; each reset
+         * takes its record out of the registry */
+        do {
+            n = 0;
+            QTHREAD_FASTLOCK_LOCK(&r->lock);
+            for (qt_syncvar_waiters_t *w = r->head; w != NULL && n < QT_SYNCVAR_RESET_BATCH; w = w->next) {
+                QTHREAD_FASTLOCK_LOCK(&w->m.lock);
+                if (!w->m.EFQ && !w->m.FEQ && !w->m.FFQ) { emptied[n++] = w->addr; }
+                QTHREAD_FASTLOCK_UNLOCK(&w->m.lock);
+            }
+            QTHREAD_FASTLOCK_UNLOCK(&r->lock);
+            for (size_t j = 0; j < n; j++) {
+                qt_syncvar_reset_emptied(emptied[j]);
+            }
+        } while (n == QT_SYNCVAR_RESET_BATCH);
+    }
+} /*}}}*/
+
 void INTERNAL qthread_syncvar_taskfilter_serial(qt_syncvar_taskfilter_f tf,
                                                 void                   *arg)
 {   /*{{{*/
     void *pass[3] = { tf, arg, NULL };
 
-    for (unsigned int i = 0; i < QTHREAD_LOCKING_STRIPES; i++) {
-        qt_hash_callback(syncvars[i], (qt_hash_callback_fn)qt_syncvar_call_tf, pass);
-    }
+    qt_syncvar_registry_call_tf(pass);
 } /*}}}*/
 
 void INTERNAL qthread_syncvar_taskfilter(qt_syncvar_taskfilter_f tf,
@@ -1621,9 +1399,7 @@ void INTERNAL qthread_syncvar_taskfilter(qt_syncvar_taskfilter_f tf,
 {   /*{{{*/
     void *pass[3] = { tf, arg, (void *)(uintptr_t)1 };
 
-    for (unsigned int i = 0; i < QTHREAD_LOCKING_STRIPES; i++) {
-        qt_hash_callback(syncvars[i], (qt_hash_callback_fn)qt_syncvar_call_tf, pass);
-    }
+    qt_syncvar_registry_call_tf(pass);
 } /*}}}*/
 
 void API_FUNC qthread_syncvar_callback(qt_syncvar_callback_f cb,
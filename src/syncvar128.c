@@ -0,0 +1,671 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <qthread/performance.h>
+
+/* System Headers */
+#include <pthread.h>
+#include <qthread/qthread-int.h>       /* for uint64_t */
+
+/* API Headers */
+#include "qthread/qthread.h"
+
+/* Internal Headers */
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qthread_innards.h"
+#include "qt_initialized.h" // for qthread_library_initialized
+#include "qt_profiling.h"
+#include "qt_feb_profile.h"
+#include "qt_blocking_structs.h"
+#include "qt_addrstat.h"
+#include "qt_qthread_struct.h"
+#include "qt_qthread_mgmt.h"
+#include "qt_threadqueues.h"
+#include "qt_debug.h"
+#ifdef QTHREAD_USE_EUREKAS
+#include "qt_eurekas.h"
+#endif /* QTHREAD_USE_EUREKAS */
+
+/* The 128-bit syncvar is laid out as two 64-bit words: the data word, which is
+ * never stolen from, and the state word, which is encoded as:
+ *
+ *   bit 0     - lock
+ *   bits 1-2  - FEB state (same encoding as the 64-bit syncvar)
+ *   bits 4-63 - pointer to the addrstat recording blocked waiters (or NULL)
+ *
+ * Addrstats come from a pool with at least 16-byte alignment, so the low four
+ * bits of the pointer are always free. Keeping the waiter record inline means
+ * blocked 128-bit syncvars never touch the syncvar hash tables.
+ *
+ * Transitions that do not involve waiters are a single double-width CAS.
+ * Anything that has to queue or release waiters sets the lock bit (again with
+ * a double-width CAS), which excludes every other transition until it is
+ * cleared. */
+
+/* state 0: full, no waiters
+ * state 1: full, queued waiters (who are waiting for it to be empty)
+ * state 2: empty, no waiters
+ * state 3: empty, queued waiters (who are waiting for it to be full)
+ */
+#define SYNCFEB_STATE_FULL_NO_WAITERS    0x0
+#define SYNCFEB_STATE_FULL_WITH_WAITERS  0x1
+#define SYNCFEB_STATE_EMPTY_NO_WAITERS   0x2
+#define SYNCFEB_STATE_EMPTY_WITH_WAITERS 0x3
+
+#define SV128_LOCK_BIT                   ((uint64_t)0x1)
+#define SV128_WAITERS_MASK               (~(uint64_t)0xf)
+#define SV128_STATE(w)                   (((w) >> 1) & 0x3)
+#define SV128_WAITERS(w)                 ((qthread_addrstat_t *)(uintptr_t)((w) & SV128_WAITERS_MASK))
+#define SV128_IS_LOCKED(w)               ((w) & SV128_LOCK_BIT)
+#define SV128_IS_EMPTY(w)                (SV128_STATE(w) & 0x2)
+#define BUILD_UNLOCKED_SYNCVAR128(m, state) \
+    ((uint64_t)(uintptr_t)(m) | ((uint64_t)(state) << 1))
+
+typedef enum bt {
+    WRITEEF,
+    WRITEF,
+    READFF,
+    READFE,
+    FILL,
+    EMPTY,
+    INCR
+} blocker_type;
+typedef struct {
+    pthread_mutex_t lock;
+    void           *a;
+    void           *b;
+    blocker_type    type;
+    int             retval;
+} qthread_syncvar128_blocker_t;
+
+#ifndef QTHREAD_ATOMIC_CAS128
+/* Without a double-width CAS, every access to a 128-bit syncvar goes through
+ * one of a handful of striped locks instead. */
+# define SV128_CAS_STRIPES 32
+# define SV128_CHOOSE_STRIPE(addr) (((uintptr_t)(addr) >> 4) & (SV128_CAS_STRIPES - 1))
+static pthread_mutex_t sv128_cas_locks[SV128_CAS_STRIPES] = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER
+};
+#endif /* ifndef QTHREAD_ATOMIC_CAS128 */
+
+/* Atomically compares *v against *expected and, if equal, replaces it with
+ * *newv. On failure, *expected is updated with the current contents. */
+static QINLINE int qt_sv128_cas(syncvar128_t *const restrict       v,
+                                syncvar128_t *const restrict       expected,
+                                const syncvar128_t *const restrict newv)
+{   /*{{{*/
+#ifdef QTHREAD_ATOMIC_CAS128
+    return qt_cas128((uint64_t *)v, (uint64_t *)expected, (const uint64_t *)newv);
+
+#else
+    pthread_mutex_t *const l = &sv128_cas_locks[SV128_CHOOSE_STRIPE(v)];
+    int                    ret;
+
+    qassert(pthread_mutex_lock(l), 0);
+    if ((v->data == expected->data) && (v->state == expected->state)) {
+        *v  = *newv;
+        ret = 1;
+    } else {
+        *expected = *v;
+        ret       = 0;
+    }
+    qassert(pthread_mutex_unlock(l), 0);
+    return ret;
+#endif /* ifdef QTHREAD_ATOMIC_CAS128 */
+} /*}}}*/
+
+/* Atomic 128-bit read: a CAS that (almost always) fails. If it happens to
+ * succeed, it wrote back exactly what was there, so nothing changed. */
+static QINLINE void qt_sv128_snapshot(syncvar128_t *const restrict v,
+                                      syncvar128_t *const restrict out)
+{   /*{{{*/
+    const syncvar128_t zero = { 0, 0 };
+
+    *out = zero;
+    (void)qt_sv128_cas(v, out, &zero);
+} /*}}}*/
+
+/* Spins until the lock bit is set; on return, *out holds the unlocked value
+ * that the syncvar had when it was locked. */
+static QINLINE void qt_sv128_lock(syncvar128_t *const restrict v,
+                                  syncvar128_t *const restrict out)
+{   /*{{{*/
+    syncvar128_t locked;
+
+    qt_sv128_snapshot(v, out);
+    do {
+        if (SV128_IS_LOCKED(out->state)) {
+            SPINLOCK_BODY();
+            qt_sv128_snapshot(v, out);
+            continue;
+        }
+        locked.data  = out->data;
+        locked.state = out->state | SV128_LOCK_BIT;
+        if (qt_sv128_cas(v, out, &locked)) { break; }
+    } while (1);
+} /*}}}*/
+
+/* Only the lock holder may call this, and since nobody else can change a
+ * locked syncvar, the CAS cannot fail. */
+static QINLINE void qt_sv128_unlock(syncvar128_t *const restrict v,
+                                    const syncvar128_t *const    locked,
+                                    const uint64_t               data,
+                                    const uint64_t               state)
+{   /*{{{*/
+    syncvar128_t expected = *locked;
+    syncvar128_t unlocked = { data, state };
+
+    expected.state |= SV128_LOCK_BIT;
+    assert(!SV128_IS_LOCKED(state));
+    qassertnot(qt_sv128_cas(v, &expected, &unlocked), 0);
+} /*}}}*/
+
+static aligned_t qthread_syncvar128_blocker_thread(void *arg)
+{                                      /*{{{ */
+    qthread_syncvar128_blocker_t *const restrict a = (qthread_syncvar128_blocker_t *)arg;
+
+    switch (a->type) {
+        case READFE: a->retval  = qthread_syncvar128_readFE(a->a, a->b); break;
+        case READFF: a->retval  = qthread_syncvar128_readFF(a->a, a->b); break;
+        case WRITEEF: a->retval = qthread_syncvar128_writeEF(a->a, a->b); break;
+        case WRITEF: a->retval  = qthread_syncvar128_writeF(a->a, a->b); break;
+        case FILL: a->retval    = qthread_syncvar128_fill(a->a); break;
+        case EMPTY: a->retval   = qthread_syncvar128_empty(a->a); break;
+        case INCR: *(uint64_t *)a->b = qthread_syncvar128_incrF(a->a, *(uint64_t *)a->b); break;
+    }
+    pthread_mutex_unlock(&(a->lock));
+    return 0;
+}                                      /*}}} */
+
+static int qthread_syncvar128_blocker_func(void        *dest,
+                                           void        *src,
+                                           blocker_type t)
+{   /*{{{*/
+    qthread_syncvar128_blocker_t args = { PTHREAD_MUTEX_INITIALIZER, dest, src, t, QTHREAD_SUCCESS };
+
+    pthread_mutex_lock(&args.lock);
+    qthread_fork(qthread_syncvar128_blocker_thread, &args, NULL);
+    pthread_mutex_lock(&args.lock);
+    pthread_mutex_unlock(&args.lock);
+    pthread_mutex_destroy(&args.lock);
+    return args.retval;
+} /*}}}*/
+
+static QINLINE void qthread_syncvar128_schedule(qthread_t          *waiter,
+                                                qthread_shepherd_t *shep)
+{   /*{{{*/
+    assert(waiter);
+    assert(shep);
+    waiter->thread_state = QTHREAD_STATE_RUNNING;
+    QTPERF_QTHREAD_ENTER_STATE(waiter->rdata->performance_data, QTHREAD_STATE_RUNNING);
+    if (waiter->flags & QTHREAD_UNSTEALABLE) {
+        qt_threadqueue_enqueue(waiter->rdata->shepherd_ptr->ready, waiter);
+    } else {
+#ifdef QTHREAD_USE_SPAWNCACHE
+        if (!qt_spawncache_spawn(waiter, shep->ready))
+#endif
+        qt_threadqueue_enqueue(shep->ready, waiter);
+    }
+} /*}}}*/
+
+/* Must be called with the syncvar locked (*locked being its unlocked value).
+ * Queues the caller on one of the waiter lists and unlocks the syncvar into
+ * the given state, then blocks until a matching transition wakes it up. */
+static int qthread_syncvar128_enqueue_and_block(syncvar128_t *const restrict       v,
+                                                const syncvar128_t *const restrict locked,
+                                                qthread_t *const restrict          me,
+                                                const int                          queue,
+                                                void                              *addr,
+                                                const uint64_t                     state)
+{   /*{{{*/
+    QTHREAD_WAIT_TIMER_DECLARATION;
+    qthread_addrstat_t *m = SV128_WAITERS(locked->state);
+    qthread_addrres_t  *X;
+
+    if (!m) {
+        m = qthread_addrstat_new();
+        if (!m) {
+            qt_sv128_unlock(v, locked, locked->data, locked->state);
+            return QTHREAD_MALLOC_ERROR;
+        }
+        assert(((uintptr_t)m & ~SV128_WAITERS_MASK) == 0);
+    }
+    X = ALLOC_ADDRRES();
+    if (!X) {
+        if (!SV128_WAITERS(locked->state)) { qthread_addrstat_delete(m); }
+        qt_sv128_unlock(v, locked, locked->data, locked->state);
+        return QTHREAD_MALLOC_ERROR;
+    }
+    X->addr   = (aligned_t *)addr;
+    X->waiter = me;
+    /* The addrstat lock is held until this thread has been swapped out; the
+     * shepherd unlocks it, so nobody can wake me up before I'm asleep. */
+    QTHREAD_FASTLOCK_LOCK(&m->lock);
+    switch (queue) {
+        case READFF:  X->next = m->FFQ; m->FFQ = X; break;
+        case READFE:  X->next = m->FEQ; m->FEQ = X; break;
+        case WRITEEF: X->next = m->EFQ; m->EFQ = X; break;
+        default: QTHREAD_TRAP();
+    }
+    qt_sv128_unlock(v, locked, locked->data, BUILD_UNLOCKED_SYNCVAR128(m, state));
+    qthread_debug(SYNCVAR_DETAILS, "v(%p) back to parent\n", v);
+    me->thread_state          = QTHREAD_STATE_FEB_BLOCKED;
+    QTPERF_QTHREAD_ENTER_STATE(me->rdata->performance_data, QTHREAD_STATE_FEB_BLOCKED);
+    me->rdata->blockedon.addr = m;
+    QTHREAD_WAIT_TIMER_START();
+    QTHREAD_FEB_PROFILE_START(me);
+    qthread_back_to_master(me);
+    QTHREAD_WAIT_TIMER_STOP(me, febwait);
+    QTHREAD_FEB_PROFILE_STOP(v, me);
+#ifdef QTHREAD_USE_EUREKAS
+    qt_eureka_check(0);
+#endif /* QTHREAD_USE_EUREKAS */
+    qthread_debug(SYNCVAR_DETAILS, "v(%p) woke up\n", v);
+    return QTHREAD_SUCCESS;
+} /*}}}*/
+
+/* Must be called with the syncvar locked and empty with waiters. Fills it with
+ * val: every readFF waiter gets val, and then at most one readFE waiter
+ * consumes it (leaving the syncvar empty again). Unlocks the syncvar. */
+static void qthread_syncvar128_release_fill(syncvar128_t *const restrict       v,
+                                            const syncvar128_t *const restrict locked,
+                                            const uint64_t                     val)
+{   /*{{{*/
+    qthread_addrstat_t *m    = SV128_WAITERS(locked->state);
+    qthread_shepherd_t *shep = qthread_internal_getshep();
+    qthread_addrres_t  *ffq, *fe;
+    int                 still_waiting;
+    uint64_t            state;
+
+    assert(m);
+    assert(SV128_STATE(locked->state) == SYNCFEB_STATE_EMPTY_WITH_WAITERS);
+    QTHREAD_FASTLOCK_LOCK(&m->lock);
+    assert(m->EFQ == NULL);            // someone snuck in!
+    ffq    = m->FFQ;
+    m->FFQ = NULL;
+    fe     = m->FEQ;
+    if (fe) {
+        m->FEQ = fe->next;
+    }
+    still_waiting = (m->FEQ != NULL);
+    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+    if (still_waiting) {
+        state = BUILD_UNLOCKED_SYNCVAR128(m, SYNCFEB_STATE_EMPTY_WITH_WAITERS);
+    } else {
+        qthread_addrstat_delete(m);
+        state = fe ? BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_EMPTY_NO_WAITERS)
+                : BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_FULL_NO_WAITERS);
+    }
+    qt_sv128_unlock(v, locked, val, state);
+    /* the waiters are no longer reachable from the syncvar, so they can be
+     * woken without holding any locks */
+    while (ffq) {
+        qthread_addrres_t *X = ffq;
+        ffq = X->next;
+        if (X->addr) { *(uint64_t *)X->addr = val; }
+        qthread_syncvar128_schedule(X->waiter, shep);
+        FREE_ADDRRES(X);
+    }
+    if (fe) {
+        if (fe->addr) { *(uint64_t *)fe->addr = val; }
+        qthread_syncvar128_schedule(fe->waiter, shep);
+        FREE_ADDRRES(fe);
+    }
+} /*}}}*/
+
+/* Must be called with the syncvar locked and full with waiters. Empties it,
+ * which immediately lets one writeEF waiter fill it again. Unlocks the
+ * syncvar. */
+static void qthread_syncvar128_release_empty(syncvar128_t *const restrict       v,
+                                             const syncvar128_t *const restrict locked)
+{   /*{{{*/
+    qthread_addrstat_t *m = SV128_WAITERS(locked->state);
+    qthread_addrres_t  *X;
+    int                 still_waiting;
+    uint64_t            state;
+    uint64_t            val;
+
+    assert(m);
+    assert(SV128_STATE(locked->state) == SYNCFEB_STATE_FULL_WITH_WAITERS);
+    QTHREAD_FASTLOCK_LOCK(&m->lock);
+    assert(m->EFQ);                           // otherwise there weren't really any waiters
+    assert(m->FFQ == NULL && m->FEQ == NULL); // someone snuck in!
+    X             = m->EFQ;
+    m->EFQ        = X->next;
+    still_waiting = (m->EFQ != NULL);
+    QTHREAD_FASTLOCK_UNLOCK(&m->lock);
+    val = *(uint64_t *)X->addr;
+    if (still_waiting) {
+        state = BUILD_UNLOCKED_SYNCVAR128(m, SYNCFEB_STATE_FULL_WITH_WAITERS);
+    } else {
+        qthread_addrstat_delete(m);
+        state = BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_FULL_NO_WAITERS);
+    }
+    qt_sv128_unlock(v, locked, val, state);
+    qthread_syncvar128_schedule(X->waiter, qthread_internal_getshep());
+    FREE_ADDRRES(X);
+} /*}}}*/
+
+int API_FUNC qthread_syncvar128_status(syncvar128_t *const v)
+{                                      /*{{{ */
+    syncvar128_t snap;
+
+    assert(v);
+    /* the lock bit does not change the recorded state, so the snapshot is
+     * accurate whether or not someone is holding the lock */
+    qt_sv128_snapshot(v, &snap);
+    return SV128_IS_EMPTY(snap.state) ? 0 : 1;
+}                                      /*}}} */
+
+int API_FUNC qthread_syncvar128_readFF(uint64_t *restrict     dest,
+                                       syncvar128_t *restrict src)
+{                                      /*{{{ */
+    assert(qthread_library_initialized);
+    syncvar128_t snap;
+    uint64_t     ret;
+    qthread_t   *me = qthread_internal_self();
+    QTHREAD_FEB_TIMER_DECLARATION(febblock);
+
+    assert(src);
+    qthread_debug(SYNCVAR_CALLS, "me(%p), dest(%p), src(%p)\n", me, dest, src);
+    if (!me) {
+        return qthread_syncvar128_blocker_func(dest, src, READFF);
+    }
+
+    qt_sv128_snapshot(src, &snap);
+    if (!SV128_IS_LOCKED(snap.state) && !SV128_IS_EMPTY(snap.state)) {
+        /* short-circuit */
+        if (dest) { *dest = snap.data; }
+        return QTHREAD_SUCCESS;
+    }
+    QTHREAD_FEB_UNIQUERECORD(feb, src, me);
+    QTHREAD_FEB_TIMER_START(febblock);
+    qt_sv128_lock(src, &snap);
+    if (SV128_IS_EMPTY(snap.state)) {
+        int rv = qthread_syncvar128_enqueue_and_block(src, &snap, me, READFF, &ret,
+                                                      SYNCFEB_STATE_EMPTY_WITH_WAITERS);
+        if (rv != QTHREAD_SUCCESS) { return rv; }
+    } else {
+        ret = snap.data;
+        qt_sv128_unlock(src, &snap, snap.data, snap.state);
+    }
+    if (dest) { *dest = ret; }
+    QTHREAD_FEB_TIMER_STOP(febblock, me);
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+int API_FUNC qthread_syncvar128_readFE(uint64_t *restrict     dest,
+                                       syncvar128_t *restrict src)
+{                                      /*{{{ */
+    assert(qthread_library_initialized);
+    syncvar128_t snap;
+    uint64_t     ret;
+    qthread_t   *me = qthread_internal_self();
+    QTHREAD_FEB_TIMER_DECLARATION(febblock);
+
+    assert(src);
+    qthread_debug(SYNCVAR_CALLS, "me(%p), dest(%p), src(%p)\n", me, dest, src);
+    if (!me) {
+        return qthread_syncvar128_blocker_func(dest, src, READFE);
+    }
+
+    qt_sv128_snapshot(src, &snap);
+    while (snap.state == BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_FULL_NO_WAITERS)) {
+        const syncvar128_t emptied = { snap.data, BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_EMPTY_NO_WAITERS) };
+        if (qt_sv128_cas(src, &snap, &emptied)) {
+            if (dest) { *dest = snap.data; }
+            return QTHREAD_SUCCESS;
+        }
+    }
+    QTHREAD_FEB_UNIQUERECORD(feb, src, me);
+    QTHREAD_FEB_TIMER_START(febblock);
+    qt_sv128_lock(src, &snap);
+    switch (SV128_STATE(snap.state)) {
+        case SYNCFEB_STATE_FULL_NO_WAITERS:
+            ret = snap.data;
+            qt_sv128_unlock(src, &snap, snap.data,
+                            BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_EMPTY_NO_WAITERS));
+            break;
+        case SYNCFEB_STATE_FULL_WITH_WAITERS:
+            ret = snap.data;
+            qthread_syncvar128_release_empty(src, &snap);
+            break;
+        default:
+        {
+            int rv = qthread_syncvar128_enqueue_and_block(src, &snap, me, READFE, &ret,
+                                                          SYNCFEB_STATE_EMPTY_WITH_WAITERS);
+            if (rv != QTHREAD_SUCCESS) { return rv; }
+            break;
+        }
+    }
+    if (dest) { *dest = ret; }
+    QTHREAD_FEB_TIMER_STOP(febblock, me);
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+int API_FUNC qthread_syncvar128_writeEF(syncvar128_t *restrict   dest,
+                                        const uint64_t *restrict src)
+{                                      /*{{{ */
+    assert(qthread_library_initialized);
+    syncvar128_t snap;
+    qthread_t   *me = qthread_internal_self();
+    QTHREAD_FEB_TIMER_DECLARATION(febblock);
+
+    assert(dest);
+    assert(src);
+    qthread_debug(SYNCVAR_CALLS, "me(%p), dest(%p), src(%p)\n", me, dest, src);
+    if (!me) {
+        return qthread_syncvar128_blocker_func(dest, (void *)src, WRITEEF);
+    }
+
+    qt_sv128_snapshot(dest, &snap);
+    while (snap.state == BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_EMPTY_NO_WAITERS)) {
+        const syncvar128_t filled = { *src, BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_FULL_NO_WAITERS) };
+        if (qt_sv128_cas(dest, &snap, &filled)) {
+            return QTHREAD_SUCCESS;
+        }
+    }
+    QTHREAD_FEB_UNIQUERECORD(feb, dest, me);
+    QTHREAD_FEB_TIMER_START(febblock);
+    qt_sv128_lock(dest, &snap);
+    switch (SV128_STATE(snap.state)) {
+        case SYNCFEB_STATE_EMPTY_NO_WAITERS:
+            qt_sv128_unlock(dest, &snap, *src,
+                            BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_FULL_NO_WAITERS));
+            break;
+        case SYNCFEB_STATE_EMPTY_WITH_WAITERS:
+            qthread_syncvar128_release_fill(dest, &snap, *src);
+            break;
+        default:
+        {
+            int rv = qthread_syncvar128_enqueue_and_block(dest, &snap, me, WRITEEF, (void *)src,
+                                                          SYNCFEB_STATE_FULL_WITH_WAITERS);
+            if (rv != QTHREAD_SUCCESS) { return rv; }
+            break;
+        }
+    }
+    QTHREAD_FEB_TIMER_STOP(febblock, me);
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+int API_FUNC qthread_syncvar128_writeEF_const(syncvar128_t *restrict dest,
+                                              const uint64_t         src)
+{                                      /*{{{ */
+    return qthread_syncvar128_writeEF(dest, &src);
+}                                      /*}}} */
+
+int API_FUNC qthread_syncvar128_writeF(syncvar128_t *restrict   dest,
+                                       const uint64_t *restrict src)
+{                                      /*{{{ */
+    assert(qthread_library_initialized);
+    syncvar128_t snap;
+
+    assert(dest);
+    assert(src);
+    qthread_debug(SYNCVAR_CALLS, "dest(%p), src(%p)\n", dest, src);
+    if (!qthread_internal_getshep()) {
+        return qthread_syncvar128_blocker_func(dest, (void *)src, WRITEF);
+    }
+
+    qt_sv128_snapshot(dest, &snap);
+    while (!SV128_IS_LOCKED(snap.state) &&
+           (SV128_STATE(snap.state) != SYNCFEB_STATE_EMPTY_WITH_WAITERS)) {
+        /* full syncvars keep their writeEF waiters; an empty one with no
+         * waiters simply becomes full */
+        const syncvar128_t written = { *src, SV128_IS_EMPTY(snap.state) ?
+                                       BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_FULL_NO_WAITERS) :
+                                       snap.state };
+        if (qt_sv128_cas(dest, &snap, &written)) {
+            return QTHREAD_SUCCESS;
+        }
+    }
+    qt_sv128_lock(dest, &snap);
+    if (SV128_STATE(snap.state) == SYNCFEB_STATE_EMPTY_WITH_WAITERS) {
+        qthread_syncvar128_release_fill(dest, &snap, *src);
+    } else if (SV128_IS_EMPTY(snap.state)) {
+        qt_sv128_unlock(dest, &snap, *src,
+                        BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_FULL_NO_WAITERS));
+    } else {
+        qt_sv128_unlock(dest, &snap, *src, snap.state);
+    }
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+int API_FUNC qthread_syncvar128_writeF_const(syncvar128_t *restrict dest,
+                                             const uint64_t         src)
+{                                      /*{{{ */
+    return qthread_syncvar128_writeF(dest, &src);
+}                                      /*}}} */
+
+int API_FUNC qthread_syncvar128_fill(syncvar128_t *restrict dest)
+{                                      /*{{{ */
+    assert(qthread_library_initialized);
+    syncvar128_t snap;
+
+    assert(dest);
+    qthread_debug(SYNCVAR_CALLS, "dest(%p)\n", dest);
+    if (!qthread_internal_getshep()) {
+        return qthread_syncvar128_blocker_func(dest, NULL, FILL);
+    }
+
+    qt_sv128_snapshot(dest, &snap);
+    while (!SV128_IS_LOCKED(snap.state)) {
+        syncvar128_t filled = { snap.data, BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_FULL_NO_WAITERS) };
+        if (!SV128_IS_EMPTY(snap.state)) {
+            return QTHREAD_SUCCESS;    // already full
+        }
+        if (SV128_STATE(snap.state) == SYNCFEB_STATE_EMPTY_WITH_WAITERS) {
+            break;
+        }
+        if (qt_sv128_cas(dest, &snap, &filled)) {
+            return QTHREAD_SUCCESS;
+        }
+    }
+    qt_sv128_lock(dest, &snap);
+    switch (SV128_STATE(snap.state)) {
+        case SYNCFEB_STATE_EMPTY_WITH_WAITERS:
+            qthread_syncvar128_release_fill(dest, &snap, snap.data);
+            break;
+        case SYNCFEB_STATE_EMPTY_NO_WAITERS:
+            qt_sv128_unlock(dest, &snap, snap.data,
+                            BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_FULL_NO_WAITERS));
+            break;
+        default:
+            qt_sv128_unlock(dest, &snap, snap.data, snap.state);
+            break;
+    }
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+int API_FUNC qthread_syncvar128_empty(syncvar128_t *restrict dest)
+{                                      /*{{{ */
+    assert(qthread_library_initialized);
+    syncvar128_t snap;
+
+    assert(dest);
+    qthread_debug(SYNCVAR_CALLS, "dest(%p)\n", dest);
+    if (!qthread_internal_getshep()) {
+        return qthread_syncvar128_blocker_func(dest, NULL, EMPTY);
+    }
+
+    qt_sv128_snapshot(dest, &snap);
+    while (!SV128_IS_LOCKED(snap.state)) {
+        syncvar128_t emptied = { snap.data, BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_EMPTY_NO_WAITERS) };
+        if (SV128_IS_EMPTY(snap.state)) {
+            return QTHREAD_SUCCESS;    // already empty
+        }
+        if (SV128_STATE(snap.state) == SYNCFEB_STATE_FULL_WITH_WAITERS) {
+            break;
+        }
+        if (qt_sv128_cas(dest, &snap, &emptied)) {
+            return QTHREAD_SUCCESS;
+        }
+    }
+    qt_sv128_lock(dest, &snap);
+    switch (SV128_STATE(snap.state)) {
+        case SYNCFEB_STATE_FULL_WITH_WAITERS:
+            qthread_syncvar128_release_empty(dest, &snap);
+            break;
+        case SYNCFEB_STATE_FULL_NO_WAITERS:
+            qt_sv128_unlock(dest, &snap, snap.data,
+                            BUILD_UNLOCKED_SYNCVAR128(NULL, SYNCFEB_STATE_EMPTY_NO_WAITERS));
+            break;
+        default:
+            qt_sv128_unlock(dest, &snap, snap.data, snap.state);
+            break;
+    }
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+uint64_t API_FUNC qthread_syncvar128_incrF(syncvar128_t *restrict operand,
+                                           const uint64_t         inc)
+{                                      /*{{{ */
+    assert(qthread_library_initialized);
+    syncvar128_t snap;
+    uint64_t     newv;
+
+    assert(operand);
+    qthread_debug(SYNCVAR_CALLS, "operand(%p), inc(%lu)\n", operand, (unsigned long)inc);
+    if (!qthread_internal_self()) {
+        uint64_t arg = inc;
+        qthread_syncvar128_blocker_func(operand, &arg, INCR);
+        return arg;
+    }
+
+    /* like qthread_syncvar_incrF(), this only changes the FEB state if there
+     * are readers waiting for the result */
+    qt_sv128_snapshot(operand, &snap);
+    while (!SV128_IS_LOCKED(snap.state) &&
+           (SV128_STATE(snap.state) != SYNCFEB_STATE_EMPTY_WITH_WAITERS)) {
+        const syncvar128_t incremented = { snap.data + inc, snap.state };
+        if (qt_sv128_cas(operand, &snap, &incremented)) {
+            return incremented.data;
+        }
+    }
+    qt_sv128_lock(operand, &snap);
+    newv = snap.data + inc;
+    if (SV128_STATE(snap.state) == SYNCFEB_STATE_EMPTY_WITH_WAITERS) {
+        qthread_syncvar128_release_fill(operand, &snap, newv);
+    } else {
+        qt_sv128_unlock(operand, &snap, newv, snap.state);
+    }
+    return newv;
+}                                      /*}}} */
+
+/* vim:set expandtab: */
@@ -4,6 +4,7 @@
 
 /* System Headers */
 #include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
 
 #ifdef HAVE_SYS_SYSCALL_H
 # include <unistd.h>
@@ -29,6 +30,7 @@ int qt_accept(int                       socket,
 
     assert(job);
     job->next   = NULL;
+    job->batch  = NULL;
     job->thread = me;
     job->op     = ACCEPT;
     memcpy(&job->args[0], &socket, sizeof(int));
@@ -40,6 +42,7 @@ int qt_accept(int                       socket,
     me->thread_state     = QTHREAD_STATE_SYSCALL;
     qthread_back_to_master(me);
     ret = job->ret;
+    if (ret < 0) { errno = job->err; }
     FREE_SYSCALLJOB(job);
     return ret;
 }
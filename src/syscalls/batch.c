@@ -0,0 +1,192 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
+#include <limits.h>              /* for INT_MAX */
+#include <unistd.h>
+#include <sys/uio.h>             /* for readv() and friends */
+
+/* Public Headers */
+#include "qthread/qt_syscalls.h"
+
+/* Internal Headers */
+#include "qt_io.h"
+#include "qt_asserts.h"
+#include "qthread_innards.h" /* for qlib */
+#include "qt_qthread_mgmt.h"
+
+static int qt_io_batch_valid(const qt_io_request_t *req)
+{   /*{{{*/
+    switch (req->op) {
+        case QT_IO_READ:
+        case QT_IO_WRITE:
+        case QT_IO_PREAD:
+        case QT_IO_PWRITE:
+            return 1;
+
+        case QT_IO_READV:
+        case QT_IO_WRITEV:
+        case QT_IO_PREADV:
+        case QT_IO_PWRITEV:
+            return req->count <= INT_MAX;
+
+        default:
+            return 0;
+    }
+} /*}}}*/
+
+/* Used when the caller cannot block in the I/O subsystem (it is not a task,
+ * or the library is not running): the requests are simply made in order. */
+static void qt_io_batch_inline(qt_io_request_t *req)
+{   /*{{{*/
+    const int iovcnt = (int)req->count;
+
+    switch (req->op) {
+        case QT_IO_READ:
+            req->ret = read(req->fd, req->buf, req->count);
+            break;
+        case QT_IO_WRITE:
+            req->ret = write(req->fd, req->buf, req->count);
+            break;
+        case QT_IO_PREAD:
+            req->ret = pread(req->fd, req->buf, req->count, req->offset);
+            break;
+        case QT_IO_PWRITE:
+            req->ret = pwrite(req->fd, req->buf, req->count, req->offset);
+            break;
+        case QT_IO_READV:
+            req->ret = readv(req->fd, req->buf, iovcnt);
+            break;
+        case QT_IO_WRITEV:
+            req->ret = writev(req->fd, req->buf, iovcnt);
+            break;
+        case QT_IO_PREADV:
+            req->ret = preadv(req->fd, req->buf, iovcnt, req->offset);
+            break;
+        case QT_IO_PWRITEV:
+            req->ret = pwritev(req->fd, req->buf, iovcnt, req->offset);
+            break;
+    }
+    req->err = (req->ret < 0) ? errno : 0;
+} /*}}}*/
+
+static void qt_io_batch_fill(qt_blocking_queue_node_t *job,
+                             const qt_io_request_t    *req)
+{   /*{{{*/
+    const int iovcnt = (int)req->count;
+
+    memcpy(&job->args[0], &req->fd, sizeof(int));
+    job->args[1] = (uintptr_t)req->buf;
+    switch (req->op) {
+        case QT_IO_READ:
+            job->op = READ;
+            break;
+        case QT_IO_WRITE:
+            job->op = WRITE;
+            break;
+        case QT_IO_PREAD:
+            job->op = PREAD;
+            break;
+        case QT_IO_PWRITE:
+            job->op = PWRITE;
+            break;
+        case QT_IO_READV:
+            job->op = READV;
+            break;
+        case QT_IO_WRITEV:
+            job->op = WRITEV;
+            break;
+        case QT_IO_PREADV:
+            job->op = PREADV;
+            break;
+        case QT_IO_PWRITEV:
+            job->op = PWRITEV;
+            break;
+    }
+    switch (req->op) {
+        case QT_IO_READ:
+        case QT_IO_WRITE:
+        case QT_IO_PREAD:
+        case QT_IO_PWRITE:
+            memcpy(&job->args[2], &req->count, sizeof(size_t));
+            break;
+        default:
+            memcpy(&job->args[2], &iovcnt, sizeof(int));
+            break;
+    }
+    memcpy(&job->args[3], &req->offset, sizeof(off_t));
+} /*}}}*/
+
+int qt_io_batch(qt_io_request_t *reqs,
+                size_t           count)
+{   /*{{{*/
+    qt_blocking_batch_t       batch;
+    qt_blocking_queue_node_t *job, **tail = &batch.first;
+    qthread_t                *me;
+    int                       failed = 0;
+
+    batch.remaining = 0;
+    batch.first     = NULL;
+    for (size_t i = 0; i < count; i++) {
+        if (qt_io_batch_valid(&reqs[i])) {
+            batch.remaining++;
+        } else {
+            reqs[i].ret = -1;
+            reqs[i].err = EINVAL;
+            failed++;
+        }
+    }
+    if (batch.remaining == 0) { return failed; }
+
+    if (!qt_blockable()) {
+        for (size_t i = 0; i < count; i++) {
+            if (qt_io_batch_valid(&reqs[i])) {
+                qt_io_batch_inline(&reqs[i]);
+                if (reqs[i].ret < 0) { failed++; }
+            }
+        }
+        return failed;
+    }
+
+    me = qthread_internal_self();
+    for (size_t i = 0; i < count; i++) {
+        if (!qt_io_batch_valid(&reqs[i])) { continue; }
+        job = ALLOC_SYSCALLJOB();
+        assert(job);
+        job->next       = NULL;
+        job->batch      = &batch;
+        job->batch_next = NULL;
+        job->thread     = me;
+        qt_io_batch_fill(job, &reqs[i]);
+        *tail = job;
+        tail  = &job->batch_next;
+    }
+
+    assert(me->rdata);
+
+    /* One trip to the master hands off every job; the task comes back once
+     * the last of them completes. */
+    me->rdata->blockedon.io = batch.first;
+    me->thread_state        = QTHREAD_STATE_SYSCALL;
+    qthread_back_to_master(me);
+
+    job = batch.first;
+    for (size_t i = 0; i < count; i++) {
+        qt_blocking_queue_node_t *next;
+
+        if (!qt_io_batch_valid(&reqs[i])) { continue; }
+        assert(job);
+        next        = job->batch_next;
+        reqs[i].ret = job->ret;
+        reqs[i].err = (job->ret < 0) ? job->err : 0;
+        if (job->ret < 0) { failed++; }
+        FREE_SYSCALLJOB(job);
+        job = next;
+    }
+    return failed;
+} /*}}}*/
+
+/* vim:set expandtab: */
@@ -5,6 +5,7 @@
 /* System Headers */
 #include <qthread/qthread-int.h> /* for uint64_t */
 
+#include <errno.h>
 #include <time.h>
 
 #ifdef HAVE_SYS_SYSCALL_H
@@ -18,6 +19,7 @@
 
 /* Internal Headers */
 #include "qt_io.h"
+#include "qt_timers.h"
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
 
@@ -25,20 +27,17 @@ int qt_nanosleep(const struct timespec *rqtp,
                  struct timespec       *rmtp)
 {
     if (qt_blockable()) {
-        qtimer_t t       = qtimer_create();
-        double   seconds = rqtp->tv_sec + (rqtp->tv_nsec * 1e-9);
-
-        qtimer_start(t);
-        do {
-            qthread_yield();
-            qtimer_stop(t);
-        } while (qtimer_secs(t) < seconds);
+        if ((rqtp->tv_sec < 0) || (rqtp->tv_nsec < 0) ||
+            (rqtp->tv_nsec >= 1000000000L)) {
+            errno = EINVAL;
+            return -1;
+        }
+        /* parked on the shepherd's timer wheel; nothing interrupts it */
+        qt_timer_sleep((uint64_t)rqtp->tv_sec * 1000000000ULL + (uint64_t)rqtp->tv_nsec);
         if (rmtp) {
-            time_t secs = (time_t)qtimer_secs(t);
-            rmtp->tv_sec = rqtp->tv_sec - secs;
-            rmtp->tv_nsec = (long)(qtimer_secs(t) - (double)secs) * 1e9;
+            rmtp->tv_sec  = 0;
+            rmtp->tv_nsec = 0;
         }
-        qtimer_destroy(t);
         return 0;
     } else {
         if (rmtp) {
@@ -4,6 +4,7 @@
 
 /* System Headers */
 #include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
 
 #ifdef HAVE_SYS_SYSCALL_H
 # include <unistd.h>
@@ -30,6 +31,7 @@ ssize_t qt_pread(int    filedes,
 
     assert(job);
     job->next   = NULL;
+    job->batch  = NULL;
     job->thread = me;
     job->op     = PREAD;
     memcpy(&job->args[0], &filedes, sizeof(int));
@@ -43,6 +45,7 @@ ssize_t qt_pread(int    filedes,
     me->thread_state        = QTHREAD_STATE_SYSCALL;
     qthread_back_to_master(me);
     ret = job->ret;
+    if (ret < 0) { errno = job->err; }
     FREE_SYSCALLJOB(job);
     return ret;
 }
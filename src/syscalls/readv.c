@@ -0,0 +1,65 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
+#include <sys/uio.h>             /* for struct iovec */
+#ifdef HAVE_SYS_SYSCALL_H
+# include <unistd.h>
+# include <sys/syscall.h>        /* for SYS_accept and others */
+#endif
+
+/* Public Headers */
+#include "qthread/qt_syscalls.h"
+
+/* Internal Headers */
+#include "qt_io.h"
+#include "qt_asserts.h"
+#include "qthread_innards.h" /* for qlib */
+#include "qt_qthread_mgmt.h"
+
+ssize_t qt_readv(int                 filedes,
+                 const struct iovec *iov,
+                 int                 iovcnt)
+{
+    qthread_t                *me  = qthread_internal_self();
+    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    ssize_t                   ret;
+
+    assert(job);
+    job->next   = NULL;
+    job->batch  = NULL;
+    job->thread = me;
+    job->op     = READV;
+    memcpy(&job->args[0], &filedes, sizeof(int));
+    job->args[1] = (uintptr_t)iov;
+    memcpy(&job->args[2], &iovcnt, sizeof(int));
+
+    assert(me->rdata);
+
+    me->rdata->blockedon.io = job;
+    me->thread_state        = QTHREAD_STATE_SYSCALL;
+    qthread_back_to_master(me);
+    ret = job->ret;
+    if (ret < 0) { errno = job->err; }
+    FREE_SYSCALLJOB(job);
+    return ret;
+}
+
+#if HAVE_SYSCALL && HAVE_DECL_SYS_READV
+ssize_t readv(int                 filedes,
+              const struct iovec *iov,
+              int                 iovcnt)
+{
+    if (qt_blockable()) {
+        return qt_readv(filedes, iov, iovcnt);
+    } else {
+        return syscall(SYS_readv, filedes, iov, iovcnt);
+    }
+}
+
+#endif /* if HAVE_SYSCALL && HAVE_DECL_SYS_READV */
+
+/* vim:set expandtab: */
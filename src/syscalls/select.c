@@ -4,6 +4,7 @@
 
 /* System Headers */
 #include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
 
 #include <sys/select.h>
 
@@ -33,6 +34,7 @@ int qt_select(int                      nfds,
 
     assert(job);
     job->next   = NULL;
+    job->batch  = NULL;
     job->thread = me;
     job->op     = SELECT;
     memcpy(&job->args[0], &nfds, sizeof(int));
@@ -47,6 +49,7 @@ int qt_select(int                      nfds,
     me->thread_state        = QTHREAD_STATE_SYSCALL;
     qthread_back_to_master(me);
     ret = job->ret;
+    if (ret < 0) { errno = job->err; }
     FREE_SYSCALLJOB(job);
     return ret;
 }
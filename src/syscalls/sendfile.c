@@ -0,0 +1,73 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
+#ifdef HAVE_SYS_SYSCALL_H
+# include <unistd.h>
+# include <sys/syscall.h>        /* for SYS_accept and others */
+#endif
+
+/* Public Headers */
+#include "qthread/qt_syscalls.h"
+
+/* Internal Headers */
+#include "qt_io.h"
+#include "qt_asserts.h"
+#include "qthread_innards.h" /* for qlib */
+#include "qt_qthread_mgmt.h"
+
+ssize_t qt_sendfile(int    out_fd,
+                    int    in_fd,
+                    off_t *offset,
+                    size_t count)
+{
+    qthread_t                *me  = qthread_internal_self();
+    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    const off_t               start = offset ? *offset : 0;
+    off_t                     pos   = start;
+    ssize_t                   ret;
+
+    assert(job);
+    job->next   = NULL;
+    job->batch  = NULL;
+    job->thread = me;
+    job->op     = SENDFILE;
+    memcpy(&job->args[0], &out_fd, sizeof(int));
+    memcpy(&job->args[1], &in_fd, sizeof(int));
+    job->args[2] = offset ? (uintptr_t)&pos : 0;
+    memcpy(&job->args[3], &count, sizeof(size_t));
+
+    assert(me->rdata);
+
+    me->rdata->blockedon.io = job;
+    me->thread_state        = QTHREAD_STATE_SYSCALL;
+    qthread_back_to_master(me);
+    ret = job->ret;
+    if (ret < 0) {
+        errno = job->err;
+    } else if (offset) {
+        *offset = start + ret;
+    }
+    FREE_SYSCALLJOB(job);
+    return ret;
+}
+
+#if HAVE_SYSCALL && HAVE_DECL_SYS_SENDFILE
+ssize_t sendfile(int    out_fd,
+                 int    in_fd,
+                 off_t *offset,
+                 size_t count)
+{
+    if (qt_blockable()) {
+        return qt_sendfile(out_fd, in_fd, offset, count);
+    } else {
+        return syscall(SYS_sendfile, out_fd, in_fd, offset, count);
+    }
+}
+
+#endif /* if HAVE_SYSCALL && HAVE_DECL_SYS_SENDFILE */
+
+/* vim:set expandtab: */
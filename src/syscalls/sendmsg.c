@@ -0,0 +1,66 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
+#include <sys/uio.h>             /* for struct iovec */
+#include <sys/socket.h>          /* for struct msghdr */
+#ifdef HAVE_SYS_SYSCALL_H
+# include <unistd.h>
+# include <sys/syscall.h>        /* for SYS_accept and others */
+#endif
+
+/* Public Headers */
+#include "qthread/qt_syscalls.h"
+
+/* Internal Headers */
+#include "qt_io.h"
+#include "qt_asserts.h"
+#include "qthread_innards.h" /* for qlib */
+#include "qt_qthread_mgmt.h"
+
+ssize_t qt_sendmsg(int                  socket,
+                   const struct msghdr *message,
+                   int                  flags)
+{
+    qthread_t                *me  = qthread_internal_self();
+    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    ssize_t                   ret;
+
+    assert(job);
+    job->next   = NULL;
+    job->batch  = NULL;
+    job->thread = me;
+    job->op     = SENDMSG;
+    memcpy(&job->args[0], &socket, sizeof(int));
+    job->args[1] = (uintptr_t)message;
+    memcpy(&job->args[2], &flags, sizeof(int));
+
+    assert(me->rdata);
+
+    me->rdata->blockedon.io = job;
+    me->thread_state        = QTHREAD_STATE_SYSCALL;
+    qthread_back_to_master(me);
+    ret = job->ret;
+    if (ret < 0) { errno = job->err; }
+    FREE_SYSCALLJOB(job);
+    return ret;
+}
+
+#if HAVE_SYSCALL && HAVE_DECL_SYS_SENDMSG
+ssize_t sendmsg(int                  socket,
+                const struct msghdr *message,
+                int                  flags)
+{
+    if (qt_blockable()) {
+        return qt_sendmsg(socket, message, flags);
+    } else {
+        return syscall(SYS_sendmsg, socket, message, flags);
+    }
+}
+
+#endif /* if HAVE_SYSCALL && HAVE_DECL_SYS_SENDMSG */
+
+/* vim:set expandtab: */
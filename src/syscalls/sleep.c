@@ -16,6 +16,7 @@
 
 /* Internal Headers */
 #include "qt_io.h"
+#include "qt_timers.h"
 #include "qt_asserts.h"
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
@@ -23,13 +24,7 @@
 unsigned int qt_sleep(unsigned int seconds)
 {
     if (qt_blockable()) {
-        qtimer_t t = qtimer_create();
-        qtimer_start(t);
-        do {
-            qthread_yield();
-            qtimer_stop(t);
-        } while (qtimer_secs(t) < seconds);
-        qtimer_destroy(t);
+        qt_timer_sleep((uint64_t)seconds * 1000000000ULL);
         return 0;
     } else {
         return seconds;
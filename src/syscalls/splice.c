@@ -0,0 +1,85 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
+#include <fcntl.h>               /* for splice() */
+#ifdef HAVE_SYS_SYSCALL_H
+# include <unistd.h>
+# include <sys/syscall.h>        /* for SYS_accept and others */
+#endif
+
+/* Public Headers */
+#include "qthread/qt_syscalls.h"
+
+/* Internal Headers */
+#include "qt_io.h"
+#include "qt_asserts.h"
+#include "qthread_innards.h" /* for qlib */
+#include "qt_qthread_mgmt.h"
+
+ssize_t qt_splice(int          fd_in,
+                  off_t       *off_in,
+                  int          fd_out,
+                  off_t       *off_out,
+                  size_t       len,
+                  unsigned int flags)
+{
+    qthread_t                *me  = qthread_internal_self();
+    qt_blocking_queue_node_t *job = ALLOC_SYSCALLJOB();
+    /* the job gets copies of the offsets; the io_uring does not move them
+     * along, so they are set from the result below */
+    const off_t               start_in  = off_in ? *off_in : 0;
+    const off_t               start_out = off_out ? *off_out : 0;
+    off_t                     pos_in    = start_in;
+    off_t                     pos_out   = start_out;
+    ssize_t                   ret;
+
+    assert(job);
+    job->next   = NULL;
+    job->batch  = NULL;
+    job->thread = me;
+    job->op     = SPLICE;
+    memcpy(&job->args[0], &fd_in, sizeof(int));
+    job->args[1] = off_in ? (uintptr_t)&pos_in : 0;
+    memcpy(&job->args[2], &fd_out, sizeof(int));
+    job->args[3] = off_out ? (uintptr_t)&pos_out : 0;
+    memcpy(&job->args[4], &len, sizeof(size_t));
+    memcpy(&job->args[5], &flags, sizeof(unsigned int));
+
+    assert(me->rdata);
+
+    me->rdata->blockedon.io = job;
+    me->thread_state        = QTHREAD_STATE_SYSCALL;
+    qthread_back_to_master(me);
+    ret = job->ret;
+    if (ret < 0) {
+        errno = job->err;
+    } else {
+        if (off_in) { *off_in = start_in + ret; }
+        if (off_out) { *off_out = start_out + ret; }
+    }
+    FREE_SYSCALLJOB(job);
+    return ret;
+}
+
+#if HAVE_SYSCALL && HAVE_DECL_SYS_SPLICE
+ssize_t splice(int          fd_in,
+               loff_t      *off_in,
+               int          fd_out,
+               loff_t      *off_out,
+               size_t       len,
+               unsigned int flags)
+{
+    if (qt_blockable()) {
+        return qt_splice(fd_in, (off_t *)off_in, fd_out, (off_t *)off_out, len, flags);
+    } else {
+        return syscall(SYS_splice, fd_in, off_in, fd_out, off_out, len, flags);
+    }
+}
+
+#endif /* if HAVE_SYSCALL && HAVE_DECL_SYS_SPLICE */
+
+/* vim:set expandtab: */
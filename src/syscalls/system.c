@@ -4,6 +4,7 @@
 
 /* System Headers */
 #include <qthread/qthread-int.h> /* for uint64_t */
+#include <errno.h>
 
 #ifdef HAVE_SYS_SYSCALL_H
 # include <sys/syscall.h>        /* for SYS_accept and others */
@@ -26,6 +27,7 @@ int qt_system(const char *command)
 
     assert(job);
     job->next    = NULL;
+    job->batch   = NULL;
     job->thread  = me;
     job->op      = SYSTEM;
     job->args[0] = (uintptr_t)command;
@@ -36,6 +38,7 @@ int qt_system(const char *command)
     me->thread_state        = QTHREAD_STATE_SYSCALL;
     qthread_back_to_master(me);
     ret = job->ret;
+    if (ret < 0) { errno = job->err; }
     FREE_SYSCALLJOB(job);
     return ret;
 }
@@ -32,6 +32,7 @@ void qt_begin_blocking_action(void)
 
         assert(job);
         job->next   = NULL;
+        job->batch  = NULL;
         job->thread = me;
         job->op     = USER_DEFINED;
 
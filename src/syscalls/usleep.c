@@ -16,20 +16,14 @@
 
 /* Internal Headers */
 #include "qt_io.h"
+#include "qt_timers.h"
 #include "qthread_innards.h" /* for qlib */
 #include "qt_qthread_mgmt.h"
 
 int qt_usleep(useconds_t useconds)
 {
-     if (qt_blockable()) {
-        qtimer_t t       = qtimer_create();
-        double   seconds = useconds * 1e-6;
-        qtimer_start(t);
-        do {
-            qthread_yield();
-            qtimer_stop(t);
-        } while (qtimer_secs(t) < seconds);
-        qtimer_destroy(t);
+    if (qt_blockable()) {
+        qt_timer_sleep((uint64_t)useconds * 1000ULL);
         return 0;
     } else {
         return -1;
@@ -21,6 +21,7 @@
 #include "qt_asserts.h"
 #include "qt_subsystems.h"
 #include "qt_debug.h"
+#include "qt_arena.h"
 
 /* Memory management macros */
 #if defined(UNPOOLED)
@@ -65,6 +66,7 @@ void INTERNAL qt_internal_teams_init(void)
     QTHREAD_FASTLOCK_INIT(qlib->team_count_lock);
 #ifndef UNPOOLED
     generic_team_pool = qt_mpool_create(sizeof(qt_team_t));
+    qt_mpool_set_name(generic_team_pool, "generic_team_pool");
 #endif
     qthread_internal_cleanup(qt_internal_teams_shutdown);
     qthread_internal_cleanup_late(qt_internal_teams_destroy);
@@ -229,6 +231,7 @@ void INTERNAL qt_internal_teamfinish(qt_team_t   *team,
             team->sinc = NULL;
             qt_sinc_destroy(team->subteams_sinc);
             team->subteams_sinc = NULL;
+            qt_arena_release((qarena **)&team->arena);
             qthread_debug(FEB_DETAILS, "tid %u killing team %u, filling my own eureka (%p)\n", qthread_id(), team->team_id, &team->eureka);
             qthread_fill(&team->eureka);
 
@@ -300,6 +303,7 @@ void INTERNAL qt_internal_teamfinish(qt_team_t   *team,
                 team->parent_eureka        = NULL;
                 team->parent_subteams_sinc = NULL;
             }
+            qt_arena_release((qarena **)&team->arena);
 
             qthread_debug(FEB_DETAILS, "tid %u killing team %u, filling my own eureka (%p)\n", qthread_id(), team->team_id, &team->eureka);
             qthread_fill(&team->eureka);
@@ -410,6 +414,7 @@ qt_team_t INTERNAL *qt_internal_team_new(void *restrict      ret,
     new_team->parent_eureka        = NULL;
     new_team->parent_subteams_sinc = NULL;
     new_team->return_loc           = ret;
+    new_team->arena                = NULL;
     new_team->flags                = feature_flag & QTHREAD_RET_MASK;
 
     if (QTHREAD_UNLIKELY(new_team->team_id == QTHREAD_NULL_TEAM_ID)) {
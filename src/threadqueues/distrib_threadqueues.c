@@ -171,6 +171,8 @@ void INTERNAL qt_threadqueue_subsystem_init(){
                                                              qthread_cacheline());
   generic_threadqueue_pools.nodes = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t),
                                                             qthread_cacheline());
+  qt_mpool_set_name(generic_threadqueue_pools.queues, "threadqueue_queues_pool");
+  qt_mpool_set_name(generic_threadqueue_pools.nodes, "threadqueue_nodes_pool");
   qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 }
 
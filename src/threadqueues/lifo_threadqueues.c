@@ -69,6 +69,8 @@ void INTERNAL qt_threadqueue_subsystem_init(void)
 {
     generic_threadqueue_pools.queues = qt_mpool_create(sizeof(qt_threadqueue_t));
     generic_threadqueue_pools.nodes  = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t), sizeof(void *));
+    qt_mpool_set_name(generic_threadqueue_pools.queues, "threadqueue_queues_pool");
+    qt_mpool_set_name(generic_threadqueue_pools.nodes, "threadqueue_nodes_pool");
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 }
 #endif /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
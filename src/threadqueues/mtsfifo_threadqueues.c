@@ -90,6 +90,8 @@ void INTERNAL qt_threadqueue_subsystem_init(void)
 {
     generic_threadqueue_pools.nodes  = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t), 16);
     generic_threadqueue_pools.queues = qt_mpool_create(sizeof(qt_threadqueue_t));
+    qt_mpool_set_name(generic_threadqueue_pools.queues, "threadqueue_queues_pool");
+    qt_mpool_set_name(generic_threadqueue_pools.nodes, "threadqueue_nodes_pool");
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 }
 
@@ -316,6 +318,7 @@ qthread_t INTERNAL *qt_scheduler_get_thread(qt_threadqueue_t         *q,
         hazardous_ptr(1, next_ptr);
 
         if (next_ptr == NULL) { // queue is empty
+            hazardous_ptr(0, NULL); // don't hold on to head while waiting
 #ifdef QTHREAD_CONDWAIT_BLOCKING_QUEUE
             if (qthread_internal_incr(&q->fruitless, &q->fruitless_m, 1) > 1000) {
 # ifdef QTHREAD_USE_EUREKAS
@@ -206,6 +206,8 @@ void INTERNAL qt_threadqueue_subsystem_init(void)
                                                                qthread_cacheline());
     generic_threadqueue_pools.nodes = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t),
                                                               qthread_cacheline());
+    qt_mpool_set_name(generic_threadqueue_pools.queues, "threadqueue_queues_pool");
+    qt_mpool_set_name(generic_threadqueue_pools.nodes, "threadqueue_nodes_pool");
     steal_chunksize = qt_internal_get_env_num("STEAL_CHUNK", 0, 0);
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 } /*}}}*/
@@ -0,0 +1,468 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <qthread/qthread-int.h> /* for uint64_t */
+
+/* API Headers */
+#include "qthread/qthread.h"
+#include "qthread/qtimer.h"
+
+/* Internal Headers */
+#include "qt_timers.h"
+#include "qt_alloc.h"
+#include "qt_macros.h"
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qt_debug.h"
+#include "qt_envariables.h"
+#include "qt_subsystems.h"
+#include "qt_threadqueues.h"
+#include "qt_qthread_mgmt.h"
+#include "qt_shepherd_innards.h"
+#include "qthread_innards.h" /* for qlib */
+
+/* Each shepherd has a hierarchical timer wheel: QT_WHEEL_LEVELS rings of
+ * QT_WHEEL_SIZE slots, where a slot in level l holds the sleepers due within
+ * one QT_WHEEL_SIZE^l-tick span. Parking a task and firing a slot are O(1);
+ * sleepers in the upper levels are moved down a level ("cascaded") when the
+ * wheel comes round to their slot. Whichever of the shepherd's workers goes
+ * through its scheduling loop advances the wheel to the current tick. So that
+ * some worker does even when there is nothing else to run, the first sleeper
+ * forks a ticker task that yields until the wheel is empty again. Timers from
+ * qthread_spawn_after() and qthread_spawn_periodic() go in the same wheels;
+ * their nodes are unlinked from their slot when they are cancelled. */
+#define QT_WHEEL_BITS   6
+#define QT_WHEEL_SIZE   (1 << QT_WHEEL_BITS)
+#define QT_WHEEL_MASK   (QT_WHEEL_SIZE - 1)
+#define QT_WHEEL_LEVELS 4
+#define QT_WHEEL_SPAN   ((uint64_t)1 << (QT_WHEEL_BITS * QT_WHEEL_LEVELS))
+
+typedef struct {
+    QTHREAD_TRYLOCK_TYPE  lock;
+    uint64_t              now;      /* every tick up to this one has fired */
+    size_t                count;    /* nodes in the slots */
+    aligned_t             sleepers; /* including those on their way in, and
+                                     * timers that have not finished */
+    aligned_t             ticking;  /* whether the ticker task is running */
+    qt_timer_node_t      *slots[QT_WHEEL_LEVELS][QT_WHEEL_SIZE];
+} qt_timer_wheel_t;
+
+typedef enum {
+    QT_TIMER_ARMED,    /* in a slot */
+    QT_TIMER_FIRING,   /* its task is being forked */
+    QT_TIMER_DONE,     /* a one-shot timer whose task has been forked */
+    QT_TIMER_CANCELLED /* cancelled while firing; the firer frees it */
+} qt_timer_state_t;
+
+struct qthread_timer_s {
+    qt_timer_node_t       node;   /* must be first */
+    qthread_f             f;
+    const void           *arg;
+    aligned_t            *ret;
+    double                due;    /* seconds after the epoch */
+    double                period; /* in seconds; 0 for a one-shot timer */
+    qthread_shepherd_id_t shep;
+    qt_timer_state_t      state;  /* guarded by the wheel's lock */
+};
+
+aligned_t                    qt_timers_pending = 0;
+static qt_timer_wheel_t     *wheels            = NULL; /* one per shepherd */
+static qthread_shepherd_id_t nwheels           = 0;
+static double                tick              = 100e-6; // in seconds
+static double                epoch             = 0.0;
+
+static QINLINE uint64_t qt_timer_ticks(double when)
+{   /*{{{*/
+    return (uint64_t)((when - epoch) / tick);
+} /*}}}*/
+
+/* the first tick that starts no earlier than <due> */
+static QINLINE uint64_t qt_timer_ticks_at(double due)
+{   /*{{{*/
+    uint64_t ticks = (uint64_t)(due / tick);
+
+    if ((double)ticks * tick < due) { ticks++; }
+    return ticks;
+} /*}}}*/
+
+static void qt_timer_subsystem_freemem(void)
+{   /*{{{*/
+    for (qthread_shepherd_id_t i = 0; i < nwheels; i++) {
+        QTHREAD_TRYLOCK_DESTROY(wheels[i].lock);
+    }
+    FREE(wheels, nwheels * sizeof(qt_timer_wheel_t));
+    wheels  = NULL;
+    nwheels = 0;
+} /*}}}*/
+
+void INTERNAL qt_timer_subsystem_init(void)
+{   /*{{{*/
+    nwheels = qlib->nshepherds;
+    wheels  = qt_calloc(nwheels, sizeof(qt_timer_wheel_t));
+    assert(wheels);
+    for (qthread_shepherd_id_t i = 0; i < nwheels; i++) {
+        QTHREAD_TRYLOCK_INIT(wheels[i].lock);
+    }
+    tick              = qt_internal_get_env_num("TIMER_TICK", 100, 1) * 1e-6;
+    epoch             = qtimer_wtime();
+    qt_timers_pending = 0;
+    qthread_internal_cleanup(qt_timer_subsystem_freemem);
+} /*}}}*/
+
+static QINLINE void qt_timer_push(qt_timer_node_t  *node,
+                                  qt_timer_node_t **fired)
+{   /*{{{*/
+    if (node->thread == NULL) {
+        ((qthread_timer_t *)node)->state = QT_TIMER_FIRING;
+    }
+    node->pprev = NULL;
+    node->next  = *fired;
+    *fired      = node;
+} /*}}}*/
+
+static QINLINE void qt_timer_unlink(qt_timer_wheel_t *w,
+                                    qt_timer_node_t  *node)
+{   /*{{{*/
+    *node->pprev = node->next;
+    if (node->next != NULL) {
+        node->next->pprev = node->pprev;
+    }
+    node->pprev = NULL;
+    w->count--;
+} /*}}}*/
+
+/* Either puts <node> in the slot for its deadline or, if that has come,
+ * on the <fired> list. Must hold the wheel's lock. */
+static void qt_timer_insert(qt_timer_wheel_t *w,
+                            qt_timer_node_t  *node,
+                            qt_timer_node_t **fired)
+{   /*{{{*/
+    uint64_t     deadline = node->deadline;
+    uint64_t     delta;
+    unsigned int level;
+
+    if (deadline <= w->now) {
+        qt_timer_push(node, fired);
+        return;
+    }
+    delta = deadline - w->now;
+    for (level = 0; level < QT_WHEEL_LEVELS - 1; level++) {
+        if (delta < ((uint64_t)1 << (QT_WHEEL_BITS * (level + 1)))) { break; }
+    }
+    if (delta >= QT_WHEEL_SPAN) {
+        /* parked as far out as the wheel goes, and re-filed from there */
+        deadline = w->now + QT_WHEEL_SPAN - 1;
+    }
+    {
+        const size_t      slot = (deadline >> (QT_WHEEL_BITS * level)) & QT_WHEEL_MASK;
+        qt_timer_node_t **head = &w->slots[level][slot];
+
+        node->next  = *head;
+        node->pprev = head;
+        if (node->next != NULL) {
+            node->next->pprev = &node->next;
+        }
+        *head = node;
+    }
+    w->count++;
+} /*}}}*/
+
+/* Advances the wheel by one tick. Must hold the wheel's lock. */
+static void qt_timer_step(qt_timer_wheel_t *w,
+                          qt_timer_node_t **fired)
+{   /*{{{*/
+    qt_timer_node_t *node;
+
+    w->now++;
+    /* level l comes round whenever the low l * QT_WHEEL_BITS bits of the
+     * tick are all zero */
+    for (unsigned int level = 1; level < QT_WHEEL_LEVELS; level++) {
+        const size_t slot = (w->now >> (QT_WHEEL_BITS * level)) & QT_WHEEL_MASK;
+
+        if (((w->now >> (QT_WHEEL_BITS * (level - 1))) & QT_WHEEL_MASK) != 0) { break; }
+        node                  = w->slots[level][slot];
+        w->slots[level][slot] = NULL;
+        while (node != NULL) {
+            qt_timer_node_t *next = node->next;
+
+            w->count--;
+            qt_timer_insert(w, node, fired);
+            node = next;
+        }
+    }
+    node = w->slots[0][w->now & QT_WHEEL_MASK];
+    w->slots[0][w->now & QT_WHEEL_MASK] = NULL;
+    while (node != NULL) {
+        qt_timer_node_t *next = node->next;
+
+        w->count--;
+        qt_timer_push(node, fired);
+        node = next;
+    }
+} /*}}}*/
+
+static aligned_t qt_timer_ticker(void *arg);
+
+/* Counts a sleeper or timer in, and makes sure that the wheel is ticking. */
+static void qt_timer_hold(qt_timer_wheel_t     *w,
+                          qthread_shepherd_id_t shep)
+{   /*{{{*/
+    (void)qthread_incr(&w->sleepers, 1);
+    (void)qthread_incr(&qt_timers_pending, 1);
+    MACHINE_FENCE;
+    if ((w->ticking == 0) && (qthread_cas(&w->ticking, 0, 1) == 0)) {
+        qthread_fork_to(qt_timer_ticker, w, NULL, shep);
+    }
+} /*}}}*/
+
+static QINLINE void qt_timer_drop(qt_timer_wheel_t *w)
+{   /*{{{*/
+    (void)qthread_incr(&w->sleepers, -1);
+    (void)qthread_incr(&qt_timers_pending, -1);
+} /*}}}*/
+
+/* Forks the timer's task and, if the timer is periodic, files it again. */
+static void qt_timer_fire(qt_timer_wheel_t *w,
+                          qthread_timer_t  *timer)
+{   /*{{{*/
+    qt_timer_state_t state;
+    qt_timer_node_t *fired = NULL;
+    int              ret;
+
+    qthread_debug(THREAD_DETAILS, "timer %p firing on shep %u\n", timer, (unsigned)timer->shep);
+    ret = qthread_spawn(timer->f, timer->arg, 0, timer->ret, 0, NULL, NO_SHEPHERD, 0);
+    if (ret != QTHREAD_SUCCESS) {
+        /* the task is lost (a periodic timer tries again next time); no one
+         * may be left waiting for a one-shot timer's return value */
+        qthread_debug(THREAD_DETAILS, "timer %p could not spawn its task (%i)\n", timer, ret);
+        if ((timer->period == 0) && timer->ret) { qthread_fill(timer->ret); }
+    }
+    QTHREAD_TRYLOCK_LOCK(&w->lock);
+    if (timer->state == QT_TIMER_FIRING) {
+        if (timer->period == 0) {
+            timer->state = QT_TIMER_DONE;
+        } else {
+            /* periods that have gone by already are skipped, not made up */
+            do {
+                timer->due          += timer->period;
+                timer->node.deadline = qt_timer_ticks_at(timer->due);
+            } while (timer->node.deadline <= w->now);
+            timer->state = QT_TIMER_ARMED;
+            qt_timer_insert(w, &timer->node, &fired);
+            assert(fired == NULL);
+        }
+    }
+    state = timer->state;
+    QTHREAD_TRYLOCK_UNLOCK(&w->lock);
+    /* once the lock is dropped, only the one who cancels it may touch a
+     * timer that is not in a slot */
+    if (state == QT_TIMER_CANCELLED) {
+        qt_timer_drop(w);
+        qt_free(timer);
+    } else if (state == QT_TIMER_DONE) {
+        qt_timer_drop(w);
+    }
+} /*}}}*/
+
+/* Wakes the sleepers and fires the timers on <fired>; must not hold the
+ * wheel's lock. */
+static void qt_timer_wake(qt_timer_wheel_t   *w,
+                          qthread_shepherd_t *shep,
+                          qt_timer_node_t    *fired)
+{   /*{{{*/
+    while (fired != NULL) {
+        /* a sleeper's node is on its stack, so it is gone once the sleeper
+         * runs, and a periodic timer's node goes back in a slot */
+        qt_timer_node_t *next = fired->next;
+        qthread_t       *t    = fired->thread;
+
+        if (t == NULL) {
+            qt_timer_fire(w, (qthread_timer_t *)fired);
+        } else {
+            qthread_debug(THREAD_DETAILS, "waking thread %u on shep %u\n", t->thread_id, (unsigned)shep->shepherd_id);
+            qt_timer_drop(w);
+            qt_threadqueue_enqueue(shep->ready, t);
+        }
+        fired = next;
+    }
+} /*}}}*/
+
+static void qt_timer_file(qt_timer_wheel_t   *w,
+                          qthread_shepherd_t *shep,
+                          qt_timer_node_t    *node)
+{   /*{{{*/
+    qt_timer_node_t *fired = NULL;
+
+    QTHREAD_TRYLOCK_LOCK(&w->lock);
+    if (w->count == 0) {
+        /* nothing to fire on the way, so no need to walk there */
+        const uint64_t now = qt_timer_ticks(qtimer_wtime());
+
+        if (now > w->now) { w->now = now; }
+    }
+    qt_timer_insert(w, node, &fired);
+    QTHREAD_TRYLOCK_UNLOCK(&w->lock);
+    qt_timer_wake(w, shep, fired);
+} /*}}}*/
+
+void INTERNAL qt_timer_park(qthread_shepherd_t *shep,
+                            qt_timer_node_t    *node)
+{   /*{{{*/
+    qt_timer_file(&wheels[shep->shepherd_id], shep, node);
+} /*}}}*/
+
+void INTERNAL qt_timer_advance(qthread_shepherd_t *shep)
+{   /*{{{*/
+    qt_timer_wheel_t *w     = &wheels[shep->shepherd_id];
+    qt_timer_node_t  *fired = NULL;
+    uint64_t          now;
+
+    if (w->sleepers == 0) { return; }
+    now = qt_timer_ticks(qtimer_wtime());
+    if ((now <= w->now) || !QTHREAD_TRYLOCK_TRY(&w->lock)) { return; }
+    if (w->count == 0) {
+        w->now = now;
+    }
+    while (w->now < now) {
+        qt_timer_step(w, &fired);
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&w->lock);
+    qt_timer_wake(w, shep, fired);
+} /*}}}*/
+
+static aligned_t qt_timer_ticker(void *arg)
+{   /*{{{*/
+    qt_timer_wheel_t *w = (qt_timer_wheel_t *)arg;
+
+    do {
+        while (w->sleepers > 0) {
+            qthread_yield();
+        }
+        w->ticking = 0;
+        MACHINE_FENCE;
+        /* a sleeper that saw it still ticking is counting on it */
+    } while ((w->sleepers > 0) && (qthread_cas(&w->ticking, 0, 1) == 0));
+    return 0;
+} /*}}}*/
+
+void INTERNAL qt_timer_sleep(uint64_t nsec)
+{   /*{{{*/
+    qthread_t             *me = qthread_internal_self();
+    qt_timer_wheel_t      *w;
+    qt_timer_node_t        node;
+    qthread_shepherd_id_t  shep;
+
+    assert(me);
+    assert(me->rdata);
+    if (nsec == 0) {
+        qthread_yield();
+        return;
+    }
+    /* the first tick that starts after the sleep is over */
+    node.thread   = me;
+    node.deadline = qt_timer_ticks(qtimer_wtime() + nsec * 1e-9) + 1;
+    shep          = me->rdata->shepherd_ptr->shepherd_id;
+    w             = &wheels[shep];
+    qt_timer_hold(w, shep);
+    qthread_debug(THREAD_DETAILS, "thread %u sleeping until tick %lu\n", me->thread_id, (unsigned long)node.deadline);
+    me->rdata->blockedon.timer = &node;
+    me->thread_state           = QTHREAD_STATE_SLEEPING;
+    qthread_back_to_master(me);
+} /*}}}*/
+
+static qthread_timer_t *qt_timer_start(uint64_t    delay,
+                                       uint64_t    period,
+                                       qthread_f   f,
+                                       const void *arg,
+                                       aligned_t  *ret)
+{   /*{{{*/
+    qthread_t        *me = qthread_internal_self();
+    qthread_timer_t  *timer;
+    qt_timer_wheel_t *w;
+
+    assert(wheels);
+    qassert_ret((f != NULL), NULL);
+    timer = qt_malloc(sizeof(qthread_timer_t));
+    qassert_ret(timer, NULL);
+    timer->node.thread   = NULL;
+    timer->f             = f;
+    timer->arg           = arg;
+    timer->ret           = ret;
+    timer->due           = qtimer_wtime() - epoch + delay * 1e-9;
+    timer->period        = period * 1e-9;
+    timer->node.deadline = qt_timer_ticks_at(timer->due);
+    /* tasks that are not running on a shepherd use the first one's wheel */
+    timer->shep  = (me && me->rdata) ? me->rdata->shepherd_ptr->shepherd_id : 0;
+    timer->state = QT_TIMER_ARMED;
+    if (ret) { qthread_empty(ret); }
+    qthread_debug(THREAD_CALLS, "timer %p: f(%p), arg(%p), due at tick %lu, period %f\n", timer, f, arg, (unsigned long)timer->node.deadline, timer->period);
+
+    w = &wheels[timer->shep];
+    qt_timer_hold(w, timer->shep);
+    qt_timer_file(w, &qlib->shepherds[timer->shep], &timer->node);
+    return timer;
+} /*}}}*/
+
+qthread_timer_t API_FUNC *qthread_spawn_after(uint64_t    delay,
+                                              qthread_f   f,
+                                              const void *arg,
+                                              aligned_t  *ret)
+{   /*{{{*/
+    return qt_timer_start(delay, 0, f, arg, ret);
+} /*}}}*/
+
+qthread_timer_t API_FUNC *qthread_spawn_periodic(uint64_t    period,
+                                                 qthread_f   f,
+                                                 const void *arg)
+{   /*{{{*/
+    if (period == 0) { return NULL; }
+    return qt_timer_start(period, period, f, arg, NULL);
+} /*}}}*/
+
+int API_FUNC qthread_timer_cancel(qthread_timer_t *timer)
+{   /*{{{*/
+    qt_timer_wheel_t *w;
+    qt_timer_state_t  state;
+    int               periodic;
+
+    qassert_ret((timer != NULL), QTHREAD_BADARGS);
+    w = &wheels[timer->shep];
+    QTHREAD_TRYLOCK_LOCK(&w->lock);
+    state    = timer->state;
+    periodic = (timer->period > 0);
+    switch (state) {
+        case QT_TIMER_ARMED:
+            qt_timer_unlink(w, &timer->node);
+            break;
+        case QT_TIMER_FIRING:
+            /* the firer frees it once the task has been forked */
+            timer->state = QT_TIMER_CANCELLED;
+            break;
+        default:
+            assert(state == QT_TIMER_DONE);
+            break;
+    }
+    QTHREAD_TRYLOCK_UNLOCK(&w->lock);
+    qthread_debug(THREAD_CALLS, "timer %p cancelled in state %i\n", timer, (int)state);
+
+    switch (state) {
+        case QT_TIMER_ARMED:
+            qt_timer_drop(w);
+            if (timer->ret) { qthread_fill(timer->ret); }
+            qt_free(timer);
+            return QTHREAD_SUCCESS;
+
+        case QT_TIMER_FIRING:
+            /* a periodic timer forks nothing more, but it is too late for a
+             * one-shot timer */
+            return periodic ? QTHREAD_SUCCESS : QTHREAD_OPFAIL;
+
+        default:
+            qt_free(timer);
+            return QTHREAD_OPFAIL;
+    }
+} /*}}}*/
+
+/* vim:set expandtab: */
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qpool.h>
+#include "argparsing.h"
+
+#define NUM_TASKS 64
+#define CYCLES    2000
+
+static aligned_t       x;
+static aligned_t       words[NUM_TASKS];
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  done_cond = PTHREAD_COND_INITIALIZER;
+static volatile int    looked    = 0;
+static int             done      = 0;
+
+/* FEB calls from a thread that is not a worker, which then sticks around
+ * without ever making another one */
+static void *outsider(void *arg)
+{
+    assert(qthread_feb_status(&x) == 0);
+    qthread_fill(&x);
+    assert(qthread_feb_status(&x) == 1);
+
+    pthread_mutex_lock(&done_lock);
+    looked = 1;
+    while (!done) {
+        pthread_cond_wait(&done_cond, &done_lock);
+    }
+    pthread_mutex_unlock(&done_lock);
+    return NULL;
+}
+
+/* each empty puts an addrstat in the hash, and each fill takes it out */
+static aligned_t cycler(void *arg)
+{
+    aligned_t *w = (aligned_t *)arg;
+
+    for (int i = 0; i < CYCLES; i++) {
+        qthread_empty(w);
+        qthread_fill(w);
+    }
+    return 0;
+}
+
+static size_t outstanding(const char *name)
+{
+    qpool_stats_t *stats;
+    size_t         npools, ret = 0;
+
+    npools = qpool_stats_all(NULL, 0);
+    stats  = calloc(npools, sizeof(qpool_stats_t));
+    assert(stats);
+    npools = qpool_stats_all(stats, npools);
+    for (size_t i = 0; i < npools; i++) {
+        if (stats[i].name && !strcmp(stats[i].name, name)) {
+            ret += stats[i].outstanding;
+        }
+    }
+    free(stats);
+    return ret;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    pthread_t thread;
+    aligned_t rets[NUM_TASKS];
+    size_t    addrstats, entries;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+
+    qthread_empty(&x);
+    pthread_create(&thread, NULL, outsider, NULL);
+    /* the outsider's fill needs a worker, and this is one */
+    while (!looked) {
+        qthread_yield();
+    }
+
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(cycler, &words[i], &rets[i]);
+    }
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+
+    /* what was retired has been reclaimed, rather than held back by the
+     * outsider */
+    addrstats = outstanding("generic_addrstat_pool");
+    entries   = outstanding("hash_entry_pool");
+    iprintf("%lu addrstats and %lu hash entries outstanding after %lu cycles\n",
+            (unsigned long)addrstats, (unsigned long)entries,
+            (unsigned long)NUM_TASKS * CYCLES);
+    assert(addrstats < NUM_TASKS * CYCLES / 4);
+    assert(entries < NUM_TASKS * CYCLES / 4);
+
+    pthread_mutex_lock(&done_lock);
+    done = 1;
+    pthread_cond_broadcast(&done_cond);
+    pthread_mutex_unlock(&done_lock);
+    pthread_join(thread, NULL);
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+#define NUM_WORDS  256
+#define ITERATIONS 200
+
+static aligned_t words[NUM_WORDS];
+static aligned_t pingpong;
+static aligned_t held;
+
+/* empties and refills its own word over and over, which is what leaves its
+ * addrstat lingering in the hash */
+static aligned_t toggler(void *arg)
+{
+    aligned_t *w = &words[(uintptr_t)arg];
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        aligned_t v;
+
+        qthread_readFE(&v, w);
+        v++;
+        qthread_writeEF(w, &v);
+    }
+    return 0;
+}
+
+/* blocks on pingpong while its addrstat may be swept */
+static aligned_t consumer(void *arg)
+{
+    aligned_t sum = 0;
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        aligned_t v;
+
+        qthread_readFE(&v, &pingpong);
+        sum += v;
+    }
+    return sum;
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t rets[NUM_WORDS];
+    aligned_t sum;
+
+    setenv("QT_FEB_LINGER", "2", 1);
+    assert(qthread_initialize() == 0);
+
+    CHECK_VERBOSE();
+
+    /* an empty word must survive any number of sweeps */
+    qthread_empty(&held);
+    assert(qthread_feb_status(&held) == 0);
+
+    qthread_empty(&pingpong);
+    qthread_fork(consumer, NULL, &sum);
+    for (uintptr_t i = 0; i < NUM_WORDS; i++) {
+        qthread_fork(toggler, (void *)i, &rets[i]);
+    }
+    for (aligned_t i = 1; i <= ITERATIONS; i++) {
+        qthread_writeEF(&pingpong, &i);
+    }
+    for (int i = 0; i < NUM_WORDS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    qthread_readFF(NULL, &sum);
+    iprintf("consumer saw %lu\n", (unsigned long)sum);
+    assert(sum == ITERATIONS * (ITERATIONS + 1) / 2);
+
+    for (int i = 0; i < NUM_WORDS; i++) {
+        assert(words[i] == ITERATIONS);
+        assert(qthread_feb_status(&words[i]) == 1);
+    }
+    assert(qthread_feb_status(&pingpong) == 0);
+    assert(qthread_feb_status(&held) == 0);
+    qthread_fill(&held);
+    qthread_fill(&pingpong);
+    assert(qthread_feb_status(&held) == 1);
+
+    /* and the words that are still lingering must still work */
+    for (int i = 0; i < NUM_WORDS; i++) {
+        qthread_fork(toggler, (void *)(uintptr_t)i, &rets[i]);
+    }
+    for (int i = 0; i < NUM_WORDS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(words[i] == 2 * ITERATIONS);
+    }
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+#define NUM_READERS 8
+#define NUM_ADDRS   64
+
+static aligned_t x;
+static aligned_t many[NUM_ADDRS];
+static syncvar_t sv = SYNCVAR_STATIC_EMPTY_INITIALIZER;
+static aligned_t started;
+
+static aligned_t feb_reader(void *arg)
+{
+    qthread_incr(&started, 1);
+    qthread_readFF(NULL, &x);
+    return 0;
+}
+
+static aligned_t addr_reader(void *arg)
+{
+    qthread_incr(&started, 1);
+    qthread_readFF(NULL, (aligned_t *)arg);
+    return 0;
+}
+
+static aligned_t syncvar_reader(void *arg)
+{
+    qthread_incr(&started, 1);
+    qthread_syncvar_readFF(NULL, &sv);
+    return 0;
+}
+
+/* Returns the number of waits recorded for addr in a CSV dump. */
+static unsigned long waits_for(const char *filename,
+                               void       *addr)
+{
+    FILE         *fp = fopen(filename, "r");
+    char          line[1024];
+    unsigned long ret = 0;
+
+    assert(fp);
+    while (fgets(line, sizeof(line), fp)) {
+        void         *a, *f;
+        unsigned long waits;
+
+        if ((line[0] == '#') || (strncmp(line, "address,", 8) == 0)) { continue; }
+        assert(sscanf(line, "%p,%p,%lu", &a, &f, &waits) == 3);
+        if (a == addr) { ret += waits; }
+    }
+    fclose(fp);
+    return ret;
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    char      filename[] = "/tmp/qt_feb_profileXXXXXX";
+    aligned_t rets[2 * NUM_READERS];
+    aligned_t many_rets[NUM_ADDRS];
+    int       fd;
+
+    /* one worker, so that every reader has blocked before the fill */
+    setenv("QT_FEB_PROFILE", "1", 1);
+    setenv("QT_FEB_PROFILE_DUMP_AT_EXIT", "0", 1);
+    setenv("QT_NUM_SHEPHERDS", "1", 1);
+    setenv("QT_NUM_WORKERS_PER_SHEPHERD", "1", 1);
+    assert(qthread_initialize() == 0);
+
+    CHECK_VERBOSE();
+
+    fd = mkstemp(filename);
+    assert(fd >= 0);
+    close(fd);
+
+    qthread_empty(&x);
+    for (int i = 0; i < NUM_READERS; i++) {
+        qthread_fork(feb_reader, NULL, &rets[i]);
+        qthread_fork(syncvar_reader, NULL, &rets[NUM_READERS + i]);
+    }
+    while (started != 2 * NUM_READERS) qthread_yield();
+    qthread_fill(&x);
+    qthread_syncvar_fill(&sv);
+    for (int i = 0; i < 2 * NUM_READERS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+
+    assert(qthread_feb_profile_dump(filename, QTHREAD_FEB_PROFILE_JSON) == QTHREAD_SUCCESS);
+    assert(qthread_feb_profile_dump(filename, 42) == QTHREAD_BADARGS);
+    assert(qthread_feb_profile_dump(filename, QTHREAD_FEB_PROFILE_CSV) == QTHREAD_SUCCESS);
+    iprintf("waits on x: %lu, on sv: %lu\n", waits_for(filename, &x), waits_for(filename, &sv));
+    assert(waits_for(filename, &x) == NUM_READERS);
+    assert(waits_for(filename, &sv) == NUM_READERS);
+
+    qthread_feb_profile_reset();
+    assert(qthread_feb_profile_dump(filename, QTHREAD_FEB_PROFILE_CSV) == QTHREAD_SUCCESS);
+    assert(waits_for(filename, &x) == 0);
+    assert(waits_for(filename, &sv) == 0);
+
+    /* more addresses than the tables start out with room for */
+    started = 0;
+    for (int i = 0; i < NUM_ADDRS; i++) {
+        qthread_empty(&many[i]);
+        qthread_fork(addr_reader, &many[i], &many_rets[i]);
+    }
+    while (started != NUM_ADDRS) qthread_yield();
+    for (int i = 0; i < NUM_ADDRS; i++) {
+        qthread_fill(&many[i]);
+        qthread_readFF(NULL, &many_rets[i]);
+    }
+    assert(qthread_feb_profile_dump(filename, QTHREAD_FEB_PROFILE_CSV) == QTHREAD_SUCCESS);
+    for (int i = 0; i < NUM_ADDRS; i++) {
+        assert(waits_for(filename, &many[i]) == 1);
+    }
+
+    unlink(filename);
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
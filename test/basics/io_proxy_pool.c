@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include <qthread/io.h>
+#include "argparsing.h"
+
+#define NUM_TASKS 32
+#define MIN_PROXIES 2
+#define MAX_PROXIES 4
+
+/* stands in for a call that blocks for a millisecond */
+static aligned_t blocker(void *arg)
+{
+    qt_begin_blocking_action();
+    {
+        double start = qtimer_wtime();
+
+        while (qtimer_wtime() - start < 1e-3) ;
+    }
+    qt_end_blocking_action();
+    return 0;
+}
+
+static void burst(void)
+{
+    aligned_t rets[NUM_TASKS];
+
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(blocker, NULL, &rets[i]);
+    }
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+}
+
+/* waits for the pool to shrink to its warm minimum; the deadline is only
+ * there so that a pool that never shrinks fails rather than hangs */
+static void settle(qt_io_stats_t *s)
+{
+    double start = qtimer_wtime();
+
+    qt_io_stats(s);
+    while (s->proxies > MIN_PROXIES && qtimer_wtime() - start < 30.0) {
+        usleep(1000);
+        qt_io_stats(s);
+    }
+}
+
+static void print_stats(const char   *when,
+                        qt_io_stats_t *s)
+{
+    iprintf("%s: %lu proxies (%lu idle), %lu queued, %lu jobs, %lu spawned, %lu retired, wait avg %g max %g\n",
+            when,
+            (unsigned long)s->proxies, (unsigned long)s->idle_proxies,
+            (unsigned long)s->queued, (unsigned long)s->jobs,
+            (unsigned long)s->spawned, (unsigned long)s->retired,
+            s->wait_avg, s->wait_max);
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    qt_io_stats_t s1, s2;
+
+    setenv("QT_MIN_IO_WORKERS", "2", 1);
+    setenv("QT_MAX_IO_WORKERS", "4", 1);
+    /* long enough that no proxy retires in the middle of a burst */
+    setenv("QT_IO_SHRINK_INTERVAL", "100000", 1);
+    assert(qthread_initialize() == 0);
+
+    CHECK_VERBOSE();
+
+    /* the warm proxies are started up front */
+    qt_io_stats(&s1);
+    print_stats("initialized", &s1);
+    assert(s1.min_proxies == MIN_PROXIES);
+    assert(s1.max_proxies == MAX_PROXIES);
+    assert(s1.jobs == 0);
+    assert(s1.proxies == MIN_PROXIES);
+    assert(s1.spawned == MIN_PROXIES);
+
+    burst();
+    qt_io_stats(&s1);
+    print_stats("after a burst", &s1);
+    assert(s1.jobs == NUM_TASKS);
+    assert(s1.spawned >= MIN_PROXIES);
+    assert(s1.proxies >= MIN_PROXIES && s1.proxies <= MAX_PROXIES);
+    assert(s1.wait_max > 0);
+
+    /* idle proxies beyond the minimum retire, and the warm ones stay */
+    settle(&s1);
+    print_stats("settled", &s1);
+    assert(s1.proxies == MIN_PROXIES);
+    assert(s1.retired == s1.spawned - MIN_PROXIES);
+    assert(s1.queued == 0);
+
+    /* another burst starts on the warm proxies, so it spawns no more than
+     * it takes to get back to the maximum (plus one for each proxy that
+     * managed to retire in the middle of it) */
+    burst();
+    qt_io_stats(&s2);
+    print_stats("after another burst", &s2);
+    assert(s2.jobs == 2 * NUM_TASKS);
+    assert(s2.spawned - s1.spawned <= MAX_PROXIES - MIN_PROXIES + (s2.retired - s1.retired));
+    settle(&s2);
+    print_stats("settled again", &s2);
+    assert(s2.proxies == MIN_PROXIES);
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
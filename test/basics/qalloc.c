@@ -4,12 +4,44 @@
 
 #include <qthread/qalloc.h>
 
+#include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <inttypes.h>
 #include <string.h>
 
+#define THREADS 4
+#define ITEMS   64
+
+static void *concurrent_map;
+
+/* each thread fills its allocations with its own byte, so that overlapping
+ * allocations show up as corruption */
+static void *hammer(void *arg)
+{
+    const unsigned char me = (unsigned char)(uintptr_t)arg;
+    char               *items[ITEMS];
+    size_t              sizes[ITEMS];
+
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < ITEMS; i++) {
+            sizes[i] = (i % 4 == 0) ? 2048 * (1 + i % 3) + 100 : 8 + i;
+            items[i] = qalloc_malloc(concurrent_map, sizes[i]);
+            assert(items[i] != NULL);
+            memset(items[i], me, sizes[i]);
+        }
+        for (int i = 0; i < ITEMS; i++) {
+            for (size_t j = 0; j < sizes[i]; j++) {
+                assert((unsigned char)items[i][j] == me);
+            }
+            qalloc_free(items[i], concurrent_map);
+        }
+    }
+    return NULL;
+}
+
 int main(int argc,
          char *argv[])
 {
@@ -69,7 +101,45 @@ int main(int argc,
         return -1;
     }
     memset(ts2, 0x55, 128);
+    assert(qalloc_sync(ts2, 128) == 0);
     qalloc_free(ts2, r2);
+
+    /* several threads allocating from one map at once */
+    {
+        char      fileconc[30] = "/tmp/testqallocconcXXXXXX";
+        pthread_t threads[THREADS];
+        size_t    left, steps = 0;
+        char     *big;
+
+        if ((fd = mkstemp(fileconc)) == -1) {
+            perror("mktemp fileconc");
+            return -1;
+        }
+        close(fd);
+        concurrent_map = qalloc_makedynmap(size * 4, NULL, fileconc, THREADS);
+        assert(concurrent_map != NULL);
+        for (uintptr_t i = 0; i < THREADS; i++) {
+            assert(pthread_create(&threads[i], NULL, hammer, (void *)(i + 1)) == 0);
+        }
+        for (int i = 0; i < THREADS; i++) {
+            assert(pthread_join(threads[i], NULL) == 0);
+        }
+        /* everything was freed, so a large allocation must fit again */
+        big = qalloc_malloc(concurrent_map, size / 2);
+        assert(big != NULL);
+        memset(big, 0xaa, size / 2);
+        /* sync it a megabyte at a time */
+        do {
+            left = qalloc_checkpoint_incremental(concurrent_map, 1024 * 1024);
+            steps++;
+        } while (left > 0);
+        assert(steps >= 16);
+        qalloc_free(big, concurrent_map);
+        if (unlink(fileconc) != 0) {
+            perror("unlinking fileconc");
+            return -1;
+        }
+    }
     qalloc_cleanup();
     /* the following is just so that it can be used in the automake test: */
     if (unlink(filestat) != 0) {
@@ -256,6 +256,34 @@ int main(int   argc,
         }
     }
 
+    iprintf("\n***** Test mixed full/empty inputs, filled in reverse *****\n");
+    {
+        aligned_t ret;
+
+        // Even inputs start full, odd ones are filled last-to-first
+        aligned_t  v[2 * NUM_MULTI];
+        aligned_t *vptr[2 * NUM_MULTI];
+        for (int i = 0; i < 2 * NUM_MULTI; i++) {
+            vptr[i] = &v[i];
+            v[i]    = 42;
+            if (i & 1) { qthread_empty(&v[i]); }
+        }
+
+        qthread_fork_precond(array_consumer, v, &ret, -2 * NUM_MULTI, vptr);
+        for (int i = 2 * NUM_MULTI - 1; i >= 0; i -= 2) {
+            assert(qthread_feb_status(&ret) == 0);
+            qthread_fork(array_producer, &v[i], NULL);
+        }
+
+        qthread_readFF(&ret, &ret);
+
+        // Verify return value
+        if (ret != NUM_MULTI * 42) {
+            iprintf("Bad return value! Wanted %u, got %u\n", NUM_MULTI * 42, (unsigned int)ret);
+            return 1;
+        }
+    }
+
     iprintf("Success!\n");
 
     return 0;
@@ -0,0 +1,84 @@
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include <qthread/qt_syscalls.h>
+#include "argparsing.h"
+
+#define MSEC 1000000ULL /* in nanoseconds */
+
+static aligned_t beats;
+static aligned_t never;
+static double    started;
+
+static aligned_t late(void *arg)
+{
+    return (aligned_t)((qtimer_wtime() - started) * 1e6);
+}
+
+static aligned_t heartbeat(void *arg)
+{
+    qthread_incr(&beats, 1);
+    return 0;
+}
+
+static aligned_t cancelled(void *arg)
+{
+    qthread_incr(&never, 1);
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    qthread_timer_t *timer, *periodic;
+    aligned_t        ret, count;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+
+    /* a one-shot timer spawns its task no sooner than asked */
+    started = qtimer_wtime();
+    timer   = qthread_spawn_after(5 * MSEC, late, NULL, &ret);
+    assert(timer);
+    qthread_readFF(&ret, &ret);
+    iprintf("spawned after %lu usecs\n", (unsigned long)ret);
+    assert(ret >= 5000);
+    assert(qthread_timer_cancel(timer) == QTHREAD_OPFAIL);
+
+    /* one cancelled in time never spawns, and its return value is filled */
+    ret   = 7;
+    timer = qthread_spawn_after(10 * MSEC, cancelled, NULL, &ret);
+    assert(timer);
+    assert(qthread_timer_cancel(timer) == QTHREAD_SUCCESS);
+    qthread_readFF(NULL, &ret);
+    assert(ret == 7);
+
+    /* a periodic timer keeps spawning until it is cancelled; how many beats
+     * that makes depends on the load, so only that there were some counts */
+    periodic = qthread_spawn_periodic(1 * MSEC, heartbeat, NULL);
+    assert(periodic);
+    while (beats < 2) {
+        qt_usleep(1000);
+    }
+    assert(qthread_timer_cancel(periodic) == QTHREAD_SUCCESS);
+    qt_usleep(2000); /* for a beat that was being spawned at the time */
+    count = beats;
+    iprintf("%lu beats\n", (unsigned long)count);
+    assert(count > 0);
+    qt_usleep(5000);
+    assert(beats == count);
+    assert(never == 0);
+
+    assert(qthread_spawn_periodic(0, heartbeat, NULL) == NULL);
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
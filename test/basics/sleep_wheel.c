@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include <qthread/qt_syscalls.h>
+#include <qthread/io.h>
+#include "argparsing.h"
+
+#define NUM_TASKS 64
+#define MSEC      1000000ULL /* in nanoseconds */
+
+static aligned_t woken;
+
+/* each task sleeps for a different time; with the default 100us tick, the
+ * longest of them are parked in the second level of the wheel and cascaded
+ * down, and with a 1us tick, in the third */
+static aligned_t sleeper(void *arg)
+{
+    const unsigned int usecs = (unsigned int)(uintptr_t)arg;
+    double             start = qtimer_wtime();
+    double             slept;
+
+    assert(qt_usleep(usecs) == 0);
+    slept = qtimer_wtime() - start;
+    assert(slept >= usecs * 1e-6);
+    qthread_incr(&woken, 1);
+    return 0;
+}
+
+static aligned_t napper(void *arg)
+{
+    struct timespec req = { 0, 2000000 };
+    struct timespec rem = { 1, 1 };
+    double          start = qtimer_wtime();
+
+    assert(qt_nanosleep(&req, &rem) == 0);
+    assert(qtimer_wtime() - start >= 2e-3);
+    assert(rem.tv_sec == 0 && rem.tv_nsec == 0);
+
+    req.tv_nsec = 1000000000L;
+    assert(qt_nanosleep(&req, NULL) == -1);
+    return 0;
+}
+
+static aligned_t never(void *arg)
+{
+    assert(0);
+    return 0;
+}
+
+static void run_sleepers(void)
+{
+    aligned_t     rets[NUM_TASKS + 1];
+    qt_io_stats_t s;
+    double        start;
+
+    woken = 0;
+    start = qtimer_wtime();
+    for (int i = 0; i < NUM_TASKS; i++) {
+        /* from 0 up to about 20ms */
+        qthread_fork(sleeper, (void *)(uintptr_t)((i * 7919) % 20000), &rets[i]);
+    }
+    qthread_fork(napper, NULL, &rets[NUM_TASKS]);
+    for (int i = 0; i < NUM_TASKS + 1; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    iprintf("%i sleepers done in %f secs\n", (int)woken, qtimer_wtime() - start);
+    assert(woken == NUM_TASKS);
+
+    /* the sleeps, including the main thread's, did not use the proxies */
+    assert(qt_usleep(1000) == 0);
+    qt_io_stats(&s);
+    iprintf("%lu proxy jobs\n", (unsigned long)s.jobs);
+    assert(s.jobs == 0);
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    qthread_timer_t *far;
+    aligned_t        ret;
+    double           start;
+
+    assert(qthread_initialize() == 0);
+    CHECK_VERBOSE();
+    run_sleepers();
+    qthread_finalize();
+
+    /* a 1us tick, so that the wheel's upper levels are reached in time */
+    setenv("QT_TIMER_TICK", "1", 1);
+    assert(qthread_initialize() == 0);
+    run_sleepers();
+
+    /* more than 2^24 ticks out, which is further than the wheel reaches, so
+     * it is parked at the far end of the top level */
+    far = qthread_spawn_after(30000 * MSEC, never, NULL, &ret);
+    assert(far);
+
+    /* over 2^18 ticks, so parked in the top level and cascaded all the way
+     * down */
+    start = qtimer_wtime();
+    assert(qt_usleep(300000) == 0);
+    iprintf("slept for %f secs\n", qtimer_wtime() - start);
+    assert(qtimer_wtime() - start >= 0.3);
+
+    assert(qthread_timer_cancel(far) == QTHREAD_SUCCESS);
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
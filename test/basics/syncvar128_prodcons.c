@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+static syncvar128_t x  = SYNCVAR128_STATIC_EMPTY_INITIALIZER;
+static syncvar128_t id = SYNCVAR128_STATIC_INITIALIZER;
+static syncvar128_t counter = SYNCVAR128_STATIC_INITIALIZE_TO(0);
+static uint64_t     readout = 0;
+
+#define BIGVAL 0xfedcba9876543210ULL
+
+static aligned_t consumer(void *arg)
+{
+    uint64_t me;
+
+    iprintf("consumer locking id(%p)\n", &id);
+    qthread_syncvar128_readFE(&me, &id);
+    me++;
+    qthread_syncvar128_writeEF(&id, &me);
+
+    iprintf("consumer readFF on x\n");
+    qthread_syncvar128_readFF(&readout, &x);
+
+    return 0;
+}
+
+static aligned_t producer(void *arg)
+{
+    uint64_t me;
+    uint64_t res = BIGVAL;
+
+    iprintf("producer locking id(%p)\n", &id);
+    qthread_syncvar128_readFE(&me, &id);
+    me++;
+    qthread_syncvar128_writeEF(&id, &me);
+
+    iprintf("producer filling x(%p)\n", &x);
+    qthread_syncvar128_writeEF(&x, &res);
+
+    return 0;
+}
+
+static aligned_t incrementer(void *arg)
+{
+    uint64_t v;
+
+    qthread_syncvar128_readFE(&v, &counter);
+    qthread_syncvar128_writeEF_const(&counter, v + 1);
+    return 0;
+}
+
+int main(int argc,
+         char *argv[])
+{
+    aligned_t  t;
+    aligned_t *rets;
+    uint64_t   tmp = 0;
+    unsigned   iterations = 1000;
+    double     d = 3.141592653589793, d2;
+
+    assert(qthread_initialize() == 0);
+
+    CHECK_VERBOSE();
+    NUMARG(iterations, "ITERATIONS");
+
+    iprintf("%i threads...\n", qthread_num_shepherds());
+
+    /* the full 64 bits survive a round trip */
+    qthread_syncvar128_writeF_const(&id, UINT64_MAX);
+    qthread_syncvar128_readFF(&tmp, &id);
+    assert(tmp == UINT64_MAX);
+    assert(qthread_syncvar128_status(&id) == 1);
+
+    memcpy(&tmp, &d, sizeof(double));
+    qthread_syncvar128_writeF(&id, &tmp);
+    qthread_syncvar128_readFE(&tmp, &id);
+    memcpy(&d2, &tmp, sizeof(double));
+    assert(d == d2);
+    assert(qthread_syncvar128_status(&id) == 0);
+    qthread_syncvar128_fill(&id);
+    assert(qthread_syncvar128_status(&id) == 1);
+    qthread_syncvar128_empty(&id);
+    assert(qthread_syncvar128_status(&id) == 0);
+    qthread_syncvar128_writeEF_const(&id, 1);
+
+    /* blocking readFF/readFE/writeEF */
+    assert(qthread_syncvar128_status(&x) == 0);
+    qthread_fork(consumer, NULL, &t);
+    qthread_fork(producer, NULL, NULL);
+    qthread_readFF(NULL, &t);
+    qthread_syncvar128_readFF(&tmp, &x);
+    assert(tmp == BIGVAL);
+    assert(readout == BIGVAL);
+    qthread_syncvar128_readFF(&tmp, &id);
+    assert(tmp == 3);
+
+    /* lots of contended readFE/writeEF pairs */
+    rets = malloc(sizeof(aligned_t) * iterations);
+    assert(rets);
+    for (unsigned i = 0; i < iterations; i++) {
+        qthread_fork(incrementer, NULL, &rets[i]);
+    }
+    for (unsigned i = 0; i < iterations; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    free(rets);
+    qthread_syncvar128_readFF(&tmp, &counter);
+    iprintf("counter = %lu (expected %u)\n", (unsigned long)tmp, iterations);
+    assert(tmp == iterations);
+
+    tmp = qthread_syncvar128_incrF(&counter, UINT64_MAX - iterations);
+    assert(tmp == UINT64_MAX);
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
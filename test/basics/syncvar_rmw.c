@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+static syncvar_t counter = SYNCVAR_STATIC_INITIALIZER;
+static syncvar_t gate    = SYNCVAR_STATIC_EMPTY_INITIALIZER;
+static syncvar_t busy    = SYNCVAR_STATIC_INITIALIZE_TO(10);
+
+static aligned_t adder(void *arg)
+{
+    qthread_syncvar_fetch_addF(&counter, 1);
+    return 0;
+}
+
+static aligned_t gated_adder(void *arg)
+{
+    return qthread_syncvar_fetch_addF(&gate, 5);
+}
+
+static aligned_t blocked_writer(void *arg)
+{
+    qthread_syncvar_writeEF_const(&busy, 100);
+    return 0;
+}
+
+int main(int argc,
+         char *argv[])
+{
+    syncvar_t  v = SYNCVAR_STATIC_INITIALIZE_TO(12);
+    uint64_t   tmp;
+    aligned_t  t;
+    aligned_t *rets;
+    unsigned   iterations = 1000;
+
+    assert(qthread_initialize() == 0);
+
+    CHECK_VERBOSE();
+    NUMARG(iterations, "ITERATIONS");
+
+    iprintf("%i threads...\n", qthread_num_shepherds());
+
+    /* sequential semantics */
+    assert(qthread_syncvar_fetch_addF(&v, 3) == 12);
+    assert(qthread_syncvar_fetch_andF(&v, 0x6) == 15);
+    assert(qthread_syncvar_fetch_orF(&v, 0x10) == 6);
+    assert(qthread_syncvar_fetch_xorF(&v, 0x3) == 0x16);
+    assert(qthread_syncvar_fetch_minF(&v, 7) == 0x15);
+    assert(qthread_syncvar_fetch_maxF(&v, 9) == 7);
+    assert(qthread_syncvar_fetch_maxF(&v, 2) == 9);
+    assert(qthread_syncvar_swapF(&v, 40) == 9);
+    assert(qthread_syncvar_cmpxchgF(&v, 41, 50) == 40);
+    assert(qthread_syncvar_cmpxchgF(&v, 40, 50) == 40);
+    qthread_syncvar_readFF(&tmp, &v);
+    assert(tmp == 50);
+    assert(qthread_syncvar_status(&v) == 1);
+    /* results wrap at 60 bits */
+    qthread_syncvar_swapF(&v, (UINT64_C(1) << 60) - 1);
+    assert(qthread_syncvar_fetch_addF(&v, 1) == (UINT64_C(1) << 60) - 1);
+    qthread_syncvar_readFF(&tmp, &v);
+    assert(tmp == 0);
+
+    /* contended adds never lose an update */
+    rets = malloc(sizeof(aligned_t) * iterations);
+    assert(rets);
+    for (unsigned i = 0; i < iterations; i++) {
+        qthread_fork(adder, NULL, &rets[i]);
+    }
+    for (unsigned i = 0; i < iterations; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    free(rets);
+    qthread_syncvar_readFF(&tmp, &counter);
+    iprintf("counter = %lu (expected %u)\n", (unsigned long)tmp, iterations);
+    assert(tmp == iterations);
+
+    /* an op on an empty syncvar waits for it to be filled */
+    qthread_fork(gated_adder, NULL, &t);
+    qthread_syncvar_writeEF_const(&gate, 2);
+    qthread_readFF(&t, &t);
+    assert(t == 2);
+    qthread_syncvar_readFF(&tmp, &gate);
+    assert(tmp == 7);
+
+    /* an op on a syncvar with queued writers leaves them queued */
+    qthread_fork(blocked_writer, NULL, &t);
+    while (busy.u.s.state == 0) {        /* wait for the writer to queue up */
+        qthread_yield();
+    }
+    assert(qthread_syncvar_fetch_addF(&busy, 1) == 10);
+    qthread_syncvar_readFE(&tmp, &busy);
+    assert(tmp == 11);
+    qthread_readFF(NULL, &t);
+    qthread_syncvar_readFF(&tmp, &busy);
+    assert(tmp == 100);
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
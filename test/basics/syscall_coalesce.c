@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qtimer.h>
+#include <qthread/qt_syscalls.h>
+#include <qthread/io.h>
+#include "argparsing.h"
+
+#define NUM_TASKS 16
+#define RECORD    8
+
+static int       filefd;
+static int       streamfd;
+static int       holding;
+static aligned_t next_slot;
+static aligned_t bad_task = NUM_TASKS; /* which pwrite gets a bad buffer */
+
+/* keeps the only proxy busy until every writer's job is queued behind it */
+static aligned_t holder(void *arg)
+{
+    qt_begin_blocking_action();
+    {
+        qt_io_stats_t s;
+        double        start = qtimer_wtime();
+
+        holding = 1;
+        do {
+            qt_io_stats(&s);
+        } while (s.queued < NUM_TASKS && qtimer_wtime() - start < 1.0);
+    }
+    qt_end_blocking_action();
+    return 0;
+}
+
+static void wait_for_holder(void)
+{
+    while (!holding) {
+        qthread_yield();
+    }
+}
+
+/* one record per task, appended to a stream */
+static aligned_t appender(void *arg)
+{
+    const int i = (int)(intptr_t)arg;
+    char      rec[RECORD];
+
+    memset(rec, 'a' + i, RECORD - 1);
+    rec[RECORD - 1] = '\n';
+    wait_for_holder();
+    assert(qt_write(streamfd, rec, RECORD) == RECORD);
+    return 0;
+}
+
+/* one record per task, at the next place in the file, so that the writes are
+ * queued in the order of their offsets */
+static aligned_t placer(void *arg)
+{
+    const int i = (int)(intptr_t)arg;
+    char      rec[RECORD];
+    off_t     offset;
+
+    memset(rec, 'A' + i, RECORD);
+    wait_for_holder();
+    offset = (off_t)qthread_incr(&next_slot, 1) * RECORD;
+    if (i == bad_task) {
+        /* a bad buffer fails only its own write */
+        errno = 0;
+        assert(qt_pwrite(filefd, NULL, RECORD, offset) == -1);
+        assert(errno == EFAULT);
+    } else {
+        assert(qt_pwrite(filefd, rec, RECORD, offset) == RECORD);
+    }
+    return 0;
+}
+
+/* every record made it to the file exactly once, in one piece */
+static void check_records(int  fd,
+                          char first)
+{
+    char buf[NUM_TASKS * RECORD];
+    int  seen[NUM_TASKS];
+
+    assert(pread(fd, buf, sizeof(buf), 0) == sizeof(buf));
+    memset(seen, 0, sizeof(seen));
+    for (int i = 0; i < NUM_TASKS; i++) {
+        const char *rec = buf + i * RECORD;
+        const int   t   = rec[0] - first;
+
+        assert(t >= 0 && t < NUM_TASKS);
+        assert(!seen[t]);
+        seen[t] = 1;
+        for (int j = 1; j < RECORD - 1; j++) {
+            assert(rec[j] == rec[0]);
+        }
+    }
+}
+
+static void run(qthread_f f)
+{
+    aligned_t rets[NUM_TASKS + 1];
+
+    holding   = 0;
+    next_slot = 0;
+    qthread_fork(holder, NULL, &rets[NUM_TASKS]);
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(f, (void *)(intptr_t)i, &rets[i]);
+    }
+    for (int i = 0; i < NUM_TASKS + 1; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    char          filename[] = "/tmp/qt_syscall_coalesceXXXXXX";
+    char          stream[]   = "/tmp/qt_syscall_coalesceXXXXXX";
+    qt_io_stats_t s;
+    uint64_t      coalesced;
+
+    CHECK_VERBOSE();
+
+    filefd = mkstemp(filename);
+    assert(filefd >= 0);
+    unlink(filename);
+    streamfd = mkstemp(stream);
+    assert(streamfd >= 0);
+    unlink(stream);
+
+    /* the writes must queue up for a single proxy thread */
+    setenv("QT_NUM_SHEPHERDS", "1", 1);
+    setenv("QT_IO_URING", "0", 1);
+    setenv("QT_MIN_IO_WORKERS", "1", 1);
+    setenv("QT_MAX_IO_WORKERS", "1", 1);
+    assert(qthread_initialize() == 0);
+
+    run(appender);
+    qt_io_stats(&s);
+    iprintf("%lu jobs, %lu coalesced\n", (unsigned long)s.jobs, (unsigned long)s.coalesced);
+    assert(s.coalesced > 0);
+    check_records(streamfd, 'a');
+
+    coalesced = s.coalesced;
+    run(placer);
+    qt_io_stats(&s);
+    iprintf("%lu jobs, %lu coalesced\n", (unsigned long)s.jobs, (unsigned long)s.coalesced);
+    assert(s.coalesced > coalesced);
+    check_records(filefd, 'A');
+
+    /* one bad buffer among the coalesced writes */
+    coalesced = s.coalesced;
+    bad_task  = NUM_TASKS / 2;
+    run(placer);
+    qt_io_stats(&s);
+    iprintf("%lu jobs, %lu coalesced\n", (unsigned long)s.jobs, (unsigned long)s.coalesced);
+    assert(s.coalesced > coalesced);
+    assert(s.jobs == 3 * NUM_TASKS + 3);
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qt_syscalls.h>
+#include "argparsing.h"
+
+#define NUM_TASKS 32
+#define BLOCK     128
+
+static int  filefd;
+static int  pipefds[2];
+static char pipebuf[BLOCK];
+
+/* writes its own block of the file, then reads it back */
+static aligned_t block_rw(void *arg)
+{
+    const int i = (int)(intptr_t)arg;
+    char      out[BLOCK], in[BLOCK];
+
+    memset(out, 'a' + (i % 26), BLOCK);
+    assert(qt_pwrite(filefd, out, BLOCK, (off_t)i * BLOCK) == BLOCK);
+    memset(in, 0, BLOCK);
+    assert(qt_pread(filefd, in, BLOCK, (off_t)i * BLOCK) == BLOCK);
+    assert(memcmp(in, out, BLOCK) == 0);
+    return 0;
+}
+
+/* blocks on the empty pipe until pipe_writer() gets to run */
+static aligned_t pipe_reader(void *arg)
+{
+    struct pollfd pfd;
+    ssize_t       got = 0;
+
+    pfd.fd      = pipefds[0];
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+    assert(qt_poll(&pfd, 1, -1) == 1);
+    assert(pfd.revents & POLLIN);
+    while (got < BLOCK) {
+        ssize_t r = qt_read(pipefds[0], pipebuf + got, BLOCK - got);
+
+        assert(r > 0);
+        got += r;
+    }
+    return 0;
+}
+
+static aligned_t pipe_writer(void *arg)
+{
+    char out[BLOCK];
+
+    memset(out, 'z', BLOCK);
+    assert(qt_write(pipefds[1], out, BLOCK) == BLOCK);
+    return 0;
+}
+
+static void run_tests(void)
+{
+    aligned_t rets[NUM_TASKS + 2];
+    char      buf[8];
+
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(block_rw, (void *)(intptr_t)i, &rets[i]);
+    }
+    memset(pipebuf, 0, BLOCK);
+    qthread_fork(pipe_reader, NULL, &rets[NUM_TASKS]);
+    qthread_fork(pipe_writer, NULL, &rets[NUM_TASKS + 1]);
+    for (int i = 0; i < NUM_TASKS + 2; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    for (int i = 0; i < BLOCK; i++) {
+        assert(pipebuf[i] == 'z');
+    }
+
+    /* errors come back the way they would from the real call */
+    errno = 0;
+    assert(qt_read(pipefds[1] + 100, buf, sizeof(buf)) == -1);
+    assert(errno == EBADF);
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    char filename[] = "/tmp/qt_syscall_ioXXXXXX";
+
+    CHECK_VERBOSE();
+
+    filefd = mkstemp(filename);
+    assert(filefd >= 0);
+    unlink(filename);
+    assert(pipe(pipefds) == 0);
+
+    /* whatever backend the library picks by default... */
+    assert(qthread_initialize() == 0);
+    run_tests();
+    qthread_finalize();
+
+    /* ...and the proxy threads */
+    setenv("QT_IO_URING", "0", 1);
+    assert(qthread_initialize() == 0);
+    run_tests();
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
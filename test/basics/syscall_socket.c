@@ -0,0 +1,208 @@
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <qthread/qthread.h>
+#include <qthread/qt_syscalls.h>
+#include "argparsing.h"
+
+#define NUM_CONNS 32
+#define MSG       32
+#define BIG       (1024 * 1024)
+
+static int                listener;
+static struct sockaddr_in addr;
+static aligned_t          go;
+static aligned_t          echo_rets[NUM_CONNS];
+
+static void read_all(int   fd,
+                     char *buf)
+{
+    ssize_t got = 0;
+
+    while (got < MSG) {
+        ssize_t r = qt_read(fd, buf + got, MSG - got);
+
+        assert(r > 0);
+        got += r;
+    }
+}
+
+/* parks in qt_read() until its client gets the go-ahead */
+static aligned_t echo(void *arg)
+{
+    const int fd = (int)(intptr_t)arg;
+    char      buf[MSG];
+
+    read_all(fd, buf);
+    assert(qt_write(fd, buf, MSG) == MSG);
+    close(fd);
+    return 0;
+}
+
+static aligned_t server(void *arg)
+{
+    for (int i = 0; i < NUM_CONNS; i++) {
+        int fd = qt_accept(listener, NULL, NULL);
+
+        assert(fd >= 0);
+        qthread_fork(echo, (void *)(intptr_t)fd, &echo_rets[i]);
+    }
+    return 0;
+}
+
+static aligned_t client(void *arg)
+{
+    const int i = (int)(intptr_t)arg;
+    char      out[MSG], in[MSG];
+    int       s = socket(AF_INET, SOCK_STREAM, 0);
+
+    assert(s >= 0);
+    assert(qt_connect(s, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    qthread_readFF(NULL, &go);
+    memset(out, 'A' + (i % 26), MSG);
+    assert(qt_write(s, out, MSG) == MSG);
+    read_all(s, in);
+    assert(memcmp(in, out, MSG) == 0);
+    close(s);
+    return 0;
+}
+
+/* a non-blocking socket gets short writes and EAGAIN, not a task that waits
+ * for it to drain */
+static void fill_nonblocking(void)
+{
+    int     sv[2];
+    char   *big = calloc(BIG, 1);
+    ssize_t r, sent;
+
+    assert(big);
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    assert(fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK) == 0);
+    sent = qt_write(sv[0], big, BIG);
+    iprintf("short write of %ld bytes\n", (long)sent);
+    assert(sent > 0 && sent < BIG);
+    do {
+        errno = 0;
+        r     = qt_write(sv[0], big, BIG);
+        assert(r < BIG);
+        if (r > 0) { sent += r; }
+    } while (r > 0);
+    assert(r == -1);
+    assert(errno == EAGAIN || errno == EWOULDBLOCK);
+    /* everything that was counted as sent arrives */
+    assert(fcntl(sv[1], F_SETFL, fcntl(sv[1], F_GETFL) | O_NONBLOCK) == 0);
+    while ((r = read(sv[1], big, BIG)) > 0) {
+        sent -= r;
+    }
+    assert(sent == 0);
+    close(sv[0]);
+    close(sv[1]);
+    free(big);
+}
+
+static void run_tests(void)
+{
+    aligned_t          rets[NUM_CONNS + 1];
+    struct sockaddr_in closed;
+    socklen_t          len = sizeof(closed);
+    char               buf[8];
+    int                s;
+
+    /* every echo task is waiting to read before any client writes */
+    qthread_empty(&go);
+    qthread_fork(server, NULL, &rets[NUM_CONNS]);
+    for (int i = 0; i < NUM_CONNS; i++) {
+        qthread_fork(client, (void *)(intptr_t)i, &rets[i]);
+    }
+    qthread_readFF(NULL, &rets[NUM_CONNS]);
+    qthread_fill(&go);
+    for (int i = 0; i < NUM_CONNS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        qthread_readFF(NULL, &echo_rets[i]);
+    }
+
+    /* errors come back the way they would from the real calls */
+    s = socket(AF_INET, SOCK_STREAM, 0);
+    assert(s >= 0);
+    errno = 0;
+    assert(qt_read(s, buf, sizeof(buf)) == -1);
+    assert(errno == ENOTCONN);
+    /* a bound socket that is not listening refuses connections */
+    memset(&closed, 0, sizeof(closed));
+    closed.sin_family      = AF_INET;
+    closed.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(s, (struct sockaddr *)&closed, sizeof(closed)) == 0);
+    assert(getsockname(s, (struct sockaddr *)&closed, &len) == 0);
+    {
+        int c = socket(AF_INET, SOCK_STREAM, 0);
+
+        errno = 0;
+        assert(qt_connect(c, (struct sockaddr *)&closed, sizeof(closed)) == -1);
+        assert(errno == ECONNREFUSED);
+        close(c);
+    }
+    close(s);
+
+    fill_nonblocking();
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    socklen_t len = sizeof(addr);
+
+    CHECK_VERBOSE();
+
+#if !defined(QTHREAD_USE_IO_URING) && !defined(QTHREAD_USE_IO_EPOLL)
+    /* the proxy threads alone cannot hold all of the connections open */
+    iprintf("no io_uring or epoll reactor; skipping\n");
+    return 0;
+#endif
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    assert(listener >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+        (listen(listener, NUM_CONNS) != 0)) {
+        iprintf("no loopback networking; skipping\n");
+        return 0;
+    }
+    assert(getsockname(listener, (struct sockaddr *)&addr, &len) == 0);
+
+    /* whatever backend the library picks by default... */
+    assert(qthread_initialize() == 0);
+    run_tests();
+    qthread_finalize();
+
+#ifdef QTHREAD_USE_IO_EPOLL
+    /* ...and the reactor, which must not need a proxy thread per connection */
+    setenv("QT_IO_URING", "0", 1);
+    setenv("QT_MAX_IO_WORKERS", "1", 1);
+    assert(qthread_initialize() == 0);
+    run_tests();
+    qthread_finalize();
+#endif
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/socket.h>
+#include <qthread/qthread.h>
+#include <qthread/qt_syscalls.h>
+#include "argparsing.h"
+
+#define CHUNK 4096
+#define SIZE  (4 * CHUNK)
+
+static int srcfd;
+static int dstfd;
+static int pipefds[2];
+static int sockfds[2];
+
+static char pattern(off_t i)
+{
+    return 'a' + (char)((i * 7) % 26);
+}
+
+/* file -> pipe -> socket, without the data ever reaching this task */
+static aligned_t forwarder(void *arg)
+{
+    off_t off = 0;
+
+    while (off < SIZE) {
+        const off_t before = off;
+        ssize_t     in     = qt_splice(srcfd, &off, pipefds[1], NULL, CHUNK, 0);
+
+        assert(in > 0);
+        assert(off == before + in);
+        while (in > 0) {
+            ssize_t out = qt_splice(pipefds[0], NULL, sockfds[1], NULL, in, 0);
+
+            assert(out > 0);
+            in -= out;
+        }
+    }
+    return 0;
+}
+
+static aligned_t receiver(void *arg)
+{
+    char  buf[256];
+    off_t got = 0;
+
+    while (got < SIZE) {
+        ssize_t r = qt_read(sockfds[0], buf, sizeof(buf));
+
+        assert(r > 0);
+        for (ssize_t i = 0; i < r; i++) {
+            assert(buf[i] == pattern(got + i));
+        }
+        got += r;
+    }
+    return 0;
+}
+
+/* the second half of the source file, to the start of the destination */
+static aligned_t file_sender(void *arg)
+{
+    off_t off = SIZE / 2;
+
+    assert(lseek(dstfd, 0, SEEK_SET) == 0);
+    assert(qt_sendfile(dstfd, srcfd, &off, SIZE / 2) == SIZE / 2);
+    assert(off == SIZE);
+    return 0;
+}
+
+static aligned_t file_copier(void *arg)
+{
+    off_t   in = 0, out = SIZE / 2;
+    ssize_t r  = qt_copy_file_range(srcfd, &in, dstfd, &out, SIZE / 2, 0);
+
+    if (r < 0) {
+        /* not every kernel and filesystem can do it */
+        assert(errno == ENOSYS || errno == EXDEV || errno == EOPNOTSUPP || errno == EINVAL);
+        return 1;
+    }
+    assert(r == SIZE / 2);
+    assert(in == SIZE / 2 && out == SIZE);
+    return 0;
+}
+
+static void check_dst(int copied)
+{
+    char buf[SIZE];
+
+    assert(pread(dstfd, buf, SIZE, 0) == SIZE);
+    for (off_t i = 0; i < SIZE / 2; i++) {
+        assert(buf[i] == pattern(SIZE / 2 + i));
+        if (copied) {
+            assert(buf[SIZE / 2 + i] == pattern(i));
+        }
+    }
+}
+
+static void run_tests(void)
+{
+    aligned_t rets[2], ret;
+
+    qthread_fork(receiver, NULL, &rets[0]);
+    qthread_fork(forwarder, NULL, &rets[1]);
+    for (int i = 0; i < 2; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+
+    assert(ftruncate(dstfd, 0) == 0);
+    qthread_fork(file_sender, NULL, &ret);
+    qthread_readFF(NULL, &ret);
+    qthread_fork(file_copier, NULL, &ret);
+    qthread_readFF(&ret, &ret);
+    iprintf("copy_file_range %s\n", ret ? "unavailable" : "done");
+    check_dst(ret == 0);
+
+    /* errors come back like any other blocking call's */
+    errno = 0;
+    assert(qt_splice(srcfd, NULL, srcfd, NULL, CHUNK, 0) == -1);
+    assert(errno == EINVAL);
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    char src[] = "/tmp/qt_syscall_spliceXXXXXX";
+    char dst[] = "/tmp/qt_syscall_spliceXXXXXX";
+    char buf[SIZE];
+
+    CHECK_VERBOSE();
+
+    srcfd = mkstemp(src);
+    assert(srcfd >= 0);
+    unlink(src);
+    dstfd = mkstemp(dst);
+    assert(dstfd >= 0);
+    unlink(dst);
+    for (off_t i = 0; i < SIZE; i++) {
+        buf[i] = pattern(i);
+    }
+    assert(pwrite(srcfd, buf, SIZE, 0) == SIZE);
+    assert(pipe(pipefds) == 0);
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sockfds) == 0);
+
+    /* whatever backend the library picks by default... */
+    assert(qthread_initialize() == 0);
+    run_tests();
+    qthread_finalize();
+
+    /* ...and the proxy threads */
+    setenv("QT_IO_URING", "0", 1);
+    assert(qthread_initialize() == 0);
+    run_tests();
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <qthread/qthread.h>
+#include <qthread/qt_syscalls.h>
+#include "argparsing.h"
+
+#define NUM_TASKS 16
+#define HALF      32
+#define BLOCK     (2 * HALF)
+
+static int filefd;
+static int pipefds[2];
+static int sockfds[2];
+
+/* writes its own block of the file in two pieces, then reads it back */
+static aligned_t block_rwv(void *arg)
+{
+    const int    i = (int)(intptr_t)arg;
+    char         head[HALF], tail[HALF], in[BLOCK];
+    struct iovec iov[2];
+
+    memset(head, 'a' + (i % 26), HALF);
+    memset(tail, 'A' + (i % 26), HALF);
+    iov[0].iov_base = head;
+    iov[0].iov_len  = HALF;
+    iov[1].iov_base = tail;
+    iov[1].iov_len  = HALF;
+    assert(qt_pwritev(filefd, iov, 2, (off_t)i * BLOCK) == BLOCK);
+    memset(in, 0, BLOCK);
+    iov[0].iov_base = in;
+    iov[1].iov_base = in + HALF;
+    assert(qt_preadv(filefd, iov, 2, (off_t)i * BLOCK) == BLOCK);
+    assert(memcmp(in, head, HALF) == 0);
+    assert(memcmp(in + HALF, tail, HALF) == 0);
+    return 0;
+}
+
+/* blocks in readv() on the empty pipe until pipe_writer() gets to run */
+static aligned_t pipe_reader(void *arg)
+{
+    char         a[HALF], b[HALF];
+    struct iovec iov[2];
+    ssize_t      got;
+
+    iov[0].iov_base = a;
+    iov[0].iov_len  = HALF;
+    iov[1].iov_base = b;
+    iov[1].iov_len  = HALF;
+    got             = qt_readv(pipefds[0], iov, 2);
+    assert(got > 0);
+    while (got < BLOCK) {
+        ssize_t r = qt_read(pipefds[0], (got < HALF) ? a + got : b + got - HALF,
+                            (got < HALF) ? HALF - got : BLOCK - got);
+
+        assert(r > 0);
+        got += r;
+    }
+    for (int i = 0; i < HALF; i++) {
+        assert(a[i] == 'x' && b[i] == 'y');
+    }
+    return 0;
+}
+
+static aligned_t pipe_writer(void *arg)
+{
+    char         a[HALF], b[HALF];
+    struct iovec iov[2];
+
+    memset(a, 'x', HALF);
+    memset(b, 'y', HALF);
+    iov[0].iov_base = a;
+    iov[0].iov_len  = HALF;
+    iov[1].iov_base = b;
+    iov[1].iov_len  = HALF;
+    assert(qt_writev(pipefds[1], iov, 2) == BLOCK);
+    return 0;
+}
+
+static aligned_t msg_receiver(void *arg)
+{
+    char          hdr[4], body[HALF];
+    struct iovec  iov[2];
+    struct msghdr msg;
+
+    iov[0].iov_base = hdr;
+    iov[0].iov_len  = sizeof(hdr);
+    iov[1].iov_base = body;
+    iov[1].iov_len  = HALF;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = 2;
+    assert(qt_recvmsg(sockfds[0], &msg, 0) == sizeof(hdr) + HALF);
+    assert(memcmp(hdr, "HDR:", sizeof(hdr)) == 0);
+    for (int i = 0; i < HALF; i++) {
+        assert(body[i] == 'm');
+    }
+    return 0;
+}
+
+static aligned_t msg_sender(void *arg)
+{
+    char          body[HALF];
+    struct iovec  iov[2];
+    struct msghdr msg;
+
+    memset(body, 'm', HALF);
+    iov[0].iov_base = "HDR:";
+    iov[0].iov_len  = 4;
+    iov[1].iov_base = body;
+    iov[1].iov_len  = HALF;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = 2;
+    assert(qt_sendmsg(sockfds[1], &msg, 0) == 4 + HALF);
+    return 0;
+}
+
+/* one block for the whole batch, with one request that is bound to fail */
+static void batch_tests(void)
+{
+    qt_io_request_t reqs[NUM_TASKS + 1];
+    char            bufs[NUM_TASKS][HALF];
+
+    for (int i = 0; i < NUM_TASKS; i++) {
+        memset(bufs[i], '0' + (i % 10), HALF);
+        reqs[i].op     = QT_IO_PWRITE;
+        reqs[i].fd     = filefd;
+        reqs[i].buf    = bufs[i];
+        reqs[i].count  = HALF;
+        reqs[i].offset = (off_t)i * HALF;
+    }
+    reqs[NUM_TASKS]    = reqs[0];
+    reqs[NUM_TASKS].fd    = pipefds[1] + 100;
+    assert(qt_io_batch(reqs, NUM_TASKS + 1) == 1);
+    for (int i = 0; i < NUM_TASKS; i++) {
+        assert(reqs[i].ret == HALF);
+        assert(reqs[i].err == 0);
+    }
+    assert(reqs[NUM_TASKS].ret == -1);
+    assert(reqs[NUM_TASKS].err == EBADF);
+
+    memset(bufs, 0, sizeof(bufs));
+    for (int i = 0; i < NUM_TASKS; i++) {
+        reqs[i].op = QT_IO_PREAD;
+    }
+    reqs[NUM_TASKS].op = 42;
+    assert(qt_io_batch(reqs, NUM_TASKS + 1) == 1);
+    for (int i = 0; i < NUM_TASKS; i++) {
+        assert(reqs[i].ret == HALF);
+        for (int j = 0; j < HALF; j++) {
+            assert(bufs[i][j] == '0' + (i % 10));
+        }
+    }
+    assert(reqs[NUM_TASKS].ret == -1);
+    assert(reqs[NUM_TASKS].err == EINVAL);
+}
+
+static void run_tests(void)
+{
+    aligned_t rets[NUM_TASKS + 4];
+
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(block_rwv, (void *)(intptr_t)i, &rets[i]);
+    }
+    qthread_fork(pipe_reader, NULL, &rets[NUM_TASKS]);
+    qthread_fork(pipe_writer, NULL, &rets[NUM_TASKS + 1]);
+    qthread_fork(msg_receiver, NULL, &rets[NUM_TASKS + 2]);
+    qthread_fork(msg_sender, NULL, &rets[NUM_TASKS + 3]);
+    for (int i = 0; i < NUM_TASKS + 4; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    batch_tests();
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    char filename[] = "/tmp/qt_syscall_vectorXXXXXX";
+
+    CHECK_VERBOSE();
+
+    filefd = mkstemp(filename);
+    assert(filefd >= 0);
+    unlink(filename);
+    assert(pipe(pipefds) == 0);
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sockfds) == 0);
+
+    /* whatever backend the library picks by default... */
+    assert(qthread_initialize() == 0);
+    run_tests();
+    qthread_finalize();
+
+    /* ...and the proxy threads */
+    setenv("QT_IO_URING", "0", 1);
+    assert(qthread_initialize() == 0);
+    run_tests();
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,230 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <qthread/qthread.h>
+#include <qthread/qarena.h>
+#include "argparsing.h"
+
+#define NUM_TASKS 64
+#define PER_TASK  100
+#define BIG_TASKS 256
+#define BIG_SIZE  (1 << 20)
+
+typedef struct {
+    aligned_t id;
+    double    value;
+} item_t;
+
+static qarena   *shared;
+static item_t   *items[NUM_TASKS][PER_TASK];
+static qarena   *team_arenas[NUM_TASKS];
+static aligned_t team_members;
+
+static aligned_t fill_shared(void *arg)
+{
+    const aligned_t id = (aligned_t)(uintptr_t)arg;
+
+    for (int i = 0; i < PER_TASK; i++) {
+        item_t *it = QARENA_NEW(shared, item_t);
+
+        assert(it);
+        assert(((uintptr_t)it & 15) == 0);
+        it->id       = id;
+        it->value    = i;
+        items[id][i] = it;
+    }
+    return 0;
+}
+
+static aligned_t use_task_arena(void *arg)
+{
+    qarena *a = qarena_task();
+    int    *v;
+
+    assert(a);
+    assert(qarena_task() == a);
+    v = QARENA_NEW_ARRAY(a, int, 1000);
+    assert(v);
+    for (int i = 0; i < 1000; i++) v[i] = i;
+    for (int i = 0; i < 1000; i++) assert(v[i] == i);
+    return 0;
+}
+
+/* each of these would leak BIG_SIZE bytes if its arena outlived it */
+static aligned_t touch_task_arena(void *arg)
+{
+    qarena *a = qarena_task();
+    char   *p;
+
+    assert(a);
+    p = qarena_alloc(a, BIG_SIZE);
+    assert(p);
+    memset(p, 1, BIG_SIZE);
+    return 0;
+}
+
+static long max_rss_kb(void)
+{
+    struct rusage ru;
+
+    assert(getrusage(RUSAGE_SELF, &ru) == 0);
+    return ru.ru_maxrss;
+}
+
+static void *not_a_task(void *arg)
+{
+    *(qarena **)arg = qarena_task();
+    return NULL;
+}
+
+static aligned_t team_member(void *arg)
+{
+    const aligned_t id = (aligned_t)(uintptr_t)arg;
+    qarena         *a  = qarena_team();
+    aligned_t      *v;
+
+    assert(a);
+    v = QARENA_NEW(a, aligned_t);
+    assert(v);
+    *v              = id;
+    team_arenas[id] = a;
+    qthread_incr(&team_members, 1);
+    return 0;
+}
+
+static aligned_t team_leader(void *arg)
+{
+    aligned_t rets[NUM_TASKS];
+
+    assert(qarena_team() != NULL);
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(team_member, (void *)(uintptr_t)i, &rets[i]);
+    }
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    /* every member saw the same arena */
+    for (int i = 1; i < NUM_TASKS; i++) {
+        assert(team_arenas[i] == team_arenas[0]);
+    }
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t rets[NUM_TASKS];
+    aligned_t leader_ret;
+    qarena   *a;
+    char     *p, *big;
+
+    assert(qthread_initialize() == 0);
+
+    CHECK_VERBOSE();
+
+    /* basic allocation and alignment */
+    a = qarena_create(1024);
+    assert(a);
+    for (int i = 1; i < 200; i++) {
+        p = qarena_alloc(a, i);
+        assert(p);
+        assert(((uintptr_t)p & 15) == 0);
+        memset(p, i, i);
+    }
+    p = qarena_alloc_aligned(a, 100, 256);
+    assert(p);
+    assert(((uintptr_t)p & 255) == 0);
+    memset(p, 0, 100);
+
+    /* larger than a chunk */
+    big = qarena_alloc(a, 1 << 20);
+    assert(big);
+    memset(big, 0xff, 1 << 20);
+
+    qarena_reset(a);
+    p = qarena_alloc(a, 64);
+    assert(p);
+    memset(p, 0, 64);
+    qarena_destroy(a);
+    iprintf("basic allocation passed\n");
+
+    /* concurrent allocation from one arena */
+    shared = qarena_create(4096);
+    assert(shared);
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(fill_shared, (void *)(uintptr_t)i, &rets[i]);
+    }
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    for (int i = 0; i < NUM_TASKS; i++) {
+        for (int j = 0; j < PER_TASK; j++) {
+            assert(items[i][j]->id == (aligned_t)i);
+            assert(items[i][j]->value == j);
+        }
+    }
+    qarena_destroy(shared);
+    iprintf("concurrent allocation passed\n");
+
+    /* task arenas, released when each task exits */
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(use_task_arena, NULL, &rets[i]);
+    }
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    iprintf("task arenas passed\n");
+
+    /* one task at a time, so only a leaked arena can raise the peak by more
+     * than a task's worth */
+    {
+        long before, after;
+
+        touch_task_arena(NULL); /* the first big chunk sets malloc's thresholds */
+        before = max_rss_kb();
+        for (int i = 0; i < BIG_TASKS; i++) {
+            qthread_fork(touch_task_arena, NULL, &rets[0]);
+            qthread_readFF(NULL, &rets[0]);
+        }
+        for (int i = 0; i < BIG_TASKS; i++) {
+            qthread_spawn(touch_task_arena, NULL, 0, &rets[0], 0, NULL,
+                          NO_SHEPHERD, QTHREAD_SPAWN_SIMPLE);
+            qthread_readFF(NULL, &rets[0]);
+        }
+        after = max_rss_kb();
+        iprintf("peak RSS %ldkB before, %ldkB after %i tasks of %ikB\n",
+                before, after, 2 * BIG_TASKS, BIG_SIZE >> 10);
+        assert(after - before < (long)(BIG_TASKS / 4) * (BIG_SIZE >> 10));
+    }
+    iprintf("task arena release passed\n");
+
+    /* only tasks have one */
+    {
+        pthread_t ext;
+        qarena   *ext_arena = (qarena *)&ext_arena;
+
+        assert(pthread_create(&ext, NULL, not_a_task, &ext_arena) == 0);
+        assert(pthread_join(ext, NULL) == 0);
+        assert(ext_arena == NULL);
+    }
+    iprintf("non-task arena passed\n");
+
+    /* a team arena, released when the team finishes */
+    assert(qarena_team() == NULL);
+    qthread_fork_new_team(team_leader, NULL, &leader_ret);
+    qthread_readFF(NULL, &leader_ret);
+    assert(team_members == NUM_TASKS);
+    iprintf("team arena passed\n");
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include <assert.h>
 #include <qthread/qthread.h>
 #include <qthread/qpool.h>
@@ -47,6 +49,7 @@ int main(int argc,
         fprintf(stderr, "qpool_create() failed!\n");
         exit(-1);
     }
+    qpool_set_name(qp, "test_pool");
 
     if ((rets = (aligned_t *)qpool_alloc(qp)) == NULL) {
         fprintf(stderr, "qpool_alloc() failed!\n");
@@ -70,9 +73,41 @@ int main(int argc,
             exit(-2);
         }
     }
+    {
+        qpool_stats_t stats;
+        qpool_stats(qp, &stats);
+        iprintf("outstanding: %lu, blocks: %lu\n", (unsigned long)stats.outstanding, (unsigned long)stats.blocks);
+        assert(stats.outstanding == ELEMENT_COUNT);
+        assert(stats.blocks * stats.items_per_block >= ELEMENT_COUNT);
+    }
     for (i = 0; i < ELEMENT_COUNT; i++) {
         qpool_free(qp, allthat[i]);
     }
+    {
+        qpool_stats_t stats;
+        qpool_stats(qp, &stats);
+        assert(stats.outstanding == 0);
+        assert(stats.allocs == stats.frees);
+        assert(stats.cached + stats.reusable >= ELEMENT_COUNT);
+    }
+    {
+        size_t released = qpool_trim(qp);
+        iprintf("trimmed: %lu bytes\n", (unsigned long)released);
+        assert(ELEMENT_COUNT < 10000 || released > 0);
+    }
+    /* trimmed blocks must be usable again */
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        if ((allthat[i] = (aligned_t *)qpool_alloc(qp)) == NULL) {
+            fprintf(stderr, "qpool_alloc() failed after trim!\n");
+            exit(-2);
+        }
+        *allthat[i] = i;
+    }
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        assert(*allthat[i] == i);
+        qpool_free(qp, allthat[i]);
+    }
+    qpool_trim_all();
     free(allthat);
 
     rets = (aligned_t *)malloc(sizeof(aligned_t) * THREAD_COUNT);
@@ -85,6 +120,41 @@ int main(int argc,
     }
     free(rets);
 
+    {
+        size_t         npools = qpool_stats_all(NULL, 0);
+        qpool_stats_t *all    = malloc(sizeof(qpool_stats_t) * npools);
+        int            found  = 0;
+        char           filename[] = "/tmp/qt_qpool_statsXXXXXX";
+        char           line[256];
+        int            fd;
+        FILE          *fp;
+
+        assert(all != NULL);
+        npools = qpool_stats_all(all, npools);
+        for (i = 0; i < npools; i++) {
+            if (all[i].name && (strcmp(all[i].name, "test_pool") == 0)) {
+                assert(all[i].outstanding == 0);
+                found = 1;
+            }
+        }
+        assert(found);
+        free(all);
+
+        fd = mkstemp(filename);
+        assert(fd >= 0);
+        close(fd);
+        assert(qpool_stats_dump(filename) == QTHREAD_SUCCESS);
+        fp = fopen(filename, "r");
+        assert(fp);
+        found = 0;
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "test_pool,", 10) == 0) { found = 1; }
+        }
+        fclose(fp);
+        unlink(filename);
+        assert(found);
+    }
+
     qpool_destroy(qp);
 
     iprintf("success!\n");
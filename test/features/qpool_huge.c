@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qpool.h>
+#include "argparsing.h"
+
+#define NUM_TASKS     256
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+static aligned_t touch_stack(void *arg)
+{
+    volatile char buf[512];
+
+    memset((char *)buf, 1, sizeof(buf));
+    return buf[(uintptr_t)arg % sizeof(buf)];
+}
+
+/* Returns the number of pages in the hugetlb reserve, or -1 if unknown. */
+static long hugetlb_reserve(void)
+{
+    FILE *fp = fopen("/proc/sys/vm/nr_hugepages", "r");
+    long  ret = -1;
+
+    if (fp) {
+        if (fscanf(fp, "%ld", &ret) != 1) { ret = -1; }
+        fclose(fp);
+    }
+    return ret;
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    aligned_t      rets[NUM_TASKS];
+    qpool_stats_t *stats;
+    size_t         npools;
+    int            found = 0;
+    const long     reserve = hugetlb_reserve();
+
+    setenv("QT_HUGEPAGES", "explicit", 1);
+    unsetenv("QT_HUGEPAGE_SIZE");
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+
+    /* enough tasks to need blocks from both pools */
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(touch_stack, (void *)(uintptr_t)i, &rets[i]);
+    }
+    for (int i = 0; i < NUM_TASKS; i++) {
+        qthread_readFF(NULL, &rets[i]);
+        assert(rets[i] == 1);
+    }
+
+    npools = qpool_stats_all(NULL, 0);
+    stats  = calloc(npools, sizeof(qpool_stats_t));
+    assert(stats);
+    npools = qpool_stats_all(stats, npools);
+    for (size_t i = 0; i < npools; i++) {
+        qpool_stats_t *s = &stats[i];
+
+        if ((s->name == NULL) ||
+            (strcmp(s->name, "generic_stack_pool") && strcmp(s->name, "generic_qthread_pool"))) {
+            continue;
+        }
+        iprintf("%s: huge_pages %u, %lu blocks of %lu bytes, %lu items of %lu bytes\n",
+                s->name, s->huge_pages, (unsigned long)s->blocks, (unsigned long)s->block_bytes,
+                (unsigned long)s->items_per_block, (unsigned long)s->item_size);
+        found++;
+        if (s->huge_pages == 0) {
+            iprintf("built without huge page support; skipping\n");
+            return 77;
+        }
+        assert(s->blocks > 0);
+        /* each block is whole huge pages, filled with items but for the
+         * slack and a node header, neither of which is bigger than an item */
+        assert(s->block_bytes % HUGEPAGE_SIZE == 0);
+        assert(s->items_per_block * s->item_size <= s->block_bytes);
+        assert((s->items_per_block + 2) * s->item_size > s->block_bytes);
+        if (reserve == 0) {
+            /* nothing to map from, so the pool must have fallen back */
+            assert(s->huge_pages == 1);
+        }
+    }
+    iprintf("hugetlb reserve: %ld pages; %i pools checked\n", reserve, found);
+    assert(found == 2);
+    free(stats);
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qpool.h>
+#include "argparsing.h"
+
+#define NUM_ITEMS 4096
+#define ITEM_SIZE 64
+
+static qpool *pool;
+static void  *set0[NUM_ITEMS], *set1[NUM_ITEMS], *again[NUM_ITEMS];
+
+static aligned_t alloc_all(void *arg)
+{
+    void **items = (void **)arg;
+
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        items[i] = qpool_alloc(pool);
+        assert(items[i]);
+        memset(items[i], i & 0xff, ITEM_SIZE);
+    }
+    return 0;
+}
+
+static aligned_t free_all(void *arg)
+{
+    void **items = (void **)arg;
+
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        qpool_free(pool, items[i]);
+    }
+    return 0;
+}
+
+static void run_on(qthread_f                   f,
+                   void                       *arg,
+                   const qthread_shepherd_id_t shep)
+{
+    aligned_t ret;
+
+    assert(qthread_fork_to(f, arg, &ret, shep) == QTHREAD_SUCCESS);
+    qthread_readFF(NULL, &ret);
+}
+
+static int ptrcmp(const void *a,
+                  const void *b)
+{
+    const void *x = *(void *const *)a, *y = *(void *const *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/* how many of items are in the (sorted) set */
+static int count_in(void *const *items,
+                    void       **set)
+{
+    int found = 0;
+
+    for (int i = 0; i < NUM_ITEMS; i++) {
+        if (bsearch(&items[i], set, NUM_ITEMS, sizeof(void *), ptrcmp)) { found++; }
+    }
+    return found;
+}
+
+#ifdef __INTEL_COMPILER
+int setenv(const char *name,
+           const char *value,
+           int         overwrite);
+#endif
+
+int main(int   argc,
+         char *argv[])
+{
+    qpool_stats_t s;
+    size_t        blocks;
+    int           reused;
+
+    /* two arenas, one per shepherd, whatever the machine looks like */
+    setenv("QT_MPOOL_NODES", "2", 1);
+    setenv("QT_NUM_SHEPHERDS", "2", 1);
+    setenv("QT_NUM_WORKERS_PER_SHEPHERD", "1", 1);
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    assert(qthread_num_shepherds() == 2);
+
+    pool = qpool_create(ITEM_SIZE);
+    assert(pool);
+    qpool_stats(pool, &s);
+    iprintf("%lu items of %lu bytes in blocks of %lu bytes\n",
+            (unsigned long)s.items_per_block, (unsigned long)s.item_size,
+            (unsigned long)s.block_bytes);
+    if (s.block_bytes == s.items_per_block * s.item_size) {
+        iprintf("pool was not split into arenas; skipping\n");
+        return 77;
+    }
+
+    run_on(alloc_all, set0, 0);
+    run_on(alloc_all, set1, 1);
+    qsort(set0, NUM_ITEMS, sizeof(void *), ptrcmp);
+    assert(count_in(set1, set0) == 0);
+
+    /* shepherd 1 frees shepherd 0's items; they go back to node 0, so
+     * shepherd 1 does not get them back... */
+    run_on(free_all, set0, 1);
+    run_on(alloc_all, again, 1);
+    assert(count_in(again, set0) == 0);
+    run_on(free_all, again, 1);
+
+    /* ...and shepherd 0 reuses them rather than mapping more blocks */
+    qpool_stats(pool, &s);
+    blocks = s.blocks;
+    run_on(alloc_all, again, 0);
+    reused = count_in(again, set0);
+    qpool_stats(pool, &s);
+    iprintf("%lu blocks before, %lu after; %i of %i items reused\n",
+            (unsigned long)blocks, (unsigned long)s.blocks, reused, NUM_ITEMS);
+    assert(s.blocks == blocks);
+    assert(reused >= NUM_ITEMS - (int)s.items_per_block);
+
+    run_on(free_all, again, 0);
+    run_on(free_all, set1, 0);
+    qpool_stats(pool, &s);
+    assert(s.outstanding == 0);
+    qpool_destroy(pool);
+
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/stream.h>
+#include "argparsing.h"
+
+static size_t chunk_size = 256;
+static size_t depth      = 4;
+static size_t nchunks    = 37;
+static size_t tail       = 100; /* the last chunk is short */
+
+static qt_stream_t       *stream;
+static qt_stream_chunk_t *chunks;
+static aligned_t         *rets;
+
+static uint8_t pattern(off_t offset)
+{
+    return (uint8_t)((offset * 7) % 251);
+}
+
+/* works on one chunk while the stream reads ahead */
+static aligned_t process(void *arg)
+{
+    qt_stream_chunk_t *c = (qt_stream_chunk_t *)arg;
+    const uint8_t     *p = c->data;
+
+    for (size_t i = 0; i < c->len; i++) {
+        assert(p[i] == pattern(c->offset + (off_t)i));
+    }
+    qt_stream_release(stream, c);
+    return 0;
+}
+
+static size_t read_file(int   fd,
+                        off_t offset)
+{
+    size_t  n = 0, bytes = 0;
+    ssize_t len;
+
+    stream = qt_stream_open(fd, offset, chunk_size, depth);
+    assert(stream != NULL);
+    while ((len = qt_stream_next(stream, &chunks[n])) > 0) {
+        assert(chunks[n].offset == offset + (off_t)(n * chunk_size));
+        assert((size_t)len == chunks[n].len);
+        bytes += len;
+        qthread_fork(process, &chunks[n], &rets[n]);
+        n++;
+    }
+    assert(len == 0);
+    /* the end stays the end */
+    assert(qt_stream_next(stream, &chunks[n]) == 0);
+    for (size_t i = 0; i < n; i++) {
+        qthread_readFF(NULL, &rets[i]);
+    }
+    assert(qt_stream_close(stream) == QTHREAD_SUCCESS);
+    return bytes;
+}
+
+static aligned_t waiting;
+
+static aligned_t next_chunk(void *arg)
+{
+    qthread_incr(&waiting, 1);
+    return (aligned_t)qt_stream_next(stream, (qt_stream_chunk_t *)arg);
+}
+
+/* with every buffer held, the next reader waits for the right one to come
+ * back, however the others are released */
+static void held_chunks(int fd)
+{
+    aligned_t ret;
+
+    stream = qt_stream_open(fd, 0, chunk_size, depth);
+    assert(stream != NULL);
+    for (size_t i = 0; i < depth; i++) {
+        assert(qt_stream_next(stream, &chunks[i]) == (ssize_t)chunk_size);
+    }
+    qthread_fork(next_chunk, &chunks[depth], &ret);
+    while (!waiting) qthread_yield();
+    for (size_t i = depth; i > 0; i--) {
+        qt_stream_release(stream, &chunks[i - 1]);
+    }
+    qthread_readFF(NULL, &ret);
+    assert(ret == chunk_size);
+    assert(chunks[depth].offset == (off_t)(depth * chunk_size));
+    qt_stream_release(stream, &chunks[depth]);
+    assert(qt_stream_close(stream) == QTHREAD_SUCCESS);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    char    filename[] = "/tmp/qt_streamXXXXXX";
+    size_t  size;
+    uint8_t buf[256];
+    int     fd;
+
+    assert(qthread_initialize() == 0);
+    NUMARG(chunk_size, "CHUNK_SIZE");
+    NUMARG(depth, "DEPTH");
+    NUMARG(nchunks, "NUM_CHUNKS");
+    CHECK_VERBOSE();
+    size = nchunks * chunk_size + tail;
+    iprintf("%lu bytes in chunks of %lu, %lu ahead\n", (unsigned long)size, (unsigned long)chunk_size, (unsigned long)depth);
+
+    fd = mkstemp(filename);
+    assert(fd >= 0);
+    for (size_t off = 0; off < size; off += sizeof(buf)) {
+        const size_t n = (size - off < sizeof(buf)) ? size - off : sizeof(buf);
+
+        for (size_t i = 0; i < n; i++) {
+            buf[i] = pattern((off_t)(off + i));
+        }
+        assert(pwrite(fd, buf, n, (off_t)off) == (ssize_t)n);
+    }
+    /* every chunk, plus the end */
+    chunks = malloc((size / chunk_size + 2) * sizeof(qt_stream_chunk_t));
+    rets   = malloc((size / chunk_size + 2) * sizeof(aligned_t));
+    assert(chunks && rets);
+
+    assert(read_file(fd, 0) == size);
+    /* starting partway in */
+    assert(read_file(fd, (off_t)(chunk_size / 2 + 1)) == size - (chunk_size / 2 + 1));
+    assert(read_file(fd, (off_t)size) == 0);
+    if (nchunks > depth) {
+        held_chunks(fd);
+    }
+
+    /* errors come back with the chunk they belong to */
+    close(fd);
+    fd = open(filename, O_WRONLY);
+    assert(fd >= 0);
+    unlink(filename);
+    stream = qt_stream_open(fd, 0, chunk_size, depth);
+    assert(stream != NULL);
+    errno = 0;
+    assert(qt_stream_next(stream, &chunks[0]) == -1);
+    assert(errno == EBADF);
+    assert(qt_stream_close(stream) == QTHREAD_SUCCESS);
+    close(fd);
+
+    errno = 0;
+    assert(qt_stream_open(-1, 0, chunk_size, depth) == NULL);
+    assert(errno == EINVAL);
+    assert(qt_stream_open(0, 0, chunk_size, 0) == NULL);
+
+    free(chunks);
+    free(rets);
+    iprintf("Success!\n");
+    return 0;
+}
+
+/* vim:set expandtab */